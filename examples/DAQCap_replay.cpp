@@ -0,0 +1,462 @@
+/**
+ * @file DAQCap_replay.cpp
+ *
+ * @brief A standalone program that replays a recorded run at a controlled
+ * rate, for testing the capture path and monitoring programs without
+ * detector hardware.
+ *
+ * Runs recorded to .dat, chunked, pcap or pcapng files can be replayed. The
+ * frames of the run can be sent out of a network interface, to be captured
+ * again, and the blobs they make can be published to monitoring programs
+ * just as they are during a live capture.
+ *
+ * @author Robert Myers
+ * Contact: romyers@umich.edu
+ */
+
+#include <Replay.h>
+#include <FrameInjector.h>
+#include <SharedRing.h>
+#include <StreamServer.h>
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <limits>
+
+#include <getopt.h>
+
+using std::string;
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+using DAQCap::DataBlob;
+using DAQCap::Frame;
+
+// How often to publish a blob of replayed frames
+const std::chrono::milliseconds PUBLISH_INTERVAL(100);
+
+// Holds the command-line arguments
+struct Arguments {
+
+	// The recorded run to replay
+	string inPath;
+
+	// Send frames out of this network interface, or not at all if empty
+	string interfaceName;
+
+	// Publish blobs to monitoring processes through this shared memory
+	// ring, or not at all if empty
+	string ringName;
+
+	// Stream blobs to local subscribers through a Unix domain socket at
+	// this path, or not at all if empty
+	string socketPath;
+
+	// The multiple of the original speed to replay at, or 0 for as fast as
+	// possible
+	double speed = 1;
+
+	// Replay at this many MB/s instead, if nonzero
+	double rateMB = 0;
+
+	// The number of data words in each frame made from a .dat or chunked
+	// file
+	int frameWords = 256;
+
+	// The maximum number of frames to replay
+	uint64_t maxFrames = std::numeric_limits<uint64_t>::max();
+
+	// Whether the help option was specified
+	bool help = false;
+
+	/// Whether valid arguments were specified
+	bool valid = true;
+
+};
+
+// Parses command-line arguments
+Arguments parseArguments(int argc, char **argv);
+
+// Print the help message
+void printHelp(std::ostream &os);
+
+int main(int argc, char **argv) {
+
+	///////////////////////////////////////////////////////////////////////////
+	// Parse CL arguments and handle help/invalid
+	///////////////////////////////////////////////////////////////////////////
+
+	Arguments args = parseArguments(argc, argv);
+
+	if(!args.valid || args.help) {
+
+		printHelp(cout);
+
+		return 0;
+
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	// Open the run and the outputs
+	///////////////////////////////////////////////////////////////////////////
+
+	std::unique_ptr<DAQCap::FrameSource> source;
+	std::unique_ptr<DAQCap::FramePacer> pacer;
+
+	std::unique_ptr<DAQCap::FrameInjector> injector;
+	std::unique_ptr<DAQCap::SharedRingPublisher> ring;
+	std::unique_ptr<DAQCap::StreamServer> server;
+
+	try {
+
+		DAQCap::FrameSourceOptions sourceOptions;
+		sourceOptions.frameWords = args.frameWords;
+
+		source = DAQCap::FrameSource::open(args.inPath, sourceOptions);
+
+		pacer.reset(new DAQCap::FramePacer(args.speed, args.rateMB * 1e6));
+
+		if(!args.interfaceName.empty()) {
+
+			injector.reset(new DAQCap::FrameInjector(args.interfaceName));
+
+		}
+
+		if(!args.ringName.empty()) {
+
+			ring.reset(new DAQCap::SharedRingPublisher(args.ringName));
+
+		}
+
+		if(!args.socketPath.empty()) {
+
+			server.reset(new DAQCap::StreamServer(args.socketPath));
+
+		}
+
+	} catch(const std::exception &e) {
+
+		cerr << e.what() << endl;
+		cout << "Aborted replay!" << endl;
+
+		return 1;
+
+	}
+
+	// Untimed runs can only be paced by data rate
+	if(!source->timed() && args.rateMB == 0 && args.speed != 0) {
+
+		cout << args.inPath << " has no timing, so it will be replayed as"
+			 << " fast as possible. Use -b to set a data rate." << endl;
+
+	}
+
+	cout << "Replaying run: " << args.inPath << endl;
+
+	///////////////////////////////////////////////////////////////////////////
+	// Replay the run
+	///////////////////////////////////////////////////////////////////////////
+
+	DAQCap::FrameBlobBuilder builder;
+	DataBlob blob;
+
+	bool publishing = ring || server;
+
+	auto publish = [&]() {
+
+		builder.build(blob);
+
+		// Like the capture, keep replaying if a monitor can't be reached
+		try {
+
+			if(ring) ring->publish(blob);
+			if(server) server->publish(blob);
+
+		} catch(const std::exception &e) {
+
+			cerr << "Failed to publish blob: " << e.what() << endl;
+
+		}
+
+	};
+
+	std::chrono::steady_clock::time_point lastPublish
+		= std::chrono::steady_clock::now();
+
+	uint64_t frames = 0;
+	uint64_t bytes = 0;
+
+	Frame frame;
+
+	try {
+
+		while(frames < args.maxFrames && source->next(frame)) {
+
+			pacer->wait(frame);
+
+			if(injector) {
+
+				injector->inject(
+					DAQCap::ByteView(frame.bytes.data(), frame.bytes.size())
+				);
+
+			}
+
+			if(publishing) {
+
+				builder.add(frame);
+
+				std::chrono::steady_clock::time_point now
+					= std::chrono::steady_clock::now();
+
+				if(now - lastPublish >= PUBLISH_INTERVAL) {
+
+					publish();
+
+					lastPublish = now;
+
+				}
+
+			}
+
+			++frames;
+			bytes += frame.bytes.size();
+
+		}
+
+		if(publishing && builder.size() > 0) publish();
+
+	} catch(const std::exception &e) {
+
+		cerr << e.what() << endl;
+		cout << "Aborted replay after " << frames << " frames!" << endl;
+
+		return 1;
+
+	}
+
+	cout << "Replayed " << frames << " frames (" << bytes << " bytes)."
+		 << endl;
+
+	return 0;
+
+}
+
+Arguments parseArguments(int argc, char **argv) {
+
+	Arguments args;
+
+	// Define arguments
+	const char *shortOpts = "f:i:s:l:x:b:w:m:h";
+	const struct option longOpts[] = {
+		{"file", required_argument, nullptr, 'f'},
+		{"interface", required_argument, nullptr, 'i'},
+		{"shm", required_argument, nullptr, 's'},
+		{"listen", required_argument, nullptr, 'l'},
+		{"speed", required_argument, nullptr, 'x'},
+		{"rate", required_argument, nullptr, 'b'},
+		{"frame-words", required_argument, nullptr, 'w'},
+		{"max-frames", required_argument, nullptr, 'm'},
+		{"help", no_argument, nullptr, 'h'},
+		{nullptr, 0, nullptr, 0}
+	};
+
+	// Handle arguments
+	while(optind < argc) {
+
+		int opt = getopt_long(argc, argv, shortOpts, longOpts, nullptr);
+
+		if(opt == -1) break;
+
+		switch(opt) {
+
+			case 'f':
+				args.inPath = optarg;
+				break;
+
+			case 'i':
+				args.interfaceName = optarg;
+				break;
+
+			case 's':
+				args.ringName = optarg;
+				break;
+
+			case 'l':
+				args.socketPath = optarg;
+				break;
+
+			case 'x':
+				try {
+
+					args.speed = std::stod(optarg);
+
+				} catch(std::invalid_argument &e) {
+
+					args.speed = -1;
+
+				}
+
+				if(args.speed < 0) {
+
+					cerr << "-x, --speed must take a multiple of the"
+						 << " original speed, or 0."
+						 << endl;
+
+					args.valid = false;
+
+				}
+				break;
+
+			case 'b':
+				try {
+
+					args.rateMB = std::stod(optarg);
+
+				} catch(std::invalid_argument &e) {
+
+					args.rateMB = -1;
+
+				}
+
+				if(args.rateMB <= 0) {
+
+					cerr << "-b, --rate must take a positive number of MB/s."
+						 << endl;
+
+					args.valid = false;
+
+				}
+				break;
+
+			case 'w':
+				try {
+
+					args.frameWords = std::stoi(optarg);
+
+				} catch(std::invalid_argument &e) {
+
+					args.frameWords = -1;
+
+				}
+
+				if(args.frameWords <= 0) {
+
+					cerr << "-w, --frame-words must take a positive integer."
+						 << endl;
+
+					args.valid = false;
+
+				}
+				break;
+
+			case 'm':
+				try {
+
+					args.maxFrames = std::stoull(optarg);
+
+				} catch(std::invalid_argument &e) {
+
+					cerr << "-m, --max-frames must take an integer argument."
+						 << endl;
+
+					args.valid = false;
+
+				}
+				break;
+
+			case 'h':
+				args.help = true;
+				break;
+
+			default:
+				args.valid = false;
+
+		}
+
+	}
+
+	if(args.inPath.empty()) {
+
+		cerr << "-f, --file is required." << endl;
+
+		args.valid = false;
+
+	}
+
+	if(args.interfaceName.empty()
+		&& args.ringName.empty()
+		&& args.socketPath.empty()) {
+
+		cerr << "At least one of -i, -s or -l is required." << endl;
+
+		args.valid = false;
+
+	}
+
+	return args;
+
+}
+
+void printHelp(std::ostream &os) {
+
+	os << "A standalone program that replays a recorded run at a controlled\n"
+	   << "rate, for testing without detector hardware.\n"
+	   << endl;
+
+	os << "Usage:" << endl;
+	os << "ereplay -f run_file [-i interface] [-s shm_name] [-l socket_path]\n"
+	   << "        [-x speed | -b rate_mb] [-w frame_words] [-m max_frames]"
+	   << " [-h]\n"
+	   << endl;
+
+	os << "Options:"
+	   << endl;
+
+	os << "\t-h, --help        Display this help message."
+	   << endl;
+
+	os << "\t-f, --file        The run to replay. May be a .dat, chunked,\n"
+	   << "\t                  pcap or pcapng file."
+	   << endl;
+
+	os << "\t-i, --interface   Send the frames of the run out of the given\n"
+	   << "\t                  network interface, to be captured again.\n"
+	   << "\t                  Usually needs root."
+	   << endl;
+
+	os << "\t-s, --shm         Publish blobs of replayed frames to a shared\n"
+	   << "\t                  memory ring with the given name, as the\n"
+	   << "\t                  capture program does."
+	   << endl;
+
+	os << "\t-l, --listen      Stream blobs of replayed frames to local\n"
+	   << "\t                  programs that connect to a Unix domain socket\n"
+	   << "\t                  at the given path, as the capture program\n"
+	   << "\t                  does."
+	   << endl;
+
+	os << "\t-x, --speed       Replay at this multiple of the speed the run\n"
+	   << "\t                  was captured at, or as fast as possible if 0.\n"
+	   << "\t                  Defaults to 1. .dat files have no timing, so\n"
+	   << "\t                  they replay as fast as possible unless -b is\n"
+	   << "\t                  given."
+	   << endl;
+
+	os << "\t-b, --rate        Replay at a fixed rate of rate_mb MB/s\n"
+	   << "\t                  instead."
+	   << endl;
+
+	os << "\t-w, --frame-words Number of data words in each frame made\n"
+	   << "\t                  from a .dat or chunked file. Defaults to\n"
+	   << "\t                  256. pcap and pcapng frames are replayed as\n"
+	   << "\t                  they were captured."
+	   << endl;
+
+	os << "\t-m, --max-frames  Stop after replaying this many frames."
+	   << endl;
+
+}
@@ -12,11 +12,19 @@
  */
 
 #include <DAQCap.h>
+#include <BlobWriter.h>
+#include <FileSink.h>
+#include <RotatingFileSink.h>
+#include <ChunkedFile.h>
+#include <SharedRing.h>
+#include <StreamServer.h>
 
 #include <cstring>
+#include <cstdio>
 #include <algorithm>
 #include <iostream>
-#include <fstream>
+#include <memory>
+#include <thread>
 
 #include <getopt.h>
 
@@ -31,6 +39,19 @@ using std::endl;
 using DAQCap::Device;
 using DAQCap::DataBlob;
 
+// How much disk space to reserve at a time in direct I/O mode
+const uint64_t RUN_FILE_EXTENT = uint64_t(1) << 30;
+
+// The smallest blobs the device's blob pool is sized for when chunks hold
+// on to them. Smaller blobs only come from slow captures, where allocating
+// their buffers costs nothing that matters.
+const uint64_t POOLED_BLOB_BYTES = 64 << 10;
+
+// How many stream subscribers the device's blob pool is sized for. Each one
+// may hold an old blob while it is partway through sending it; beyond this,
+// those blobs just get unpooled buffers.
+const size_t POOLED_SUBSCRIBERS = 4;
+
 // Holds the command-line arguments
 struct Arguments {
 
@@ -49,6 +70,39 @@ struct Arguments {
 	// The maximum number of packets to capture
 	int maxPackets = std::numeric_limits<int>::max();
 
+	// Whether to write the output file through io_uring
+	bool useIOUring = false;
+
+	// Whether to write the output file with O_DIRECT
+	bool directIO = false;
+
+	// Write the output file back to disk every this many MB, or leave it
+	// to the kernel if 0
+	int writebackMB = 0;
+
+	// Start a new output file after this many GB, or never if 0
+	double rotateGB = 0;
+
+	// Start a new output file after this many minutes, or never if 0
+	int rotateMinutes = 0;
+
+	// Whether to write an indexed chunked file instead of a .dat file
+	bool chunked = false;
+
+	// How to compress the chunks of a chunked file
+	DAQCap::ChunkCodec codec = DAQCap::ChunkCodec::None;
+
+	// Whether to also record the raw frames to a .pcapng file
+	bool recordFrames = false;
+
+	// Publish blobs to monitoring processes through this shared memory
+	// ring, or not at all if empty
+	string ringName;
+
+	// Stream blobs to local subscribers through a Unix domain socket at
+	// this path, or not at all if empty
+	string socketPath;
+
 };
 
 // Parses command-line arguments
@@ -165,12 +219,110 @@ int main(int argc, char **argv) {
 
 	}
 
-	outputFile += runLabel + ".dat";
+	string runPrefix = outputFile + runLabel;
+
+	bool rotating = args.rotateGB > 0 || args.rotateMinutes > 0;
+
+	// Rotated files are numbered in order, e.g. run_<timestamp>_0000.dat
+	auto rotatedPath = [runPrefix](size_t index) {
+
+		char suffix[16];
+		snprintf(suffix, sizeof(suffix), "_%04zu.dat", index);
+
+		return runPrefix + suffix;
+
+	};
+
+	if(rotating) {
+
+		outputFile = rotatedPath(0);
+
+	} else {
+
+		outputFile = runPrefix + (args.chunked ? ".dqc" : ".dat");
+
+	}
+
+	DAQCap::FileSinkOptions sinkOptions;
+	sinkOptions.useIOUring = args.useIOUring;
+
+	// Direct writes keep run files out of the page cache. Reserve space in
+	// large extents too, so the file stays contiguous on disk.
+	if(args.directIO) {
+
+		sinkOptions.directIO = true;
+		sinkOptions.preallocateBytes = RUN_FILE_EXTENT;
+
+	}
+
+	// Otherwise, writing back steadily keeps dirty pages from piling up and
+	// being flushed in bursts that stall the capture
+	sinkOptions.writebackBytes = uint64_t(args.writebackMB) << 20;
+
+	// The device recycles the buffers of fetched blobs once we're done with
+	// them, so its pool must cover every blob we hold at once: the one being
+	// fetched, plus those queued and being written by the BlobWriter
+	size_t poolBuffers = 2 * DAQCap::BlobWriter::DEFAULT_QUEUE_CAPACITY + 1;
 
-	std::ofstream fileWriter(outputFile);
-	if(!fileWriter.is_open()) {
+	std::unique_ptr<DAQCap::FileSink> sink;
+	try {
+
+		if(rotating) {
+
+			// NOTE: The next file is opened and preallocated in the 
+			//       background, so rotating doesn't hold up the writer.
+			DAQCap::RotationOptions rotation;
+			rotation.maxBytes = uint64_t(args.rotateGB * (1 << 30));
+			rotation.maxDuration = std::chrono::minutes(args.rotateMinutes);
+
+			sink.reset(
+				new DAQCap::RotatingFileSink(
+					rotatedPath, 
+					rotation, 
+					sinkOptions
+				)
+			);
+
+		} else if(args.chunked) {
+
+			// NOTE: Chunks are compressed on a pool of threads, so
+			//       compression keeps up with the capture as long as there
+			//       are spare cores.
+			DAQCap::ChunkedFileOptions chunkOptions;
+			chunkOptions.codec = args.codec;
+
+			// Chunks hold their blobs until they're written, or until
+			// they're compressed: one chunk being filled, one per thread
+			// and one waiting for a thread
+			size_t chunks = 1;
+			if(args.codec != DAQCap::ChunkCodec::None) {
+
+				chunks += std::max(1u, std::thread::hardware_concurrency())
+					+ 1;
+
+			}
+
+			poolBuffers += chunks * (
+				chunkOptions.chunkSize / POOLED_BLOB_BYTES + 1
+			);
+
+			sink.reset(
+				new DAQCap::ChunkedFileSink(
+					DAQCap::FileSink::open(outputFile, sinkOptions),
+					chunkOptions
+				)
+			);
+
+		} else {
+
+			sink = DAQCap::FileSink::open(outputFile, sinkOptions);
+
+		}
+
+	} catch(const std::exception &e) {
 
 		cerr << "Failed to open output file: " << outputFile << endl;
+		cerr << e.what() << endl;
 		cerr << "Does the output directory exist?" << endl;
 		cout << "Aborted run!" << endl;
 
@@ -178,23 +330,120 @@ int main(int argc, char **argv) {
 
 	}
 
+	string frameFile = runPrefix + ".pcapng";
+
+	if(args.recordFrames) {
+
+		try {
+
+			device->setRawFrameFile(frameFile);
+
+		} catch(const std::exception &e) {
+
+			cerr << "Failed to open raw frame file: " << frameFile << endl;
+			cerr << e.what() << endl;
+			cout << "Aborted run!" << endl;
+
+			return 1;
+
+		}
+
+	}
+
+	std::unique_ptr<DAQCap::SharedRingPublisher> ring;
+
+	if(!args.ringName.empty()) {
+
+		try {
+
+			ring.reset(new DAQCap::SharedRingPublisher(args.ringName));
+
+		} catch(const std::exception &e) {
+
+			cerr << e.what() << endl;
+			cout << "Aborted run!" << endl;
+
+			return 1;
+
+		}
+
+	}
+
+	std::unique_ptr<DAQCap::StreamServer> server;
+
+	if(!args.socketPath.empty()) {
+
+		try {
+
+			DAQCap::StreamServerOptions streamOptions;
+
+			server.reset(
+				new DAQCap::StreamServer(args.socketPath, streamOptions)
+			);
+
+			// Subscriber queues share the most recent queueLength blobs
+			// between them, plus the blob each subscriber is sending
+			poolBuffers += streamOptions.queueLength + POOLED_SUBSCRIBERS;
+
+		} catch(const std::exception &e) {
+
+			cerr << e.what() << endl;
+			cout << "Aborted run!" << endl;
+
+			return 1;
+
+		}
+
+	}
+
 	cout << "Listening on device: " << device->getName() << endl;
 	cout << "Starting run: " << runLabel << endl; 
 	cout << "Saving packet data to: " 
 			  << outputFile 
-			  << endl
 			  << endl;
 
+	if(args.recordFrames) {
+
+		cout << "Saving raw frames to: " << frameFile << endl;
+
+	}
+
+	if(ring) {
+
+		cout << "Publishing blobs to: " << ring->name() << endl;
+
+	}
+
+	if(server) {
+
+		cout << "Streaming blobs on: " << server->path() << endl;
+
+	}
+
+	cout << endl;
+
 	///////////////////////////////////////////////////////////////////////////
 	// Fetch packets and write to file
 	///////////////////////////////////////////////////////////////////////////
 
+	device->setBlobPoolSize(poolBuffers);
+
+	// Blobs are written on a separate thread by a DAQCap::BlobWriter, so 
+	// that slow disk writes don't pause the capture.
+	DAQCap::BlobWriter writer(*sink);
+
 	int packets = 0;
 	int consecutiveErrors = 0;
 
+	// Reusing one blob lets the device recycle its buffer on every fetch
+	DAQCap::DataBlob blob;
+
 	while(packets < args.maxPackets) {
 
-		cout << "\rRecorded " << packets << " packets" << std::flush;
+		cout << "\rRecorded " << packets << " packets"
+			 << " (write queue: " << writer.queueDepth() 
+			 << ", peak " << writer.maxQueueDepth() << ")   "
+			 << std::flush;
 
 		if(consecutiveErrors > 5) {
 
@@ -203,11 +452,9 @@ int main(int argc, char **argv) {
 
 		}
 
-		DAQCap::DataBlob blob;
-
 		try {
 
-			blob = device->fetchData(std::chrono::seconds(1));
+			device->fetchData(blob, std::chrono::seconds(1));
 
 		} catch(const std::exception &e) {
 
@@ -225,7 +472,47 @@ int main(int argc, char **argv) {
 
 		}
 
-		fileWriter << blob << std::flush;
+		if(blob.metadata().kernelDrops > 0) {
+
+			cerr << blob.metadata().kernelDrops 
+				 << " frames dropped by the kernel!" 
+				 << endl;
+
+		}
+
+		// NOTE: The writer shares the blob's buffer until it is written, so
+		//       the next fetch takes a recycled buffer instead of this one.
+		try {
+
+			writer.write(blob);
+
+		} catch(const std::exception &e) {
+
+			cerr << endl << e.what() << endl;
+			cerr << "Could not write to output file. Exiting..." << endl;
+			break;
+
+		}
+
+		// NOTE: Monitoring is best effort, so a blob that can't be 
+		//       published is only reported.
+		if(ring) {
+
+			try {
+
+				ring->publish(blob);
+
+			} catch(const std::exception &e) {
+
+				cerr << endl << e.what() << endl;
+
+			}
+
+		}
+
+		// NOTE: Subscribers get their own references to the blob, so the
+		//       next fetch takes a recycled buffer while they're sent.
+		if(server) server->publish(blob);
 
 		packets += blob.packetCount();
 
@@ -237,7 +524,37 @@ int main(int argc, char **argv) {
 	// Cleanup
 	///////////////////////////////////////////////////////////////////////////
 
+	try {
+
+		device->setRawFrameFile("");
+
+	} catch(const std::exception &e) {
+
+		cerr << endl << e.what() << endl;
+		cerr << "Could not write to raw frame file." << endl;
+
+	}
+
+	try {
+
+		writer.close();
+		sink->close();
+
+	} catch(const std::exception &e) {
+
+		cerr << endl << e.what() << endl;
+		cerr << "Could not write to output file." << endl;
+
+	}
+
 	cout << endl;
+
+	if(writer.stalls() > 0) {
+
+		cerr << "Capture waited on the disk " << writer.stalls() 
+			 << " times. Consider a faster output device." << endl;
+
+	}
 	cout << "Data capture finished!" << endl;
 
 	// Look at this for killing threads:
@@ -294,12 +611,22 @@ Arguments parseArguments(int argc, char **argv) {
 	Arguments args;
 
 	// Define arguments
-	const char *shortOpts = "o:d:hm:";
+	const char *shortOpts = "o:d:hm:uDw:r:t:cz:ps:l:";
 	const struct option longOpts[] = {
 		{"out", required_argument, nullptr, 'o'},
 		{"device", required_argument, nullptr, 'd'},
 		{"help", no_argument, nullptr, 'h'},
 		{"max-packets", required_argument, nullptr, 'm'},
+		{"uring", no_argument, nullptr, 'u'},
+		{"direct", no_argument, nullptr, 'D'},
+		{"writeback", required_argument, nullptr, 'w'},
+		{"rotate-size", required_argument, nullptr, 'r'},
+		{"rotate-time", required_argument, nullptr, 't'},
+		{"chunked", no_argument, nullptr, 'c'},
+		{"compress", required_argument, nullptr, 'z'},
+		{"pcapng", no_argument, nullptr, 'p'},
+		{"shm", required_argument, nullptr, 's'},
+		{"listen", required_argument, nullptr, 'l'},
 		{nullptr, 0, nullptr, 0}
 	};
 
@@ -340,6 +667,114 @@ Arguments parseArguments(int argc, char **argv) {
 				args.help = true;
 				break;
 
+			case 'u':
+				args.useIOUring = true;
+				break;
+
+			case 'D':
+				args.directIO = true;
+				break;
+
+			case 'w':
+				try {
+
+					args.writebackMB = std::stoi(optarg);
+
+				} catch(std::invalid_argument &e) {
+
+					args.writebackMB = -1;
+
+				}
+
+				if(args.writebackMB <= 0) {
+
+					cerr << "-w, --writeback must take a positive number"
+						 << " of MB."
+						 << endl;
+
+					args.valid = false;
+
+				}
+				break;
+
+			case 'r':
+				try {
+
+					args.rotateGB = std::stod(optarg);
+
+				} catch(std::invalid_argument &e) {
+
+					args.rotateGB = -1;
+
+				}
+
+				if(args.rotateGB <= 0) {
+
+					cerr << "-r, --rotate-size must take a positive number"
+						 << " of GB."
+						 << endl;
+
+					args.valid = false;
+
+				}
+				break;
+
+			case 't':
+				try {
+
+					args.rotateMinutes = std::stoi(optarg);
+
+				} catch(std::invalid_argument &e) {
+
+					args.rotateMinutes = -1;
+
+				}
+
+				if(args.rotateMinutes <= 0) {
+
+					cerr << "-t, --rotate-time must take a positive number"
+						 << " of minutes."
+						 << endl;
+
+					args.valid = false;
+
+				}
+				break;
+
+			case 'c':
+				args.chunked = true;
+				break;
+
+			case 'z':
+				if(std::strcmp(optarg, "fast") == 0) {
+
+					args.codec = DAQCap::ChunkCodec::Blob;
+
+				} else if(std::strcmp(optarg, "zstd") == 0) {
+
+					args.codec = DAQCap::ChunkCodec::Zstd;
+
+				} else {
+
+					cerr << "-z, --compress must be fast or zstd." << endl;
+
+					args.valid = false;
+
+				}
+				break;
+
+			case 'p':
+				args.recordFrames = true;
+				break;
+
+			case 's':
+				args.ringName = optarg;
+				break;
+
+			case 'l':
+				args.socketPath = optarg;
+				break;
+
 			default:
 				args.valid = false;
 
@@ -347,6 +782,32 @@ Arguments parseArguments(int argc, char **argv) {
 
 	}
 
+	// NOTE: Each chunked file ends with an index, so chunked files can't be
+	//       split up by a RotatingFileSink.
+	if(args.chunked && (args.rotateGB > 0 || args.rotateMinutes > 0)) {
+
+		cerr << "-c, --chunked cannot be combined with rotation." << endl;
+
+		args.valid = false;
+
+	}
+
+	if(args.codec != DAQCap::ChunkCodec::None && !args.chunked) {
+
+		cerr << "-z, --compress can only be used with -c, --chunked." << endl;
+
+		args.valid = false;
+
+	}
+
+	if(!DAQCap::ChunkedFileSink::supportsCodec(args.codec)) {
+
+		cerr << "This build does not support zstd compression." << endl;
+
+		args.valid = false;
+
+	}
+
 	return args;
 
 }
@@ -435,7 +896,11 @@ void printHelp(std::ostream &os) {
 
 	os << "Usage:" << endl; 
 	os << "p2ecap_standalone [-o output_path] [-d device_name]"
-	   << " [-m max_packets] [-h]\n"
+	   << " [-m max_packets] [-u | -D]\n"
+	   << "                  [-w size_mb] [-r size_gb] [-t minutes]"
+	   << " [-c [-z codec]]\n"
+	   << "                  [-p]"
+	   << " [-s shm_name] [-l socket_path] [-h]\n"
 	   << endl;
 
 	os << "Options:"
@@ -457,4 +922,60 @@ void printHelp(std::ostream &os) {
 	   << "\t                  may be captured."
 	   << endl;
 
+	os << "\t-u, --uring       Write the output file through io_uring.\n"
+	   << "\t                  Requires Linux 5.1 or later."
+	   << endl;
+
+	os << "\t-D, --direct      Write the output file with O_DIRECT, so\n"
+	   << "\t                  that it bypasses the page cache, and reserve\n"
+	   << "\t                  disk space for it in 1 GB extents. Linux only."
+	   << endl;
+
+	os << "\t-w, --writeback   Write the output file back to disk every\n"
+	   << "\t                  size_mb MB and drop it from the page cache,\n"
+	   << "\t                  so dirty data is written steadily instead\n"
+	   << "\t                  of in bursts that stall the machine. Linux\n"
+	   << "\t                  only. Has no effect with -D."
+	   << endl;
+
+	os << "\t-r, --rotate-size Start a new output file every size_gb GB.\n"
+	   << "\t                  Files are numbered, and always end on a\n"
+	   << "\t                  word boundary."
+	   << endl;
+
+	os << "\t-t, --rotate-time Start a new output file every given number\n"
+	   << "\t                  of minutes."
+	   << endl;
+
+	os << "\t-c, --chunked     Write an indexed, checksummed .dqc file\n"
+	   << "\t                  instead of a .dat file, so that any part of\n"
+	   << "\t                  the run can be found without scanning it.\n"
+	   << "\t                  Cannot be combined with rotation."
+	   << endl;
+
+	os << "\t-z, --compress    Compress each chunk of a chunked file,\n"
+	   << "\t                  with fast (the built-in codec) or zstd.\n"
+	   << "\t                  Chunks are compressed on one thread per\n"
+	   << "\t                  core. zstd must be enabled when DAQCap is\n"
+	   << "\t                  built."
+	   << endl;
+
+	os << "\t-p, --pcapng      Also record the raw frames to a .pcapng\n"
+	   << "\t                  file, for inspection with Wireshark or\n"
+	   << "\t                  tcpdump."
+	   << endl;
+
+	os << "\t-s, --shm         Publish each blob to a shared memory ring\n"
+	   << "\t                  with the given name, e.g. /daqcap, where\n"
+	   << "\t                  monitoring programs can read it live. Slow\n"
+	   << "\t                  readers miss blobs instead of slowing the\n"
+	   << "\t                  capture."
+	   << endl;
+
+	os << "\t-l, --listen      Stream each blob to local programs that\n"
+	   << "\t                  connect to a Unix domain socket at the\n"
+	   << "\t                  given path. Slow subscribers miss blobs\n"
+	   << "\t                  instead of slowing the capture."
+	   << endl;
+
 }
\ No newline at end of file
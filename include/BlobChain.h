@@ -0,0 +1,162 @@
+/**
+ * @file BlobChain.h
+ *
+ * @brief Joins data blobs without copying their data.
+ *
+ * @author Robert Myers
+ * Contact: romyers@umich.edu
+ */
+
+#pragma once
+
+#include "DAQBlob.h"
+
+#include <vector>
+#include <ostream>
+#include <cstddef>
+
+namespace DAQCap {
+
+	/**
+	 * @brief A sequence of miniDAQ data made of segments of data blobs.
+	 * 
+	 * Appending, concatenating and splitting chains never copies data. Each
+	 * segment shares its blob's reference-counted buffer, so a chain keeps
+	 * the data it refers to alive.
+	 * 
+	 * @note Chains always hold an integral number of words, and every
+	 * segment begins at a word boundary.
+	 */
+	class BlobChain final {
+
+	public:
+
+		/**
+		 * @brief A contiguous range of one blob's data.
+		 */
+		struct Segment {
+
+			/**
+			 * @brief The blob holding the data.
+			 */
+			DataBlob blob;
+
+			/**
+			 * @brief The offset in bytes of the segment in the blob's data.
+			 */
+			size_t offset;
+
+			/**
+			 * @brief The size in bytes of the segment.
+			 */
+			size_t size;
+
+			/**
+			 * @brief Gets a view of the segment's data.
+			 */
+			ByteView view() const;
+
+		};
+
+		BlobChain() = default;
+
+		/**
+		 * @brief Constructs a chain holding the data in a blob.
+		 */
+		explicit BlobChain(const DataBlob &blob);
+
+		/**
+		 * @brief Appends the data in a blob to the end of the chain. Empty
+		 * blobs are ignored.
+		 */
+		void append(const DataBlob &blob);
+
+		/**
+		 * @brief Appends the data in another chain to the end of this one.
+		 */
+		void append(const BlobChain &other);
+
+		/**
+		 * @brief Splits the chain at a word boundary. This chain keeps the
+		 * words before the boundary, and the rest are returned.
+		 * 
+		 * @param word The index of the first word to move to the returned
+		 * chain.
+		 * 
+		 * @return A chain holding the words from index word onward.
+		 * 
+		 * @throws std::out_of_range If word is greater than wordCount().
+		 */
+		BlobChain split(size_t word);
+
+		/**
+		 * @brief Gets a chain holding up to count words starting at index
+		 * firstWord. The result stops early at the end of the chain.
+		 * 
+		 * @throws std::out_of_range If firstWord is greater than wordCount().
+		 */
+		BlobChain slice(size_t firstWord, size_t count) const;
+
+		/**
+		 * @brief Removes all data from the chain.
+		 */
+		void clear();
+
+		/**
+		 * @brief Gets the number of data bytes in the chain.
+		 */
+		size_t size() const;
+
+		/**
+		 * @brief Gets the number of words in the chain.
+		 */
+		size_t wordCount() const;
+
+		/**
+		 * @brief Checks whether the chain contains no data.
+		 */
+		bool empty() const;
+
+		/**
+		 * @brief Gets the segments making up the chain, in order.
+		 */
+		const std::vector<Segment> &segments() const;
+
+		/**
+		 * @brief Decodes the word at the given index.
+		 * 
+		 * @throws std::out_of_range If index is greater than or equal to
+		 * wordCount().
+		 */
+		Word word(size_t index) const;
+
+		/**
+		 * @brief Copies the chain's data into a single contiguous buffer.
+		 */
+		std::vector<uint8_t> flatten() const;
+
+	private:
+
+		std::vector<Segment> segmentList;
+
+		// The byte offset in the chain of the end of each segment
+		std::vector<size_t> segmentEnds;
+
+		// Adds a segment to the end of the chain
+		void push(const Segment &segment);
+
+		// Finds the segment containing the given byte offset in the chain
+		size_t findSegment(size_t offset) const;
+
+	};
+
+	/**
+	 * @brief Stream insertion operator for BlobChain. Writes the miniDAQ data
+	 * in every segment to the stream with no padding or metadata.
+	 */
+	std::ostream &operator<<(
+		std::ostream &os, 
+		const BlobChain &chain
+	);
+
+}
@@ -0,0 +1,165 @@
+/**
+ * @file BlobCodec.h
+ *
+ * @brief A lightweight compression codec for miniDAQ data.
+ *
+ * @author Robert Myers
+ * Contact: romyers@umich.edu
+ */
+
+#pragma once
+
+#include "DAQBlob.h"
+
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+
+namespace DAQCap {
+
+	/**
+	 * @brief Compresses miniDAQ data as it is captured.
+	 * 
+	 * The codec is specialized for the miniDAQ word stream, and trades
+	 * compression ratio for speed. Data is encoded in independent blocks
+	 * of words. Within a block:
+	 *  - Runs of repeated words are collapsed into one word and a run
+	 *    length.
+	 *  - Each remaining word is replaced by its difference from the previous
+	 *    one, modulo the word size, so that slowly-changing fields such as
+	 *    timestamps become small numbers.
+	 *  - The differences are split into byte planes, one for each byte of
+	 *    the word, so that mostly-constant bytes end up next to each other.
+	 *  - Each plane, and the run lengths, are run-length encoded at the
+	 *    byte level.
+	 * 
+	 * Encoded blocks can be decoded with decompressData() or BlobDecoder.
+	 * 
+	 * @note Data passed to the encoder must begin at a word boundary.
+	 * Trailing partial words are held until the rest of the word arrives,
+	 * and are discarded by finish().
+	 */
+	class BlobEncoder final {
+
+	public:
+
+		/**
+		 * @brief The default maximum number of words per encoded block.
+		 */
+		static const size_t DEFAULT_BLOCK_WORDS;
+
+		/**
+		 * @brief Constructs an encoder.
+		 * 
+		 * @param blockWords The maximum number of words per encoded block.
+		 * Larger blocks compress slightly better, and smaller blocks reduce
+		 * latency and memory use.
+		 * 
+		 * @throws std::invalid_argument If blockWords is zero.
+		 */
+		explicit BlobEncoder(size_t blockWords = DEFAULT_BLOCK_WORDS);
+
+		/**
+		 * @brief Adds data to the encoder, appending any blocks that are
+		 * completed to out.
+		 * 
+		 * @param[in] data The data to encode.
+		 * @param[out] out Encoded blocks are appended here.
+		 */
+		void encode(ByteView data, std::vector<uint8_t> &out);
+
+		/**
+		 * @brief Adds a blob's data to the encoder, appending any blocks that
+		 * are completed to out.
+		 * 
+		 * @param[in] blob The blob to encode.
+		 * @param[out] out Encoded blocks are appended here.
+		 */
+		void encode(const DataBlob &blob, std::vector<uint8_t> &out);
+
+		/**
+		 * @brief Encodes any buffered words as a final, possibly short,
+		 * block and appends it to out. The encoder can be reused
+		 * afterward.
+		 * 
+		 * @param[out] out The encoded block is appended here.
+		 */
+		void finish(std::vector<uint8_t> &out);
+
+	private:
+
+		size_t blockWords;
+
+		// Words waiting to be encoded
+		std::vector<Word> pending;
+
+		// Bytes of a word that has not been completed yet
+		std::vector<uint8_t> partialWord;
+
+		// Scratch space reused across blocks
+		std::vector<Word> values;
+		std::vector<uint8_t> runLengths;
+		std::vector<uint8_t> plane;
+
+		// Encodes the pending words as one block and appends it to out
+		void encodeBlock(std::vector<uint8_t> &out);
+
+	};
+
+	/**
+	 * @brief Decodes data produced by BlobEncoder as it arrives.
+	 */
+	class BlobDecoder final {
+
+	public:
+
+		/**
+		 * @brief Adds encoded data to the decoder, appending the contents of
+		 * any blocks that are completed to out.
+		 * 
+		 * @param[in] encoded Encoded data. Blocks may be split across calls.
+		 * @param[out] out Decoded miniDAQ data is appended here.
+		 * 
+		 * @throws std::invalid_argument If the encoded data is malformed.
+		 */
+		void decode(ByteView encoded, std::vector<uint8_t> &out);
+
+		/**
+		 * @brief Checks whether the decoder is holding part of a block.
+		 */
+		bool hasPartialBlock() const;
+
+		/**
+		 * @brief Discards any partially received block.
+		 */
+		void reset();
+
+	private:
+
+		std::vector<uint8_t> pending;
+
+	};
+
+	/**
+	 * @brief Compresses miniDAQ data in one call.
+	 * 
+	 * REQUIRES: data holds an integral number of words.
+	 */
+	std::vector<uint8_t> compressData(ByteView data);
+
+	/**
+	 * @brief Decompresses data produced by compressData() or BlobEncoder.
+	 * 
+	 * @param maxSize The most decompressed bytes to accept. A block that
+	 * would decompress past it is rejected before its words are allocated,
+	 * so pass the expected size when it is known.
+	 * 
+	 * @throws std::invalid_argument If the encoded data is malformed or
+	 * truncated, or decompresses to more than maxSize bytes.
+	 */
+	std::vector<uint8_t> decompressData(
+		ByteView encoded, 
+		size_t maxSize = SIZE_MAX
+	);
+
+}
@@ -0,0 +1,110 @@
+/**
+ * @file BlobIO.h
+ *
+ * @brief Writes captured data directly to file descriptors.
+ *
+ * @author Robert Myers
+ * Contact: romyers@umich.edu
+ */
+
+#pragma once
+
+#include "DAQBlob.h"
+#include "BlobChain.h"
+
+#include <vector>
+#include <cstddef>
+
+namespace DAQCap {
+
+	/**
+	 * @brief Writes the miniDAQ data in a blob to a file descriptor with no
+	 * padding or metadata. Produces the same bytes as DataBlob's stream
+	 * insertion operator.
+	 * 
+	 * The data is handed to the kernel directly from the blob's buffer
+	 * with writev(), so no intermediate copy or stream buffer is involved.
+	 * Partial writes and interrupted system calls are retried until all of
+	 * the data is written.
+	 * 
+	 * @param fd An open file descriptor to write to.
+	 * @param blob The blob to write.
+	 * 
+	 * @return The number of bytes written.
+	 * 
+	 * @throws std::runtime_error if the data could not be written.
+	 * 
+	 * @note Only supported on POSIX systems.
+	 */
+	size_t writeBlob(int fd, const DataBlob &blob);
+
+	/**
+	 * @brief Writes a range of bytes to a file descriptor, retrying partial
+	 * writes and interrupted system calls until all of it is written.
+	 * 
+	 * @param fd An open file descriptor to write to.
+	 * @param data The bytes to write.
+	 * 
+	 * @return The number of bytes written.
+	 * 
+	 * @throws std::runtime_error if the data could not be written.
+	 * 
+	 * @note Only supported on POSIX systems.
+	 */
+	size_t writeData(int fd, ByteView data);
+
+	/**
+	 * @brief Writes the miniDAQ data in several blobs to a file descriptor,
+	 * in order, with no padding or metadata.
+	 * 
+	 * All of the blobs are gathered into as few writev() calls as possible.
+	 * 
+	 * @param fd An open file descriptor to write to.
+	 * @param blobs The blobs to write.
+	 * 
+	 * @return The number of bytes written.
+	 * 
+	 * @throws std::runtime_error if the data could not be written.
+	 * 
+	 * @note Only supported on POSIX systems.
+	 */
+	size_t writeBlobs(int fd, const std::vector<DataBlob> &blobs);
+
+	/**
+	 * @brief Writes the miniDAQ data in a chain to a file descriptor, in
+	 * order, with no padding or metadata.
+	 * 
+	 * Every segment is gathered into as few writev() calls as possible, so
+	 * a chain of many small blobs becomes one large write.
+	 * 
+	 * @param fd An open file descriptor to write to.
+	 * @param chain The chain to write.
+	 * 
+	 * @return The number of bytes written.
+	 * 
+	 * @throws std::runtime_error if the data could not be written.
+	 * 
+	 * @note Only supported on POSIX systems.
+	 */
+	size_t writeChain(int fd, const BlobChain &chain);
+
+	/**
+	 * @brief Writes a blob to a file descriptor in serialized form, with its
+	 * metadata, packet gaps, packet index and warnings.
+	 * 
+	 * Produces the same bytes as serializeBlob(), but the data is written
+	 * directly from the blob's buffer rather than copied. The result can
+	 * be read back with SerializedBlob.
+	 * 
+	 * @param fd An open file descriptor to write to.
+	 * @param blob The blob to write.
+	 * 
+	 * @return The number of bytes written.
+	 * 
+	 * @throws std::runtime_error if the data could not be written.
+	 * 
+	 * @note Only supported on POSIX systems.
+	 */
+	size_t writeSerializedBlob(int fd, const DataBlob &blob);
+
+}
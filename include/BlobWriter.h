@@ -0,0 +1,195 @@
+/**
+ * @file BlobWriter.h
+ *
+ * @brief Writes DataBlobs to a file on a background thread.
+ *
+ * @author Robert Myers
+ * Contact: romyers@umich.edu
+ */
+
+#pragma once
+
+#include "DAQBlob.h"
+#include "FileSink.h"
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <cstddef>
+#include <stdint.h>
+
+namespace DAQCap {
+
+	/**
+	 * @brief Writes the miniDAQ data in DataBlobs to a file on a background
+	 * thread, so that slow writes do not hold up data capture.
+	 * 
+	 * Blobs are handed to the writer through a bounded queue. The queue is
+	 * double buffered: the writer thread takes every queued blob at once,
+	 * leaving an empty queue behind, and writes the whole batch to the file
+	 * at once while new blobs are queued.
+	 * 
+	 * Since DataBlobs share their buffers, queueing a blob does not copy its
+	 * data. Buffers are released back to the capture device once they are
+	 * written.
+	 * 
+	 * @note Only supported on POSIX systems.
+	 */
+	class BlobWriter final {
+
+	public:
+
+		/**
+		 * @brief The default maximum number of blobs waiting to be written.
+		 */
+		static const size_t DEFAULT_QUEUE_CAPACITY;
+
+		/**
+		 * @brief Starts a writer thread for the given file descriptor.
+		 * 
+		 * @param fd An open file descriptor to write to. The writer does not
+		 * take ownership of it, and it must stay open until the writer is
+		 * closed.
+		 * @param queueCapacity The maximum number of blobs waiting to be
+		 * written. Once the queue is full, write() blocks until the writer
+		 * thread catches up.
+		 * 
+		 * @throws std::invalid_argument If queueCapacity is zero.
+		 */
+		explicit BlobWriter(
+			int fd,
+			size_t queueCapacity = DEFAULT_QUEUE_CAPACITY
+		);
+
+		/**
+		 * @brief Starts a writer thread for the given file sink.
+		 * 
+		 * @param sink The sink to write to. The writer does not take
+		 * ownership of it, and it may not be used by anything else until the
+		 * writer is closed. The writer flushes the sink but does not close
+		 * it.
+		 * @param queueCapacity The maximum number of blobs waiting to be
+		 * written. Once the queue is full, write() blocks until the writer
+		 * thread catches up.
+		 * 
+		 * @throws std::invalid_argument If queueCapacity is zero.
+		 */
+		explicit BlobWriter(
+			FileSink &sink,
+			size_t queueCapacity = DEFAULT_QUEUE_CAPACITY
+		);
+
+		/**
+		 * @brief Writes any queued blobs and stops the writer thread. Errors
+		 * are ignored; call close() first to find out about them.
+		 */
+		~BlobWriter();
+
+		BlobWriter(const BlobWriter &other) = delete;
+		BlobWriter &operator=(const BlobWriter &other) = delete;
+
+		/**
+		 * @brief Queues a blob to be written. Empty blobs are ignored.
+		 * 
+		 * Blocks if the queue is full.
+		 * 
+		 * @param blob The blob to write.
+		 * 
+		 * @throws std::runtime_error If the writer thread failed to write
+		 * earlier data, or if the writer has been closed.
+		 */
+		void write(const DataBlob &blob);
+
+		/**
+		 * @brief Blocks until every queued blob has been written and the
+		 * sink has been flushed.
+		 * 
+		 * @throws std::runtime_error If the writer thread failed to write
+		 * data.
+		 */
+		void flush();
+
+		/**
+		 * @brief Writes any queued blobs and stops the writer thread. Has no
+		 * effect if the writer is already closed.
+		 * 
+		 * @throws std::runtime_error If the writer thread failed to write
+		 * data.
+		 */
+		void close();
+
+		/**
+		 * @brief Gets the number of blobs waiting to be written, including
+		 * the batch being written.
+		 */
+		size_t queueDepth() const;
+
+		/**
+		 * @brief Gets the largest queueDepth() seen so far.
+		 */
+		size_t maxQueueDepth() const;
+
+		/**
+		 * @brief Gets the number of times write() had to wait for room in
+		 * the queue.
+		 */
+		uint64_t stalls() const;
+
+		/**
+		 * @brief Gets the number of bytes written so far.
+		 */
+		uint64_t bytesWritten() const;
+
+	private:
+
+		// Only set if the writer made its own sink
+		std::unique_ptr<FileSink> ownedSink;
+
+		FileSink *sink;
+
+		size_t capacity;
+
+		mutable std::mutex mutex;
+
+		// Signals the writer thread that blobs were queued or the writer
+		// is closing
+		std::condition_variable queued;
+
+		// Signals write() and flush() that a batch was written
+		std::condition_variable written;
+
+		// Blobs queued by write()
+		std::vector<DataBlob> pending;
+
+		// The number of blobs the writer thread is currently writing
+		size_t inFlight;
+
+		size_t peakDepth;
+		uint64_t stallCount;
+		uint64_t bytes;
+
+		bool closing;
+
+		// Set by flush() until the writer thread has flushed the sink
+		bool flushRequested;
+
+		// The first error from the writer thread, if any
+		std::exception_ptr error;
+
+		std::thread thread;
+
+		// Starts the writer thread
+		void start();
+
+		// The body of the writer thread
+		void run();
+
+		// Throws the writer thread's error, if any. REQUIRES: mutex is held
+		void checkError() const;
+
+	};
+
+}
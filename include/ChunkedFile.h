@@ -0,0 +1,442 @@
+/**
+ * @file ChunkedFile.h
+ *
+ * @brief Writes and reads recorded runs in an indexed, checksummed
+ * container, so that readers can jump straight to any part of a run.
+ *
+ * @author Robert Myers
+ * Contact: romyers@umich.edu
+ */
+
+#pragma once
+
+#include "FileSink.h"
+#include "DAQBlob.h"
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstddef>
+#include <stdint.h>
+
+namespace DAQCap {
+
+	/**
+	 * @brief How the data in a chunk is compressed.
+	 */
+	enum class ChunkCodec : uint32_t {
+
+		/**
+		 * @brief The data is stored as it was captured.
+		 */
+		None = 0,
+
+		/**
+		 * @brief The data is compressed with the built-in BlobEncoder,
+		 * which is fast and needs no external libraries.
+		 */
+		Blob = 1,
+
+		/**
+		 * @brief The data is compressed with zstd, which compresses better
+		 * but is slower. Only available if DAQCap was built with zstd.
+		 */
+		Zstd = 2
+
+	};
+
+	/**
+	 * @brief Describes one chunk of a chunked file.
+	 */
+	struct ChunkInfo {
+
+		/**
+		 * @brief The file offset of the chunk's data.
+		 */
+		uint64_t offset = 0;
+
+		/**
+		 * @brief The number of bytes of data in the chunk.
+		 */
+		uint64_t dataSize = 0;
+
+		/**
+		 * @brief The number of bytes the chunk's data takes up in the file.
+		 * Less than dataSize if the data is compressed.
+		 */
+		uint64_t storedSize = 0;
+
+		/**
+		 * @brief How the chunk's data is compressed.
+		 */
+		ChunkCodec codec = ChunkCodec::None;
+
+		/**
+		 * @brief The number of words of data in the chunk.
+		 */
+		uint64_t wordCount = 0;
+
+		/**
+		 * @brief The position in the run of the chunk's first packet,
+		 * counting from 0. Lost packets are counted too, so this increases
+		 * steadily even though packet numbers wrap around.
+		 */
+		uint64_t firstPacket = 0;
+
+		/**
+		 * @brief The number of packets the chunk covers, including lost
+		 * packets.
+		 */
+		uint64_t packetCount = 0;
+
+		/**
+		 * @brief Packet number of the chunk's first packet, or -1 if it has
+		 * no packets.
+		 */
+		int firstSequence = -1;
+
+		/**
+		 * @brief Packet number of the chunk's last packet, or -1 if it has
+		 * no packets.
+		 */
+		int lastSequence = -1;
+
+		/**
+		 * @brief Arrival time of the chunk's first packet. Unset if the chunk
+		 * has no packets.
+		 */
+		Timestamp firstArrival;
+
+		/**
+		 * @brief Arrival time of the chunk's last packet. Unset if the chunk
+		 * has no packets.
+		 */
+		Timestamp lastArrival;
+
+		/**
+		 * @brief The number of blobs written to the chunk.
+		 */
+		uint32_t blobCount = 0;
+
+		/**
+		 * @brief The CRC32C of the chunk's data, before compression.
+		 */
+		uint32_t checksum = 0;
+
+	};
+
+	/**
+	 * @brief Options controlling how a chunked file is laid out.
+	 */
+	struct ChunkedFileOptions {
+
+		/**
+		 * @brief The target size in bytes of each chunk's data. A chunk is
+		 * finished as soon as the blobs written to it reach this size, so
+		 * chunks hold whole blobs and may be larger.
+		 */
+		uint64_t chunkSize = 16 << 20;
+
+		/**
+		 * @brief How to compress each chunk's data. Chunks that don't get
+		 * smaller are stored uncompressed.
+		 */
+		ChunkCodec codec = ChunkCodec::None;
+
+		/**
+		 * @brief The number of threads compressing chunks, or 0 to use one
+		 * per core. Ignored if chunks aren't compressed.
+		 * 
+		 * Chunks are compressed in parallel and written in order. Up to one
+		 * more chunk than there are threads is held in memory while it is
+		 * compressed, so compression only holds up the writer once every
+		 * thread is busy.
+		 */
+		unsigned compressionThreads = 0;
+
+	};
+
+	/**
+	 * @brief A FileSink that writes a chunked file to another FileSink.
+	 * 
+	 * A chunked file holds the same miniDAQ data as a .dat file, grouped
+	 * into chunks. Each chunk has a header recording the packets and time
+	 * span it covers and a checksum of its data, and the file ends with an
+	 * index of every chunk, so a ChunkedFileReader can find any packet or
+	 * time in a run without scanning it.
+	 * 
+	 * Blobs are held until their chunk is finished, without copying their
+	 * data. Data written as raw bytes is copied, and has no packet or time
+	 * information.
+	 * 
+	 * If chunks are compressed, finished chunks are compressed on a pool
+	 * of background threads, and written by whichever call to the sink
+	 * finds them done. Chunks are always written in order.
+	 * 
+	 * @note Data written to the sink must be a whole number of words.
+	 */
+	class ChunkedFileSink final : public FileSink {
+
+	public:
+
+		/**
+		 * @brief Creates a sink that writes a chunked file to target.
+		 * 
+		 * @param target The sink to write the file to. Closed when the
+		 * chunked sink is closed.
+		 * @param options How to lay out the file.
+		 * 
+		 * @throws std::invalid_argument If target is null or the chunk size
+		 * is 0.
+		 * @throws std::runtime_error If the file header could not be
+		 * written, or the codec is not supported by this build.
+		 */
+		ChunkedFileSink(
+			std::unique_ptr<FileSink> target,
+			const ChunkedFileOptions &options = ChunkedFileOptions()
+		);
+
+		/**
+		 * @brief Closes the sink. Errors are ignored; call close() first to
+		 * find out about them.
+		 */
+		virtual ~ChunkedFileSink();
+
+		/**
+		 * @brief Checks whether chunks can be compressed with a codec in
+		 * this build.
+		 */
+		static bool supportsCodec(ChunkCodec codec);
+
+		/**
+		 * @brief Adds raw data to the current chunk.
+		 * 
+		 * @throws std::runtime_error If a finished chunk could not be
+		 * written.
+		 */
+		virtual void write(ByteView data) override;
+
+		/**
+		 * @brief Adds blobs to the current chunk, finishing it once it is
+		 * big enough.
+		 * 
+		 * @throws std::runtime_error If a finished chunk could not be
+		 * written.
+		 */
+		virtual void write(const std::vector<DataBlob> &blobs) override;
+
+		/**
+		 * @brief Finishes the current chunk, even if it is smaller than the
+		 * chunk size, waits for every chunk to be compressed and written,
+		 * and flushes the target.
+		 * 
+		 * @throws std::runtime_error If the data could not be written.
+		 */
+		virtual void flush() override;
+
+		/**
+		 * @brief Finishes the current chunk, writes the index and closes the
+		 * target.
+		 * 
+		 * @throws std::runtime_error If the data could not be written.
+		 */
+		virtual void close() override;
+
+		/**
+		 * @brief Gets the number of bytes of data written to the sink.
+		 * Chunk headers and the index are not counted.
+		 */
+		virtual uint64_t bytesWritten() const override;
+
+		/**
+		 * @brief Gets the chunks written so far.
+		 */
+		const std::vector<ChunkInfo> &chunks() const;
+
+	private:
+
+		// A piece of the current chunk: either a blob or a range of staged
+		// raw bytes
+		struct Segment {
+
+			DataBlob blob;
+			size_t stagedOffset;
+			size_t size;
+			bool staged;
+
+		};
+
+		std::unique_ptr<FileSink> target;
+		ChunkedFileOptions options;
+
+		// The current chunk
+		std::vector<Segment> segments;
+		std::vector<uint8_t> staged;
+		ChunkInfo pending;
+
+		std::vector<ChunkInfo> finished;
+
+		// Compresses finished chunks in the background. Null if chunks
+		// aren't compressed.
+		struct Compressor;
+		std::unique_ptr<Compressor> compressor;
+
+		// The position in the run of the next packet
+		uint64_t nextPacket;
+
+		// The file offset of the end of everything written so far
+		uint64_t offset;
+
+		uint64_t bytes;
+
+		bool closed;
+
+		// Adds the packets and times in a blob to the current chunk
+		void describe(const DataBlob &blob);
+
+		// Writes the current chunk, or hands it to the compressor, if it
+		// has any data
+		void finishChunk();
+
+		// Writes a chunk header followed by data, and records the chunk
+		void writeChunk(ChunkInfo chunk, ByteView data);
+
+		// Writes chunks the compressor has finished, in order. If wait is
+		// true, waits for every chunk.
+		void writeCompressed(bool wait);
+
+		void checkOpen() const;
+
+	};
+
+	/**
+	 * @brief Reads a chunked file written by a ChunkedFileSink.
+	 * 
+	 * The reader loads the file's index when it is opened, and reads chunk
+	 * data on demand. Finding the chunk holding a packet or a time is a
+	 * binary search of the index.
+	 * 
+	 * Compressed chunks are decompressed as they are read.
+	 * 
+	 * If the file has no index, for example because the recorder stopped
+	 * before closing it, the index is rebuilt from the chunk headers. Any
+	 * partially written chunk at the end of the file is ignored.
+	 * 
+	 * @note Reading chunks is thread safe.
+	 * 
+	 * @note Only supported on POSIX systems.
+	 */
+	class ChunkedFileReader final {
+
+	public:
+
+		/**
+		 * @brief Opens a chunked file and loads its index.
+		 * 
+		 * @throws std::runtime_error If the file could not be read, or is
+		 * not a chunked file.
+		 */
+		explicit ChunkedFileReader(const std::string &path);
+
+		~ChunkedFileReader();
+
+		ChunkedFileReader(const ChunkedFileReader &other) = delete;
+		ChunkedFileReader &operator=(const ChunkedFileReader &other) = delete;
+
+		/**
+		 * @brief Checks whether a file starts like a chunked file.
+		 * 
+		 * @return False if the file is not a chunked file or could not be
+		 * read.
+		 */
+		static bool isChunkedFile(const std::string &path);
+
+		/**
+		 * @brief Gets the number of chunks in the file.
+		 */
+		size_t chunkCount() const;
+
+		/**
+		 * @brief Gets the description of a chunk.
+		 * 
+		 * @throws std::out_of_range If index is not a valid chunk index.
+		 */
+		const ChunkInfo &chunk(size_t index) const;
+
+		/**
+		 * @brief Gets the descriptions of every chunk, in order.
+		 */
+		const std::vector<ChunkInfo> &chunks() const;
+
+		/**
+		 * @brief Checks whether the index was rebuilt from the chunk headers
+		 * because the file had no valid index.
+		 */
+		bool recovered() const;
+
+		/**
+		 * @brief Finds the chunk covering the packet at the given position
+		 * in the run, as counted by ChunkInfo::firstPacket.
+		 * 
+		 * @return The index of the chunk, or chunkCount() if the packet is
+		 * past the end of the run.
+		 */
+		size_t findPacket(uint64_t packet) const;
+
+		/**
+		 * @brief Finds the first chunk holding data that arrived at or after
+		 * the given time.
+		 * 
+		 * @return The index of the chunk, or chunkCount() if no data arrived
+		 * that late.
+		 */
+		size_t findTime(Timestamp time) const;
+
+		/**
+		 * @brief Reads a chunk's data, decompressing it if needed, and checks
+		 * it against the chunk's checksum.
+		 * 
+		 * @param index The index of the chunk to read.
+		 * @param out Replaced with the chunk's data.
+		 * 
+		 * @throws std::out_of_range If index is not a valid chunk index.
+		 * @throws std::runtime_error If the chunk could not be read or
+		 * decompressed, or its data does not match its checksum.
+		 */
+		void readChunk(size_t index, std::vector<uint8_t> &out) const;
+
+		/**
+		 * @brief Reads a chunk's data, decompressing it if needed, and checks
+		 * it against the chunk's checksum.
+		 * 
+		 * @throws std::out_of_range If index is not a valid chunk index.
+		 * @throws std::runtime_error If the chunk could not be read or
+		 * decompressed, or its data does not match its checksum.
+		 */
+		std::vector<uint8_t> readChunk(size_t index) const;
+
+	private:
+
+		int fd;
+
+		std::vector<ChunkInfo> index;
+
+		bool rebuilt;
+
+		// The size of each chunk header, which depends on the format
+		// version
+		size_t headerSize;
+
+		// Loads the index at the end of the file. Returns false if there
+		// isn't a valid one.
+		bool loadIndex(uint64_t fileSize);
+
+		// Rebuilds the index by walking the chunk headers
+		void rebuildIndex(uint64_t fileSize);
+
+		// Reads exactly size bytes at offset
+		void readAt(uint64_t offset, uint8_t *out, size_t size) const;
+
+	};
+
+}
@@ -11,12 +11,17 @@
 
 #include <vector>
 #include <string>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <stdint.h>
 
-namespace DAQCap {
+#if __cplusplus >= 202002L
+	#include <span>
+#endif
 
-	// OPTIMIZATION: If performance matters, we can return DataBlob values
-	//               by const reference instead of by value, at the risk of a 
-	//               more complex interface.
+namespace DAQCap {
 
 	/**
 	 * @brief An integer type representing a word of miniDAQ data.
@@ -39,10 +44,210 @@ namespace DAQCap {
 	 */
 	std::vector<Word> packData(const std::vector<uint8_t> &data);
 
+	/**
+	 * @brief A non-owning, read-only view of a contiguous range of bytes.
+	 * 
+	 * A ByteView does not extend the lifetime of the data it refers to. It
+	 * is invalidated when the object that owns the data is destroyed or
+	 * modified.
+	 */
+	class ByteView final {
+
+	public:
+
+		/**
+		 * @brief An iterator used to traverse the viewed bytes.
+		 */
+		typedef const uint8_t *const_iterator;
+
+		ByteView() = default;
+
+		/**
+		 * @brief Constructs a view of size bytes starting at data.
+		 */
+		ByteView(const uint8_t *data, size_t size)
+			: first(data), length(size) {}
+
+		/**
+		 * @brief Returns a pointer to the first viewed byte.
+		 */
+		const uint8_t *data() const { return first; }
+
+		/**
+		 * @brief Returns the number of viewed bytes.
+		 */
+		size_t size() const { return length; }
+
+		/**
+		 * @brief Checks whether the view is empty.
+		 */
+		bool empty() const { return length == 0; }
+
+		/**
+		 * @brief Returns the byte at the given index. Does not check bounds.
+		 */
+		uint8_t operator[](size_t index) const { return first[index]; }
+
+		const_iterator begin() const { return first; }
+		const_iterator end() const { return first + length; }
+
+		const_iterator cbegin() const { return first; }
+		const_iterator cend() const { return first + length; }
+
+	private:
+
+		const uint8_t *first = nullptr;
+		size_t length = 0;
+
+	};
+
+	/**
+	 * @brief Packs viewed data bytes into words. Excludes any trailing partial
+	 * words.
+	 * 
+	 * REQUIRES: The same as packData(const std::vector<uint8_t>&).
+	 * 
+	 * @note DataBlob::view() is guaranteed to be well-formed input for
+	 * packData().
+	 * 
+	 * @param data The data to be packed. The data is expected to begin at the
+	 * start of a word.
+	 */
+	std::vector<Word> packData(ByteView data);
+
+	/**
+	 * @brief A point in time, as reported by the capture device.
+	 */
+	typedef std::chrono::system_clock::time_point Timestamp;
+
+	/**
+	 * @brief Summary statistics describing how a DataBlob was captured.
+	 */
+	struct BlobMetadata {
+
+		/**
+		 * @brief Arrival time of the first packet in the blob. Unset if
+		 * the blob holds no packets.
+		 */
+		Timestamp firstArrival;
+
+		/**
+		 * @brief Arrival time of the last packet in the blob. Unset if the
+		 * blob holds no packets.
+		 */
+		Timestamp lastArrival;
+
+		/**
+		 * @brief Packet number of the first packet in the blob, or -1 if
+		 * the blob holds no packets.
+		 */
+		int firstSequence = -1;
+
+		/**
+		 * @brief Packet number of the last packet in the blob, or -1 if the
+		 * blob holds no packets.
+		 */
+		int lastSequence = -1;
+
+		/**
+		 * @brief Total size in bytes of the captured frames, including
+		 * frame headers and trailers.
+		 */
+		uint64_t rawBytes = 0;
+
+		/**
+		 * @brief Number of idle words removed from the data.
+		 */
+		uint64_t idleWordsRemoved = 0;
+
+		/**
+		 * @brief Number of frames received during the fetch that were
+		 * discarded because they could not be parsed as packets.
+		 */
+		uint64_t framesRejected = 0;
+
+		/**
+		 * @brief Number of frames dropped by the kernel or the network
+		 * interface since the previous fetch.
+		 */
+		uint64_t kernelDrops = 0;
+
+		/**
+		 * @brief Time spent turning the captured packets into the blob.
+		 */
+		std::chrono::nanoseconds processingTime = std::chrono::nanoseconds(0);
+
+	};
+
+	/**
+	 * @brief Locates the data of one packet within a DataBlob.
+	 * 
+	 * A word is attributed to the packet its last byte arrived in, so words
+	 * split across packets belong to the later packet. Idle words are not
+	 * counted.
+	 */
+	struct PacketIndexEntry {
+
+		/**
+		 * @brief The packet number of the packet.
+		 */
+		int sequence;
+
+		/**
+		 * @brief The number of words of data attributed to the packet.
+		 */
+		uint32_t wordCount;
+
+		/**
+		 * @brief The index of the packet's first word in the blob's data.
+		 */
+		uint64_t wordOffset;
+
+	};
+
+	/**
+	 * @brief Records a run of missing packets in a DataBlob.
+	 */
+	struct PacketGap {
+
+		/**
+		 * @brief The packet number of the last packet before the gap. It may
+		 * belong to a previous blob.
+		 */
+		int previousSequence;
+
+		/**
+		 * @brief The packet number of the first packet after the gap.
+		 */
+		int nextSequence;
+
+		/**
+		 * @brief The number of packets that were lost.
+		 */
+		int missing;
+
+		/**
+		 * @brief The index in the blob's data of the first word of the packet
+		 * after the gap.
+		 */
+		uint64_t wordOffset;
+
+	};
+
 	/**
 	 * @brief Represents a blob of data fetched from a network device.
 	 * 
+	 * DataBlobs are immutable and cheap to copy. Copies share a single
+	 * reference-counted buffer rather than duplicating the data, so one
+	 * blob can be handed to any number of consumers, including consumers
+	 * on other threads, without copying it.
+	 * 
 	 * @note DataBlobs contain exactly an integral number of words.
+	 * 
+	 * @note As with std::shared_ptr, distinct DataBlob objects may be read,
+	 * copied and destroyed concurrently even if they share data, but a
+	 * single DataBlob object may not be assigned to while another thread
+	 * uses it.
 	 */
 	class DataBlob final {
 
@@ -57,13 +262,98 @@ namespace DAQCap {
 
 		/**
 		 * @brief Gets data fetched from the network device.
+		 * 
+		 * @note The returned reference is valid until the blob is destroyed
+		 * or assigned to.
 		 */
-		std::vector<uint8_t> data() const;
+		const std::vector<uint8_t> &data() const;
 
 		/**
 		 * @brief Gets warnings that were generated during the fetch.
+		 * 
+		 * @note The returned reference is valid until the blob is destroyed
+		 * or assigned to.
+		 */
+		const std::vector<std::string> &warnings() const;
+
+		/**
+		 * @brief Gets statistics describing how the blob was captured.
 		 */
-		std::vector<std::string> warnings() const;
+		const BlobMetadata &metadata() const;
+
+		/**
+		 * @brief Gets the packet gaps detected in the blob's data, in the
+		 * order they occurred.
+		 * 
+		 * @note The returned reference is valid until the blob is destroyed
+		 * or assigned to.
+		 */
+		const std::vector<PacketGap> &gaps() const;
+
+		/**
+		 * @brief Gets the location of each packet's data in the blob, in
+		 * the order the packets arrived.
+		 * 
+		 * Empty unless packet indexing was enabled when the blob was
+		 * captured.
+		 * 
+		 * @note The returned reference is valid until the blob is destroyed
+		 * or assigned to.
+		 */
+		const std::vector<PacketIndexEntry> &packetIndex() const;
+
+		/**
+		 * @brief Gets a non-owning view of the data attributed to one packet.
+		 * 
+		 * @param index The position of the packet in packetIndex().
+		 * 
+		 * @throws std::out_of_range if index is not a valid position in
+		 * packetIndex(), or if its entry lies outside the blob's data.
+		 * 
+		 * @note The view is valid until the blob is destroyed or assigned to.
+		 */
+		ByteView packetView(size_t index) const;
+
+		/**
+		 * @brief Gets the number of data bytes in the blob.
+		 */
+		size_t size() const;
+
+		/**
+		 * @brief Checks whether the blob contains no data.
+		 */
+		bool empty() const;
+
+		/**
+		 * @brief Gets a non-owning view of the blob's data.
+		 * 
+		 * @note The view is valid until the blob is destroyed or assigned to.
+		 */
+		ByteView view() const;
+
+		/**
+		 * @brief Gets the number of DataBlobs sharing this blob's data,
+		 * including this one. Returns 0 for a default-constructed blob.
+		 */
+		long useCount() const;
+
+		#if __cplusplus >= 202002L
+
+		/**
+		 * @brief Gets a non-owning view of the blob's data as a std::span.
+		 * Only available when compiled as C++20 or later.
+		 * 
+		 * @note The span is valid until the blob is destroyed or assigned to.
+		 */
+		std::span<const uint8_t> span() const {
+
+			ByteView data = view();
+
+			return std::span<const uint8_t>(data.data(), data.size());
+
+		}
+
+		#endif
 
 		/**
 		 * @brief An iterator used to traverse the blob's data
@@ -82,13 +372,38 @@ namespace DAQCap {
 
 	private:
 
-		int packets = 0;
+		// The shared, immutable part of a blob
+		struct Contents {
+
+			int packets = 0;
+
+			std::vector<uint8_t> dataBuffer;
+
+			std::vector<std::string> warningsBuffer;
+
+			BlobMetadata metadata;
+
+			std::vector<PacketGap> gapList;
+
+			std::vector<PacketIndexEntry> packetList;
+
+			// Whether a BlobPool holds a reference to these contents
+			std::atomic<bool> pooled{false};
+
+		};
 
-		std::vector<uint8_t> dataBuffer;
+		// Null for a default-constructed blob.
+		// NOTE: Contents are only ever written by PacketProcessor, right
+		//       after it acquires them from a BlobPool and before the blob
+		//       is handed out. After that they are immutable.
+		std::shared_ptr<Contents> contents;
 
-		std::vector<std::string> warningsBuffer;
+		// Returns the contents for reading. Never null.
+		const Contents &read() const;
 
 		friend class PacketProcessor;
+		friend class BlobPool;
+		friend class SerializedBlob;
 
 	};
 
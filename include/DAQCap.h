@@ -101,6 +101,58 @@ namespace DAQCap {
 		 */
 		virtual void interrupt() = 0;
 
+		/**
+		 * @brief Enables or disables recording where each packet's data lies
+		 * in fetched blobs. Disabled by default.
+		 * 
+		 * The index costs a few bytes per packet, and lets consumers slice
+		 * blobs at packet granularity after idle words are removed.
+		 * 
+		 * @see DataBlob::packetIndex()
+		 */
+		virtual void setPacketIndexing(bool enabled) = 0;
+
+		/**
+		 * @brief Sets how many blob buffers the device keeps for reuse.
+		 * Defaults to 16.
+		 * 
+		 * fetchData() only reuses a data buffer while a free one is
+		 * available, so this should be at least the number of fetched blobs
+		 * the program keeps alive at once -- for instance, the blobs queued
+		 * in a BlobWriter, those held by the sink it writes to and those
+		 * queued for StreamServer subscribers. Blobs beyond that get
+		 * buffers that are allocated and freed each time.
+		 * 
+		 * @param buffers The maximum number of buffers to keep.
+		 */
+		virtual void setBlobPoolSize(size_t buffers) = 0;
+
+		/**
+		 * @brief Starts recording every raw frame fetched from the device in
+		 * a pcapng file, in addition to processing it. Pass an empty path to
+		 * stop recording and close the file.
+		 * 
+		 * Frames are recorded exactly as captured, including frames that
+		 * could not be parsed as packets, so that data loss reported in
+		 * fetched blobs can be investigated without running a second
+		 * capture alongside this one. Timestamps have nanosecond precision
+		 * where the device supports it.
+		 * 
+		 * Frames are recorded on the thread calling fetchData() and are
+		 * buffered in large blocks, so the file may lag behind the capture
+		 * until recording stops. Recording also stops when the device is
+		 * closed.
+		 * 
+		 * @param path The pcapng file to create, or an empty string.
+		 * 
+		 * @throws std::runtime_error if the device is not open, or if the
+		 * file could not be opened or written.
+		 * 
+		 * @note If a frame can't be recorded, recording stops and the next
+		 * call to fetchData() throws.
+		 */
+		virtual void setRawFrameFile(const std::string &path) = 0;
+
 		/**
 		 * @brief Fetches data from the device.
 		 * 
@@ -136,6 +188,37 @@ namespace DAQCap {
 			int packetsToRead = ALL_PACKETS
 		) = 0;
 
+		/**
+		 * @brief Fetches data from the device into an existing blob.
+		 * 
+		 * Behaves exactly like fetchData(timeout, packetsToRead), except
+		 * that the result is stored in blob. The blob's previous buffer is
+		 * reused if blob was its only owner. Otherwise it is released, and
+		 * a buffer from a previously released blob is reused instead when
+		 * one is available.
+		 * 
+		 * Calling this in a loop with the same blob does not allocate new
+		 * blob data buffers once the loop reaches a steady state. Each
+		 * captured packet is still copied into a small allocation of its
+		 * own before it is processed.
+		 * 
+		 * @param blob The blob to store the fetched data in.
+		 * 
+		 * @param timeout The maximum time to wait for data to be available
+		 * before returning.
+		 * 
+		 * @param packetsToRead The maximum number of packets to read from the
+		 * device in one call to fetchData.
+		 * 
+		 * @throws std::runtime_error if an error occurs while fetching data.
+		 * If an exception is thrown, blob is left empty.
+		 */
+		virtual void fetchData(
+			DataBlob &blob,
+			std::chrono::seconds timeout = FOREVER,
+			int packetsToRead = ALL_PACKETS
+		) = 0;
+
 		virtual ~Device() = default;
 
 		Device(const Device &other) = delete;
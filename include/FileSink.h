@@ -0,0 +1,177 @@
+/**
+ * @file FileSink.h
+ *
+ * @brief Provides interchangeable output paths for writing captured data to
+ * files.
+ *
+ * @author Robert Myers
+ * Contact: romyers@umich.edu
+ */
+
+#pragma once
+
+#include "DAQBlob.h"
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstddef>
+#include <stdint.h>
+
+namespace DAQCap {
+
+	/**
+	 * @brief Options controlling how a FileSink writes its file.
+	 */
+	struct FileSinkOptions {
+
+		/**
+		 * @brief Submit writes through io_uring instead of blocking write
+		 * calls. Requires Linux 5.1 or later.
+		 * 
+		 * Data is copied into a fixed set of buffers registered with the
+		 * kernel, and up to bufferCount writes are left in flight at once.
+		 * FileSink::write() only blocks when every buffer is in flight.
+		 */
+		bool useIOUring = false;
+
+		/**
+		 * @brief Open the file with O_DIRECT, so that written data bypasses
+		 * the page cache instead of evicting memory other processes need.
+		 * Only supported on Linux, and not together with useIOUring.
+		 * 
+		 * Data is staged in a block-aligned buffer of bufferSize bytes and
+		 * written in whole blocks. A partial final block is padded while it
+		 * is written, and the padding is truncated away again.
+		 */
+		bool directIO = false;
+
+		/**
+		 * @brief Reserve disk space ahead of the data in extents of this many
+		 * bytes, so the file stays contiguous and writes don't wait on block
+		 * allocation. 0 disables preallocation. Only supported on Linux.
+		 * 
+		 * Space that is reserved but not written is released when the sink
+		 * is closed.
+		 */
+		uint64_t preallocateBytes = 0;
+
+		/**
+		 * @brief Start writing data back to disk every time this many bytes
+		 * have been written, and drop the data from the page cache once it
+		 * is on disk. 0 leaves writeback to the kernel. Only supported on
+		 * Linux, and ignored for direct writes, which skip the page cache.
+		 * 
+		 * Left to itself, the kernel lets dirty pages pile up and then
+		 * writes them back in large bursts, which can stall the whole
+		 * machine. Writing back each window as soon as it is complete keeps
+		 * the disk busy at a steady rate instead. Before starting on a
+		 * window, the sink waits for the window before it to reach the
+		 * disk, so the writer is held to the speed of the disk and never
+		 * has more than two windows of dirty data.
+		 */
+		uint64_t writebackBytes = 0;
+
+		/**
+		 * @brief The size in bytes of each buffer used for io_uring or direct
+		 * writes. Rounded up to a whole number of blocks for direct writes.
+		 */
+		size_t bufferSize = 1 << 20;
+
+		/**
+		 * @brief The number of buffers used for io_uring writes, and so the
+		 * maximum number of writes in flight.
+		 */
+		size_t bufferCount = 8;
+
+	};
+
+	/**
+	 * @brief Writes data to a file.
+	 * 
+	 * FileSinks hide how data reaches the disk, so that recorders can pick
+	 * an output path to suit their storage without changing how they write.
+	 * 
+	 * Data written to a FileSink may still be on its way to the file when
+	 * write() returns. Call flush() to wait for it.
+	 * 
+	 * @note FileSinks are not thread safe.
+	 * 
+	 * @note Only supported on POSIX systems.
+	 */
+	class FileSink {
+
+	public:
+
+		/**
+		 * @brief Creates or truncates a file and opens a sink to write to it.
+		 * 
+		 * @param path The path of the file to write.
+		 * @param options Options controlling how the file is written.
+		 * 
+		 * @throws std::runtime_error If the file could not be opened, or if
+		 * the requested options are not supported on this system.
+		 */
+		static std::unique_ptr<FileSink> open(
+			const std::string &path,
+			const FileSinkOptions &options = FileSinkOptions()
+		);
+
+		/**
+		 * @brief Checks whether io_uring writes are supported on this system.
+		 */
+		static bool supportsIOUring();
+
+		/**
+		 * @brief Writes data to the end of the file.
+		 * 
+		 * @throws std::runtime_error If the data could not be written.
+		 */
+		virtual void write(ByteView data) = 0;
+
+		/**
+		 * @brief Writes the miniDAQ data in several blobs to the end of the
+		 * file, in order.
+		 * 
+		 * @throws std::runtime_error If the data could not be written.
+		 */
+		virtual void write(const std::vector<DataBlob> &blobs);
+
+		/**
+		 * @brief Blocks until all data written to the sink has been handed
+		 * to the operating system.
+		 * 
+		 * @throws std::runtime_error If the data could not be written.
+		 */
+		virtual void flush() = 0;
+
+		/**
+		 * @brief Flushes the sink and closes its file. Has no effect if the
+		 * sink is already closed.
+		 * 
+		 * @throws std::runtime_error If the data could not be written.
+		 */
+		virtual void close() = 0;
+
+		/**
+		 * @brief Gets the number of bytes written to the sink, including
+		 * bytes not yet flushed.
+		 */
+		virtual uint64_t bytesWritten() const = 0;
+
+		/**
+		 * @brief Flushes and closes the sink. Errors are ignored; call
+		 * close() first to find out about them.
+		 */
+		virtual ~FileSink() = default;
+
+		FileSink(const FileSink &other) = delete;
+		FileSink &operator=(const FileSink &other) = delete;
+
+	protected:
+
+		FileSink() = default;
+
+	};
+
+}
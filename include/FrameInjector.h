@@ -0,0 +1,71 @@
+/**
+ * @file FrameInjector.h
+ *
+ * @brief Sends raw network frames out of a network interface.
+ *
+ * @author Robert Myers
+ * Contact: romyers@umich.edu
+ */
+
+#pragma once
+
+#include "DAQBlob.h"
+
+#include <string>
+#include <stdint.h>
+
+namespace DAQCap {
+
+	/**
+	 * @brief Sends raw frames out of a network interface through pcap, so
+	 * recorded runs can be replayed to a capture on another machine, or to
+	 * a capture on the same interface.
+	 * 
+	 * @note Sending frames usually needs the same privileges as capturing
+	 * them.
+	 * 
+	 * @note FrameInjectors are not thread safe.
+	 */
+	class FrameInjector final {
+
+	public:
+
+		/**
+		 * @brief Opens an interface for sending.
+		 * 
+		 * @param interfaceName The name of the interface, as given by
+		 * Device::getName().
+		 * 
+		 * @throws std::runtime_error If the interface could not be opened.
+		 */
+		explicit FrameInjector(const std::string &interfaceName);
+
+		~FrameInjector();
+
+		FrameInjector(const FrameInjector &other) = delete;
+		FrameInjector &operator=(const FrameInjector &other) = delete;
+
+		/**
+		 * @brief Sends a frame, which must start with its Ethernet header.
+		 * 
+		 * @throws std::runtime_error If the frame could not be sent.
+		 */
+		void inject(ByteView frame);
+
+		/**
+		 * @brief Gets the number of frames sent.
+		 */
+		uint64_t framesSent() const;
+
+	private:
+
+		// A pcap_t, kept opaque so users don't need pcap's headers
+		void *handle;
+
+		std::string name;
+
+		uint64_t frames;
+
+	};
+
+}
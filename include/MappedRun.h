@@ -0,0 +1,207 @@
+/**
+ * @file MappedRun.h
+ *
+ * @brief Reads recorded runs of any size by mapping them into memory.
+ *
+ * @author Robert Myers
+ * Contact: romyers@umich.edu
+ */
+
+#pragma once
+
+#include "DAQBlob.h"
+#include "WordView.h"
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <cstddef>
+#include <stdint.h>
+
+namespace DAQCap {
+
+	/**
+	 * @brief Provides random access to the words in a recorded .dat file or
+	 * chunked file, without reading the file into memory.
+	 * 
+	 * The file is mapped into the address space, and pages are read from
+	 * disk as they are touched, so runs much larger than memory can be
+	 * read. Words are decoded when they are accessed.
+	 * 
+	 * The run is divided into chunks for processing in parallel. A chunked
+	 * file keeps its own chunks, and a .dat file is divided into chunks of
+	 * a fixed number of words.
+	 * 
+	 * @note Reading a MappedRun is thread safe.
+	 * 
+	 * @note Only supported on POSIX systems.
+	 */
+	class MappedRun final {
+
+	public:
+
+		/**
+		 * @brief The default number of words in each chunk of a .dat file.
+		 */
+		static const size_t DEFAULT_CHUNK_WORDS;
+
+		/**
+		 * @brief Processes the decoded words in one chunk.
+		 * 
+		 * @param chunk The index of the chunk.
+		 * @param words The decoded words. Only valid during the call.
+		 */
+		typedef std::function<
+			void(size_t chunk, const std::vector<Word> &words)
+		> ChunkFunction;
+
+		/**
+		 * @brief Maps a recorded run into memory.
+		 * 
+		 * @param path The path of a .dat file or chunked file.
+		 * @param chunkWords The number of words in each chunk of a .dat
+		 * file. Ignored for chunked files.
+		 * 
+		 * @throws std::invalid_argument If chunkWords is 0.
+		 * @throws std::runtime_error If the file could not be mapped, or is
+		 * a chunked file with compressed chunks.
+		 */
+		explicit MappedRun(
+			const std::string &path,
+			size_t chunkWords = DEFAULT_CHUNK_WORDS
+		);
+
+		~MappedRun();
+
+		MappedRun(const MappedRun &other) = delete;
+		MappedRun &operator=(const MappedRun &other) = delete;
+
+		/**
+		 * @brief Checks whether the run was read from a chunked file.
+		 */
+		bool chunked() const;
+
+		/**
+		 * @brief Gets the number of whole words in the run.
+		 */
+		uint64_t size() const;
+
+		/**
+		 * @brief Checks whether the run contains no whole words.
+		 */
+		bool empty() const;
+
+		/**
+		 * @brief Decodes the word at the given index. Does not check bounds.
+		 */
+		Word operator[](uint64_t index) const;
+
+		/**
+		 * @brief Decodes the word at the given index.
+		 * 
+		 * @throws std::out_of_range If index is greater than or equal to
+		 * size().
+		 */
+		Word at(uint64_t index) const;
+
+		/**
+		 * @brief Decodes up to count consecutive words starting at index
+		 * firstWord, across chunk boundaries. Decoding stops early at the
+		 * end of the run.
+		 * 
+		 * @param[in] firstWord The index of the first word to decode.
+		 * @param[in] count The maximum number of words to decode.
+		 * @param[out] out Receives the decoded words. Must have room for
+		 * count words.
+		 * 
+		 * @return The number of words decoded.
+		 * 
+		 * @throws std::out_of_range If firstWord is greater than size().
+		 */
+		size_t decode(uint64_t firstWord, size_t count, Word *out) const;
+
+		/**
+		 * @brief Gets the number of chunks in the run.
+		 */
+		size_t chunkCount() const;
+
+		/**
+		 * @brief Gets a view of the words in a chunk. The view is valid
+		 * until the MappedRun is destroyed.
+		 * 
+		 * @throws std::out_of_range If index is not a valid chunk index.
+		 */
+		WordView chunk(size_t index) const;
+
+		/**
+		 * @brief Gets the index of the run's first word in a chunk.
+		 * 
+		 * @throws std::out_of_range If index is not a valid chunk index.
+		 */
+		uint64_t chunkOffset(size_t index) const;
+
+		/**
+		 * @brief Checks a chunk against its checksum. Chunks of .dat files
+		 * have no checksum, and always pass.
+		 * 
+		 * @throws std::out_of_range If index is not a valid chunk index.
+		 */
+		bool verifyChunk(size_t index) const;
+
+		/**
+		 * @brief Decodes every chunk and passes its words to a function,
+		 * processing chunks on several threads at once.
+		 * 
+		 * Chunks are handed out in order, but may finish in any order, and
+		 * the function is called from several threads concurrently. Chunks
+		 * of chunked files are checked against their checksums before they
+		 * are processed.
+		 * 
+		 * If the function throws, no further chunks are started, and the
+		 * first exception is rethrown once every thread has finished.
+		 * 
+		 * @param function Called once for each chunk.
+		 * @param threads The number of threads to use, or 0 to use one per
+		 * core.
+		 * 
+		 * @throws std::runtime_error If a chunk does not match its checksum.
+		 */
+		void forEachChunk(
+			const ChunkFunction &function,
+			unsigned threads = 0
+		) const;
+
+	private:
+
+		struct Segment {
+
+			const uint8_t *data;
+			uint64_t firstWord;
+			size_t words;
+
+			// The chunk's size in bytes, including any trailing partial word
+			size_t size;
+			uint32_t checksum;
+
+		};
+
+		void *mapping;
+		size_t mappingSize;
+
+		bool isChunked;
+		size_t chunkWords;
+
+		std::vector<Segment> segments;
+		uint64_t words;
+
+		// Gets the index of the chunk holding a word
+		size_t chunkFor(uint64_t word) const;
+
+		// Asks the kernel to read a chunk into memory ahead of time
+		void prefetch(size_t index) const;
+
+		void checkChunk(size_t index) const;
+
+	};
+
+}
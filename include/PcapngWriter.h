@@ -0,0 +1,146 @@
+/**
+ * @file PcapngWriter.h
+ *
+ * @brief Records raw network frames in pcapng files.
+ *
+ * @author Robert Myers
+ * Contact: romyers@umich.edu
+ */
+
+#pragma once
+
+#include "FileSink.h"
+#include "DAQBlob.h"
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstddef>
+#include <stdint.h>
+
+namespace DAQCap {
+
+	/**
+	 * @brief Describes the interface frames were captured on, for the
+	 * header of a pcapng file.
+	 */
+	struct PcapngInterface {
+
+		/**
+		 * @brief The link-layer type of the frames, as a LINKTYPE_ value.
+		 * Defaults to Ethernet.
+		 */
+		uint16_t linkType = 1;
+
+		/**
+		 * @brief The maximum number of bytes captured from each frame.
+		 */
+		uint32_t snapLength = 65536;
+
+		/**
+		 * @brief The name of the interface. Omitted if empty.
+		 */
+		std::string name;
+
+		/**
+		 * @brief A description of the interface. Omitted if empty.
+		 */
+		std::string description;
+
+	};
+
+	/**
+	 * @brief Writes raw frames to a pcapng file, with nanosecond timestamps,
+	 * so they can be inspected with tools like Wireshark and tcpdump.
+	 * 
+	 * Frames are gathered in a large buffer and handed to the file's sink
+	 * whenever it fills up, so recording a frame is usually just a copy.
+	 * 
+	 * @note PcapngWriters are not thread safe.
+	 */
+	class PcapngWriter final {
+
+	public:
+
+		/**
+		 * @brief The default size in bytes of the frame buffer.
+		 */
+		static const size_t DEFAULT_BUFFER_SIZE;
+
+		/**
+		 * @brief Starts a pcapng file with one interface.
+		 * 
+		 * @param sink The sink to write the file to. Closed when the writer
+		 * is closed.
+		 * @param link The interface frames are captured on.
+		 * @param bufferSize How many bytes of frames to gather before
+		 * writing them to the sink.
+		 * 
+		 * @throws std::invalid_argument If sink is null.
+		 */
+		PcapngWriter(
+			std::unique_ptr<FileSink> sink,
+			const PcapngInterface &link,
+			size_t bufferSize = DEFAULT_BUFFER_SIZE
+		);
+
+		/**
+		 * @brief Closes the writer. Errors are ignored; call close() first
+		 * to find out about them.
+		 */
+		~PcapngWriter();
+
+		PcapngWriter(const PcapngWriter &other) = delete;
+		PcapngWriter &operator=(const PcapngWriter &other) = delete;
+
+		/**
+		 * @brief Records a frame.
+		 * 
+		 * @param frame The captured bytes of the frame.
+		 * @param originalLength The length of the frame on the wire, which
+		 * may be more than was captured.
+		 * @param time When the frame arrived.
+		 * 
+		 * @throws std::runtime_error If the buffer could not be written.
+		 */
+		void writeFrame(
+			ByteView frame,
+			uint32_t originalLength,
+			Timestamp time
+		);
+
+		/**
+		 * @brief Writes any buffered frames and flushes the sink.
+		 * 
+		 * @throws std::runtime_error If the frames could not be written.
+		 */
+		void flush();
+
+		/**
+		 * @brief Writes any buffered frames and closes the sink. Has no
+		 * effect if the writer is already closed.
+		 * 
+		 * @throws std::runtime_error If the frames could not be written.
+		 */
+		void close();
+
+		/**
+		 * @brief Gets the number of frames recorded.
+		 */
+		uint64_t framesWritten() const;
+
+	private:
+
+		std::unique_ptr<FileSink> sink;
+
+		std::vector<uint8_t> buffer;
+		size_t bufferSize;
+
+		uint64_t frames;
+
+		// Hands the buffer to the sink
+		void drain();
+
+	};
+
+}
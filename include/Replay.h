@@ -0,0 +1,214 @@
+/**
+ * @file Replay.h
+ *
+ * @brief Reads recorded runs back as network frames, and replays them at a
+ * controlled rate.
+ *
+ * @author Robert Myers
+ * Contact: romyers@umich.edu
+ */
+
+#pragma once
+
+#include "DAQBlob.h"
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <chrono>
+#include <cstddef>
+#include <stdint.h>
+
+namespace DAQCap {
+
+	/**
+	 * @brief A network frame read from a recorded run.
+	 */
+	struct Frame {
+
+		/**
+		 * @brief The bytes of the frame, starting with its Ethernet header.
+		 */
+		std::vector<uint8_t> bytes;
+
+		/**
+		 * @brief The length of the frame on the wire, which may be more than
+		 * was captured.
+		 */
+		uint32_t originalLength = 0;
+
+		/**
+		 * @brief When the frame arrived. Only meaningful if the source is
+		 * timed.
+		 */
+		Timestamp time;
+
+	};
+
+	/**
+	 * @brief Options for reading frames from recorded runs.
+	 */
+	struct FrameSourceOptions {
+
+		/**
+		 * @brief The number of data words in each frame made from a .dat or
+		 * chunked file. Frames read from pcap files are kept as they were
+		 * captured.
+		 */
+		size_t frameWords = 256;
+
+	};
+
+	/**
+	 * @brief Reads the frames of a recorded run in order.
+	 * 
+	 * Runs recorded to pcap or pcapng files are read frame by frame, as
+	 * they were captured. The data in .dat and chunked files is split back
+	 * into miniDAQ frames, with consecutive packet numbers, so it can be
+	 * sent through the capture path again. Idle words removed during the
+	 * original capture are not restored.
+	 */
+	class FrameSource {
+
+	public:
+
+		/**
+		 * @brief Opens a recorded run, working out its format from its
+		 * contents.
+		 * 
+		 * @param path A pcap, pcapng, chunked or .dat file.
+		 * @param options Options for reading the run.
+		 * 
+		 * @throws std::invalid_argument If frameWords is 0, or too large
+		 * for a frame.
+		 * @throws std::runtime_error If the file could not be opened.
+		 */
+		static std::unique_ptr<FrameSource> open(
+			const std::string &path,
+			const FrameSourceOptions &options = FrameSourceOptions()
+		);
+
+		virtual ~FrameSource() = default;
+
+		FrameSource(const FrameSource &other) = delete;
+		FrameSource &operator=(const FrameSource &other) = delete;
+
+		/**
+		 * @brief Reads the next frame.
+		 * 
+		 * @param[out] frame Receives the frame. Its buffer is reused.
+		 * 
+		 * @return True if a frame was read, or false at the end of the run.
+		 * 
+		 * @throws std::runtime_error If the file could not be read or is
+		 * corrupt.
+		 */
+		virtual bool next(Frame &frame) = 0;
+
+		/**
+		 * @brief Checks whether frames carry the times they arrived. Frames
+		 * from .dat files don't.
+		 */
+		virtual bool timed() const = 0;
+
+	protected:
+
+		FrameSource() = default;
+
+	};
+
+	/**
+	 * @brief Holds back frames so they are replayed at a chosen rate.
+	 * 
+	 * Frames can be replayed at a multiple of the speed they were captured
+	 * at, at a fixed data rate, or as fast as possible. Pacing follows a
+	 * schedule set by the first frame, so time spent between calls to
+	 * wait() doesn't slow the replay down, and a replay that falls behind
+	 * catches up by sending frames back to back.
+	 * 
+	 * @note FramePacers are not thread safe.
+	 */
+	class FramePacer final {
+
+	public:
+
+		/**
+		 * @brief Creates a pacer.
+		 * 
+		 * @param speed The multiple of the original speed to replay timed
+		 * frames at, or 0 to replay them as fast as possible.
+		 * @param bytesPerSecond If nonzero, frames are replayed at this
+		 * data rate instead, whether or not they are timed.
+		 * 
+		 * @throws std::invalid_argument If either argument is negative.
+		 */
+		explicit FramePacer(double speed = 1, double bytesPerSecond = 0);
+
+		/**
+		 * @brief Waits until a frame is due to be replayed.
+		 */
+		void wait(const Frame &frame);
+
+		/**
+		 * @brief Starts a new schedule with the next frame.
+		 */
+		void reset();
+
+	private:
+
+		double speed;
+		double bytesPerSecond;
+
+		bool started;
+		std::chrono::steady_clock::time_point start;
+		Timestamp firstFrame;
+		uint64_t bytes;
+
+	};
+
+	/**
+	 * @brief Processes replayed frames into blobs, as a Device would when
+	 * capturing them.
+	 * 
+	 * Packet numbers are checked across blobs, so gaps between frames are
+	 * reported in the blobs just as they are during capture.
+	 * 
+	 * @note FrameBlobBuilders are not thread safe.
+	 */
+	class FrameBlobBuilder final {
+
+	public:
+
+		FrameBlobBuilder();
+		~FrameBlobBuilder();
+
+		FrameBlobBuilder(const FrameBlobBuilder &other) = delete;
+		FrameBlobBuilder &operator=(const FrameBlobBuilder &other) = delete;
+
+		/**
+		 * @brief Adds a frame to the next blob. Frames too short to be
+		 * miniDAQ packets are counted as rejected.
+		 */
+		void add(const Frame &frame);
+
+		/**
+		 * @brief Gets the number of frames added since the last blob was
+		 * built, including rejected frames.
+		 */
+		size_t size() const;
+
+		/**
+		 * @brief Processes the frames added since the last blob into blob.
+		 * The blob's buffer is reused if blob was its only owner.
+		 */
+		void build(DataBlob &blob);
+
+	private:
+
+		struct Batch;
+
+		std::unique_ptr<Batch> batch;
+
+	};
+
+}
@@ -0,0 +1,174 @@
+/**
+ * @file RotatingFileSink.h
+ *
+ * @brief Splits recorded data across a series of files.
+ *
+ * @author Robert Myers
+ * Contact: romyers@umich.edu
+ */
+
+#pragma once
+
+#include "FileSink.h"
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <future>
+#include <chrono>
+#include <functional>
+#include <cstddef>
+#include <stdint.h>
+
+namespace DAQCap {
+
+	/**
+	 * @brief Controls when a RotatingFileSink moves on to a new file.
+	 * 
+	 * A new file is started as soon as either limit is reached. If neither
+	 * limit is set, everything is written to one file.
+	 */
+	struct RotationOptions {
+
+		/**
+		 * @brief The maximum number of bytes per file, or 0 for no limit.
+		 * Must be at least one word if set.
+		 */
+		uint64_t maxBytes = 0;
+
+		/**
+		 * @brief The maximum time to write to one file, or 0 for no limit.
+		 */
+		std::chrono::seconds maxDuration = std::chrono::seconds(0);
+
+	};
+
+	/**
+	 * @brief A FileSink that writes to a series of files, starting a new file
+	 * whenever the current one gets too big or too old.
+	 * 
+	 * Files only ever end at a word boundary, so each file holds a whole
+	 * number of miniDAQ words and can be processed on its own.
+	 * 
+	 * The next file is opened, and preallocated if requested, on a
+	 * background thread while the current file is written, and finished
+	 * files are closed in the background too. Switching files therefore
+	 * doesn't wait on the file system.
+	 * 
+	 * @note Data written to the sink must begin at a word boundary.
+	 */
+	class RotatingFileSink final : public FileSink {
+
+	public:
+
+		/**
+		 * @brief Gets the path of the file with the given index. Files are
+		 * numbered from 0.
+		 */
+		typedef std::function<std::string(size_t index)> PathFunction;
+
+		/**
+		 * @brief Opens the first file and starts preparing the second.
+		 * 
+		 * @param pathFor Gives the path of each file.
+		 * @param rotation When to start a new file.
+		 * @param options How to write each file.
+		 * 
+		 * @throws std::invalid_argument If rotation.maxBytes is smaller than
+		 * a word.
+		 * @throws std::runtime_error If the first file could not be opened.
+		 */
+		RotatingFileSink(
+			PathFunction pathFor,
+			const RotationOptions &rotation,
+			const FileSinkOptions &options = FileSinkOptions()
+		);
+
+		/**
+		 * @brief Closes the sink. Errors are ignored; call close() first to
+		 * find out about them.
+		 */
+		virtual ~RotatingFileSink();
+
+		/**
+		 * @brief Writes data, starting new files as needed.
+		 * 
+		 * @throws std::runtime_error If the data could not be written, or if
+		 * a new file could not be opened.
+		 */
+		virtual void write(ByteView data) override;
+
+		/**
+		 * @brief Writes the data in several blobs, starting new files as
+		 * needed.
+		 * 
+		 * @throws std::runtime_error If the data could not be written, or if
+		 * a new file could not be opened.
+		 */
+		virtual void write(const std::vector<DataBlob> &blobs) override;
+
+		virtual void flush() override;
+
+		/**
+		 * @brief Closes the current file, waits for earlier files to finish
+		 * closing, and removes the prepared next file, which is empty.
+		 */
+		virtual void close() override;
+
+		virtual uint64_t bytesWritten() const override;
+
+		/**
+		 * @brief Gets the index of the file being written.
+		 */
+		size_t fileIndex() const;
+
+		/**
+		 * @brief Gets the path of the file being written.
+		 */
+		std::string currentPath() const;
+
+	private:
+
+		PathFunction pathFor;
+		RotationOptions rotation;
+		FileSinkOptions options;
+
+		// The file being written
+		std::unique_ptr<FileSink> current;
+		std::string path;
+		size_t index;
+
+		uint64_t fileBytes;
+		std::chrono::steady_clock::time_point fileStart;
+
+		// The next file, being opened in the background
+		std::future<std::unique_ptr<FileSink>> next;
+		std::string nextPath;
+
+		// Earlier files, being closed in the background
+		std::vector<std::future<void>> closing;
+
+		uint64_t bytes;
+
+		// Starts opening the file after the current one
+		void prepareNext();
+
+		// Moves on to the next file
+		void rotate();
+
+		// Checks whether the current file has been open too long
+		bool expired() const;
+
+		// Gets how many more bytes fit in the current file, ending at a word
+		// boundary
+		uint64_t room() const;
+
+		// Reports errors from files that finished closing. If wait is true,
+		// waits for every file to finish closing first.
+		void collectClosed(bool wait);
+
+		void checkOpen() const;
+
+	};
+
+}
@@ -0,0 +1,166 @@
+/**
+ * @file SerializedBlob.h
+ *
+ * @brief A self-describing binary format for DataBlobs, for handing blobs
+ * to other processes or later processing stages.
+ *
+ * @author Robert Myers
+ * Contact: romyers@umich.edu
+ */
+
+#pragma once
+
+#include "DAQBlob.h"
+
+#include <vector>
+#include <string>
+#include <cstddef>
+#include <stdint.h>
+
+namespace DAQCap {
+
+	/**
+	 * @brief Appends everything in a blob's serialized form except its data
+	 * to out.
+	 * 
+	 * The serialized blob is the appended header followed immediately by
+	 * the blob's data. Keeping the two apart lets the data be written
+	 * straight from the blob's buffer without copying it.
+	 * 
+	 * @param[in] blob The blob to serialize.
+	 * @param[out] out The header is appended here.
+	 * 
+	 * @see writeSerializedBlob()
+	 */
+	void serializeBlobHeader(const DataBlob &blob, std::vector<uint8_t> &out);
+
+	/**
+	 * @brief Serializes a blob, including its data, metadata, packet gaps,
+	 * packet index and warnings.
+	 * 
+	 * @param blob The blob to serialize.
+	 * 
+	 * @return The serialized blob.
+	 */
+	std::vector<uint8_t> serializeBlob(const DataBlob &blob);
+
+	/**
+	 * @brief A read-only view of a serialized blob.
+	 * 
+	 * Parsing a serialized blob validates it and decodes its metadata, but
+	 * does not copy its data or other variable-length contents. This makes
+	 * it cheap to read blobs directly out of e.g. a memory-mapped file or
+	 * shared memory region.
+	 * 
+	 * Like ByteView, a SerializedBlob does not extend the lifetime of the
+	 * bytes it refers to.
+	 */
+	class SerializedBlob final {
+
+	public:
+
+		/**
+		 * @brief The version of the format written by this library.
+		 */
+		static const uint16_t VERSION;
+
+		/**
+		 * @brief Parses the serialized blob at the start of bytes.
+		 * 
+		 * Bytes may extend past the end of the serialized blob, e.g. when
+		 * several serialized blobs are stored back to back. Use size() to
+		 * find where the next one starts.
+		 * 
+		 * @param bytes The bytes to parse.
+		 * 
+		 * @throws std::invalid_argument if bytes do not start with a
+		 * complete serialized blob, or if it was written by an incompatible
+		 * version of the library.
+		 */
+		explicit SerializedBlob(ByteView bytes);
+
+		/**
+		 * @brief Gets the number of bytes taken up by the serialized blob.
+		 */
+		size_t size() const;
+
+		/**
+		 * @brief Gets the format version the blob was serialized with.
+		 */
+		uint16_t version() const;
+
+		/**
+		 * @brief Gets the number of packets in the blob.
+		 */
+		int packetCount() const;
+
+		/**
+		 * @brief Gets statistics describing how the blob was captured.
+		 */
+		const BlobMetadata &metadata() const;
+
+		/**
+		 * @brief Gets the number of packet gaps recorded in the blob.
+		 */
+		size_t gapCount() const;
+
+		/**
+		 * @brief Gets a packet gap recorded in the blob.
+		 * 
+		 * @throws std::out_of_range if index >= gapCount().
+		 */
+		PacketGap gap(size_t index) const;
+
+		/**
+		 * @brief Gets the number of entries in the blob's packet index.
+		 */
+		size_t packetIndexSize() const;
+
+		/**
+		 * @brief Gets an entry of the blob's packet index.
+		 * 
+		 * @throws std::out_of_range if index >= packetIndexSize().
+		 */
+		PacketIndexEntry packetIndexEntry(size_t index) const;
+
+		/**
+		 * @brief Gets the number of warnings recorded in the blob.
+		 */
+		size_t warningCount() const;
+
+		/**
+		 * @brief Copies out the warnings recorded in the blob.
+		 */
+		std::vector<std::string> warnings() const;
+
+		/**
+		 * @brief Gets a view of the blob's data, without copying it.
+		 */
+		ByteView data() const;
+
+		/**
+		 * @brief Copies the serialized blob into a new DataBlob.
+		 */
+		DataBlob toBlob() const;
+
+	private:
+
+		ByteView bytes;
+
+		uint16_t formatVersion;
+		int packets;
+		BlobMetadata blobMetadata;
+
+		size_t gaps;
+		size_t indexEntries;
+		size_t warningStrings;
+
+		// Where each section starts in bytes
+		size_t gapStart;
+		size_t indexStart;
+		size_t warningStart;
+		size_t dataStart;
+
+	};
+
+}
@@ -0,0 +1,213 @@
+/**
+ * @file SharedRing.h
+ *
+ * @brief Publishes blobs to other processes through a ring buffer in POSIX
+ * shared memory.
+ *
+ * @author Robert Myers
+ * Contact: romyers@umich.edu
+ */
+
+#pragma once
+
+#include "DAQBlob.h"
+
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstddef>
+#include <stdint.h>
+
+namespace DAQCap {
+
+	/**
+	 * @brief Publishes blobs into a ring buffer in shared memory, where
+	 * monitoring processes can read them with SharedRingSubscribers.
+	 * 
+	 * The ring has a single writer and any number of readers. Each reader
+	 * keeps its own position, and readers never hold up the writer: once
+	 * the ring is full, the oldest blobs are overwritten whether or not
+	 * every reader has seen them. Readers that fall a whole ring behind
+	 * skip ahead and count the blobs they missed.
+	 * 
+	 * Blobs are published in the format written by serializeBlob().
+	 * 
+	 * The shared memory object is created when the publisher is
+	 * constructed, replacing any object with the same name, and removed
+	 * when the publisher is destroyed. Readers that are still attached keep
+	 * their mapping, and see that the ring was closed.
+	 * 
+	 * @note SharedRingPublishers are not thread safe.
+	 * 
+	 * @note Only supported on POSIX systems.
+	 */
+	class SharedRingPublisher final {
+
+	public:
+
+		/**
+		 * @brief The default number of bytes of blobs the ring holds.
+		 */
+		static const size_t DEFAULT_CAPACITY;
+
+		/**
+		 * @brief Creates a shared memory ring.
+		 * 
+		 * @param name The name of the shared memory object, e.g.
+		 * "/daqcap". A leading slash is added if it is missing.
+		 * @param capacity The number of bytes of blobs the ring can hold.
+		 * Rounded up to a multiple of 8.
+		 * 
+		 * @throws std::invalid_argument If capacity is too small to hold
+		 * anything.
+		 * @throws std::runtime_error If the shared memory could not be
+		 * created.
+		 */
+		explicit SharedRingPublisher(
+			const std::string &name,
+			size_t capacity = DEFAULT_CAPACITY
+		);
+
+		/**
+		 * @brief Marks the ring closed and removes the shared memory object.
+		 */
+		~SharedRingPublisher();
+
+		SharedRingPublisher(const SharedRingPublisher &other) = delete;
+		SharedRingPublisher &operator=(
+			const SharedRingPublisher &other
+		) = delete;
+
+		/**
+		 * @brief Copies a blob into the ring, overwriting the oldest blobs
+		 * if there isn't room. Never waits for readers.
+		 * 
+		 * @throws std::invalid_argument If the serialized blob is larger
+		 * than the ring.
+		 */
+		void publish(const DataBlob &blob);
+
+		/**
+		 * @brief Gets the number of blobs published.
+		 */
+		uint64_t published() const;
+
+		/**
+		 * @brief Gets the name of the shared memory object.
+		 */
+		const std::string &name() const;
+
+	private:
+
+		std::string objectName;
+
+		void *mapping;
+		size_t mappingSize;
+
+		uint64_t capacity;
+		uint64_t position;
+		uint64_t records;
+
+		// Reused for each blob's serialized header
+		std::vector<uint8_t> header;
+
+		// Copies bytes into the ring at a position, wrapping around the end
+		void copyIn(uint64_t at, const uint8_t *data, size_t size);
+
+	};
+
+	/**
+	 * @brief Reads blobs published by a SharedRingPublisher, possibly in
+	 * another process.
+	 * 
+	 * A new subscriber starts with the next blob published. Blobs are read
+	 * in order, except that a subscriber that falls a whole ring behind the
+	 * publisher skips ahead to the newest blobs. Blobs that were skipped are
+	 * counted by missed().
+	 * 
+	 * @note SharedRingSubscribers are not thread safe, but any number of
+	 * them may read the same ring.
+	 * 
+	 * @note Only supported on POSIX systems.
+	 */
+	class SharedRingSubscriber final {
+
+	public:
+
+		/**
+		 * @brief Attaches to a shared memory ring.
+		 * 
+		 * @param name The name the ring was published under. A leading
+		 * slash is added if it is missing.
+		 * 
+		 * @throws std::runtime_error If there is no ring with the given
+		 * name, or it was written by an incompatible version of the
+		 * library.
+		 */
+		explicit SharedRingSubscriber(const std::string &name);
+
+		~SharedRingSubscriber();
+
+		SharedRingSubscriber(const SharedRingSubscriber &other) = delete;
+		SharedRingSubscriber &operator=(
+			const SharedRingSubscriber &other
+		) = delete;
+
+		/**
+		 * @brief Reads the next blob, waiting for one to be published if
+		 * necessary.
+		 * 
+		 * @param[out] blob Receives the blob.
+		 * @param[in] timeout The maximum time to wait for a blob. If 0, only
+		 * blobs that have already been published are read.
+		 * 
+		 * @return True if a blob was read, or false if the timeout expired
+		 * or the ring was closed first.
+		 */
+		bool next(
+			DataBlob &blob,
+			std::chrono::milliseconds timeout = std::chrono::milliseconds(0)
+		);
+
+		/**
+		 * @brief Gets the number of blobs skipped because the subscriber
+		 * fell behind.
+		 */
+		uint64_t missed() const;
+
+		/**
+		 * @brief Checks whether the publisher has closed the ring. Blobs it
+		 * published may still be read.
+		 */
+		bool closed() const;
+
+	private:
+
+		void *mapping;
+		size_t mappingSize;
+
+		uint64_t capacity;
+		uint64_t position;
+
+		bool started;
+		uint64_t nextRecord;
+		uint64_t skipped;
+
+		// Holds each record while it is checked and parsed
+		std::vector<uint8_t> buffer;
+
+		// Copies bytes out of the ring at a position, wrapping around the
+		// end
+		void copyOut(uint64_t at, uint8_t *data, size_t size) const;
+
+		// Checks whether the publisher may have started overwriting the
+		// bytes at position or later since they were copied
+		bool overwritten() const;
+
+		// Reads the record at position, if it is complete and intact.
+		// Returns false if there is nothing to read.
+		bool tryRead(DataBlob &blob);
+
+	};
+
+}
@@ -0,0 +1,221 @@
+/**
+ * @file StreamServer.h
+ *
+ * @brief Streams blobs to local subscribers over a Unix domain socket.
+ *
+ * @author Robert Myers
+ * Contact: romyers@umich.edu
+ */
+
+#pragma once
+
+#include "DAQBlob.h"
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <cstddef>
+#include <stdint.h>
+
+namespace DAQCap {
+
+	/**
+	 * @brief Options for a StreamServer.
+	 */
+	struct StreamServerOptions {
+
+		/**
+		 * @brief The maximum number of blobs waiting to be sent to each
+		 * subscriber. Once a subscriber's queue is full, its oldest waiting
+		 * blob is dropped to make room for each new one.
+		 */
+		size_t queueLength = 64;
+
+	};
+
+	/**
+	 * @brief Serves blobs to any number of local subscribers, such as event
+	 * displays and data quality monitors, over a Unix domain socket.
+	 * 
+	 * Each blob is sent in the format written by serializeBlob(), which
+	 * begins with its own size, so subscribers can tell where each blob
+	 * ends. StreamClient reads this format.
+	 * 
+	 * Blobs are sent from a background thread. Each subscriber has its own
+	 * bounded queue, and publishing never waits for a subscriber: a
+	 * subscriber that can't keep up loses its oldest waiting blobs instead.
+	 * Queued blobs share their buffers with the published blob, so queueing
+	 * doesn't copy any data.
+	 * 
+	 * @note Only supported on POSIX systems.
+	 */
+	class StreamServer final {
+
+	public:
+
+		/**
+		 * @brief Starts listening for subscribers.
+		 * 
+		 * @param path The path of the socket. A stale socket at the path
+		 * is replaced.
+		 * @param options Options for the server.
+		 * 
+		 * @throws std::invalid_argument If queueLength is 0 or the path is
+		 * too long for a socket.
+		 * @throws std::runtime_error If the socket could not be created.
+		 */
+		explicit StreamServer(
+			const std::string &path,
+			const StreamServerOptions &options = StreamServerOptions()
+		);
+
+		/**
+		 * @brief Closes the server.
+		 */
+		~StreamServer();
+
+		StreamServer(const StreamServer &other) = delete;
+		StreamServer &operator=(const StreamServer &other) = delete;
+
+		/**
+		 * @brief Queues a blob for every connected subscriber. Never waits
+		 * for subscribers. Empty blobs are ignored.
+		 * 
+		 * @throws std::runtime_error If the server is closed.
+		 */
+		void publish(const DataBlob &blob);
+
+		/**
+		 * @brief Gets the number of connected subscribers.
+		 */
+		size_t subscriberCount() const;
+
+		/**
+		 * @brief Gets the number of blobs dropped because a subscriber's
+		 * queue was full, over all subscribers.
+		 */
+		uint64_t dropped() const;
+
+		/**
+		 * @brief Gets the path of the socket.
+		 */
+		const std::string &path() const;
+
+		/**
+		 * @brief Disconnects every subscriber, stops listening and removes
+		 * the socket. Blobs that have not been sent are discarded. Has no
+		 * effect if the server is already closed.
+		 */
+		void close();
+
+	private:
+
+		struct Subscriber {
+
+			int fd;
+
+			// The first blob is the one being sent
+			std::deque<DataBlob> queue;
+
+			// The serialized header of the blob being sent, and how much of
+			// the blob has been sent. Empty if no blob is being sent.
+			std::vector<uint8_t> header;
+			size_t sent;
+
+		};
+
+		std::string socketPath;
+		size_t queueLength;
+
+		int listener;
+
+		// Wakes the server thread when blobs are queued or the server is
+		// closing
+		int wakeRead;
+		int wakeWrite;
+
+		mutable std::mutex mutex;
+
+		// Only added to and removed from by the server thread
+		std::vector<std::unique_ptr<Subscriber>> subscribers;
+
+		uint64_t dropCount;
+		bool closing;
+
+		std::thread thread;
+
+		// Accepts subscribers and sends them blobs until the server closes
+		void run();
+
+		// Sends as much of a subscriber's queue as it will take without
+		// waiting. Returns false if the subscriber disconnected.
+		bool send(Subscriber &subscriber);
+
+		void wake();
+
+	};
+
+	/**
+	 * @brief Receives blobs from a StreamServer.
+	 * 
+	 * @note StreamClients are not thread safe.
+	 * 
+	 * @note Only supported on POSIX systems.
+	 */
+	class StreamClient final {
+
+	public:
+
+		/**
+		 * @brief Connects to a StreamServer.
+		 * 
+		 * @param path The path of the server's socket.
+		 * 
+		 * @throws std::invalid_argument If the path is too long for a
+		 * socket.
+		 * @throws std::runtime_error If the server could not be reached.
+		 */
+		explicit StreamClient(const std::string &path);
+
+		~StreamClient();
+
+		StreamClient(const StreamClient &other) = delete;
+		StreamClient &operator=(const StreamClient &other) = delete;
+
+		/**
+		 * @brief Receives the next blob.
+		 * 
+		 * A blob that is partly received when the timeout expires is kept,
+		 * and finished by a later call.
+		 * 
+		 * @param[out] blob Receives the blob.
+		 * @param[in] timeout The maximum time to wait.
+		 * 
+		 * @return True if a blob was received, or false if the timeout
+		 * expired or the server disconnected first.
+		 * 
+		 * @throws std::runtime_error If the stream is corrupt or could not
+		 * be read.
+		 */
+		bool next(DataBlob &blob, std::chrono::milliseconds timeout);
+
+		/**
+		 * @brief Checks whether the client is still connected to the server.
+		 */
+		bool connected() const;
+
+	private:
+
+		int fd;
+
+		// The blob being received, and how many bytes of it have arrived
+		std::vector<uint8_t> buffer;
+		size_t received;
+
+	};
+
+}
@@ -0,0 +1,377 @@
+/**
+ * @file WordLayout.h
+ *
+ * @brief Declares bit layouts of miniDAQ words and generates decoders for
+ * them at compile time.
+ *
+ * A layout is declared by naming each field as a BitField:
+ * @code
+ * struct Channel   : DAQCap::BitField<35, 5> {};
+ * struct EdgeTime  : DAQCap::BitField<0, 17> {};
+ * 
+ * typedef DAQCap::WordLayout<Channel, EdgeTime> HitWord;
+ * 
+ * DAQCap::Word channel = HitWord::get<Channel>(word);
+ * @endcode
+ *
+ * @author Robert Myers
+ * Contact: romyers@umich.edu
+ */
+
+#pragma once
+
+#include "DAQBlob.h"
+#include "WordView.h"
+
+#include <array>
+#include <cstddef>
+#include <type_traits>
+
+// pext gathers arbitrary bits in a single instruction, but it is only
+// fast on some CPUs. Single words only use it when the including translation
+// unit is compiled for a target that has it (e.g. with -mbmi2 or
+// -march=native), since they're gathered inline. Batches of words are
+// gathered by the library, which checks the CPU when it is loaded.
+#if defined(__BMI2__) && defined(__x86_64__)
+
+	#include <immintrin.h>
+
+	#define DAQCAP_WORD_LAYOUT_PEXT
+
+#endif
+
+namespace DAQCap {
+
+	/**
+	 * @brief Checks whether batches of words are gathered with the CPU's
+	 * pext instruction.
+	 * 
+	 * On x86-64 CPUs with BMI2, WordLayout::gather() uses pext for batches
+	 * of words no matter how the caller was compiled, except on CPUs where
+	 * pext is known to be slow. Otherwise, fields are gathered with shifts
+	 * and masks.
+	 */
+	bool wordGatherAccelerated();
+
+	/**
+	 * @brief A field of Width bits starting at bit Offset of a word, where bit
+	 * 0 is the least significant bit.
+	 * 
+	 * Name fields by inheriting from BitField, so that each field is a
+	 * distinct type.
+	 */
+	template<unsigned Offset, unsigned Width>
+	struct BitField {
+
+		static_assert(Width > 0, "BitField must be at least one bit wide.");
+		static_assert(
+			Offset + Width <= 8 * sizeof(Word), 
+			"BitField must fit in a Word."
+		);
+
+		/**
+		 * @brief Gets the offset of the field's least significant bit.
+		 */
+		static constexpr unsigned offset() { return Offset; }
+
+		/**
+		 * @brief Gets the width of the field in bits.
+		 */
+		static constexpr unsigned width() { return Width; }
+
+		/**
+		 * @brief Gets a mask of the field's bits in a word.
+		 */
+		static constexpr Word mask() { return valueMask() << Offset; }
+
+		/**
+		 * @brief Gets a mask of the field's bits once extracted.
+		 */
+		static constexpr Word valueMask() {
+
+			return Width == 8 * sizeof(Word) 
+				? ~Word(0) 
+				: (Word(1) << Width) - 1;
+
+		}
+
+		/**
+		 * @brief Extracts the field from a word.
+		 */
+		static constexpr Word extract(Word word) {
+
+			return (word >> Offset) & valueMask();
+
+		}
+
+		/**
+		 * @brief Returns word with the field replaced by value. Bits of value
+		 * that don't fit in the field are ignored.
+		 */
+		static constexpr Word insert(Word word, Word value) {
+
+			return (word & ~mask()) | ((value & valueMask()) << Offset);
+
+		}
+
+	};
+
+	namespace detail {
+
+		// Gathers the bits of each word under mask with pext.
+		// REQUIRES: wordGatherAccelerated()
+		void pextWords(const Word *words, size_t count, Word mask, Word *out);
+
+		// Counts the set bits in a word at compile time
+		constexpr unsigned popcount(Word word) {
+
+			return word == 0 ? 0 : (word & 1) + popcount(word >> 1);
+
+		}
+
+		// Combines the masks and widths of a list of fields
+		template<typename... Fields>
+		struct FieldList;
+
+		template<>
+		struct FieldList<> {
+
+			static constexpr Word mask() { return 0; }
+			static constexpr unsigned totalWidth() { return 0; }
+
+			template<typename Field>
+			static constexpr bool contains() { return false; }
+
+			// The total width of the fields below bit offset
+			static constexpr unsigned widthBelow(unsigned) { return 0; }
+
+		};
+
+		template<typename First, typename... Rest>
+		struct FieldList<First, Rest...> {
+
+			static constexpr Word mask() {
+
+				return First::mask() | FieldList<Rest...>::mask();
+
+			}
+
+			static constexpr unsigned totalWidth() {
+
+				return First::width() + FieldList<Rest...>::totalWidth();
+
+			}
+
+			template<typename Field>
+			static constexpr bool contains() {
+
+				return std::is_same<Field, First>::value 
+					|| FieldList<Rest...>::template contains<Field>();
+
+			}
+
+			static constexpr unsigned widthBelow(unsigned offset) {
+
+				return (First::offset() < offset ? First::width() : 0)
+					+ FieldList<Rest...>::widthBelow(offset);
+
+			}
+
+		};
+
+		// Gathers fields into a compact integer without pext
+		template<typename List, typename... Fields>
+		struct Gatherer;
+
+		template<typename List>
+		struct Gatherer<List> {
+
+			static Word gather(Word) { return 0; }
+
+		};
+
+		template<typename List, typename First, typename... Rest>
+		struct Gatherer<List, First, Rest...> {
+
+			static Word gather(Word word) {
+
+				return (First::extract(word) << List::widthBelow(First::offset()))
+					| Gatherer<List, Rest...>::gather(word);
+
+			}
+
+		};
+
+	}
+
+	/**
+	 * @brief A word layout made up of the given fields.
+	 * 
+	 * Fields may be listed in any order, but may not overlap.
+	 */
+	template<typename... Fields>
+	struct WordLayout {
+
+	private:
+
+		typedef detail::FieldList<Fields...> List;
+
+	public:
+
+		static_assert(
+			detail::popcount(List::mask()) == List::totalWidth(),
+			"WordLayout fields may not overlap."
+		);
+
+		/**
+		 * @brief The number of fields in the layout.
+		 */
+		static constexpr size_t fieldCount() { return sizeof...(Fields); }
+
+		/**
+		 * @brief Gets a mask of every bit covered by a field.
+		 */
+		static constexpr Word mask() { return List::mask(); }
+
+		/**
+		 * @brief Extracts a single field from a word.
+		 */
+		template<typename Field>
+		static constexpr Word get(Word word) {
+
+			static_assert(
+				List::template contains<Field>(), 
+				"Field is not part of this WordLayout."
+			);
+
+			return Field::extract(word);
+
+		}
+
+		/**
+		 * @brief Decodes every field of a word, in the order the fields are
+		 * listed in the layout.
+		 */
+		static std::array<Word, sizeof...(Fields)> decode(Word word) {
+
+			std::array<Word, sizeof...(Fields)> result = {{
+				Fields::extract(word)...
+			}};
+
+			return result;
+
+		}
+
+		/**
+		 * @brief Extracts one field from each of count words.
+		 * 
+		 * @param[in] words The words to decode.
+		 * @param[in] count The number of words to decode.
+		 * @param[out] out Receives count field values.
+		 */
+		template<typename Field>
+		static void decode(const Word *words, size_t count, Word *out) {
+
+			static_assert(
+				List::template contains<Field>(), 
+				"Field is not part of this WordLayout."
+			);
+
+			// NOTE: Simple enough for the compiler to vectorize
+			for(size_t i = 0; i < count; ++i) {
+
+				out[i] = Field::extract(words[i]);
+
+			}
+
+		}
+
+		/**
+		 * @brief Extracts one field from every word in a view.
+		 * 
+		 * @param[in] words The words to decode.
+		 * @param[out] out Receives words.size() field values.
+		 */
+		template<typename Field>
+		static void decode(const WordView &words, Word *out) {
+
+			// Unpack in batches that fit comfortably in cache
+			const size_t BATCH = 256;
+			Word batch[BATCH];
+
+			for(size_t first = 0; first < words.size(); first += BATCH) {
+
+				size_t count = words.decode(first, BATCH, batch);
+
+				decode<Field>(batch, count, out + first);
+
+			}
+
+		}
+
+		/**
+		 * @brief Gathers every field of a word into one compact integer.
+		 * 
+		 * Fields are packed in order of their position in the word, with
+		 * the lowest field in the least significant bits. The result is
+		 * handy as e.g. a lookup key built from several fields.
+		 * 
+		 * Uses the pext instruction when compiled for a target that has it.
+		 */
+		static Word gather(Word word) {
+
+			#ifdef DAQCAP_WORD_LAYOUT_PEXT
+
+				return _pext_u64(word, mask());
+
+			#else
+
+				return detail::Gatherer<List, Fields...>::gather(word);
+
+			#endif
+
+		}
+
+		/**
+		 * @brief Gathers the fields of each of count words.
+		 * 
+		 * @param[in] words The words to gather fields from.
+		 * @param[in] count The number of words.
+		 * @param[out] out Receives count gathered values.
+		 * 
+		 * @see wordGatherAccelerated()
+		 */
+		static void gather(const Word *words, size_t count, Word *out) {
+
+			#ifndef DAQCAP_WORD_LAYOUT_PEXT
+
+				if(wordGatherAccelerated()) {
+
+					detail::pextWords(words, count, mask(), out);
+					return;
+
+				}
+
+			#endif
+
+			for(size_t i = 0; i < count; ++i) {
+
+				out[i] = gather(words[i]);
+
+			}
+
+		}
+
+		/**
+		 * @brief Gets the offset of a field within the result of gather().
+		 */
+		template<typename Field>
+		static constexpr unsigned gatheredOffset() {
+
+			return List::widthBelow(Field::offset());
+
+		}
+
+	};
+
+}
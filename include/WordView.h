@@ -0,0 +1,326 @@
+/**
+ * @file WordView.h
+ *
+ * @brief Provides random access to the words in a range of miniDAQ bytes.
+ *
+ * @author Robert Myers
+ * Contact: romyers@umich.edu
+ */
+
+#pragma once
+
+#include "DAQBlob.h"
+
+#include <iterator>
+#include <cstddef>
+
+namespace DAQCap {
+
+	/**
+	 * @brief A non-owning, read-only view of the words in a range of bytes.
+	 * 
+	 * Words are decoded from the underlying big-endian bytes only when they
+	 * are accessed, so no packed copy of the data is ever made. Use
+	 * decode() to unpack many consecutive words at once.
+	 * 
+	 * REQUIRES: The first viewed byte is the first byte of a word. Any
+	 * trailing partial word is ignored.
+	 * 
+	 * @note A WordView does not extend the lifetime of the data it refers
+	 * to. A view of a DataBlob is valid until the blob is destroyed or
+	 * assigned to.
+	 */
+	class WordView final {
+
+	public:
+
+		/**
+		 * @brief The size in bytes of a miniDAQ word.
+		 */
+		static constexpr size_t WORD_SIZE = 5;
+
+		/**
+		 * @brief A random-access iterator that decodes words on dereference.
+		 * 
+		 * @note Dereferencing returns a Word by value rather than a 
+		 * reference.
+		 */
+		class const_iterator {
+
+		public:
+
+			typedef std::random_access_iterator_tag iterator_category;
+			typedef Word value_type;
+			typedef std::ptrdiff_t difference_type;
+			typedef const Word *pointer;
+			typedef Word reference;
+
+			const_iterator() = default;
+
+			Word operator*() const { return decodeWord(position); }
+
+			Word operator[](difference_type n) const { 
+
+				return *(*this + n); 
+
+			}
+
+			const_iterator &operator++() { 
+
+				position += WORD_SIZE; 
+				return *this; 
+
+			}
+
+			const_iterator &operator--() { 
+
+				position -= WORD_SIZE; 
+				return *this; 
+
+			}
+
+			const_iterator operator++(int) { 
+
+				const_iterator old = *this; 
+				++*this; 
+				return old; 
+
+			}
+
+			const_iterator operator--(int) { 
+
+				const_iterator old = *this; 
+				--*this; 
+				return old; 
+
+			}
+
+			const_iterator &operator+=(difference_type n) {
+
+				position += n * static_cast<difference_type>(WORD_SIZE);
+				return *this;
+
+			}
+
+			const_iterator &operator-=(difference_type n) {
+
+				return *this += -n;
+
+			}
+
+			friend const_iterator operator+(
+				const_iterator it, 
+				difference_type n
+			) {
+
+				return it += n;
+
+			}
+
+			friend const_iterator operator+(
+				difference_type n, 
+				const_iterator it
+			) {
+
+				return it += n;
+
+			}
+
+			friend const_iterator operator-(
+				const_iterator it, 
+				difference_type n
+			) {
+
+				return it -= n;
+
+			}
+
+			friend difference_type operator-(
+				const const_iterator &a, 
+				const const_iterator &b
+			) {
+
+				return (a.position - b.position) 
+					/ static_cast<difference_type>(WORD_SIZE);
+
+			}
+
+			friend bool operator==(
+				const const_iterator &a, 
+				const const_iterator &b
+			) {
+
+				return a.position == b.position;
+
+			}
+
+			friend bool operator!=(
+				const const_iterator &a, 
+				const const_iterator &b
+			) {
+
+				return a.position != b.position;
+
+			}
+
+			friend bool operator<(
+				const const_iterator &a, 
+				const const_iterator &b
+			) {
+
+				return a.position < b.position;
+
+			}
+
+			friend bool operator>(
+				const const_iterator &a, 
+				const const_iterator &b
+			) {
+
+				return a.position > b.position;
+
+			}
+
+			friend bool operator<=(
+				const const_iterator &a, 
+				const const_iterator &b
+			) {
+
+				return a.position <= b.position;
+
+			}
+
+			friend bool operator>=(
+				const const_iterator &a, 
+				const const_iterator &b
+			) {
+
+				return a.position >= b.position;
+
+			}
+
+		private:
+
+			explicit const_iterator(const uint8_t *position) 
+				: position(position) {}
+
+			const uint8_t *position = nullptr;
+
+			friend class WordView;
+
+		};
+
+		WordView() = default;
+
+		/**
+		 * @brief Constructs a view of the words in a range of bytes.
+		 */
+		explicit WordView(ByteView bytes);
+
+		/**
+		 * @brief Constructs a view of the words in size bytes starting at
+		 * data.
+		 */
+		WordView(const uint8_t *data, size_t size);
+
+		/**
+		 * @brief Constructs a view of the words in a blob.
+		 */
+		explicit WordView(const DataBlob &blob);
+
+		/**
+		 * @brief Gets the number of whole words in the view.
+		 */
+		size_t size() const { return words; }
+
+		/**
+		 * @brief Checks whether the view contains no whole words.
+		 */
+		bool empty() const { return words == 0; }
+
+		/**
+		 * @brief Decodes the word at the given index. Does not check bounds.
+		 */
+		Word operator[](size_t index) const {
+
+			return decodeWord(first + index * WORD_SIZE);
+
+		}
+
+		/**
+		 * @brief Decodes the word at the given index.
+		 * 
+		 * @throws std::out_of_range If index is greater than or equal to
+		 * size().
+		 */
+		Word at(size_t index) const;
+
+		const_iterator begin() const { return const_iterator(first); }
+		const_iterator end() const { 
+
+			return const_iterator(first + words * WORD_SIZE); 
+
+		}
+
+		const_iterator cbegin() const { return begin(); }
+		const_iterator cend() const { return end(); }
+
+		/**
+		 * @brief Decodes up to count consecutive words starting at index
+		 * firstWord. Decoding stops early at the end of the view.
+		 * 
+		 * This is much faster than decoding the words one at a time.
+		 * 
+		 * @param[in] firstWord The index of the first word to decode.
+		 * @param[in] count The maximum number of words to decode.
+		 * @param[out] out Receives the decoded words. Must have room for
+		 * count words.
+		 * 
+		 * @return The number of words decoded.
+		 * 
+		 * @throws std::out_of_range If firstWord is greater than size().
+		 */
+		size_t decode(size_t firstWord, size_t count, Word *out) const;
+
+		/**
+		 * @brief Gets a view of up to count words starting at index
+		 * firstWord. The result stops early at the end of the view.
+		 * 
+		 * @throws std::out_of_range If firstWord is greater than size().
+		 */
+		WordView subview(size_t firstWord, size_t count) const;
+
+		/**
+		 * @brief Gets the bytes of the whole words in the view.
+		 */
+		ByteView bytes() const { return ByteView(first, words * WORD_SIZE); }
+
+		/**
+		 * @brief Decodes a single word from its big-endian bytes.
+		 * 
+		 * REQUIRES: data points to at least WORD_SIZE readable bytes.
+		 */
+		static Word decodeWord(const uint8_t *data) {
+
+			// NOTE: Defined here so the loop unrolls into the callers that
+			//       decode one word at a time, like operator[].
+			Word word = 0;
+			for(size_t byte = 0; byte < WORD_SIZE; ++byte) {
+
+				word |= static_cast<Word>(data[byte])
+					<< (8 * (WORD_SIZE - byte - 1));
+
+			}
+
+			return word;
+
+		}
+
+	private:
+
+		const uint8_t *first = nullptr;
+		size_t words = 0;
+
+	};
+
+}
@@ -0,0 +1,236 @@
+#include <BlobChain.h>
+
+#include "Packet.h"
+#include "WordPacking.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+using std::vector;
+using std::ostream;
+
+using namespace DAQCap;
+
+ByteView BlobChain::Segment::view() const {
+
+	return ByteView(blob.view().data() + offset, size);
+
+}
+
+BlobChain::BlobChain(const DataBlob &blob) {
+
+	append(blob);
+
+}
+
+void BlobChain::push(const Segment &segment) {
+
+	if(segment.size == 0) return;
+
+	segmentList.push_back(segment);
+	segmentEnds.push_back(size() + segment.size);
+
+}
+
+void BlobChain::append(const DataBlob &blob) {
+
+	Segment segment;
+	segment.blob   = blob;
+	segment.offset = 0;
+	segment.size   = blob.size();
+
+	push(segment);
+
+}
+
+void BlobChain::append(const BlobChain &other) {
+
+	// NOTE: Copy the segment list first in case other is this chain
+	vector<Segment> otherSegments = other.segmentList;
+
+	segmentList.reserve(segmentList.size() + otherSegments.size());
+	segmentEnds.reserve(segmentEnds.size() + otherSegments.size());
+
+	for(const Segment &segment : otherSegments) {
+
+		push(segment);
+
+	}
+
+}
+
+size_t BlobChain::findSegment(size_t offset) const {
+
+	// The first segment that ends after offset contains it
+	return std::upper_bound(
+		segmentEnds.cbegin(), 
+		segmentEnds.cend(), 
+		offset
+	) - segmentEnds.cbegin();
+
+}
+
+BlobChain BlobChain::split(size_t word) {
+
+	if(word > wordCount()) {
+
+		throw std::out_of_range(
+			"BlobChain::split: word out of range."
+		);
+
+	}
+
+	BlobChain tail;
+
+	size_t offset = word * Packet::WORD_SIZE;
+	if(offset == size()) return tail;
+
+	size_t index = findSegment(offset);
+
+	// Bytes of the split segment that stay in this chain
+	size_t segmentStart = index == 0 ? 0 : segmentEnds[index - 1];
+	size_t keep         = offset - segmentStart;
+
+	Segment &splitSegment = segmentList[index];
+
+	Segment rest = splitSegment;
+	rest.offset += keep;
+	rest.size   -= keep;
+
+	tail.push(rest);
+	for(size_t i = index + 1; i < segmentList.size(); ++i) {
+
+		tail.push(segmentList[i]);
+
+	}
+
+	// Trim this chain back to the boundary
+	splitSegment.size = keep;
+
+	size_t kept = keep == 0 ? index : index + 1;
+	segmentList.erase(segmentList.begin() + kept, segmentList.end());
+	segmentEnds.erase(segmentEnds.begin() + kept, segmentEnds.end());
+	if(keep != 0) segmentEnds[index] = offset;
+
+	return tail;
+
+}
+
+BlobChain BlobChain::slice(size_t firstWord, size_t count) const {
+
+	if(firstWord > wordCount()) {
+
+		throw std::out_of_range(
+			"BlobChain::slice: firstWord out of range."
+		);
+
+	}
+
+	count = std::min(count, wordCount() - firstWord);
+
+	BlobChain result;
+	if(count == 0) return result;
+
+	size_t offset = firstWord * Packet::WORD_SIZE;
+	size_t end    = offset + count * Packet::WORD_SIZE;
+
+	for(size_t index = findSegment(offset); index < segmentList.size(); ++index) {
+
+		size_t segmentStart = index == 0 ? 0 : segmentEnds[index - 1];
+		if(segmentStart >= end) break;
+
+		size_t first = std::max(offset, segmentStart);
+		size_t last  = std::min(end, segmentEnds[index]);
+
+		Segment segment = segmentList[index];
+		segment.offset += first - segmentStart;
+		segment.size    = last - first;
+
+		result.push(segment);
+
+	}
+
+	return result;
+
+}
+
+void BlobChain::clear() {
+
+	segmentList.clear();
+	segmentEnds.clear();
+
+}
+
+size_t BlobChain::size() const {
+
+	return segmentEnds.empty() ? 0 : segmentEnds.back();
+
+}
+
+size_t BlobChain::wordCount() const {
+
+	return size() / Packet::WORD_SIZE;
+
+}
+
+bool BlobChain::empty() const {
+
+	return segmentList.empty();
+
+}
+
+const vector<BlobChain::Segment> &BlobChain::segments() const {
+
+	return segmentList;
+
+}
+
+Word BlobChain::word(size_t index) const {
+
+	if(index >= wordCount()) {
+
+		throw std::out_of_range(
+			"BlobChain::word: index out of range."
+		);
+
+	}
+
+	size_t offset  = index * Packet::WORD_SIZE;
+	size_t segment = findSegment(offset);
+
+	size_t segmentStart = segment == 0 ? 0 : segmentEnds[segment - 1];
+
+	return packWord(segmentList[segment].view().data() + offset - segmentStart);
+
+}
+
+vector<uint8_t> BlobChain::flatten() const {
+
+	vector<uint8_t> result;
+	result.reserve(size());
+
+	for(const Segment &segment : segmentList) {
+
+		ByteView data = segment.view();
+
+		result.insert(result.end(), data.begin(), data.end());
+
+	}
+
+	return result;
+
+}
+
+ostream &DAQCap::operator<<(ostream &os, const BlobChain &chain) {
+
+	for(const BlobChain::Segment &segment : chain.segments()) {
+
+		ByteView data = segment.view();
+
+		os.write((const char*)data.data(), data.size());
+
+	}
+
+	return os;
+
+}
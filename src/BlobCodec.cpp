@@ -0,0 +1,572 @@
+#include <BlobCodec.h>
+
+#include "Packet.h"
+#include "ByteOrder.h"
+#include "WordPacking.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <string>
+
+using std::vector;
+using std::string;
+
+using namespace DAQCap;
+
+/*
+ * Block format (all integers little-endian):
+ *   u32 BLOCK_MAGIC
+ *   u32 size of the whole block in bytes, including this header
+ *   u32 number of words in the block
+ *   u32 number of runs of repeated words
+ *   u32 encoded size of the run lengths
+ *   u32 encoded size of each byte plane, least significant plane first
+ *   run lengths: (length - 1) of each run as LEB128 varints, byte-RLE encoded
+ *   byte planes: one byte per run in each plane, byte-RLE encoded
+ *
+ * Byte-RLE control bytes:
+ *   0   - 127: the next (control + 1) bytes are literals
+ *   128 - 255: the next byte is repeated (control - 125) times
+ */
+
+const size_t BlobEncoder::DEFAULT_BLOCK_WORDS = 65536;
+
+namespace {
+
+	const uint32_t BLOCK_MAGIC = 0x31425144; // "DQB1"
+
+	const size_t FIXED_HEADER_FIELDS = 5;
+
+	const size_t MAX_LITERALS = 128;
+	const size_t MIN_RUN      = 3;
+	const size_t MAX_RUN      = 130;
+
+	size_t headerSize() {
+
+		return 4 * (FIXED_HEADER_FIELDS + Packet::WORD_SIZE);
+
+	}
+
+	Word wordMask() {
+
+		return Packet::WORD_SIZE >= sizeof(Word) 
+			? ~Word(0) 
+			: (Word(1) << (8 * Packet::WORD_SIZE)) - 1;
+
+	}
+
+	// Appends byte-RLE encoded data to out and returns the encoded size
+	size_t encodeBytes(const vector<uint8_t> &data, vector<uint8_t> &out) {
+
+		size_t startSize = out.size();
+
+		size_t i = 0;
+		while(i < data.size()) {
+
+			size_t run = 1;
+			while(
+				i + run < data.size() && 
+				run < MAX_RUN && 
+				data[i + run] == data[i]
+			) {
+
+				++run;
+
+			}
+
+			if(run >= MIN_RUN) {
+
+				out.push_back(static_cast<uint8_t>(run + 125));
+				out.push_back(data[i]);
+				i += run;
+
+				continue;
+
+			}
+
+			// Collect literals until the next run worth encoding
+			size_t start = i;
+			while(i < data.size() && i - start < MAX_LITERALS) {
+
+				if(
+					i + 2 < data.size() && 
+					data[i] == data[i + 1] && 
+					data[i] == data[i + 2]
+				) {
+
+					break;
+
+				}
+
+				++i;
+
+			}
+
+			out.push_back(static_cast<uint8_t>(i - start - 1));
+			out.insert(out.end(), data.begin() + start, data.begin() + i);
+
+		}
+
+		return out.size() - startSize;
+
+	}
+
+	void malformed(const string &reason) {
+
+		throw std::invalid_argument(
+			string("Malformed compressed data: ") + reason
+		);
+
+	}
+
+	// Decodes byte-RLE data, appending the result to out
+	void decodeBytes(const uint8_t *data, size_t size, vector<uint8_t> &out) {
+
+		size_t i = 0;
+		while(i < size) {
+
+			uint8_t control = data[i++];
+
+			if(control < MAX_LITERALS) {
+
+				size_t count = control + 1;
+				if(count > size - i) malformed("literal overruns block");
+
+				out.insert(out.end(), data + i, data + i + count);
+				i += count;
+
+			} else {
+
+				if(i >= size) malformed("run overruns block");
+
+				out.insert(out.end(), control - 125, data[i]);
+				++i;
+
+			}
+
+		}
+
+	}
+
+	void putVarint(vector<uint8_t> &out, uint64_t value) {
+
+		while(value >= 0x80) {
+
+			out.push_back(static_cast<uint8_t>(value | 0x80));
+			value >>= 7;
+
+		}
+
+		out.push_back(static_cast<uint8_t>(value));
+
+	}
+
+	uint64_t getVarint(const vector<uint8_t> &data, size_t &position) {
+
+		uint64_t value = 0;
+		for(unsigned shift = 0; shift < 64; shift += 7) {
+
+			if(position >= data.size()) malformed("truncated run length");
+
+			uint8_t byte = data[position++];
+			value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+
+			if(!(byte & 0x80)) return value;
+
+		}
+
+		malformed("run length too long");
+
+		return 0;
+
+	}
+
+	// Decodes the block at the start of data, appending its words to out.
+	// Rejects blocks holding more than maxWords words.
+	// REQUIRES: size is at least the block size in the block's header.
+	void decodeBlock(
+		const uint8_t *data, 
+		vector<uint8_t> &out, 
+		size_t maxWords = SIZE_MAX
+	) {
+
+		uint32_t blockSize      = loadU32(data + 4);
+		uint32_t wordCount      = loadU32(data + 8);
+		uint32_t runCount       = loadU32(data + 12);
+		uint32_t runLengthsSize = loadU32(data + 16);
+
+		if(runCount > wordCount) malformed("more runs than words");
+		if(wordCount > maxWords) malformed("block exceeds expected size");
+
+		const uint8_t *section = data + headerSize();
+		const uint8_t *end     = data + blockSize;
+
+		if(runLengthsSize > static_cast<size_t>(end - section)) {
+
+			malformed("run lengths overrun block");
+
+		}
+
+		vector<uint8_t> runLengths;
+		decodeBytes(section, runLengthsSize, runLengths);
+		section += runLengthsSize;
+
+		// Rebuild the differences between successive run values
+		// NOTE: The run count is only trusted once a decoded plane agrees
+		//       with it, so a corrupt header can't make us allocate more
+		//       than the encoded data can actually represent.
+		vector<Word> values;
+		vector<uint8_t> plane;
+		for(size_t byte = 0; byte < Packet::WORD_SIZE; ++byte) {
+
+			uint32_t planeSize = loadU32(
+				data + 4 * (FIXED_HEADER_FIELDS + byte)
+			);
+
+			if(planeSize > static_cast<size_t>(end - section)) {
+
+				malformed("byte plane overruns block");
+
+			}
+
+			plane.clear();
+			decodeBytes(section, planeSize, plane);
+			section += planeSize;
+
+			if(plane.size() != runCount) malformed("byte plane size");
+
+			if(byte == 0) values.assign(runCount, 0);
+
+			for(size_t i = 0; i < runCount; ++i) {
+
+				values[i] |= static_cast<Word>(plane[i]) << (8 * byte);
+
+			}
+
+		}
+
+		if(section != end) malformed("unexpected block size");
+
+		// Read the run lengths and check that they add up before expanding
+		// anything
+		vector<uint64_t> lengths(runCount);
+		size_t position = 0;
+		uint64_t words = 0;
+		for(size_t i = 0; i < runCount; ++i) {
+
+			uint64_t length = getVarint(runLengths, position);
+
+			// NOTE: Check before adding, so that neither the length nor the
+			//       total can wrap around. Every run holds at least one word.
+			if(length >= wordCount - words) {
+
+				malformed("runs exceed word count");
+
+			}
+
+			lengths[i] = length + 1;
+			words += lengths[i];
+
+		}
+
+		if(words != wordCount || position != runLengths.size()) {
+
+			malformed("run lengths do not match word count");
+
+		}
+
+		// Undo the differences and expand the runs
+		Word mask = wordMask();
+		Word previous = 0;
+
+		size_t outStart = out.size();
+		out.resize(outStart + wordCount * Packet::WORD_SIZE);
+
+		uint8_t *next = out.data() + outStart;
+		for(size_t i = 0; i < runCount; ++i) {
+
+			Word value = (previous + values[i]) & mask;
+			previous = value;
+
+			for(size_t byte = 0; byte < Packet::WORD_SIZE; ++byte) {
+
+				next[byte] = static_cast<uint8_t>(
+					value >> (8 * (Packet::WORD_SIZE - byte - 1))
+				);
+
+			}
+			next += Packet::WORD_SIZE;
+
+			// Copy the first word for the rest of the run
+			for(uint64_t run = 1; run < lengths[i]; ++run) {
+
+				std::copy(
+					next - Packet::WORD_SIZE, 
+					next, 
+					next
+				);
+				next += Packet::WORD_SIZE;
+
+			}
+
+		}
+
+	}
+
+	// Gets the size of the block at the start of data, or 0 if the header
+	// isn't complete yet.
+	size_t blockSizeAt(const uint8_t *data, size_t size) {
+
+		if(size < headerSize()) return 0;
+
+		if(loadU32(data) != BLOCK_MAGIC) malformed("bad block magic");
+
+		uint32_t blockSize = loadU32(data + 4);
+		if(blockSize < headerSize()) malformed("bad block size");
+
+		return blockSize;
+
+	}
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+BlobEncoder::BlobEncoder(size_t blockWords) : blockWords(blockWords) {
+
+	if(blockWords == 0 || blockWords > UINT32_MAX) {
+
+		throw std::invalid_argument(
+			"BlobEncoder::BlobEncoder: invalid block size."
+		);
+
+	}
+
+}
+
+void BlobEncoder::encode(ByteView data, vector<uint8_t> &out) {
+
+	const uint8_t *next = data.data();
+	size_t remaining    = data.size();
+
+	// Finish any word left over from the last call
+	if(!partialWord.empty()) {
+
+		size_t needed = std::min(
+			Packet::WORD_SIZE - partialWord.size(), 
+			remaining
+		);
+
+		partialWord.insert(partialWord.end(), next, next + needed);
+		next      += needed;
+		remaining -= needed;
+
+		if(partialWord.size() < Packet::WORD_SIZE) return;
+
+		pending.push_back(packWord(partialWord.data()));
+		partialWord.clear();
+
+		if(pending.size() == blockWords) encodeBlock(out);
+
+	}
+
+	// Pack whole words straight into the pending block
+	while(remaining >= Packet::WORD_SIZE) {
+
+		size_t words = std::min(
+			remaining / Packet::WORD_SIZE, 
+			blockWords - pending.size()
+		);
+
+		size_t start = pending.size();
+		pending.resize(start + words);
+		packWords(next, words, pending.data() + start);
+
+		next      += words * Packet::WORD_SIZE;
+		remaining -= words * Packet::WORD_SIZE;
+
+		if(pending.size() == blockWords) encodeBlock(out);
+
+	}
+
+	partialWord.assign(next, next + remaining);
+
+}
+
+void BlobEncoder::encode(const DataBlob &blob, vector<uint8_t> &out) {
+
+	encode(blob.view(), out);
+
+}
+
+void BlobEncoder::finish(vector<uint8_t> &out) {
+
+	if(!pending.empty()) encodeBlock(out);
+
+	partialWord.clear();
+
+}
+
+void BlobEncoder::encodeBlock(vector<uint8_t> &out) {
+
+	// Collapse runs of repeated words, recording the run lengths
+	values.clear();
+	runLengths.clear();
+
+	size_t run = 0;
+	for(size_t i = 0; i < pending.size(); ++i) {
+
+		if(run > 0 && pending[i] == values.back()) {
+
+			++run;
+			continue;
+
+		}
+
+		if(run > 0) putVarint(runLengths, run - 1);
+
+		values.push_back(pending[i]);
+		run = 1;
+
+	}
+	if(run > 0) putVarint(runLengths, run - 1);
+
+	// Replace each value with its difference from the previous one
+	Word mask = wordMask();
+	Word previous = 0;
+	for(Word &value : values) {
+
+		Word current = value;
+		value = (current - previous) & mask;
+		previous = current;
+
+	}
+
+	// Write the header, leaving the sizes to be filled in
+	size_t blockStart = out.size();
+
+	putU32(out, BLOCK_MAGIC);
+	putU32(out, 0);
+	putU32(out, static_cast<uint32_t>(pending.size()));
+	putU32(out, static_cast<uint32_t>(values.size()));
+	for(size_t field = 0; field <= Packet::WORD_SIZE; ++field) {
+
+		putU32(out, 0);
+
+	}
+
+	size_t runLengthsSize = encodeBytes(runLengths, out);
+	storeLittleEndian(&out[blockStart + 16], runLengthsSize, 4);
+
+	// Write the byte planes
+	plane.resize(values.size());
+	for(size_t byte = 0; byte < Packet::WORD_SIZE; ++byte) {
+
+		for(size_t i = 0; i < values.size(); ++i) {
+
+			plane[i] = static_cast<uint8_t>(values[i] >> (8 * byte));
+
+		}
+
+		size_t planeSize = encodeBytes(plane, out);
+		storeLittleEndian(
+			&out[blockStart + 4 * (FIXED_HEADER_FIELDS + byte)], 
+			planeSize, 
+			4
+		);
+
+	}
+
+	storeLittleEndian(&out[blockStart + 4], out.size() - blockStart, 4);
+
+	pending.clear();
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+void BlobDecoder::decode(ByteView encoded, vector<uint8_t> &out) {
+
+	pending.insert(pending.end(), encoded.begin(), encoded.end());
+
+	size_t position = 0;
+	while(true) {
+
+		size_t blockSize = blockSizeAt(
+			pending.data() + position, 
+			pending.size() - position
+		);
+
+		if(blockSize == 0 || blockSize > pending.size() - position) break;
+
+		decodeBlock(pending.data() + position, out);
+		position += blockSize;
+
+	}
+
+	pending.erase(pending.begin(), pending.begin() + position);
+
+}
+
+bool BlobDecoder::hasPartialBlock() const {
+
+	return !pending.empty();
+
+}
+
+void BlobDecoder::reset() {
+
+	pending.clear();
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+vector<uint8_t> DAQCap::compressData(ByteView data) {
+
+	vector<uint8_t> out;
+
+	BlobEncoder encoder;
+	encoder.encode(data, out);
+	encoder.finish(out);
+
+	return out;
+
+}
+
+vector<uint8_t> DAQCap::decompressData(ByteView encoded, size_t maxSize) {
+
+	vector<uint8_t> out;
+
+	size_t position = 0;
+	while(position < encoded.size()) {
+
+		size_t blockSize = blockSizeAt(
+			encoded.data() + position, 
+			encoded.size() - position
+		);
+
+		if(blockSize == 0 || blockSize > encoded.size() - position) {
+
+			malformed("truncated block");
+
+		}
+
+		decodeBlock(
+			encoded.data() + position, 
+			out, 
+			(maxSize - out.size()) / Packet::WORD_SIZE
+		);
+		position += blockSize;
+
+	}
+
+	return out;
+
+}
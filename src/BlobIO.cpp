@@ -0,0 +1,163 @@
+#include <BlobIO.h>
+#include <SerializedBlob.h>
+
+#include <stdexcept>
+#include <algorithm>
+#include <string>
+#include <cstring>
+#include <cerrno>
+
+#include <sys/uio.h>
+#include <unistd.h>
+#include <limits.h>
+
+using std::vector;
+using std::string;
+
+using namespace DAQCap;
+
+// Some systems don't define IOV_MAX. POSIX guarantees at least 16, and
+// every system we care about supports at least 1024.
+#ifndef IOV_MAX
+	#define IOV_MAX 1024
+#endif
+
+namespace {
+
+	// Writes every buffer in iov to fd, retrying partial writes and
+	// interrupted calls. Modifies the iovec entries as it goes.
+	size_t writeVectors(int fd, vector<struct iovec> &iov) {
+
+		size_t written = 0;
+		size_t next    = 0;
+
+		while(next < iov.size()) {
+
+			int count = static_cast<int>(
+				std::min(iov.size() - next, static_cast<size_t>(IOV_MAX))
+			);
+
+			ssize_t ret = writev(fd, &iov[next], count);
+
+			if(ret < 0) {
+
+				if(errno == EINTR) continue;
+
+				throw std::runtime_error(
+					string("Could not write data: ") + std::strerror(errno)
+				);
+
+			}
+
+			// NOTE: Every vector is non-empty, so writing nothing means the
+			//       call would never make progress if retried.
+			if(ret == 0) {
+
+				throw std::runtime_error(
+					"Could not write data: no progress was made."
+				);
+
+			}
+
+			written += ret;
+
+			// Skip past the buffers that were written completely, then
+			// trim the front of the buffer that was written partially.
+			size_t remaining = ret;
+			while(next < iov.size() && remaining >= iov[next].iov_len) {
+
+				remaining -= iov[next].iov_len;
+				++next;
+
+			}
+
+			if(remaining > 0) {
+
+				iov[next].iov_base 
+					= static_cast<uint8_t*>(iov[next].iov_base) + remaining;
+				iov[next].iov_len -= remaining;
+
+			}
+
+		}
+
+		return written;
+
+	}
+
+	void appendVector(vector<struct iovec> &iov, ByteView data) {
+
+		// Empty buffers are legal in writev, but there's no reason to pass
+		// them to the kernel
+		if(data.empty()) return;
+
+		struct iovec entry;
+		entry.iov_base = const_cast<uint8_t*>(data.data());
+		entry.iov_len  = data.size();
+
+		iov.push_back(entry);
+
+	}
+
+}
+
+size_t DAQCap::writeBlob(int fd, const DataBlob &blob) {
+
+	vector<struct iovec> iov;
+	appendVector(iov, blob.view());
+
+	return writeVectors(fd, iov);
+
+}
+
+size_t DAQCap::writeData(int fd, ByteView data) {
+
+	vector<struct iovec> iov;
+	appendVector(iov, data);
+
+	return writeVectors(fd, iov);
+
+}
+
+size_t DAQCap::writeBlobs(int fd, const vector<DataBlob> &blobs) {
+
+	vector<struct iovec> iov;
+	iov.reserve(blobs.size());
+
+	for(const DataBlob &blob : blobs) {
+
+		appendVector(iov, blob.view());
+
+	}
+
+	return writeVectors(fd, iov);
+
+}
+
+size_t DAQCap::writeChain(int fd, const BlobChain &chain) {
+
+	vector<struct iovec> iov;
+	iov.reserve(chain.segments().size());
+
+	for(const BlobChain::Segment &segment : chain.segments()) {
+
+		appendVector(iov, segment.view());
+
+	}
+
+	return writeVectors(fd, iov);
+
+}
+
+size_t DAQCap::writeSerializedBlob(int fd, const DataBlob &blob) {
+
+	vector<uint8_t> header;
+	serializeBlobHeader(blob, header);
+
+	vector<struct iovec> iov;
+	appendVector(iov, ByteView(header.data(), header.size()));
+	appendVector(iov, blob.view());
+
+	return writeVectors(fd, iov);
+
+}
\ No newline at end of file
@@ -0,0 +1,227 @@
+#include "BlobPool.h"
+
+#include <atomic>
+#include <algorithm>
+
+using std::vector;
+using std::shared_ptr;
+
+using namespace DAQCap;
+
+const size_t BlobPool::DEFAULT_MAX_BUFFERS = 16;
+
+namespace {
+
+	// Gets the smallest n such that 2^n >= capacity
+	unsigned capacityClass(size_t capacity) {
+
+		const unsigned MAX_CLASS = 8 * sizeof(size_t) - 1;
+
+		unsigned result = 0;
+		while(result < MAX_CLASS && (size_t(1) << result) < capacity) {
+
+			++result;
+
+		}
+
+		return result;
+
+	}
+
+}
+
+BlobPool::BlobPool(size_t maxBuffers)
+	: maxBuffers(maxBuffers), next(0) {
+
+	buffers.reserve(maxBuffers);
+
+}
+
+void BlobPool::resetContents(DataBlob::Contents &contents, size_t capacity) {
+
+	contents.packets = 0;
+	contents.dataBuffer.clear();
+	contents.warningsBuffer.clear();
+	contents.metadata = BlobMetadata();
+	contents.gapList.clear();
+	contents.packetList.clear();
+
+	if(contents.dataBuffer.capacity() < capacity) {
+
+		contents.dataBuffer.reserve(size_t(1) << capacityClass(capacity));
+
+	}
+
+}
+
+BlobPool::~BlobPool() {
+
+	clear();
+
+}
+
+void BlobPool::acquire(DataBlob &blob, size_t capacity) {
+
+	// Take the blob's contents out of the blob first, so that if they are
+	// pooled they become free for the search below.
+	shared_ptr<DataBlob::Contents> previous;
+	std::swap(previous, blob.contents);
+
+	// Contents nobody else refers to can be recycled in place
+	if(previous && previous.use_count() == 1) {
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+
+		resetContents(*previous, capacity);
+
+		std::swap(blob.contents, previous);
+
+		return;
+
+	}
+
+	previous.reset();
+
+	// Otherwise look for the smallest free buffer in a large enough class.
+	// OPTIMIZATION -- The search starts just after the last buffer handed
+	//                 out and stops at the first free buffer of exactly the
+	//                 requested class. Blobs are mostly released in the
+	//                 order they were acquired, so in steady state this
+	//                 finds a buffer after checking one or two, even in
+	//                 pools of thousands.
+	const size_t count = buffers.size();
+	const unsigned wanted = capacityClass(capacity);
+
+	size_t best = count;
+	size_t fallback = count;
+	for(size_t step = 0; step < count; ++step) {
+
+		size_t index = next + step;
+		if(index >= count) index -= count;
+
+		shared_ptr<DataBlob::Contents> &buffer = buffers[index];
+
+		// NOTE: A buffer with a use count of 1 is referenced only by the
+		//       pool, and only acquire() can hand out new references, so
+		//       it can't become shared again behind our back.
+		if(buffer.use_count() != 1) continue;
+
+		if(fallback == count) fallback = index;
+
+		size_t bufferCapacity = buffer->dataBuffer.capacity();
+
+		if(bufferCapacity < capacity) continue;
+
+		if(
+			best == count || 
+			bufferCapacity < buffers[best]->dataBuffer.capacity()
+		) {
+
+			best = index;
+
+		}
+
+		// Nothing smaller could still serve the request
+		if(capacityClass(bufferCapacity) == wanted) break;
+
+	}
+
+	// Settle for a too-small buffer rather than allocating new contents.
+	// It will grow into the required class, and stay there.
+	if(best == count) best = fallback;
+
+	if(best != count) {
+
+		// Pairs with the release in the last owner's reference decrement,
+		// so that the owner's reads finish before we write to the buffer.
+		std::atomic_thread_fence(std::memory_order_acquire);
+
+		resetContents(*buffers[best], capacity);
+
+		blob.contents = buffers[best];
+
+		next = best + 1 < count ? best + 1 : 0;
+
+		return;
+
+	}
+
+	// There's no free buffer, so we need a new one
+	blob.contents = std::make_shared<DataBlob::Contents>();
+	resetContents(*blob.contents, capacity);
+
+	if(buffers.size() < maxBuffers) {
+
+		blob.contents->pooled = true;
+		buffers.push_back(blob.contents);
+
+	}
+
+}
+
+void BlobPool::setMaxBuffers(size_t maxBuffers) {
+
+	this->maxBuffers = maxBuffers;
+
+	// Drop free buffers first, so the ones we keep are the ones in use
+	std::stable_partition(
+		buffers.begin(), 
+		buffers.end(), 
+		[](const shared_ptr<DataBlob::Contents> &buffer) {
+
+			return buffer.use_count() != 1;
+
+		}
+	);
+
+	while(buffers.size() > maxBuffers) {
+
+		buffers.back()->pooled = false;
+		buffers.pop_back();
+
+	}
+
+	buffers.reserve(maxBuffers);
+
+	next = 0;
+
+}
+
+size_t BlobPool::maxSize() const {
+
+	return maxBuffers;
+
+}
+
+size_t BlobPool::size() const {
+
+	return buffers.size();
+
+}
+
+size_t BlobPool::available() const {
+
+	size_t count = 0;
+	for(const shared_ptr<DataBlob::Contents> &buffer : buffers) {
+
+		if(buffer.use_count() == 1) ++count;
+
+	}
+
+	return count;
+
+}
+
+void BlobPool::clear() {
+
+	for(shared_ptr<DataBlob::Contents> &buffer : buffers) {
+
+		buffer->pooled = false;
+
+	}
+
+	buffers.clear();
+
+	next = 0;
+
+}
@@ -0,0 +1,128 @@
+/**
+ * @file BlobPool.h
+ *
+ * @brief Recycles the buffers of released data blobs.
+ *
+ * @author Robert Myers
+ * Contact: romyers@umich.edu
+ */
+
+#pragma once
+
+#include <DAQBlob.h>
+
+#include <vector>
+#include <memory>
+#include <cstddef>
+
+namespace DAQCap {
+
+	/**
+	 * @brief A pool of blob buffers that are reused once every blob
+	 * referring to them has been released.
+	 * 
+	 * The pool keeps a reference to each buffer it hands out. A buffer is
+	 * free again once that reference is the only one left, which happens
+	 * automatically when the last DataBlob sharing the buffer is destroyed
+	 * or reassigned, on any thread. In steady state, acquiring a buffer
+	 * therefore does not allocate.
+	 * 
+	 * Buffers are sorted into power-of-two capacity classes, and a request
+	 * is served by the smallest free buffer whose class is large enough.
+	 * The search resumes after the last buffer handed out and stops at the
+	 * first free buffer of the requested class, so it stays short in large
+	 * pools whose blobs are released roughly in order.
+	 * 
+	 * @note acquire() may not be called concurrently. Releasing blobs is
+	 * safe from any thread.
+	 */
+	class BlobPool {
+
+	public:
+
+		/**
+		 * @brief The default maximum number of buffers held by a pool.
+		 */
+		static const size_t DEFAULT_MAX_BUFFERS;
+
+		/**
+		 * @brief Constructs an empty pool.
+		 * 
+		 * @param maxBuffers The maximum number of buffers the pool will
+		 * keep. Once the pool is full and every buffer is in use, acquire()
+		 * falls back to unpooled buffers.
+		 */
+		explicit BlobPool(size_t maxBuffers = DEFAULT_MAX_BUFFERS);
+
+		~BlobPool();
+
+		BlobPool(const BlobPool &other) = delete;
+		BlobPool &operator=(const BlobPool &other) = delete;
+
+		/**
+		 * @brief Replaces the contents of blob with empty contents that can
+		 * hold at least capacity bytes of data without reallocating.
+		 * 
+		 * If blob is the only owner of its contents, they are recycled
+		 * directly. Otherwise blob releases them and a free pooled buffer
+		 * is used instead.
+		 * 
+		 * @param[in,out] blob The blob to prepare.
+		 * @param[in] capacity The number of data bytes blob must be able to
+		 * hold.
+		 */
+		void acquire(DataBlob &blob, size_t capacity);
+
+		/**
+		 * @brief Changes the maximum number of buffers the pool will keep.
+		 * 
+		 * The pool should hold at least as many buffers as there are blobs
+		 * alive at once, or some blobs will get unpooled buffers that are
+		 * allocated and freed each time. If the pool already holds more
+		 * buffers than the new maximum, the extra ones are dropped, and any
+		 * still in use are freed when their last blob is released.
+		 */
+		void setMaxBuffers(size_t maxBuffers);
+
+		/**
+		 * @brief Gets the maximum number of buffers the pool will keep.
+		 */
+		size_t maxSize() const;
+
+		/**
+		 * @brief Gets the number of buffers held by the pool.
+		 */
+		size_t size() const;
+
+		/**
+		 * @brief Gets the number of pooled buffers not referenced by any
+		 * blob.
+		 */
+		size_t available() const;
+
+		/**
+		 * @brief Drops every buffer held by the pool. Buffers still in use
+		 * are freed when their last blob is released.
+		 */
+		void clear();
+
+	private:
+
+		size_t maxBuffers;
+
+		std::vector<std::shared_ptr<DataBlob::Contents>> buffers;
+
+		// Where acquire() starts looking for a free buffer
+		size_t next;
+
+		// Empties contents without releasing any of their memory, and
+		// makes sure they can hold capacity bytes. Buffers that have to
+		// grow are grown to the full size of their capacity class.
+		static void resetContents(
+			DataBlob::Contents &contents, 
+			size_t capacity
+		);
+
+	};
+
+}
@@ -0,0 +1,281 @@
+#include <BlobWriter.h>
+
+#include "FileSinks.h"
+
+#include <stdexcept>
+#include <algorithm>
+
+using std::vector;
+
+using namespace DAQCap;
+
+const size_t BlobWriter::DEFAULT_QUEUE_CAPACITY = 64;
+
+BlobWriter::BlobWriter(int fd, size_t queueCapacity)
+	: ownedSink(openPosixFileSink(fd, false)),
+	  sink(ownedSink.get()),
+	  capacity(queueCapacity),
+	  inFlight(0),
+	  peakDepth(0),
+	  stallCount(0),
+	  bytes(0),
+	  closing(false),
+	  flushRequested(false) {
+
+	start();
+
+}
+
+BlobWriter::BlobWriter(FileSink &sink, size_t queueCapacity)
+	: sink(&sink),
+	  capacity(queueCapacity),
+	  inFlight(0),
+	  peakDepth(0),
+	  stallCount(0),
+	  bytes(0),
+	  closing(false),
+	  flushRequested(false) {
+
+	start();
+
+}
+
+BlobWriter::~BlobWriter() {
+
+	try {
+
+		close();
+
+	} catch(...) {}
+
+}
+
+void BlobWriter::start() {
+
+	if(capacity == 0) {
+
+		throw std::invalid_argument(
+			"BlobWriter queue capacity must be nonzero."
+		);
+
+	}
+
+	pending.reserve(capacity);
+
+	thread = std::thread(&BlobWriter::run, this);
+
+}
+
+void BlobWriter::write(const DataBlob &blob) {
+
+	if(blob.empty()) return;
+
+	std::unique_lock<std::mutex> lock(mutex);
+
+	checkError();
+
+	if(closing) {
+
+		throw std::runtime_error("Cannot write to a closed BlobWriter.");
+
+	}
+
+	if(pending.size() >= capacity) {
+
+		++stallCount;
+
+		written.wait(lock, [this]() {
+
+			return pending.size() < capacity || error;
+
+		});
+
+		checkError();
+
+	}
+
+	pending.push_back(blob);
+
+	peakDepth = std::max(peakDepth, pending.size() + inFlight);
+
+	lock.unlock();
+
+	queued.notify_one();
+
+}
+
+void BlobWriter::flush() {
+
+	std::unique_lock<std::mutex> lock(mutex);
+
+	checkError();
+
+	// Closing flushes everything anyway
+	if(closing) return;
+
+	flushRequested = true;
+	queued.notify_one();
+
+	written.wait(lock, [this]() { return !flushRequested || error; });
+
+	checkError();
+
+}
+
+void BlobWriter::close() {
+
+	{
+
+		std::lock_guard<std::mutex> lock(mutex);
+
+		closing = true;
+
+	}
+
+	queued.notify_one();
+
+	if(thread.joinable()) {
+
+		thread.join();
+
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	checkError();
+
+}
+
+size_t BlobWriter::queueDepth() const {
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	return pending.size() + inFlight;
+
+}
+
+size_t BlobWriter::maxQueueDepth() const {
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	return peakDepth;
+
+}
+
+uint64_t BlobWriter::stalls() const {
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	return stallCount;
+
+}
+
+uint64_t BlobWriter::bytesWritten() const {
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	return bytes;
+
+}
+
+void BlobWriter::run() {
+
+	// The batch being written. Swapped with pending, so that both vectors
+	// keep their capacity and write() never waits on a write in progress.
+	vector<DataBlob> batch;
+	batch.reserve(capacity);
+
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while(true) {
+
+		queued.wait(lock, [this]() {
+
+			return !pending.empty() || closing || flushRequested;
+
+		});
+
+		// If writing failed, there is no point writing anything else
+		if(error) break;
+
+		// Once everything queued is written, flush the sink if we've been
+		// asked to or are about to stop
+		if(pending.empty()) {
+
+			lock.unlock();
+
+			std::exception_ptr failure;
+
+			try {
+
+				sink->flush();
+
+			} catch(...) {
+
+				failure = std::current_exception();
+
+			}
+
+			lock.lock();
+
+			if(failure) error = failure;
+
+			flushRequested = false;
+			written.notify_all();
+
+			if(closing) break;
+
+			continue;
+
+		}
+
+		std::swap(batch, pending);
+		inFlight = batch.size();
+
+		lock.unlock();
+
+		// Let write() know there is room in the queue again
+		written.notify_all();
+
+		std::exception_ptr failure;
+		uint64_t count = 0;
+
+		try {
+
+			sink->write(batch);
+
+			for(const DataBlob &blob : batch) count += blob.size();
+
+		} catch(...) {
+
+			failure = std::current_exception();
+
+		}
+
+		// Release the blobs outside the lock, so their buffers can be
+		// recycled by the capture device
+		batch.clear();
+
+		lock.lock();
+
+		bytes += count;
+		inFlight = 0;
+
+		if(failure) error = failure;
+
+		written.notify_all();
+
+	}
+
+	pending.clear();
+
+	flushRequested = false;
+	written.notify_all();
+
+}
+
+void BlobWriter::checkError() const {
+
+	if(error) std::rethrow_exception(error);
+
+}
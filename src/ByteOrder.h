@@ -0,0 +1,103 @@
+/**
+ * @file ByteOrder.h
+ *
+ * @brief Reads and writes fixed-width little-endian integers, as used by
+ * DAQCap's binary formats.
+ *
+ * @author Robert Myers
+ * Contact: romyers@umich.edu
+ */
+
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+
+namespace DAQCap {
+
+	/**
+	 * @brief Appends the low size bytes of value to out, least significant
+	 * byte first.
+	 */
+	inline void putLittleEndian(
+		std::vector<uint8_t> &out, 
+		uint64_t value, 
+		size_t size
+	) {
+
+		for(size_t byte = 0; byte < size; ++byte) {
+
+			out.push_back(static_cast<uint8_t>(value >> (8 * byte)));
+
+		}
+
+	}
+
+	/**
+	 * @brief Writes the low size bytes of value to out, least significant
+	 * byte first.
+	 */
+	inline void storeLittleEndian(uint8_t *out, uint64_t value, size_t size) {
+
+		for(size_t byte = 0; byte < size; ++byte) {
+
+			out[byte] = static_cast<uint8_t>(value >> (8 * byte));
+
+		}
+
+	}
+
+	/**
+	 * @brief Reads a size-byte little-endian integer from data.
+	 */
+	inline uint64_t loadLittleEndian(const uint8_t *data, size_t size) {
+
+		uint64_t value = 0;
+		for(size_t byte = size; byte > 0; --byte) {
+
+			value = (value << 8) | data[byte - 1];
+
+		}
+
+		return value;
+
+	}
+
+	inline void putU16(std::vector<uint8_t> &out, uint16_t value) {
+
+		putLittleEndian(out, value, 2);
+
+	}
+
+	inline void putU32(std::vector<uint8_t> &out, uint32_t value) {
+
+		putLittleEndian(out, value, 4);
+
+	}
+
+	inline void putU64(std::vector<uint8_t> &out, uint64_t value) {
+
+		putLittleEndian(out, value, 8);
+
+	}
+
+	inline uint16_t loadU16(const uint8_t *data) {
+
+		return static_cast<uint16_t>(loadLittleEndian(data, 2));
+
+	}
+
+	inline uint32_t loadU32(const uint8_t *data) {
+
+		return static_cast<uint32_t>(loadLittleEndian(data, 4));
+
+	}
+
+	inline uint64_t loadU64(const uint8_t *data) {
+
+		return loadLittleEndian(data, 8);
+
+	}
+
+}
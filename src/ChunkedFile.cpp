@@ -0,0 +1,1370 @@
+#include <ChunkedFile.h>
+#include <BlobCodec.h>
+
+#include "Packet.h"
+#include "ByteOrder.h"
+#include "Crc32c.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <cstring>
+#include <cerrno>
+
+#ifdef DAQCAP_HAVE_ZSTD
+
+	#include <zstd.h>
+
+#endif
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+using std::vector;
+using std::string;
+using std::unique_ptr;
+
+using namespace DAQCap;
+
+/*
+ * Chunked file format (all integers little-endian):
+ *   file header:
+ *     u32 FILE_MAGIC
+ *     u16 format version
+ *     u16 size of the file header in bytes
+ *     u64 target chunk size
+ *   chunks, each:
+ *     u32 CHUNK_MAGIC
+ *     u32 CRC32C of the chunk's data
+ *     u64 data size in bytes
+ *     u64 word count
+ *     u64 position in the run of the first packet
+ *     u64 packet count, including lost packets
+ *     i32 first packet number
+ *     i32 last packet number
+ *     i64 first arrival time, in nanoseconds since the epoch
+ *     i64 last arrival time, in nanoseconds since the epoch
+ *     u32 blob count
+ *     u32 codec
+ *     u64 stored data size in bytes
+ *     u32 CRC32C of the preceding header fields
+ *     data, compressed as the codec says
+ *   index, one entry per chunk:
+ *     u64 file offset of the chunk header
+ *     a copy of the chunk header
+ *   footer:
+ *     u64 file offset of the index
+ *     u64 number of chunks
+ *     u32 CRC32C of the index
+ *     u32 INDEX_MAGIC
+ *
+ * Chunk headers carry everything in the index, so a file whose footer was
+ * never written can still be read by walking the chunks.
+ *
+ * Chunk checksums cover the data before it is compressed. Version 1 files
+ * have no codec or stored size in their chunk headers, and are never
+ * compressed.
+ */
+
+namespace {
+
+	const uint32_t FILE_MAGIC  = 0x46435144; // "DQCF"
+	const uint32_t CHUNK_MAGIC = 0x4B435144; // "DQCK"
+	const uint32_t INDEX_MAGIC = 0x49435144; // "DQCI"
+
+	const uint16_t VERSION = 2;
+
+	const size_t FILE_HEADER_SIZE     = 16;
+	const size_t CHUNK_HEADER_SIZE    = 84;
+	const size_t V1_CHUNK_HEADER_SIZE = 72;
+	const size_t FOOTER_SIZE          = 24;
+
+	#ifdef DAQCAP_HAVE_ZSTD
+
+		// Favor speed, so compression keeps up with the capture
+		const int ZSTD_LEVEL = 1;
+
+	#endif
+
+	int64_t toNanoseconds(Timestamp time) {
+
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			time.time_since_epoch()
+		).count();
+
+	}
+
+	Timestamp fromNanoseconds(int64_t count) {
+
+		return Timestamp(
+			std::chrono::duration_cast<Timestamp::duration>(
+				std::chrono::nanoseconds(count)
+			)
+		);
+
+	}
+
+	void putI32(vector<uint8_t> &out, int value) {
+
+		putU32(out, static_cast<uint32_t>(value));
+
+	}
+
+	int loadI32(const uint8_t *data) {
+
+		return static_cast<int32_t>(loadU32(data));
+
+	}
+
+	void putChunkHeader(vector<uint8_t> &out, const ChunkInfo &chunk) {
+
+		size_t start = out.size();
+
+		putU32(out, CHUNK_MAGIC);
+		putU32(out, chunk.checksum);
+		putU64(out, chunk.dataSize);
+		putU64(out, chunk.wordCount);
+		putU64(out, chunk.firstPacket);
+		putU64(out, chunk.packetCount);
+		putI32(out, chunk.firstSequence);
+		putI32(out, chunk.lastSequence);
+		putU64(out, toNanoseconds(chunk.firstArrival));
+		putU64(out, toNanoseconds(chunk.lastArrival));
+		putU32(out, chunk.blobCount);
+		putU32(out, static_cast<uint32_t>(chunk.codec));
+		putU64(out, chunk.storedSize);
+		putU32(out, crc32c(&out[start], out.size() - start));
+
+	}
+
+	// Decodes a chunk header of the given size. Returns false if it isn't a
+	// valid header.
+	bool loadChunkHeader(
+		const uint8_t *data,
+		size_t headerSize,
+		uint64_t headerOffset,
+		ChunkInfo &chunk
+	) {
+
+		if(loadU32(data) != CHUNK_MAGIC) return false;
+
+		size_t checked = headerSize - 4;
+		if(loadU32(data + checked) != crc32c(data, checked)) return false;
+
+		chunk.offset        = headerOffset + headerSize;
+		chunk.checksum      = loadU32(data + 4);
+		chunk.dataSize      = loadU64(data + 8);
+		chunk.wordCount     = loadU64(data + 16);
+		chunk.firstPacket   = loadU64(data + 24);
+		chunk.packetCount   = loadU64(data + 32);
+		chunk.firstSequence = loadI32(data + 40);
+		chunk.lastSequence  = loadI32(data + 44);
+		chunk.firstArrival  = fromNanoseconds(loadU64(data + 48));
+		chunk.lastArrival   = fromNanoseconds(loadU64(data + 56));
+		chunk.blobCount     = loadU32(data + 64);
+
+		if(headerSize == V1_CHUNK_HEADER_SIZE) {
+
+			chunk.codec      = ChunkCodec::None;
+			chunk.storedSize = chunk.dataSize;
+
+		} else {
+
+			chunk.codec      = static_cast<ChunkCodec>(loadU32(data + 68));
+			chunk.storedSize = loadU64(data + 72);
+
+		}
+
+		return true;
+
+	}
+
+	// Compresses the data of chunks. Each compressing thread has its own.
+	class ChunkEncoder final {
+
+	public:
+
+		explicit ChunkEncoder(ChunkCodec codec) : codec(codec) {
+
+			#ifdef DAQCAP_HAVE_ZSTD
+
+				context = nullptr;
+
+				if(codec == ChunkCodec::Zstd) {
+
+					context = ZSTD_createCCtx();
+
+					if(!context) throw std::bad_alloc();
+
+					ZSTD_CCtx_setParameter(
+						context, 
+						ZSTD_c_compressionLevel, 
+						ZSTD_LEVEL
+					);
+
+				}
+
+			#endif
+
+		}
+
+		~ChunkEncoder() {
+
+			#ifdef DAQCAP_HAVE_ZSTD
+
+				ZSTD_freeCCtx(context);
+
+			#endif
+
+		}
+
+		ChunkEncoder(const ChunkEncoder &other) = delete;
+		ChunkEncoder &operator=(const ChunkEncoder &other) = delete;
+
+		// Compresses the pieces of a chunk's data, size bytes in all, into
+		// out. Returns the codec used, which is None if compressing didn't
+		// make the data any smaller.
+		ChunkCodec encode(
+			const vector<ByteView> &pieces, 
+			uint64_t size,
+			vector<uint8_t> &out
+		) {
+
+			out.clear();
+
+			if(codec == ChunkCodec::Blob) {
+
+				for(ByteView piece : pieces) blobEncoder.encode(piece, out);
+
+				blobEncoder.finish(out);
+
+			}
+
+			#ifdef DAQCAP_HAVE_ZSTD
+
+				if(codec == ChunkCodec::Zstd) encodeZstd(pieces, size, out);
+
+			#endif
+
+			if(codec != ChunkCodec::None && out.size() < size) return codec;
+
+			// Store the data as it is instead
+			out.clear();
+			out.reserve(size);
+
+			for(ByteView piece : pieces) {
+
+				out.insert(out.end(), piece.begin(), piece.end());
+
+			}
+
+			return ChunkCodec::None;
+
+		}
+
+	private:
+
+		ChunkCodec codec;
+
+		BlobEncoder blobEncoder;
+
+		#ifdef DAQCAP_HAVE_ZSTD
+
+			ZSTD_CCtx *context;
+
+			void encodeZstd(
+				const vector<ByteView> &pieces, 
+				uint64_t size,
+				vector<uint8_t> &out
+			) {
+
+				ZSTD_CCtx_reset(context, ZSTD_reset_session_only);
+				ZSTD_CCtx_setPledgedSrcSize(context, size);
+
+				// NOTE: With room for the worst case, compression always
+				//       finishes in one pass.
+				out.resize(ZSTD_compressBound(size));
+
+				ZSTD_outBuffer output = { out.data(), out.size(), 0 };
+
+				for(ByteView piece : pieces) {
+
+					ZSTD_inBuffer input = { piece.data(), piece.size(), 0 };
+
+					while(input.pos < input.size) {
+
+						check(ZSTD_compressStream2(
+							context, &output, &input, ZSTD_e_continue
+						));
+
+					}
+
+				}
+
+				ZSTD_inBuffer end = { nullptr, 0, 0 };
+
+				while(check(ZSTD_compressStream2(
+					context, &output, &end, ZSTD_e_end
+				)) != 0) {}
+
+				out.resize(output.pos);
+
+			}
+
+			static size_t check(size_t result) {
+
+				if(ZSTD_isError(result)) {
+
+					throw std::runtime_error(
+						string("Could not compress chunk: ")
+							+ ZSTD_getErrorName(result)
+					);
+
+				}
+
+				return result;
+
+			}
+
+		#endif
+
+	};
+
+	// Decompresses a chunk's stored data into out
+	void decodeChunk(
+		size_t index,
+		const ChunkInfo &chunk,
+		ByteView stored,
+		vector<uint8_t> &out
+	) {
+
+		string name = "Chunk " + std::to_string(index);
+
+		switch(chunk.codec) {
+
+			case ChunkCodec::None:
+				out.assign(stored.begin(), stored.end());
+				break;
+
+			case ChunkCodec::Blob:
+				try {
+
+					out = decompressData(stored, chunk.dataSize);
+
+				} catch(const std::invalid_argument &e) {
+
+					throw std::runtime_error(
+						name + " is corrupt: " + e.what()
+					);
+
+				}
+				break;
+
+			case ChunkCodec::Zstd:
+
+				#ifdef DAQCAP_HAVE_ZSTD
+
+				{
+
+					out.resize(chunk.dataSize);
+
+					size_t size = ZSTD_decompress(
+						out.data(), 
+						out.size(), 
+						stored.data(), 
+						stored.size()
+					);
+
+					if(ZSTD_isError(size)) {
+
+						throw std::runtime_error(
+							name + " is corrupt: " + ZSTD_getErrorName(size)
+						);
+
+					}
+
+					out.resize(size);
+
+				}
+				break;
+
+				#else
+
+					throw std::runtime_error(
+						name + " is compressed with zstd, which this build"
+							+ " does not support."
+					);
+
+				#endif
+
+			default:
+				throw std::runtime_error(
+					name + " is compressed with an unknown codec."
+				);
+
+		}
+
+		if(out.size() != chunk.dataSize) {
+
+			throw std::runtime_error(
+				name + " is corrupt: wrong size after decompression."
+			);
+
+		}
+
+	}
+
+	[[noreturn]] void notChunked(const string &path, const string &reason) {
+
+		throw std::runtime_error(
+			path + " is not a chunked file: " + reason
+		);
+
+	}
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+struct ChunkedFileSink::Compressor {
+
+	// A finished chunk waiting to be compressed and written
+	struct Job {
+
+		vector<Segment> segments;
+		vector<uint8_t> staged;
+
+		ChunkInfo chunk;
+
+		// The chunk's data as it will be written
+		vector<uint8_t> stored;
+
+		bool done = false;
+		std::exception_ptr error;
+
+	};
+
+	Compressor(ChunkCodec codec, unsigned threads);
+	~Compressor();
+
+	// Queues a chunk to be compressed, taking its segments and staged data
+	void submit(
+		vector<Segment> &segments, 
+		vector<uint8_t> &staged, 
+		const ChunkInfo &chunk
+	);
+
+	// Removes the oldest chunk from the queue if it has been compressed. If
+	// wait is true, waits for it first. Returns null if the queue is empty,
+	// or the oldest chunk isn't ready and wait is false.
+	unique_ptr<Job> next(bool wait);
+
+	// Checks whether every thread has a chunk and another is waiting
+	bool full() const;
+
+	ChunkCodec codec;
+
+	mutable std::mutex mutex;
+
+	// Signalled when a chunk is queued or the compressor is stopping
+	std::condition_variable queued;
+
+	// Signalled when a chunk is compressed
+	std::condition_variable compressed;
+
+	// Chunks in the order they are written. The first started are being
+	// compressed, or are done.
+	std::deque<unique_ptr<Job>> jobs;
+	size_t started;
+
+	bool stopping;
+
+	vector<std::thread> threads;
+
+	// Compresses chunks until the compressor stops
+	void run();
+
+	// Stops the threads and waits for them to finish
+	void stop();
+
+};
+
+ChunkedFileSink::Compressor::Compressor(ChunkCodec codec, unsigned threads)
+	: codec(codec), started(0), stopping(false) {
+
+	if(threads == 0) {
+
+		threads = std::max(1u, std::thread::hardware_concurrency());
+
+	}
+
+	try {
+
+		for(unsigned i = 0; i < threads; ++i) {
+
+			this->threads.emplace_back(&Compressor::run, this);
+
+		}
+
+	} catch(...) {
+
+		stop();
+		throw;
+
+	}
+
+}
+
+ChunkedFileSink::Compressor::~Compressor() {
+
+	stop();
+
+}
+
+void ChunkedFileSink::Compressor::stop() {
+
+	{
+
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+
+	}
+
+	queued.notify_all();
+
+	for(std::thread &thread : threads) {
+
+		if(thread.joinable()) thread.join();
+
+	}
+
+}
+
+void ChunkedFileSink::Compressor::submit(
+	vector<Segment> &segments,
+	vector<uint8_t> &staged,
+	const ChunkInfo &chunk
+) {
+
+	unique_ptr<Job> job(new Job);
+
+	job->segments.swap(segments);
+	job->staged.swap(staged);
+	job->chunk = chunk;
+
+	{
+
+		std::lock_guard<std::mutex> lock(mutex);
+		jobs.push_back(std::move(job));
+
+	}
+
+	queued.notify_one();
+
+}
+
+unique_ptr<ChunkedFileSink::Compressor::Job> 
+ChunkedFileSink::Compressor::next(bool wait) {
+
+	std::unique_lock<std::mutex> lock(mutex);
+
+	if(wait) {
+
+		compressed.wait(lock, [this]() {
+
+			return jobs.empty() || jobs.front()->done;
+
+		});
+
+	}
+
+	if(jobs.empty() || !jobs.front()->done) return nullptr;
+
+	unique_ptr<Job> job = std::move(jobs.front());
+
+	jobs.pop_front();
+	--started;
+
+	return job;
+
+}
+
+bool ChunkedFileSink::Compressor::full() const {
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	return jobs.size() > threads.size();
+
+}
+
+void ChunkedFileSink::Compressor::run() {
+
+	ChunkEncoder encoder(codec);
+
+	vector<ByteView> pieces;
+
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while(true) {
+
+		queued.wait(lock, [this]() {
+
+			return stopping || started < jobs.size();
+
+		});
+
+		if(stopping) return;
+
+		// Jobs are only removed once they are done, so this stays put
+		Job &job = *jobs[started++];
+
+		lock.unlock();
+
+		try {
+
+			pieces.clear();
+
+			uint32_t checksum = 0;
+
+			for(const Segment &segment : job.segments) {
+
+				ByteView piece = segment.staged
+					? ByteView(
+						job.staged.data() + segment.stagedOffset, 
+						segment.size
+					)
+					: segment.blob.view();
+
+				checksum = crc32c(piece.data(), piece.size(), checksum);
+
+				pieces.push_back(piece);
+
+			}
+
+			job.chunk.checksum   = checksum;
+			job.chunk.codec      = encoder.encode(
+				pieces, 
+				job.chunk.dataSize, 
+				job.stored
+			);
+			job.chunk.storedSize = job.stored.size();
+
+		} catch(...) {
+
+			job.error = std::current_exception();
+
+		}
+
+		// Let go of the blobs now, so their buffers can be reused while
+		// the chunk waits to be written
+		job.segments.clear();
+		vector<uint8_t>().swap(job.staged);
+
+		lock.lock();
+
+		job.done = true;
+
+		compressed.notify_all();
+
+	}
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+ChunkedFileSink::ChunkedFileSink(
+	unique_ptr<FileSink> target,
+	const ChunkedFileOptions &options
+) : target(std::move(target)),
+    options(options),
+    nextPacket(0),
+    offset(0),
+    bytes(0),
+    closed(false) {
+
+	if(!this->target) {
+
+		throw std::invalid_argument("ChunkedFileSink needs a target sink.");
+
+	}
+
+	if(options.chunkSize == 0) {
+
+		throw std::invalid_argument("Chunk size must be nonzero.");
+
+	}
+
+	if(!supportsCodec(options.codec)) {
+
+		throw std::runtime_error(
+			"Chunks can't be compressed with this codec in this build."
+		);
+
+	}
+
+	vector<uint8_t> header;
+	header.reserve(FILE_HEADER_SIZE);
+
+	putU32(header, FILE_MAGIC);
+	putU16(header, VERSION);
+	putU16(header, FILE_HEADER_SIZE);
+	putU64(header, options.chunkSize);
+
+	this->target->write(ByteView(header.data(), header.size()));
+
+	offset = header.size();
+
+	if(options.codec != ChunkCodec::None) {
+
+		compressor.reset(
+			new Compressor(options.codec, options.compressionThreads)
+		);
+
+	}
+
+}
+
+ChunkedFileSink::~ChunkedFileSink() {
+
+	try {
+
+		close();
+
+	} catch(...) {}
+
+}
+
+bool ChunkedFileSink::supportsCodec(ChunkCodec codec) {
+
+	switch(codec) {
+
+		case ChunkCodec::None:
+		case ChunkCodec::Blob:
+			return true;
+
+		case ChunkCodec::Zstd:
+
+			#ifdef DAQCAP_HAVE_ZSTD
+
+				return true;
+
+			#else
+
+				return false;
+
+			#endif
+
+		default:
+			return false;
+
+	}
+
+}
+
+void ChunkedFileSink::write(ByteView data) {
+
+	checkOpen();
+
+	if(data.empty()) return;
+
+	Segment segment;
+	segment.stagedOffset = staged.size();
+	segment.size = data.size();
+	segment.staged = true;
+
+	segments.push_back(segment);
+	staged.insert(staged.end(), data.begin(), data.end());
+
+	pending.dataSize  += data.size();
+	pending.wordCount += data.size() / Packet::WORD_SIZE;
+
+	bytes += data.size();
+
+	if(pending.dataSize >= options.chunkSize) finishChunk();
+
+}
+
+void ChunkedFileSink::write(const vector<DataBlob> &blobs) {
+
+	checkOpen();
+
+	for(const DataBlob &blob : blobs) {
+
+		if(blob.empty()) continue;
+
+		Segment segment;
+		segment.blob = blob;
+		segment.stagedOffset = 0;
+		segment.size = blob.size();
+		segment.staged = false;
+
+		segments.push_back(segment);
+
+		describe(blob);
+
+		pending.dataSize  += blob.size();
+		pending.wordCount += blob.size() / Packet::WORD_SIZE;
+		++pending.blobCount;
+
+		bytes += blob.size();
+
+		if(pending.dataSize >= options.chunkSize) finishChunk();
+
+	}
+
+}
+
+void ChunkedFileSink::flush() {
+
+	checkOpen();
+
+	finishChunk();
+
+	if(compressor) writeCompressed(true);
+
+	target->flush();
+
+}
+
+void ChunkedFileSink::close() {
+
+	if(closed) return;
+
+	closed = true;
+
+	// Close the target even if finishing the file fails, then report the
+	// first failure
+	std::exception_ptr failure;
+
+	try {
+
+		finishChunk();
+
+		if(compressor) writeCompressed(true);
+
+		vector<uint8_t> index;
+		index.reserve(finished.size() * (8 + CHUNK_HEADER_SIZE) + FOOTER_SIZE);
+
+		for(const ChunkInfo &chunk : finished) {
+
+			putU64(index, chunk.offset - CHUNK_HEADER_SIZE);
+			putChunkHeader(index, chunk);
+
+		}
+
+		uint32_t checksum = crc32c(index.data(), index.size());
+
+		putU64(index, offset);
+		putU64(index, finished.size());
+		putU32(index, checksum);
+		putU32(index, INDEX_MAGIC);
+
+		target->write(ByteView(index.data(), index.size()));
+
+	} catch(...) {
+
+		failure = std::current_exception();
+
+	}
+
+	try {
+
+		target->close();
+
+	} catch(...) {
+
+		if(!failure) failure = std::current_exception();
+
+	}
+
+	// Stops the compressing threads, and drops any chunks left after a
+	// failure
+	compressor.reset();
+
+	segments.clear();
+	staged.clear();
+
+	if(failure) std::rethrow_exception(failure);
+
+}
+
+uint64_t ChunkedFileSink::bytesWritten() const {
+
+	return bytes;
+
+}
+
+const vector<ChunkInfo> &ChunkedFileSink::chunks() const {
+
+	return finished;
+
+}
+
+void ChunkedFileSink::describe(const DataBlob &blob) {
+
+	const BlobMetadata &metadata = blob.metadata();
+
+	if(blob.packetCount() == 0) return;
+
+	if(pending.firstSequence == -1) {
+
+		pending.firstSequence = metadata.firstSequence;
+		pending.firstArrival  = metadata.firstArrival;
+
+	}
+
+	pending.lastSequence = metadata.lastSequence;
+	pending.lastArrival  = metadata.lastArrival;
+
+	// Count lost packets too, so packet positions keep increasing when
+	// packet numbers wrap around
+	uint64_t packets = blob.packetCount();
+	for(const PacketGap &gap : blob.gaps()) packets += gap.missing;
+
+	pending.packetCount += packets;
+	nextPacket += packets;
+
+}
+
+void ChunkedFileSink::finishChunk() {
+
+	if(segments.empty()) return;
+
+	if(compressor) {
+
+		compressor->submit(segments, staged, pending);
+
+		segments.clear();
+		staged.clear();
+
+		pending = ChunkInfo();
+		pending.firstPacket = nextPacket;
+
+		// Write whatever is done, and wait if we've gotten too far ahead
+		writeCompressed(false);
+
+		return;
+
+	}
+
+	uint32_t checksum = 0;
+
+	for(const Segment &segment : segments) {
+
+		const uint8_t *data = segment.staged
+			? staged.data() + segment.stagedOffset
+			: segment.blob.view().data();
+
+		checksum = crc32c(data, segment.size, checksum);
+
+	}
+
+	pending.checksum = checksum;
+	pending.storedSize = pending.dataSize;
+	pending.offset = offset + CHUNK_HEADER_SIZE;
+
+	vector<uint8_t> header;
+	header.reserve(CHUNK_HEADER_SIZE);
+	putChunkHeader(header, pending);
+
+	target->write(ByteView(header.data(), header.size()));
+
+	// Hand runs of blobs to the target together, so it can gather them
+	// into as few writes as possible
+	vector<DataBlob> batch;
+
+	for(const Segment &segment : segments) {
+
+		if(!segment.staged) {
+
+			batch.push_back(segment.blob);
+			continue;
+
+		}
+
+		if(!batch.empty()) {
+
+			target->write(batch);
+			batch.clear();
+
+		}
+
+		target->write(
+			ByteView(staged.data() + segment.stagedOffset, segment.size)
+		);
+
+	}
+
+	if(!batch.empty()) target->write(batch);
+
+	offset += CHUNK_HEADER_SIZE + pending.storedSize;
+
+	finished.push_back(pending);
+
+	segments.clear();
+	staged.clear();
+
+	pending = ChunkInfo();
+	pending.firstPacket = nextPacket;
+
+}
+
+void ChunkedFileSink::writeChunk(ChunkInfo chunk, ByteView data) {
+
+	chunk.offset = offset + CHUNK_HEADER_SIZE;
+
+	vector<uint8_t> header;
+	header.reserve(CHUNK_HEADER_SIZE);
+	putChunkHeader(header, chunk);
+
+	target->write(ByteView(header.data(), header.size()));
+	target->write(data);
+
+	offset += CHUNK_HEADER_SIZE + chunk.storedSize;
+
+	finished.push_back(chunk);
+
+}
+
+void ChunkedFileSink::writeCompressed(bool wait) {
+
+	while(true) {
+
+		unique_ptr<Compressor::Job> job = compressor->next(
+			wait || compressor->full()
+		);
+
+		if(!job) return;
+
+		if(job->error) std::rethrow_exception(job->error);
+
+		writeChunk(
+			job->chunk, 
+			ByteView(job->stored.data(), job->stored.size())
+		);
+
+	}
+
+}
+
+void ChunkedFileSink::checkOpen() const {
+
+	if(closed) {
+
+		throw std::runtime_error("Cannot write to a closed FileSink.");
+
+	}
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+ChunkedFileReader::ChunkedFileReader(const string &path)
+	: fd(-1), rebuilt(false), headerSize(CHUNK_HEADER_SIZE) {
+
+	fd = ::open(path.data(), O_RDONLY);
+
+	if(fd < 0) {
+
+		throw std::runtime_error(
+			"Could not open " + path + ": " + std::strerror(errno)
+		);
+
+	}
+
+	try {
+
+		struct stat info;
+		if(fstat(fd, &info) != 0) {
+
+			throw std::runtime_error(
+				"Could not read " + path + ": " + std::strerror(errno)
+			);
+
+		}
+
+		uint64_t fileSize = info.st_size;
+
+		if(fileSize < FILE_HEADER_SIZE) notChunked(path, "too small.");
+
+		uint8_t header[FILE_HEADER_SIZE];
+		readAt(0, header, sizeof(header));
+
+		if(loadU32(header) != FILE_MAGIC) notChunked(path, "bad magic.");
+
+		uint16_t version = loadU16(header + 4);
+
+		if(version == 1) {
+
+			headerSize = V1_CHUNK_HEADER_SIZE;
+
+		} else if(version != VERSION) {
+
+			notChunked(path, "unsupported version.");
+
+		}
+
+		if(!loadIndex(fileSize)) rebuildIndex(fileSize);
+
+	} catch(...) {
+
+		::close(fd);
+		throw;
+
+	}
+
+}
+
+ChunkedFileReader::~ChunkedFileReader() {
+
+	::close(fd);
+
+}
+
+bool ChunkedFileReader::isChunkedFile(const string &path) {
+
+	int file = ::open(path.data(), O_RDONLY);
+	if(file < 0) return false;
+
+	uint8_t magic[4];
+	bool chunked = pread(file, magic, sizeof(magic), 0) == sizeof(magic)
+		&& loadU32(magic) == FILE_MAGIC;
+
+	::close(file);
+
+	return chunked;
+
+}
+
+size_t ChunkedFileReader::chunkCount() const {
+
+	return index.size();
+
+}
+
+const ChunkInfo &ChunkedFileReader::chunk(size_t i) const {
+
+	if(i >= index.size()) {
+
+		throw std::out_of_range("Chunk index out of range.");
+
+	}
+
+	return index[i];
+
+}
+
+const vector<ChunkInfo> &ChunkedFileReader::chunks() const {
+
+	return index;
+
+}
+
+bool ChunkedFileReader::recovered() const {
+
+	return rebuilt;
+
+}
+
+size_t ChunkedFileReader::findPacket(uint64_t packet) const {
+
+	// Chunks cover consecutive packet positions, so the chunk we want is
+	// the first one that ends past the packet
+	return std::partition_point(
+		index.begin(),
+		index.end(),
+		[packet](const ChunkInfo &chunk) {
+
+			return chunk.firstPacket + chunk.packetCount <= packet;
+
+		}
+	) - index.begin();
+
+}
+
+size_t ChunkedFileReader::findTime(Timestamp time) const {
+
+	return std::partition_point(
+		index.begin(),
+		index.end(),
+		[time](const ChunkInfo &chunk) {
+
+			return chunk.lastArrival < time;
+
+		}
+	) - index.begin();
+
+}
+
+void ChunkedFileReader::readChunk(size_t i, vector<uint8_t> &out) const {
+
+	const ChunkInfo &info = chunk(i);
+
+	if(info.codec == ChunkCodec::None) {
+
+		out.resize(info.dataSize);
+		readAt(info.offset, out.data(), out.size());
+
+	} else {
+
+		vector<uint8_t> stored(info.storedSize);
+		readAt(info.offset, stored.data(), stored.size());
+
+		decodeChunk(i, info, ByteView(stored.data(), stored.size()), out);
+
+	}
+
+	if(crc32c(out.data(), out.size()) != info.checksum) {
+
+		throw std::runtime_error(
+			"Chunk " + std::to_string(i) + " is corrupt: checksum mismatch."
+		);
+
+	}
+
+}
+
+vector<uint8_t> ChunkedFileReader::readChunk(size_t i) const {
+
+	vector<uint8_t> data;
+	readChunk(i, data);
+
+	return data;
+
+}
+
+bool ChunkedFileReader::loadIndex(uint64_t fileSize) {
+
+	if(fileSize < FILE_HEADER_SIZE + FOOTER_SIZE) return false;
+
+	uint8_t footer[FOOTER_SIZE];
+	readAt(fileSize - FOOTER_SIZE, footer, sizeof(footer));
+
+	if(loadU32(footer + 20) != INDEX_MAGIC) return false;
+
+	uint64_t indexOffset = loadU64(footer);
+	uint64_t count       = loadU64(footer + 8);
+
+	uint64_t indexEnd = fileSize - FOOTER_SIZE;
+
+	size_t entrySize = 8 + headerSize;
+
+	if(indexOffset < FILE_HEADER_SIZE || indexOffset > indexEnd) return false;
+	if(count != (indexEnd - indexOffset) / entrySize) return false;
+	if((indexEnd - indexOffset) % entrySize != 0) return false;
+
+	vector<uint8_t> entries(indexEnd - indexOffset);
+	readAt(indexOffset, entries.data(), entries.size());
+
+	if(crc32c(entries.data(), entries.size()) != loadU32(footer + 16)) {
+
+		return false;
+
+	}
+
+	vector<ChunkInfo> chunks(count);
+
+	for(uint64_t i = 0; i < count; ++i) {
+
+		const uint8_t *entry = &entries[i * entrySize];
+
+		uint64_t headerOffset = loadU64(entry);
+
+		if(!loadChunkHeader(
+			entry + 8, 
+			headerSize, 
+			headerOffset, 
+			chunks[i]
+		)) {
+
+			return false;
+
+		}
+
+		if(chunks[i].offset > indexOffset
+			|| chunks[i].storedSize > indexOffset - chunks[i].offset) {
+
+			return false;
+
+		}
+
+	}
+
+	index.swap(chunks);
+
+	return true;
+
+}
+
+void ChunkedFileReader::rebuildIndex(uint64_t fileSize) {
+
+	rebuilt = true;
+
+	uint64_t position = FILE_HEADER_SIZE;
+
+	uint8_t header[CHUNK_HEADER_SIZE];
+
+	while(fileSize - position >= headerSize) {
+
+		readAt(position, header, headerSize);
+
+		ChunkInfo chunk;
+		if(!loadChunkHeader(header, headerSize, position, chunk)) break;
+
+		// Stop at a chunk that was cut off partway through
+		if(chunk.storedSize > fileSize - chunk.offset) break;
+
+		index.push_back(chunk);
+
+		position = chunk.offset + chunk.storedSize;
+
+	}
+
+}
+
+void ChunkedFileReader::readAt(
+	uint64_t offset,
+	uint8_t *out,
+	size_t size
+) const {
+
+	while(size > 0) {
+
+		ssize_t count = pread(fd, out, size, offset);
+
+		if(count < 0 && errno == EINTR) continue;
+
+		if(count < 0) {
+
+			throw std::runtime_error(
+				string("Could not read chunked file: ") + std::strerror(errno)
+			);
+
+		}
+
+		if(count == 0) {
+
+			throw std::runtime_error(
+				"Could not read chunked file: unexpected end of file."
+			);
+
+		}
+
+		out    += count;
+		offset += count;
+		size   -= count;
+
+	}
+
+}
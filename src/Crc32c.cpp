@@ -0,0 +1,180 @@
+#include "Crc32c.h"
+
+#include <cstring>
+
+// The crc32 instruction from SSE4.2 computes CRC32C directly. It is compiled
+// for just the functions that use it, and only used if the CPU has it, so
+// builds still run on any x86-64 CPU.
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+	#define DAQCAP_HAVE_SSE42_CRC
+	#include <nmmintrin.h>
+#endif
+
+using namespace DAQCap;
+
+namespace {
+
+	// The reflected CRC32C polynomial
+	const uint32_t POLYNOMIAL = 0x82F63B78;
+
+	// Lookup tables for slicing-by-8. tables[0] is the usual byte-at-a-time
+	// table, and tables[k] advances a byte through k more zero bytes.
+	struct Tables {
+
+		uint32_t entries[8][256];
+
+		Tables() {
+
+			for(uint32_t byte = 0; byte < 256; ++byte) {
+
+				uint32_t crc = byte;
+				for(int bit = 0; bit < 8; ++bit) {
+
+					crc = (crc >> 1) ^ (POLYNOMIAL & (0 - (crc & 1)));
+
+				}
+
+				entries[0][byte] = crc;
+
+			}
+
+			for(uint32_t byte = 0; byte < 256; ++byte) {
+
+				for(int k = 1; k < 8; ++k) {
+
+					uint32_t previous = entries[k - 1][byte];
+
+					entries[k][byte] 
+						= (previous >> 8) ^ entries[0][previous & 0xFF];
+
+				}
+
+			}
+
+		}
+
+	};
+
+	const Tables TABLES;
+
+	// Takes and returns the inverted checksum
+	typedef uint32_t (*Implementation)(
+		const uint8_t *data, 
+		size_t size, 
+		uint32_t crc
+	);
+
+	uint32_t softwareCrc(const uint8_t *data, size_t size, uint32_t crc) {
+
+		const uint32_t (&table)[8][256] = TABLES.entries;
+
+		// OPTIMIZATION -- Eight bytes at a time. Bytes are combined 
+		//                 explicitly, so this doesn't depend on the host's
+		//                 byte order.
+		while(size >= 8) {
+
+			uint32_t low = crc 
+				^ (uint32_t(data[0])       | (uint32_t(data[1]) << 8)
+				|  (uint32_t(data[2]) << 16) | (uint32_t(data[3]) << 24));
+
+			crc = table[7][low & 0xFF]
+				^ table[6][(low >> 8) & 0xFF]
+				^ table[5][(low >> 16) & 0xFF]
+				^ table[4][low >> 24]
+				^ table[3][data[4]]
+				^ table[2][data[5]]
+				^ table[1][data[6]]
+				^ table[0][data[7]];
+
+			data += 8;
+			size -= 8;
+
+		}
+
+		while(size > 0) {
+
+			crc = (crc >> 8) ^ table[0][(crc ^ *data) & 0xFF];
+
+			++data;
+			--size;
+
+		}
+
+		return crc;
+
+	}
+
+#ifdef DAQCAP_HAVE_SSE42_CRC
+
+	__attribute__((target("sse4.2")))
+	uint32_t hardwareCrc(const uint8_t *data, size_t size, uint32_t crc) {
+
+		uint64_t crc64 = crc;
+
+		// OPTIMIZATION -- One instruction per eight bytes, with no table
+		//                 lookups. x86 is little-endian, so loading a word
+		//                 feeds its bytes in order.
+		while(size >= 8) {
+
+			uint64_t word;
+			std::memcpy(&word, data, sizeof(word));
+
+			crc64 = _mm_crc32_u64(crc64, word);
+
+			data += 8;
+			size -= 8;
+
+		}
+
+		crc = static_cast<uint32_t>(crc64);
+
+		while(size > 0) {
+
+			crc = _mm_crc32_u8(crc, *data);
+
+			++data;
+			--size;
+
+		}
+
+		return crc;
+
+	}
+
+#endif
+
+	Implementation chooseImplementation() {
+
+#ifdef DAQCAP_HAVE_SSE42_CRC
+
+		if(__builtin_cpu_supports("sse4.2")) return hardwareCrc;
+
+#endif
+
+		return softwareCrc;
+
+	}
+
+	// Chosen on first use rather than when the library is loaded, so
+	// callers from other static initializers never see it unset
+	Implementation implementation() {
+
+		static const Implementation CHOSEN = chooseImplementation();
+
+		return CHOSEN;
+
+	}
+
+}
+
+uint32_t DAQCap::crc32c(const uint8_t *data, size_t size, uint32_t crc) {
+
+	return ~implementation()(data, size, ~crc);
+
+}
+
+bool DAQCap::crc32cAccelerated() {
+
+	return implementation() != softwareCrc;
+
+}
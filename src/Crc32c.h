@@ -0,0 +1,42 @@
+/**
+ * @file Crc32c.h
+ *
+ * @brief Computes CRC32C (Castagnoli) checksums, as used by DAQCap's chunked
+ * file format.
+ *
+ * @author Robert Myers
+ * Contact: romyers@umich.edu
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <stdint.h>
+
+namespace DAQCap {
+
+	/**
+	 * @brief Computes the CRC32C of a range of bytes.
+	 * 
+	 * Uses the CPU's CRC instruction where it is available.
+	 * 
+	 * Checksums can be computed piece by piece by passing the checksum of
+	 * the data so far as crc. That is, crc32c(b, m, crc32c(a, n)) is the
+	 * checksum of a followed by b.
+	 * 
+	 * @param data The first byte to checksum.
+	 * @param size The number of bytes to checksum.
+	 * @param crc The checksum of any preceding data, or 0 if there is none.
+	 */
+	uint32_t crc32c(const uint8_t *data, size_t size, uint32_t crc = 0);
+
+	/**
+	 * @brief Checks whether crc32c() uses the CPU's CRC instruction.
+	 * 
+	 * On x86-64 CPUs with SSE4.2, checksums are computed with the crc32
+	 * instruction, which is fast enough to checksum everything that is
+	 * captured. Other CPUs fall back to a table-driven implementation.
+	 */
+	bool crc32cAccelerated();
+
+}
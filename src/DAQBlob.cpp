@@ -1,6 +1,7 @@
 #include <DAQBlob.h>
 
 #include "Packet.h"
+#include "WordPacking.h"
 
 #include <stdexcept>
 #include <iostream>
@@ -12,73 +13,154 @@ using std::ostream;
 using namespace DAQCap;
 
 
+const DataBlob::Contents &DataBlob::read() const {
+
+	// Default-constructed blobs all read from the same empty contents, so
+	// that creating an empty blob never allocates.
+	static const Contents EMPTY_CONTENTS;
+
+	return contents ? *contents : EMPTY_CONTENTS;
+
+}
+
 int DataBlob::packetCount() const {
 
-	return packets;
+	return read().packets;
 
 }
 
-vector<uint8_t> DataBlob::data() const {
+const vector<uint8_t> &DataBlob::data() const {
 
-	return dataBuffer;
+	return read().dataBuffer;
 
 }
 
-vector<string> DataBlob::warnings() const {
+const vector<string> &DataBlob::warnings() const {
 
-	return warningsBuffer;
+	return read().warningsBuffer;
 
 }
 
-vector<Word> DAQCap::packData(const vector<uint8_t> &data) {
+const BlobMetadata &DataBlob::metadata() const {
+
+	return read().metadata;
+
+}
+
+const vector<PacketGap> &DataBlob::gaps() const {
+
+	return read().gapList;
+
+}
 
-	vector<uint64_t> packedData;
-	packedData.reserve(data.size() / Packet::WORD_SIZE);
+const vector<PacketIndexEntry> &DataBlob::packetIndex() const {
 
-	// NOTE: Since data.size() and Packet::WORD_SIZE are unsigned, we need to
-	//       cast to int to avoid underflow for small data.size() in the loop
-	//       comparison.
-	for(
-		int wordStart = 0; 
-		wordStart <= (int)data.size() - (int)Packet::WORD_SIZE; 
-		wordStart += Packet::WORD_SIZE
-	) {
+	return read().packetList;
 
-		// Convert a word of raw bytes into a uint64_t
-		packedData.push_back(0);
-		for(size_t byte = 0; byte < Packet::WORD_SIZE; ++byte) {
+}
+
+ByteView DataBlob::packetView(size_t index) const {
 
-			// memcpy would be faster, but runs into byte order issues.
+	const Contents &contents = read();
 
-			// NOTE: Without the cast to uint64_t, the shift will be done as if
-			//       on a 32-bit integer, causing the first byte to wrap around
-			//       and distort the data.
-			packedData.back() |= static_cast<uint64_t>(data[wordStart + byte])
-								   << (8 * (Packet::WORD_SIZE - byte - 1));
+	if(index >= contents.packetList.size()) {
 
-		}
+		throw std::out_of_range(
+			"Packet index " 
+				+ std::to_string(index) 
+				+ " is out of range for a blob with "
+				+ std::to_string(contents.packetList.size())
+				+ " indexed packets."
+		);
 
 	}
 
+	const PacketIndexEntry &entry = contents.packetList[index];
+
+	size_t words = contents.dataBuffer.size() / Packet::WORD_SIZE;
+
+	if(entry.wordOffset > words || entry.wordCount > words - entry.wordOffset) {
+
+		throw std::out_of_range(
+			"Packet index entry "
+				+ std::to_string(index)
+				+ " lies outside the blob's data."
+		);
+
+	}
+
+	return ByteView(
+		contents.dataBuffer.data() + entry.wordOffset * Packet::WORD_SIZE,
+		entry.wordCount * Packet::WORD_SIZE
+	);
+
+}
+
+size_t DataBlob::size() const {
+
+	return read().dataBuffer.size();
+
+}
+
+bool DataBlob::empty() const {
+
+	return read().dataBuffer.empty();
+
+}
+
+ByteView DataBlob::view() const {
+
+	const vector<uint8_t> &data = read().dataBuffer;
+
+	return ByteView(data.data(), data.size());
+
+}
+
+long DataBlob::useCount() const {
+
+	if(!contents) return 0;
+
+	// The pool's reference doesn't count -- it isn't a DataBlob
+	return contents.use_count() - (contents->pooled ? 1 : 0);
+
+}
+
+vector<Word> DAQCap::packData(const vector<uint8_t> &data) {
+
+	return packData(ByteView(data.data(), data.size()));
+
+}
+
+vector<Word> DAQCap::packData(ByteView data) {
+
+	// Size the output up front so the words can be stored directly, with
+	// no per-word bounds or capacity checks
+	vector<Word> packedData(data.size() / Packet::WORD_SIZE);
+
+	packWords(data.data(), packedData.size(), packedData.data());
+
 	return packedData;
 
 }
 
 DataBlob::const_iterator DataBlob::cbegin() const {
 
-	return dataBuffer.cbegin();
+	return read().dataBuffer.cbegin();
 
 }
 
 DataBlob::const_iterator DataBlob::cend() const {
 
-	return dataBuffer.cend();
+	return read().dataBuffer.cend();
 
 }
 
 ostream &DAQCap::operator<<(ostream &os, const DataBlob &blob) {
 
-	os.write((char*)blob.data().data(), blob.data().size());
+	// Write straight from the blob's buffer without copying it
+	ByteView data = blob.view();
+
+	os.write((const char*)data.data(), data.size());
 
 	return os;
 
@@ -3,9 +3,13 @@
 #include "Packet.h"
 #include "PacketProcessor.h"
 
+#include <PcapngWriter.h>
+#include <FileSink.h>
+
 #include <pcap.h>
 
 #include <stdexcept>
+#include <memory>
 #include <map>
 
 using std::string;
@@ -57,6 +61,21 @@ class PCapDevice;
 //       buffer before using it.
 vector<Packet> g_packetBuffer;
 
+// Counts frames that listen_callback() could not turn into packets. Like
+// g_packetBuffer, it is reset by the fetch that reads it.
+uint64_t g_framesRejected = 0;
+
+// Where listen_callback() records raw frames, if anywhere. Set by the fetch
+// that is running.
+PcapngWriter *g_rawFrames = nullptr;
+
+// Why recording raw frames failed, if it did. Since listen_callback() can't
+// throw, the error is reported by the device after the fetch.
+string g_rawFrameError;
+
+// Whether the fetch that is running gets nanosecond timestamps from pcap
+bool g_nanosecondTimestamps = false;
+
 // Global map of existing devices we can use to keep device instances unique.
 map<string, PCapDevice> g_devices;
 
@@ -68,16 +87,49 @@ void listen_callback(
 	const u_char *packet_data
 ) {
 
+	// NOTE: With nanosecond precision, pcap stores nanoseconds in tv_usec
+	std::chrono::nanoseconds fraction = g_nanosecondTimestamps
+		? std::chrono::nanoseconds(header->ts.tv_usec)
+		: std::chrono::microseconds(header->ts.tv_usec);
+
+	std::chrono::system_clock::time_point timestamp(
+		std::chrono::duration_cast<std::chrono::system_clock::duration>(
+			std::chrono::seconds(header->ts.tv_sec) + fraction
+		)
+	);
+
+	// Record the frame before parsing it, so frames we reject are recorded
+	// too
+	if(g_rawFrames) {
+
+		try {
+
+			g_rawFrames->writeFrame(
+				ByteView(packet_data, header->caplen),
+				header->len,
+				timestamp
+			);
+
+		} catch(const std::exception &e) {
+
+			g_rawFrameError = e.what();
+			g_rawFrames = nullptr;
+
+		}
+
+	}
+
 	try {
 
 		// NOTE: We have to use a structure with global scope here.
-		g_packetBuffer.emplace_back(packet_data, header->len);
+		g_packetBuffer.emplace_back(packet_data, header->len, timestamp);
 
 	} catch(...) {
 
 		// We don't want to throw exceptions from a callback function.
 		// We'll just ignore the malformed packet. DAQCap::SessionHandler will
 		// notice that we missed a packet.
+		++g_framesRejected;
 		
 	}
 
@@ -103,11 +155,23 @@ public:
 
 	virtual void interrupt() override;
 
+	virtual void setPacketIndexing(bool enabled) override;
+
+	virtual void setBlobPoolSize(size_t buffers) override;
+
+	virtual void setRawFrameFile(const std::string &path) override;
+
 	virtual DataBlob fetchData(
 		std::chrono::seconds timeout = FOREVER,
 		int packetsToRead = ALL_PACKETS
 	) override;
 
+	virtual void fetchData(
+		DataBlob &blob,
+		std::chrono::seconds timeout = FOREVER,
+		int packetsToRead = ALL_PACKETS
+	) override;
+
 	PCapDevice(PCapDevice &other) = delete;
 	PCapDevice& operator=(PCapDevice &other) = delete;
 
@@ -118,8 +182,29 @@ private:
 
 	PacketProcessor packetProcessor;
 
+	// Swapped with g_packetBuffer on each fetch, so that the two vectors
+	// keep their capacity between fetches instead of reallocating.
+	// NOTE: This doesn't make fetching allocation-free. Each Packet still
+	//       copies its frame into a vector of its own.
+	vector<Packet> packetScratch;
+
+	// Total drops reported by pcap_stats() as of the last fetch
+	u_int lastDropCount;
+
 	pcap_t *handler;
 
+	// Whether pcap gives this device nanosecond timestamps
+	bool nanosecondTimestamps;
+
+	// Where raw frames are recorded, if anywhere
+	std::unique_ptr<PcapngWriter> rawFrames;
+
+	// Gets the number of frames dropped since the last call
+	uint64_t collectDrops();
+
+	// Stops recording raw frames, ignoring errors
+	void abandonRawFrames();
+
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -216,7 +301,11 @@ Device *Device::getDevice(const string &name) {
 ///////////////////////////////////////////////////////////////////////////////
 
 PCapDevice::PCapDevice(std::string name, std::string description)
-	: name(name), description(description), handler(nullptr) {}
+	: name(name), 
+	  description(description), 
+	  lastDropCount(0), 
+	  handler(nullptr),
+	  nanosecondTimestamps(false) {}
 
 void PCapDevice::open() {
 
@@ -254,6 +343,14 @@ void PCapDevice::open() {
 	// TODO: In immediate_mode, is there really a reason to use pcap_dispatch
 	//       instead of just getting packets one at a time?
 
+	// Ask for nanosecond timestamps. Not every device supports them, so we
+	// check what we actually got once the handle is active.
+	#ifdef PCAP_TSTAMP_PRECISION_NANO
+
+		pcap_set_tstamp_precision(handler, PCAP_TSTAMP_PRECISION_NANO);
+
+	#endif
+
 	int ret = pcap_activate(handler);
 	if(ret < 0) {
 
@@ -264,6 +361,17 @@ void PCapDevice::open() {
 
 	}
 
+	#ifdef PCAP_TSTAMP_PRECISION_NANO
+
+		nanosecondTimestamps = pcap_get_tstamp_precision(handler) 
+			== PCAP_TSTAMP_PRECISION_NANO;
+
+	#else
+
+		nanosecondTimestamps = false;
+
+	#endif
+
 	// Compile the filter
 	struct bpf_program fcode;
 	bpf_u_int32 netmask = 0xffffff;
@@ -295,6 +403,10 @@ void PCapDevice::open() {
 	// pcap_setfilter(3PCAP).
 	pcap_freecode(&fcode);
 
+	// Start counting drops from zero for this session
+	lastDropCount = 0;
+	collectDrops();
+
 	// TODO: Idea -- Start buffering packets immediately when open() is called,
 	//       and let the fetch function just read out the buffer.
 
@@ -310,14 +422,35 @@ void PCapDevice::close() {
 
 	interrupt();
 
+	abandonRawFrames();
+
 	if(handler) pcap_close(handler);
 	handler = nullptr;
 
 	g_packetBuffer.clear();
+	g_framesRejected = 0;
 	packetProcessor.reset();
 
 }
 
+uint64_t PCapDevice::collectDrops() {
+
+	if(!handler) return 0;
+
+	struct pcap_stat stats;
+	if(pcap_stats(handler, &stats) < 0) return 0;
+
+	// NOTE: The counters are cumulative and may wrap around, so we take
+	//       the difference in unsigned arithmetic.
+	u_int dropCount = stats.ps_drop + stats.ps_ifdrop;
+	u_int drops     = dropCount - lastDropCount;
+
+	lastDropCount = dropCount;
+
+	return drops;
+
+}
+
 void PCapDevice::interrupt() {
 
 	if(!handler) return;
@@ -345,27 +478,115 @@ void PCapDevice::interrupt() {
 
 }
 
+void PCapDevice::setPacketIndexing(bool enabled) {
+
+	packetProcessor.setPacketIndexing(enabled);
+
+}
+
+void PCapDevice::setBlobPoolSize(size_t buffers) {
+
+	packetProcessor.setBlobPoolSize(buffers);
+
+}
+
+void PCapDevice::setRawFrameFile(const string &path) {
+
+	if(rawFrames) {
+
+		// Hand over the writer first, so that it's gone even if closing
+		// it fails
+		std::unique_ptr<PcapngWriter> finished = std::move(rawFrames);
+
+		finished->close();
+
+	}
+
+	if(path.empty()) return;
+
+	if(!handler) {
+
+		throw std::runtime_error("The device is not open.");
+
+	}
+
+	PcapngInterface link;
+	link.linkType    = pcap_datalink(handler);
+	link.snapLength  = pcap_snapshot(handler);
+	link.name        = name;
+	link.description = description;
+
+	rawFrames.reset(new PcapngWriter(FileSink::open(path), link));
+
+}
+
+void PCapDevice::abandonRawFrames() {
+
+	if(!rawFrames) return;
+
+	try {
+
+		rawFrames->close();
+
+	} catch(...) {}
+
+	rawFrames.reset();
+
+}
+
 DataBlob PCapDevice::fetchData(
 	std::chrono::seconds timeout,
 	int packetsToRead
 ) {
 
+	DataBlob blob;
+
+	fetchData(blob, timeout, packetsToRead);
+
+	return blob;
+
+}
+
+void PCapDevice::fetchData(
+	DataBlob &blob,
+	std::chrono::seconds timeout,
+	int packetsToRead
+) {
+
 	// TODO: It would be great if fetchData could abandon the dispatch thread
 	//       and return on interrupt. We can make sure the dispatch thread will
 	//       end *eventually* and just detach it.
 
-	DataBlob blob;
-
 	// TODO: Timeout logic for versions that can't interrupt
 
 	if(!handler) {
 
+		blob = DataBlob();
+
 		throw std::runtime_error(
 			"The device is not open."
 		);
 
 	}
 
+	// Report a failure to record raw frames during the previous fetch. The
+	// packets of this fetch are still waiting in pcap's buffer, so nothing
+	// is lost by throwing here.
+	if(!g_rawFrameError.empty()) {
+
+		string error = g_rawFrameError;
+		g_rawFrameError.clear();
+
+		abandonRawFrames();
+
+		blob = DataBlob();
+
+		throw std::runtime_error(
+			"Stopped recording raw frames: " + error
+		);
+
+	}
+
 	///////////////////////////////////////////////////////////////////////////
 	// Read the data with timeout logic
 	///////////////////////////////////////////////////////////////////////////
@@ -422,6 +643,9 @@ DataBlob PCapDevice::fetchData(
 	int ret = -1;
 	if(sel > 0) {
 
+		g_rawFrames = rawFrames.get();
+		g_nanosecondTimestamps = nanosecondTimestamps;
+
 		ret = pcap_dispatch(
 			handler, 
 			packetsToRead, 
@@ -429,6 +653,8 @@ DataBlob PCapDevice::fetchData(
 			NULL
 		);
 
+		g_rawFrames = nullptr;
+
 	} else if(sel == 0) {
 
 		// We timed out
@@ -445,13 +671,15 @@ DataBlob PCapDevice::fetchData(
 	// Get data from global buffer
 	///////////////////////////////////////////////////////////////////////////
 
-	// Swap g_packetBuffer with the local vector, clearing g_packetBuffer in
-	// the process
-	vector<Packet> packets;
-	std::swap(packets, g_packetBuffer);
+	// Swap g_packetBuffer with the (empty) scratch vector, clearing 
+	// g_packetBuffer in the process
+	packetScratch.clear();
+	std::swap(packetScratch, g_packetBuffer);
 
 	if(ret == -1) { // An error occurred
 
+		blob = DataBlob();
+
 		string errorMessage(pcap_geterr(handler));
 
 		throw std::runtime_error(
@@ -470,8 +698,17 @@ DataBlob PCapDevice::fetchData(
 	// Blobify and return data
 	///////////////////////////////////////////////////////////////////////////
 	
-	// TODO: Is this faster with std::move?
-	return packetProcessor.blobify(packets);
+	CaptureStats stats;
+	stats.framesRejected = g_framesRejected;
+	stats.kernelDrops    = collectDrops();
+
+	g_framesRejected = 0;
+
+	packetProcessor.blobify(packetScratch, blob, stats);
+
+	// Destroy the packets now rather than holding on to them until the next
+	// fetch. The vector keeps its capacity.
+	packetScratch.clear();
 
 }
 
@@ -0,0 +1,658 @@
+#include <FileSink.h>
+#include <BlobIO.h>
+
+#include "FileSinks.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using std::vector;
+using std::string;
+using std::unique_ptr;
+
+using namespace DAQCap;
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+Preallocator::Preallocator(int fd, uint64_t extent) 
+	: fd(fd), extent(extent), reserved(0) {
+
+	off_t start = lseek(fd, 0, SEEK_CUR);
+	if(start > 0) reserved = start;
+
+	// Reserve the first extent up front, so it is already in place when
+	// a sink is opened ahead of time
+	reserve(reserved + 1);
+
+}
+
+void Preallocator::reserve(uint64_t end) {
+
+	#ifdef __linux__
+
+		if(extent == 0 || end <= reserved) return;
+
+		// Round up to a whole number of extents past what we have
+		uint64_t size = ((end - reserved + extent - 1) / extent) * extent;
+
+		// NOTE: FALLOC_FL_KEEP_SIZE reserves blocks without changing the
+		//       file size, so readers never see space we haven't written.
+		if(fallocate(fd, FALLOC_FL_KEEP_SIZE, reserved, size) != 0) {
+
+			// Not supported here, or the disk is full. Either way, writes
+			// will go ahead (or fail) without our help.
+			extent = 0;
+			return;
+
+		}
+
+		reserved += size;
+
+	#else
+
+		(void)end;
+
+	#endif
+
+}
+
+void Preallocator::release(uint64_t size) {
+
+	#ifdef __linux__
+
+		if(reserved <= size) return;
+
+		// Truncating frees the blocks past the end of the file, even if the
+		// size doesn't change. Punching a hole doesn't work past the end.
+		if(ftruncate(fd, size) == 0) reserved = size;
+
+	#else
+
+		(void)size;
+
+	#endif
+
+}
+
+bool Preallocator::truncate(uint64_t size) {
+
+	if(ftruncate(fd, size) != 0) return false;
+
+	// NOTE: Nothing past size is reserved anymore, so keep the next extent
+	//       ahead of the data the same way the constructor does.
+	if(reserved > size) {
+
+		reserved = size;
+
+		reserve(size + 1);
+
+	}
+
+	return true;
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+Writeback::Writeback(int fd, uint64_t window)
+	: fd(fd), window(window), started(0), dropped(0) {
+
+	off_t start = lseek(fd, 0, SEEK_CUR);
+	if(start > 0) started = dropped = start;
+
+}
+
+void Writeback::advance(uint64_t end) {
+
+	#ifdef __linux__
+
+		while(window > 0 && end - started >= window) {
+
+			// Start writing the finished window back without waiting
+			if(sync_file_range(
+				fd, started, window, SYNC_FILE_RANGE_WRITE
+			) != 0) {
+
+				// Not supported for this file. Leave it to the kernel.
+				window = 0;
+				return;
+
+			}
+
+			// NOTE: Waiting for the previous window, rather than this one,
+			//       keeps the disk busy while we wait. Pages can only be
+			//       dropped once they are clean, so this is also what lets
+			//       the page cache let go of them.
+			if(started > dropped) {
+
+				sync_file_range(
+					fd,
+					dropped,
+					started - dropped,
+					SYNC_FILE_RANGE_WAIT_BEFORE 
+						| SYNC_FILE_RANGE_WRITE 
+						| SYNC_FILE_RANGE_WAIT_AFTER
+				);
+
+				posix_fadvise(
+					fd, 
+					dropped, 
+					started - dropped, 
+					POSIX_FADV_DONTNEED
+				);
+
+				dropped = started;
+
+			}
+
+			started += window;
+
+		}
+
+	#else
+
+		(void)end;
+
+	#endif
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+	// The alignment of buffers, offsets and sizes for O_DIRECT. Every
+	// device we care about has a logical block size that divides this.
+	const size_t DIRECT_ALIGNMENT = 4096;
+
+	[[noreturn]] void systemError(const string &what) {
+
+		throw std::runtime_error(what + ": " + std::strerror(errno));
+
+	}
+
+	// Writes with blocking write calls straight from the caller's buffers
+	class PosixFileSink final : public FileSink {
+
+	public:
+
+		PosixFileSink(int fd, bool ownsFd, const FileSinkOptions &options);
+		virtual ~PosixFileSink();
+
+		virtual void write(ByteView data) override;
+		virtual void write(const vector<DataBlob> &blobs) override;
+
+		virtual void flush() override;
+		virtual void close() override;
+
+		virtual uint64_t bytesWritten() const override;
+
+	private:
+
+		int fd;
+		bool ownsFd;
+
+		uint64_t bytes;
+
+		// Where in the file the next byte goes
+		uint64_t offset;
+
+		Preallocator preallocator;
+		Writeback writeback;
+
+		void checkOpen() const;
+
+	};
+
+	PosixFileSink::PosixFileSink(
+		int fd, 
+		bool ownsFd, 
+		const FileSinkOptions &options
+	) : fd(fd), 
+	    ownsFd(ownsFd), 
+	    bytes(0), 
+	    offset(0),
+	    preallocator(fd, options.preallocateBytes),
+	    writeback(fd, options.writebackBytes) {
+
+		off_t start = lseek(fd, 0, SEEK_CUR);
+		if(start > 0) offset = start;
+
+	}
+
+	PosixFileSink::~PosixFileSink() {
+
+		try {
+
+			close();
+
+		} catch(...) {}
+
+	}
+
+	void PosixFileSink::write(ByteView data) {
+
+		checkOpen();
+
+		preallocator.reserve(offset + data.size());
+
+		size_t count = writeData(fd, data);
+
+		bytes  += count;
+		offset += count;
+
+		writeback.advance(offset);
+
+	}
+
+	void PosixFileSink::write(const vector<DataBlob> &blobs) {
+
+		checkOpen();
+
+		uint64_t size = 0;
+		for(const DataBlob &blob : blobs) size += blob.size();
+
+		preallocator.reserve(offset + size);
+
+		size_t count = writeBlobs(fd, blobs);
+
+		bytes  += count;
+		offset += count;
+
+		writeback.advance(offset);
+
+	}
+
+	void PosixFileSink::flush() {
+
+		checkOpen();
+
+	}
+
+	void PosixFileSink::close() {
+
+		if(fd < 0) return;
+
+		int closing = fd;
+		fd = -1;
+
+		preallocator.release(offset);
+
+		if(ownsFd && ::close(closing) != 0) {
+
+			systemError("Could not close output file");
+
+		}
+
+	}
+
+	uint64_t PosixFileSink::bytesWritten() const {
+
+		return bytes;
+
+	}
+
+	void PosixFileSink::checkOpen() const {
+
+		if(fd < 0) {
+
+			throw std::runtime_error("Cannot write to a closed FileSink.");
+
+		}
+
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+
+	// Writes whole blocks from an aligned buffer to a file opened with
+	// O_DIRECT
+	class DirectFileSink final : public FileSink {
+
+	public:
+
+		DirectFileSink(int fd, const FileSinkOptions &options);
+		virtual ~DirectFileSink();
+
+		virtual void write(ByteView data) override;
+
+		virtual void flush() override;
+		virtual void close() override;
+
+		virtual uint64_t bytesWritten() const override;
+
+	private:
+
+		int fd;
+
+		uint8_t *buffer;
+		size_t bufferSize;
+
+		// Bytes of data in the buffer
+		size_t fill;
+
+		// Where in the file the start of the buffer goes. Always aligned.
+		uint64_t bufferOffset;
+
+		uint64_t bytes;
+
+		Preallocator preallocator;
+
+		// Writes the first size bytes of the buffer. size must be aligned.
+		void writeBuffer(size_t size);
+
+		void checkOpen() const;
+
+	};
+
+	DirectFileSink::DirectFileSink(int fd, const FileSinkOptions &options)
+		: fd(fd),
+		  buffer(nullptr),
+		  bufferSize(0),
+		  fill(0),
+		  bufferOffset(0),
+		  bytes(0),
+		  preallocator(fd, options.preallocateBytes) {
+
+		if(options.bufferSize == 0) {
+
+			throw std::invalid_argument(
+				"Direct I/O buffer size must be nonzero."
+			);
+
+		}
+
+		// Round the buffer up to a whole number of blocks
+		bufferSize = (
+			(options.bufferSize + DIRECT_ALIGNMENT - 1) / DIRECT_ALIGNMENT
+		) * DIRECT_ALIGNMENT;
+
+		void *memory = nullptr;
+		int error = posix_memalign(&memory, DIRECT_ALIGNMENT, bufferSize);
+		if(error != 0) {
+
+			errno = error;
+			systemError("Could not allocate direct I/O buffer");
+
+		}
+
+		buffer = static_cast<uint8_t*>(memory);
+
+	}
+
+	DirectFileSink::~DirectFileSink() {
+
+		try {
+
+			close();
+
+		} catch(...) {}
+
+		free(buffer);
+
+	}
+
+	void DirectFileSink::write(ByteView data) {
+
+		checkOpen();
+
+		const uint8_t *next = data.data();
+		size_t remaining = data.size();
+
+		while(remaining > 0) {
+
+			size_t count = std::min(remaining, bufferSize - fill);
+
+			std::memcpy(buffer + fill, next, count);
+
+			fill      += count;
+			next      += count;
+			remaining -= count;
+
+			if(fill == bufferSize) {
+
+				writeBuffer(bufferSize);
+
+				bufferOffset += bufferSize;
+				fill = 0;
+
+			}
+
+		}
+
+		bytes += data.size();
+
+	}
+
+	void DirectFileSink::flush() {
+
+		checkOpen();
+
+		if(fill == 0) return;
+
+		// O_DIRECT can only write whole blocks, so pad the last partial
+		// block with zeros, write it, and cut the padding off again. The
+		// partial block stays in the buffer, and is written again in full
+		// once the rest of it arrives.
+		size_t whole  = (fill / DIRECT_ALIGNMENT) * DIRECT_ALIGNMENT;
+		size_t padded = (
+			(fill + DIRECT_ALIGNMENT - 1) / DIRECT_ALIGNMENT
+		) * DIRECT_ALIGNMENT;
+
+		std::memset(buffer + fill, 0, padded - fill);
+
+		writeBuffer(padded);
+
+		if(padded != fill && !preallocator.truncate(bufferOffset + fill)) {
+
+			systemError("Could not truncate output file");
+
+		}
+
+		std::memmove(buffer, buffer + whole, fill - whole);
+
+		bufferOffset += whole;
+		fill         -= whole;
+
+	}
+
+	void DirectFileSink::close() {
+
+		if(fd < 0) return;
+
+		try {
+
+			flush();
+
+		} catch(...) {
+
+			::close(fd);
+			fd = -1;
+
+			throw;
+
+		}
+
+		preallocator.release(bufferOffset + fill);
+
+		int closing = fd;
+		fd = -1;
+
+		if(::close(closing) != 0) {
+
+			systemError("Could not close output file");
+
+		}
+
+	}
+
+	uint64_t DirectFileSink::bytesWritten() const {
+
+		return bytes;
+
+	}
+
+	void DirectFileSink::writeBuffer(size_t size) {
+
+		preallocator.reserve(bufferOffset + size);
+
+		size_t written = 0;
+
+		while(written < size) {
+
+			ssize_t ret = pwrite(
+				fd, 
+				buffer + written, 
+				size - written, 
+				bufferOffset + written
+			);
+
+			if(ret < 0) {
+
+				if(errno == EINTR) continue;
+
+				systemError("Could not write data");
+
+			}
+
+			written += ret;
+
+		}
+
+	}
+
+	void DirectFileSink::checkOpen() const {
+
+		if(fd < 0) {
+
+			throw std::runtime_error("Cannot write to a closed FileSink.");
+
+		}
+
+	}
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+unique_ptr<FileSink> DAQCap::openPosixFileSink(
+	int fd, 
+	bool ownsFd,
+	const FileSinkOptions &options
+) {
+
+	return unique_ptr<FileSink>(new PosixFileSink(fd, ownsFd, options));
+
+}
+
+unique_ptr<FileSink> DAQCap::openDirectFileSink(
+	int fd,
+	const FileSinkOptions &options
+) {
+
+	return unique_ptr<FileSink>(new DirectFileSink(fd, options));
+
+}
+
+unique_ptr<FileSink> FileSink::open(
+	const string &path,
+	const FileSinkOptions &options
+) {
+
+	if(options.useIOUring && !uringSupported()) {
+
+		throw std::runtime_error(
+			"io_uring is not supported on this system."
+		);
+
+	}
+
+	int flags = O_WRONLY | O_CREAT | O_TRUNC;
+
+	if(options.directIO) {
+
+		if(options.useIOUring) {
+
+			throw std::runtime_error(
+				"Direct I/O can't be combined with io_uring."
+			);
+
+		}
+
+		#ifdef O_DIRECT
+
+			flags |= O_DIRECT;
+
+		#else
+
+			throw std::runtime_error(
+				"Direct I/O is not supported on this system."
+			);
+
+		#endif
+
+	}
+
+	int fd = ::open(path.data(), flags, 0644);
+	if(fd < 0) {
+
+		throw std::runtime_error(
+			"Could not open " + path + ": " + std::strerror(errno)
+		);
+
+	}
+
+	try {
+
+		if(options.useIOUring) {
+
+			return openUringFileSink(fd, true, options);
+
+		}
+
+		if(options.directIO) {
+
+			return openDirectFileSink(fd, options);
+
+		}
+
+		return openPosixFileSink(fd, true, options);
+
+	} catch(...) {
+
+		::close(fd);
+		throw;
+
+	}
+
+}
+
+bool FileSink::supportsIOUring() {
+
+	return uringSupported();
+
+}
+
+void FileSink::write(const vector<DataBlob> &blobs) {
+
+	for(const DataBlob &blob : blobs) {
+
+		write(blob.view());
+
+	}
+
+}
@@ -0,0 +1,163 @@
+/**
+ * @file FileSinks.h
+ *
+ * @brief Creates the FileSink implementations behind FileSink::open().
+ *
+ * @author Robert Myers
+ * Contact: romyers@umich.edu
+ */
+
+#pragma once
+
+#include <FileSink.h>
+
+#include <memory>
+#include <stdint.h>
+
+namespace DAQCap {
+
+	/**
+	 * @brief Reserves disk space for a file ahead of the data written to it.
+	 * 
+	 * Preallocation is best-effort. If the file system doesn't support it,
+	 * the preallocator quietly does nothing.
+	 */
+	class Preallocator final {
+
+	public:
+
+		/**
+		 * @brief Creates a preallocator for a file and reserves the first
+		 * extent past the current offset.
+		 * 
+		 * @param fd The file to reserve space for.
+		 * @param extent How many bytes to reserve at a time. If 0, nothing
+		 * is reserved.
+		 */
+		Preallocator(int fd, uint64_t extent);
+
+		/**
+		 * @brief Makes sure space is reserved up to the given file offset.
+		 */
+		void reserve(uint64_t end);
+
+		/**
+		 * @brief Releases space reserved past the given file size.
+		 */
+		void release(uint64_t size);
+
+		/**
+		 * @brief Truncates the file to the given size, then reserves space
+		 * past it again, since truncating frees everything reserved beyond
+		 * the new end.
+		 * 
+		 * @return False if the file could not be truncated, with errno set.
+		 */
+		bool truncate(uint64_t size);
+
+	private:
+
+		int fd;
+		uint64_t extent;
+
+		// The end of the reserved space
+		uint64_t reserved;
+
+	};
+
+	/**
+	 * @brief Writes a file back to disk in fixed windows as data is written
+	 * to it, and drops written windows from the page cache.
+	 * 
+	 * Writeback is best-effort. If the file doesn't support it, as with
+	 * pipes, the writeback quietly does nothing.
+	 */
+	class Writeback final {
+
+	public:
+
+		/**
+		 * @brief Creates a writeback for a file, starting at its current
+		 * offset.
+		 * 
+		 * @param fd The file to write back.
+		 * @param window How many bytes to write back at a time. If 0,
+		 * writeback is left to the kernel.
+		 */
+		Writeback(int fd, uint64_t window);
+
+		/**
+		 * @brief Tells the writeback that every byte of the file before the
+		 * given offset has been written. Writes back any windows this
+		 * completes, after waiting for the windows before them.
+		 */
+		void advance(uint64_t end);
+
+	private:
+
+		int fd;
+		uint64_t window;
+
+		// The end of the data being written back
+		uint64_t started;
+
+		// The end of the data known to be on disk and dropped from the
+		// page cache
+		uint64_t dropped;
+
+	};
+
+	/**
+	 * @brief Opens a sink that writes to a file descriptor with blocking
+	 * write calls.
+	 * 
+	 * @param fd The file descriptor to write to.
+	 * @param ownsFd Whether the sink should close fd when it is closed.
+	 * @param options Preallocation and writeback settings for the sink.
+	 */
+	std::unique_ptr<FileSink> openPosixFileSink(
+		int fd, 
+		bool ownsFd,
+		const FileSinkOptions &options = FileSinkOptions()
+	);
+
+	/**
+	 * @brief Opens a sink that writes whole blocks from an aligned buffer to
+	 * a file descriptor opened with O_DIRECT. The sink takes ownership of
+	 * fd.
+	 * 
+	 * @param fd The file descriptor to write to, positioned at offset 0.
+	 * @param options Buffer and preallocation settings for the sink.
+	 */
+	std::unique_ptr<FileSink> openDirectFileSink(
+		int fd,
+		const FileSinkOptions &options
+	);
+
+	/**
+	 * @brief Opens a sink that writes to a file descriptor through io_uring.
+	 * 
+	 * Data is written at the file descriptor's current offset. If the sink
+	 * does not own fd, the offset is moved past the written data when the
+	 * sink is closed.
+	 * 
+	 * @param fd The file descriptor to write to. Must be seekable.
+	 * @param ownsFd Whether the sink should close fd when it is closed.
+	 * @param options Buffer, preallocation and writeback settings for the
+	 * sink.
+	 * 
+	 * @throws std::runtime_error If io_uring is not supported, or could not
+	 * be set up.
+	 */
+	std::unique_ptr<FileSink> openUringFileSink(
+		int fd, 
+		bool ownsFd, 
+		const FileSinkOptions &options
+	);
+
+	/**
+	 * @brief Checks whether this system supports io_uring.
+	 */
+	bool uringSupported();
+
+}
@@ -0,0 +1,77 @@
+#include <FrameInjector.h>
+
+#include <pcap.h>
+
+#include <stdexcept>
+
+using std::string;
+
+using namespace DAQCap;
+
+namespace {
+
+	pcap_t *asPcap(void *handle) {
+
+		return static_cast<pcap_t*>(handle);
+
+	}
+
+}
+
+FrameInjector::FrameInjector(const string &interfaceName)
+	: handle(nullptr), name(interfaceName), frames(0) {
+
+	char errorBuffer[PCAP_ERRBUF_SIZE];
+
+	pcap_t *pcap = pcap_create(name.data(), errorBuffer);
+
+	if(!pcap) {
+
+		throw std::runtime_error(
+			"Could not open " + name + ": " + errorBuffer
+		);
+
+	}
+
+	if(pcap_activate(pcap) < 0) {
+
+		string error = pcap_geterr(pcap);
+
+		pcap_close(pcap);
+
+		throw std::runtime_error("Could not open " + name + ": " + error);
+
+	}
+
+	handle = pcap;
+
+}
+
+FrameInjector::~FrameInjector() {
+
+	pcap_close(asPcap(handle));
+
+}
+
+void FrameInjector::inject(ByteView frame) {
+
+	int sent = pcap_inject(asPcap(handle), frame.data(), frame.size());
+
+	if(sent < 0 || static_cast<size_t>(sent) != frame.size()) {
+
+		throw std::runtime_error(
+			"Could not send a frame on " + name + ": "
+				+ pcap_geterr(asPcap(handle))
+		);
+
+	}
+
+	++frames;
+
+}
+
+uint64_t FrameInjector::framesSent() const {
+
+	return frames;
+
+}
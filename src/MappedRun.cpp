@@ -0,0 +1,395 @@
+#include <MappedRun.h>
+#include <ChunkedFile.h>
+
+#include "Packet.h"
+#include "Crc32c.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <cstring>
+#include <cerrno>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using std::vector;
+using std::string;
+
+using namespace DAQCap;
+
+const size_t MappedRun::DEFAULT_CHUNK_WORDS = 1 << 20;
+
+MappedRun::MappedRun(const string &path, size_t chunkWords)
+	: mapping(nullptr),
+	  mappingSize(0),
+	  isChunked(false),
+	  chunkWords(chunkWords),
+	  words(0) {
+
+	if(chunkWords == 0) {
+
+		throw std::invalid_argument("Chunks must hold at least one word.");
+
+	}
+
+	// Load the index first, so that a bad chunked file fails before
+	// anything is mapped
+	vector<ChunkInfo> chunks;
+
+	if(ChunkedFileReader::isChunkedFile(path)) {
+
+		isChunked = true;
+
+		ChunkedFileReader reader(path);
+		chunks = reader.chunks();
+
+		// Compressed words can't be read in place
+		for(const ChunkInfo &chunk : chunks) {
+
+			if(chunk.codec != ChunkCodec::None) {
+
+				throw std::runtime_error(
+					path + " has compressed chunks, which can't be mapped."
+						+ " Read it with a ChunkedFileReader instead."
+				);
+
+			}
+
+		}
+
+	}
+
+	int fd = ::open(path.data(), O_RDONLY);
+
+	if(fd < 0) {
+
+		throw std::runtime_error(
+			"Could not open " + path + ": " + std::strerror(errno)
+		);
+
+	}
+
+	struct stat info;
+	if(fstat(fd, &info) != 0) {
+
+		::close(fd);
+
+		throw std::runtime_error(
+			"Could not read " + path + ": " + std::strerror(errno)
+		);
+
+	}
+
+	mappingSize = info.st_size;
+
+	// NOTE: Mapping an empty file fails, and there's nothing to map anyway
+	if(mappingSize > 0) {
+
+		mapping = mmap(nullptr, mappingSize, PROT_READ, MAP_SHARED, fd, 0);
+
+	}
+
+	// The mapping stays valid after the file is closed
+	::close(fd);
+
+	if(mapping == MAP_FAILED) {
+
+		mapping = nullptr;
+
+		throw std::runtime_error(
+			"Could not map " + path + ": " + std::strerror(errno)
+		);
+
+	}
+
+	const uint8_t *base = static_cast<const uint8_t*>(mapping);
+
+	if(isChunked) {
+
+		for(const ChunkInfo &chunk : chunks) {
+
+			// The file may have been cut short since the index was read
+			if(chunk.offset + chunk.dataSize > mappingSize) break;
+
+			Segment segment;
+			segment.data = base + chunk.offset;
+			segment.firstWord = words;
+			segment.words = chunk.dataSize / Packet::WORD_SIZE;
+			segment.size = chunk.dataSize;
+			segment.checksum = chunk.checksum;
+
+			segments.push_back(segment);
+
+			words += segment.words;
+
+		}
+
+	} else {
+
+		words = mappingSize / Packet::WORD_SIZE;
+
+		for(uint64_t first = 0; first < words; first += chunkWords) {
+
+			Segment segment;
+			segment.data = base + first * Packet::WORD_SIZE;
+			segment.firstWord = first;
+			segment.words = std::min<uint64_t>(chunkWords, words - first);
+			segment.size = segment.words * Packet::WORD_SIZE;
+			segment.checksum = 0;
+
+			segments.push_back(segment);
+
+		}
+
+	}
+
+}
+
+MappedRun::~MappedRun() {
+
+	if(mapping) munmap(mapping, mappingSize);
+
+}
+
+bool MappedRun::chunked() const {
+
+	return isChunked;
+
+}
+
+uint64_t MappedRun::size() const {
+
+	return words;
+
+}
+
+bool MappedRun::empty() const {
+
+	return words == 0;
+
+}
+
+Word MappedRun::operator[](uint64_t index) const {
+
+	const Segment &segment = segments[chunkFor(index)];
+
+	return WordView::decodeWord(
+		segment.data + (index - segment.firstWord) * Packet::WORD_SIZE
+	);
+
+}
+
+Word MappedRun::at(uint64_t index) const {
+
+	if(index >= words) {
+
+		throw std::out_of_range("MappedRun::at: index out of range.");
+
+	}
+
+	return (*this)[index];
+
+}
+
+size_t MappedRun::decode(uint64_t firstWord, size_t count, Word *out) const {
+
+	if(firstWord > words) {
+
+		throw std::out_of_range(
+			"MappedRun::decode: firstWord out of range."
+		);
+
+	}
+
+	count = std::min<uint64_t>(count, words - firstWord);
+
+	size_t decoded = 0;
+	size_t index = count > 0 ? chunkFor(firstWord) : 0;
+
+	while(decoded < count) {
+
+		const Segment &segment = segments[index];
+
+		decoded += chunk(index).decode(
+			firstWord + decoded - segment.firstWord,
+			count - decoded,
+			out + decoded
+		);
+
+		++index;
+
+	}
+
+	return count;
+
+}
+
+size_t MappedRun::chunkCount() const {
+
+	return segments.size();
+
+}
+
+WordView MappedRun::chunk(size_t index) const {
+
+	checkChunk(index);
+
+	const Segment &segment = segments[index];
+
+	return WordView(segment.data, segment.words * Packet::WORD_SIZE);
+
+}
+
+uint64_t MappedRun::chunkOffset(size_t index) const {
+
+	checkChunk(index);
+
+	return segments[index].firstWord;
+
+}
+
+bool MappedRun::verifyChunk(size_t index) const {
+
+	checkChunk(index);
+
+	if(!isChunked) return true;
+
+	const Segment &segment = segments[index];
+
+	// NOTE: The checksum covers the whole chunk, not just its whole words
+	return crc32c(segment.data, segment.size) == segment.checksum;
+
+}
+
+void MappedRun::forEachChunk(
+	const ChunkFunction &function,
+	unsigned threads
+) const {
+
+	if(threads == 0) {
+
+		threads = std::max(1u, std::thread::hardware_concurrency());
+
+	}
+
+	threads = std::min<size_t>(threads, segments.size());
+
+	std::atomic<size_t> next(0);
+	std::atomic<bool> stop(false);
+
+	std::mutex errorMutex;
+	std::exception_ptr error;
+
+	auto work = [&]() {
+
+		// Each thread reuses one buffer for every chunk it decodes
+		vector<Word> decoded;
+
+		while(!stop) {
+
+			size_t index = next++;
+			if(index >= segments.size()) break;
+
+			try {
+
+				prefetch(index);
+
+				if(!verifyChunk(index)) {
+
+					throw std::runtime_error(
+						"Chunk " + std::to_string(index)
+						+ " is corrupt: checksum mismatch."
+					);
+
+				}
+
+				WordView view = chunk(index);
+
+				decoded.resize(view.size());
+				view.decode(0, view.size(), decoded.data());
+
+				function(index, decoded);
+
+			} catch(...) {
+
+				std::lock_guard<std::mutex> lock(errorMutex);
+
+				if(!error) error = std::current_exception();
+
+				stop = true;
+
+			}
+
+		}
+
+	};
+
+	vector<std::thread> workers;
+
+	for(unsigned i = 1; i < threads; ++i) workers.emplace_back(work);
+
+	// The calling thread does its share too
+	work();
+
+	for(std::thread &worker : workers) worker.join();
+
+	if(error) std::rethrow_exception(error);
+
+}
+
+size_t MappedRun::chunkFor(uint64_t word) const {
+
+	if(!isChunked) return word / chunkWords;
+
+	// The last chunk starting at or before the word. Empty chunks share a
+	// first word with the next chunk, so this skips past them.
+	return std::upper_bound(
+		segments.begin(),
+		segments.end(),
+		word,
+		[](uint64_t value, const Segment &segment) {
+
+			return value < segment.firstWord;
+
+		}
+	) - segments.begin() - 1;
+
+}
+
+void MappedRun::prefetch(size_t index) const {
+
+	const Segment &segment = segments[index];
+
+	// madvise() needs a page-aligned start
+	uintptr_t page = sysconf(_SC_PAGESIZE);
+	uintptr_t start = reinterpret_cast<uintptr_t>(segment.data);
+	uintptr_t end = start + segment.words * Packet::WORD_SIZE;
+
+	start -= start % page;
+
+	// OPTIMIZATION -- Start reading the whole chunk from disk at once, 
+	//                 instead of faulting it in a page at a time as it is
+	//                 decoded. This is only a hint, so failures don't
+	//                 matter.
+	posix_madvise(
+		reinterpret_cast<void*>(start), 
+		end - start, 
+		POSIX_MADV_WILLNEED
+	);
+
+}
+
+void MappedRun::checkChunk(size_t index) const {
+
+	if(index >= segments.size()) {
+
+		throw std::out_of_range("Chunk index out of range.");
+
+	}
+
+}
@@ -24,8 +24,11 @@ const size_t Packet::WORD_SIZE = 5;
 const vector<uint8_t> Packet::IDLE_WORD 
 	= vector<uint8_t>(Packet::WORD_SIZE, 0xFF);
 		
-Packet::Packet(const uint8_t *raw_data, size_t size) 
-	: packetNumber(0) {
+Packet::Packet(
+	const uint8_t *raw_data, 
+	size_t size,
+	std::chrono::system_clock::time_point timestamp
+) : packetNumber(0), timestamp(timestamp), rawSize(size) {
 
 	// NOTE: This relates to the data format from the miniDAQ, not to the 
 	//       network interface we're using to get the data.
@@ -71,6 +74,18 @@ int Packet::getPacketNumber() const {
 
 }
 
+std::chrono::system_clock::time_point Packet::getTimestamp() const {
+
+	return timestamp;
+
+}
+
+size_t Packet::getRawSize() const {
+
+	return rawSize;
+
+}
+
 Packet::const_iterator Packet::cbegin() const { 
 
 	return data.cbegin(); 
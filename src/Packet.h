@@ -11,6 +11,7 @@
 
 #include <cstddef>
 #include <vector>
+#include <chrono>
 #include <stdint.h>
 
 namespace DAQCap {
@@ -43,10 +44,17 @@ namespace DAQCap {
 		 * 
 		 * @param size The size of the raw packet data array.
 		 * 
+		 * @param timestamp The time at which the packet arrived.
+		 * 
 		 * @throws std::invalid_argument If size is too small to represent a
 		 * packet.
 		 */
-		Packet(const uint8_t *raw_data, size_t size);
+		Packet(
+			const uint8_t *raw_data, 
+			size_t size,
+			std::chrono::system_clock::time_point timestamp 
+				= std::chrono::system_clock::time_point()
+		);
 
 		/**
 		 * @brief Returns the packet number associated with this packet.
@@ -55,6 +63,17 @@ namespace DAQCap {
 		 */
 		int getPacketNumber() const;
 
+		/**
+		 * @brief Returns the time at which the packet arrived.
+		 */
+		std::chrono::system_clock::time_point getTimestamp() const;
+
+		/**
+		 * @brief Returns the size of the raw packet, including the preload
+		 * and postload.
+		 */
+		size_t getRawSize() const;
+
 		/**
 		 * @brief Returns the size of the data portion of the packet.
 		 */
@@ -110,6 +129,10 @@ namespace DAQCap {
 
 		int packetNumber;
 
+		std::chrono::system_clock::time_point timestamp;
+
+		size_t rawSize;
+
 		std::vector<uint8_t> data;
 
 		unsigned long ID;
@@ -1,26 +1,105 @@
 #include "PacketProcessor.h"
 
 #include <numeric>
+#include <algorithm>
 
 using namespace DAQCap;
 
 using std::vector;
 
+namespace {
+
+	// Compacts the words in [begin, end) to the output position, dropping
+	// idle words. Returns the new output position.
+	// NOTE: out must not be after begin.
+	vector<uint8_t>::iterator keepDataWords(
+		vector<uint8_t>::const_iterator begin,
+		vector<uint8_t>::const_iterator end,
+		vector<uint8_t>::iterator out
+	) {
+
+		// Scan through each word
+		for(auto iter = begin; iter != end; iter += Packet::WORD_SIZE) {
+
+			// Check if the word is idle.
+			if(
+				Packet::IDLE_WORD.empty() || // If so, there is no idle word
+				!std::equal(
+					iter,
+					iter + Packet::WORD_SIZE,
+					Packet::IDLE_WORD.cbegin()
+				)
+			) {
+
+				// If it isn't, keep it
+				if(out != iter) {
+
+					std::copy(iter, iter + Packet::WORD_SIZE, out);
+
+				}
+
+				out += Packet::WORD_SIZE;
+
+			}
+
+		}
+
+		return out;
+
+	}
+
+}
+
 PacketProcessor::PacketProcessor()
-	: lastPacket(nullptr) {}
+	: lastPacket(nullptr), indexing(false) {}
 
 DataBlob PacketProcessor::blobify(const vector<Packet> &packets) {
 
 	DataBlob blob;
 
+	blobify(packets, blob);
+
+	return blob;
+
+}
+
+void PacketProcessor::blobify(
+	const vector<Packet> &packets, 
+	DataBlob &blob,
+	const CaptureStats &stats
+) {
+
+	std::chrono::steady_clock::time_point start 
+		= std::chrono::steady_clock::now();
+
+	// Add up the data size first so the blob's buffer can be prepared
+	// with enough room for all of it
+	size_t dataSize = unfinishedWords.size();
+	for(const Packet &packet : packets) {
+
+		dataSize += packet.size();
+
+	}
+
+	pool.acquire(blob, dataSize);
+
 	// Record the number of packets
-	blob.packets = packets.size();
+	blob.contents->packets = packets.size();
 
 	unpack(packets, blob);
-	getWarnings(packets, blob);
 	removeIdleWords(blob);
+	getWarnings(packets, blob);
+	index(packets, blob);
+	describe(packets, blob);
 
-	return blob;
+	BlobMetadata &metadata = blob.contents->metadata;
+
+	metadata.framesRejected = stats.framesRejected;
+	metadata.kernelDrops    = stats.kernelDrops;
+
+	metadata.processingTime = std::chrono::duration_cast<
+		std::chrono::nanoseconds
+	>(std::chrono::steady_clock::now() - start);
 
 }
 
@@ -31,48 +110,71 @@ void PacketProcessor::reset() {
 
 }
 
+void PacketProcessor::setPacketIndexing(bool enabled) {
+
+	indexing = enabled;
+
+}
+
+bool PacketProcessor::packetIndexing() const {
+
+	return indexing;
+
+}
+
+void PacketProcessor::setBlobPoolSize(size_t buffers) {
+
+	pool.setMaxBuffers(buffers);
+
+}
+
+size_t PacketProcessor::blobPoolSize() const {
+
+	return pool.maxSize();
+
+}
+
 void PacketProcessor::unpack(
 	const vector<Packet> &packets, 
 	DataBlob &blob
 ) {
 
+	vector<uint8_t> &dataBuffer = blob.contents->dataBuffer;
+
 	// Put any unfinished words at the start of dataBuffer, and clear
 	// unfinishedWords at the same time.
-	std::swap(blob.dataBuffer, unfinishedWords);
+	// NOTE: We copy rather than swap so that both buffers keep their
+	//       capacity. dataBuffer comes from the pool and is already big
+	//       enough for everything we're about to insert.
+	dataBuffer.assign(unfinishedWords.cbegin(), unfinishedWords.cend());
+	unfinishedWords.clear();
 
-	// This likely won't hold everything, but it will eliminate some extraneous
-	// reallocations.
-	// OPTIMIZATION -- It might be faster to accumulate packet sizes and
-	//                 reserve the resulting size.
-	blob.dataBuffer.reserve(packets.size() * Packet::WORD_SIZE);
+	packetEnds.clear();
 
-	// Unpack packets into dataBuffer
+	// Unpack packets into dataBuffer, remembering where each one ends
 	for(const Packet &packet : packets) {
 
-		// OPTIMIZATION -- We could resize and memcpy into dataBuffer for
-		//                 faster insertion. Fastest would likely be to
-		//                 run through packets to get the total data size,
-		//                 resize data to that size, and then memcpy in
-		//                 each packet.
-		blob.dataBuffer.insert(
-			blob.dataBuffer.end(),
+		dataBuffer.insert(
+			dataBuffer.end(),
 			packet.cbegin(),
 			packet.cend()
 		);
 
+		packetEnds.push_back(dataBuffer.size());
+
 	}
 
 	// Add any trailing unfinished word to unfinishedWords
 	unfinishedWords.insert(
 		unfinishedWords.end(),
-		blob.dataBuffer.cend() - (blob.dataBuffer.size() % Packet::WORD_SIZE),
-		blob.dataBuffer.cend()
+		dataBuffer.cend() - (dataBuffer.size() % Packet::WORD_SIZE),
+		dataBuffer.cend()
 	);
 
 	// And erase it from dataBuffer
-	blob.dataBuffer.erase(
-		blob.dataBuffer.cend() - (blob.dataBuffer.size() % Packet::WORD_SIZE),
-		blob.dataBuffer.cend()
+	dataBuffer.erase(
+		dataBuffer.cend() - (dataBuffer.size() % Packet::WORD_SIZE),
+		dataBuffer.cend()
 	);
 
 }
@@ -82,11 +184,17 @@ void PacketProcessor::getWarnings(
 	DataBlob &blob
 ) {
 
+	vector<std::string> &warningsBuffer = blob.contents->warningsBuffer;
+
+	vector<PacketGap> &gapList = blob.contents->gapList;
+
 	// Start with the last packet we checked
 	const Packet *prevPacket = lastPacket.get();
 
 	// Check all the new packets sequentially
-	for(const Packet &packet : packets) {
+	for(size_t i = 0; i < packets.size(); ++i) {
+
+		const Packet &packet = packets[i];
 
 		if(prevPacket) {
 
@@ -94,7 +202,7 @@ void PacketProcessor::getWarnings(
 
 			if(gap != 0) {
 
-				blob.warningsBuffer.push_back(
+				warningsBuffer.push_back(
 					std::to_string(gap)
 						+ " packets lost! Packet = "
 						+ std::to_string(packet.getPacketNumber())
@@ -102,6 +210,14 @@ void PacketProcessor::getWarnings(
 						+ std::to_string(prevPacket->getPacketNumber())
 				);
 
+				PacketGap record;
+				record.previousSequence = prevPacket->getPacketNumber();
+				record.nextSequence     = packet.getPacketNumber();
+				record.missing          = gap;
+				record.wordOffset       = packetOffsets[i];
+
+				gapList.push_back(record);
+
 			}
 
 		}
@@ -113,7 +229,16 @@ void PacketProcessor::getWarnings(
 	// Store the last packet for next time
 	if(prevPacket) {
 
-		lastPacket = std::unique_ptr<Packet>(new Packet(*prevPacket));
+		// Reuse the stored packet if we have one, to avoid reallocating it
+		if(lastPacket) {
+
+			*lastPacket = *prevPacket;
+
+		} else {
+
+			lastPacket = std::unique_ptr<Packet>(new Packet(*prevPacket));
+
+		}
 		
 	}
 
@@ -124,42 +249,99 @@ void PacketProcessor::removeIdleWords(DataBlob &blob) {
 	// Now dataBuffer should start at the beginning of a word, so we can use 
 	// that invariant to scan it for idle words.
 
-	// Make a temporary vector and swap the dataBuffer into it
-	std::vector<uint8_t> data;
-	std::swap(data, blob.dataBuffer);
+	vector<uint8_t> &dataBuffer = blob.contents->dataBuffer;
 
-	// The dataBuffer is empty now, so let's reserve what we need
-	blob.dataBuffer.reserve(data.size());
+	// Compact the buffer in place, copying each non-idle word back to the
+	// write position. The write position never passes the read position,
+	// so no word is overwritten before it is read, and nothing needs to be
+	// allocated.
+	vector<uint8_t>::iterator write = dataBuffer.begin();
 
-	// Scan through each word
 	// NOTE: The unpacking logic guarantees that blob holds exactly an integer
 	//       number of words, so we can trust that we won't go out of bounds.
-	for(
-		auto iter = data.cbegin();
-		iter != data.cend();
-		iter += Packet::WORD_SIZE
-	) {
+	size_t totalWords = dataBuffer.size() / Packet::WORD_SIZE;
 
-		// Check if the word is idle.
-		if(
-			Packet::IDLE_WORD.empty() || // If so, there is no idle word
-			!std::equal(
-				iter,
-				iter + Packet::WORD_SIZE,
-				Packet::IDLE_WORD.cbegin()
-			)
-		) {
-
-			// If it isn't add it back to the dataBuffer
-			// OPTIMIZATION -- Again, memcpy would be a bit faster, though less
-			//                 so since we're only copying one word at a time.
-			blob.dataBuffer.insert(
-				blob.dataBuffer.end(),
-				iter,
-				iter + Packet::WORD_SIZE
-			);
+	// Compact one packet at a time so we know where each packet's words end
+	// up. A word belongs to the packet its last byte came from.
+	packetOffsets.clear();
 
-		}
+	size_t firstWord = 0;
+	for(size_t packetEnd : packetEnds) {
+
+		size_t endWord = std::min(packetEnd / Packet::WORD_SIZE, totalWords);
+
+		packetOffsets.push_back(
+			(write - dataBuffer.begin()) / Packet::WORD_SIZE
+		);
+
+		write = keepDataWords(
+			dataBuffer.cbegin() + firstWord * Packet::WORD_SIZE,
+			dataBuffer.cbegin() + endWord * Packet::WORD_SIZE,
+			write
+		);
+
+		firstWord = endWord;
+
+	}
+
+	write = keepDataWords(
+		dataBuffer.cbegin() + firstWord * Packet::WORD_SIZE,
+		dataBuffer.cend(),
+		write
+	);
+
+	packetOffsets.push_back((write - dataBuffer.begin()) / Packet::WORD_SIZE);
+
+	blob.contents->metadata.idleWordsRemoved 
+		= (dataBuffer.end() - write) / Packet::WORD_SIZE;
+
+	dataBuffer.erase(write, dataBuffer.end());
+
+}
+
+void PacketProcessor::index(
+	const vector<Packet> &packets, 
+	DataBlob &blob
+) {
+
+	if(!indexing) return;
+
+	vector<PacketIndexEntry> &packetList = blob.contents->packetList;
+
+	packetList.reserve(packets.size());
+
+	for(size_t i = 0; i < packets.size(); ++i) {
+
+		PacketIndexEntry entry;
+		entry.sequence   = packets[i].getPacketNumber();
+		entry.wordOffset = packetOffsets[i];
+		entry.wordCount  = static_cast<uint32_t>(
+			packetOffsets[i + 1] - packetOffsets[i]
+		);
+
+		packetList.push_back(entry);
+
+	}
+
+}
+
+void PacketProcessor::describe(
+	const vector<Packet> &packets, 
+	DataBlob &blob
+) {
+
+	BlobMetadata &metadata = blob.contents->metadata;
+
+	if(packets.empty()) return;
+
+	metadata.firstArrival  = packets.front().getTimestamp();
+	metadata.lastArrival   = packets.back().getTimestamp();
+	metadata.firstSequence = packets.front().getPacketNumber();
+	metadata.lastSequence  = packets.back().getPacketNumber();
+
+	for(const Packet &packet : packets) {
+
+		metadata.rawBytes += packet.getRawSize();
 
 	}
 
@@ -12,12 +12,31 @@
 #include <DAQBlob.h>
 
 #include "Packet.h"
+#include "BlobPool.h"
 
 #include <vector>
 #include <memory>
 
 namespace DAQCap {
 
+	/**
+	 * @brief Counters collected by the capture device during a fetch,
+	 * which are recorded in the blob's metadata.
+	 */
+	struct CaptureStats {
+
+		/**
+		 * @brief Frames that could not be parsed as packets.
+		 */
+		uint64_t framesRejected = 0;
+
+		/**
+		 * @brief Frames dropped by the kernel or network interface.
+		 */
+		uint64_t kernelDrops = 0;
+
+	};
+
 	// TODO: Bundle this class in an existing .h?
 	// TODO: Reflect semantically that it's more of a packet 'accumulator'
 
@@ -39,11 +58,57 @@ namespace DAQCap {
 		 */
 		DataBlob blobify(const std::vector<Packet> &packet);
 
+		/**
+		 * @brief Unpacks a vector of packets into an existing blob, removing
+		 * idle words and conducting missing packet checks.
+		 * 
+		 * The blob's previous contents are released. Their buffer is reused
+		 * if blob was its only owner, and otherwise a buffer is taken from
+		 * the processor's pool.
+		 * 
+		 * @param[in] packets The packets to blobify.
+		 * @param[in,out] blob The blob to store the processed data in.
+		 * @param[in] stats Capture counters to record in the blob's
+		 * metadata.
+		 */
+		void blobify(
+			const std::vector<Packet> &packets, 
+			DataBlob &blob,
+			const CaptureStats &stats = CaptureStats()
+		);
+
 		/**
 		 * @brief Resets the packet processor.
 		 */
 		void reset();
 
+		/**
+		 * @brief Enables or disables recording a packet index in each blob.
+		 * Disabled by default.
+		 * 
+		 * @see DataBlob::packetIndex()
+		 */
+		void setPacketIndexing(bool enabled);
+
+		/**
+		 * @brief Checks whether blobs are given a packet index.
+		 */
+		bool packetIndexing() const;
+
+		/**
+		 * @brief Sets the maximum number of blob buffers the processor
+		 * recycles.
+		 * 
+		 * @see BlobPool::setMaxBuffers()
+		 */
+		void setBlobPoolSize(size_t buffers);
+
+		/**
+		 * @brief Gets the maximum number of blob buffers the processor
+		 * recycles.
+		 */
+		size_t blobPoolSize() const;
+
 	private:
 
 		// The last packet processed
@@ -52,6 +117,19 @@ namespace DAQCap {
 		// Buffer for unfinished data words at the end of a packet
 		std::vector<uint8_t> unfinishedWords;
 
+		// Recycles the buffers of blobs we've handed out
+		BlobPool pool;
+
+		// Whether to record a packet index in each blob
+		bool indexing;
+
+		// Where each packet's data ends in the unpacked data buffer, in bytes
+		std::vector<size_t> packetEnds;
+
+		// Where each packet's data starts once idle words are removed, in
+		// words, followed by the total number of words
+		std::vector<size_t> packetOffsets;
+
 		/**
 		 * @brief Unpacks a vector of packets into a data blob.
 		 * 
@@ -65,7 +143,9 @@ namespace DAQCap {
 
 		/**
 		 * @brief Scans a vector of packets for warnings and stores the
-		 * warnings in a data blob.
+		 * warnings and packet gaps in a data blob.
+		 * 
+		 * REQUIRES: Idle words have already been removed from the blob.
 		 * 
 		 * @param[in] packets The packets to scan for warnings.
 		 * @param[out] blob The blob to store the warnings in.
@@ -82,6 +162,29 @@ namespace DAQCap {
 		 */
 		void removeIdleWords(DataBlob &blob);
 
+		/**
+		 * @brief Records where each packet's data is in a data blob.
+		 * 
+		 * @param[in] packets The packets the blob was made from.
+		 * @param[out] blob The blob to store the packet index in.
+		 */
+		void index(
+			const std::vector<Packet> &packets, 
+			DataBlob &blob
+		);
+
+		/**
+		 * @brief Records statistics about a vector of packets in a data
+		 * blob's metadata.
+		 * 
+		 * @param[in] packets The packets the blob was made from.
+		 * @param[out] blob The blob to store the statistics in.
+		 */
+		void describe(
+			const std::vector<Packet> &packets, 
+			DataBlob &blob
+		);
+
 	};
 
 }
\ No newline at end of file
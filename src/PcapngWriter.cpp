@@ -0,0 +1,277 @@
+#include <PcapngWriter.h>
+
+#include "ByteOrder.h"
+
+#include <stdexcept>
+#include <algorithm>
+
+using std::vector;
+using std::string;
+using std::unique_ptr;
+
+using namespace DAQCap;
+
+/*
+ * Block layouts follow the pcapng specification. Every block is
+ *   u32 block type
+ *   u32 block length, including this header and the trailing length
+ *   body, padded to 4 bytes
+ *   u32 block length
+ * and options are
+ *   u16 code
+ *   u16 length of the value
+ *   value, padded to 4 bytes
+ * ending with opt_endofopt.
+ *
+ * Files are written little-endian, which the byte-order magic in the
+ * section header tells readers.
+ */
+
+const size_t PcapngWriter::DEFAULT_BUFFER_SIZE = 4 << 20;
+
+namespace {
+
+	const uint32_t SECTION_HEADER_BLOCK    = 0x0A0D0D0A;
+	const uint32_t INTERFACE_BLOCK         = 0x00000001;
+	const uint32_t ENHANCED_PACKET_BLOCK   = 0x00000006;
+
+	const uint32_t BYTE_ORDER_MAGIC        = 0x1A2B3C4D;
+
+	const uint16_t OPT_ENDOFOPT            = 0;
+	const uint16_t SHB_USERAPPL            = 4;
+	const uint16_t IF_NAME                 = 2;
+	const uint16_t IF_DESCRIPTION          = 3;
+	const uint16_t IF_TSRESOL              = 9;
+
+	// Timestamps are in units of 10^-9 seconds
+	const uint8_t NANOSECOND_RESOLUTION    = 9;
+
+	// Block type, block length and trailing block length
+	const size_t BLOCK_OVERHEAD            = 12;
+
+	// Interface ID, timestamp, captured length and original length
+	const size_t PACKET_FIELDS_SIZE        = 20;
+
+	size_t padded(size_t size) {
+
+		return (size + 3) & ~size_t(3);
+
+	}
+
+	void putPadding(vector<uint8_t> &out) {
+
+		while(out.size() % 4 != 0) out.push_back(0);
+
+	}
+
+	void putOption(
+		vector<uint8_t> &out,
+		uint16_t code,
+		const uint8_t *value,
+		size_t size
+	) {
+
+		putU16(out, code);
+		putU16(out, static_cast<uint16_t>(size));
+
+		out.insert(out.end(), value, value + size);
+		putPadding(out);
+
+	}
+
+	void putOption(vector<uint8_t> &out, uint16_t code, const string &value) {
+
+		if(value.empty()) return;
+
+		putOption(
+			out,
+			code,
+			reinterpret_cast<const uint8_t*>(value.data()),
+			std::min<size_t>(value.size(), 0xFFFF)
+		);
+
+	}
+
+	// Starts a block. Returns the position of its length field.
+	size_t beginBlock(vector<uint8_t> &out, uint32_t type) {
+
+		putU32(out, type);
+		putU32(out, 0);
+
+		return out.size() - 4;
+
+	}
+
+	// Ends a block started at the given length field
+	void endBlock(vector<uint8_t> &out, size_t lengthField) {
+
+		putPadding(out);
+
+		uint32_t length = out.size() - lengthField + 4 + 4;
+
+		storeLittleEndian(&out[lengthField], length, 4);
+		putU32(out, length);
+
+	}
+
+}
+
+PcapngWriter::PcapngWriter(
+	unique_ptr<FileSink> sink,
+	const PcapngInterface &link,
+	size_t bufferSize
+) : sink(std::move(sink)), bufferSize(bufferSize), frames(0) {
+
+	if(!this->sink) {
+
+		throw std::invalid_argument("PcapngWriter needs a sink.");
+
+	}
+
+	buffer.reserve(bufferSize);
+
+	size_t block = beginBlock(buffer, SECTION_HEADER_BLOCK);
+
+	putU32(buffer, BYTE_ORDER_MAGIC);
+	putU16(buffer, 1); // Major version
+	putU16(buffer, 0); // Minor version
+	putU64(buffer, ~uint64_t(0)); // Section length not given
+
+	putOption(buffer, SHB_USERAPPL, "DAQCap");
+	putU32(buffer, OPT_ENDOFOPT);
+
+	endBlock(buffer, block);
+
+	block = beginBlock(buffer, INTERFACE_BLOCK);
+
+	putU16(buffer, link.linkType);
+	putU16(buffer, 0); // Reserved
+	putU32(buffer, link.snapLength);
+
+	putOption(buffer, IF_NAME, link.name);
+	putOption(buffer, IF_DESCRIPTION, link.description);
+	putOption(buffer, IF_TSRESOL, &NANOSECOND_RESOLUTION, 1);
+	putU32(buffer, OPT_ENDOFOPT);
+
+	endBlock(buffer, block);
+
+}
+
+PcapngWriter::~PcapngWriter() {
+
+	try {
+
+		close();
+
+	} catch(...) {}
+
+}
+
+void PcapngWriter::writeFrame(
+	ByteView frame,
+	uint32_t originalLength,
+	Timestamp time
+) {
+
+	if(!sink) {
+
+		throw std::runtime_error("Cannot write to a closed PcapngWriter.");
+
+	}
+
+	size_t blockSize = BLOCK_OVERHEAD
+		+ PACKET_FIELDS_SIZE
+		+ padded(frame.size());
+
+	// OPTIMIZATION -- Drain before the buffer would outgrow its reserved
+	//                 size, so appending doesn't reallocate. Only a frame
+	//                 too big for the buffer makes it grow, and that frame
+	//                 is written out on its own.
+	if(buffer.size() + blockSize > bufferSize) drain();
+
+	uint64_t nanoseconds = std::chrono::duration_cast<
+		std::chrono::nanoseconds
+	>(time.time_since_epoch()).count();
+
+	size_t block = beginBlock(buffer, ENHANCED_PACKET_BLOCK);
+
+	putU32(buffer, 0); // Interface ID
+	putU32(buffer, static_cast<uint32_t>(nanoseconds >> 32));
+	putU32(buffer, static_cast<uint32_t>(nanoseconds));
+	putU32(buffer, frame.size());
+	putU32(buffer, originalLength);
+
+	buffer.insert(buffer.end(), frame.begin(), frame.end());
+
+	endBlock(buffer, block);
+
+	++frames;
+
+	if(buffer.size() > bufferSize) drain();
+
+}
+
+void PcapngWriter::flush() {
+
+	if(!sink) return;
+
+	drain();
+
+	sink->flush();
+
+}
+
+void PcapngWriter::close() {
+
+	if(!sink) return;
+
+	unique_ptr<FileSink> closing = std::move(sink);
+
+	// Close the sink even if the last frames can't be written
+	std::exception_ptr failure;
+
+	try {
+
+		if(!buffer.empty()) {
+
+			closing->write(ByteView(buffer.data(), buffer.size()));
+
+		}
+
+	} catch(...) {
+
+		failure = std::current_exception();
+
+	}
+
+	buffer.clear();
+
+	try {
+
+		closing->close();
+
+	} catch(...) {
+
+		if(!failure) failure = std::current_exception();
+
+	}
+
+	if(failure) std::rethrow_exception(failure);
+
+}
+
+uint64_t PcapngWriter::framesWritten() const {
+
+	return frames;
+
+}
+
+void PcapngWriter::drain() {
+
+	if(buffer.empty()) return;
+
+	sink->write(ByteView(buffer.data(), buffer.size()));
+
+	buffer.clear();
+
+}
@@ -0,0 +1,875 @@
+#include <Replay.h>
+#include <ChunkedFile.h>
+
+#include "Packet.h"
+#include "PacketProcessor.h"
+#include "ByteOrder.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <thread>
+#include <cstring>
+#include <cerrno>
+
+#include <unistd.h>
+#include <fcntl.h>
+
+using std::vector;
+using std::string;
+using std::unique_ptr;
+
+using namespace DAQCap;
+
+namespace {
+
+	/*
+	 * Frames made from run files follow the miniDAQ packet format:
+	 *   6 bytes destination address (broadcast)
+	 *   6 bytes source address, matching the capture filter
+	 *   2 bytes length of the rest of the frame, big-endian
+	 *   data words
+	 *   2 bytes zero
+	 *   2 bytes packet number, big-endian
+	 */
+	const size_t PRELOAD_BYTES  = 14;
+	const size_t POSTLOAD_BYTES = 4;
+
+	const uint8_t MINIDAQ_SOURCE[6] = {0xFF, 0xFF, 0xFF, 0xC7, 0x05, 0x01};
+
+	// Frames longer than this can't give their length in the header
+	const size_t MAX_FRAME_BYTES = 0xFFFF;
+
+	// Anything larger in a pcap file is certainly corruption
+	const uint32_t MAX_RECORD_BYTES = 256 << 20;
+
+	const uint32_t PCAP_MAGIC_MICROSECONDS = 0xA1B2C3D4;
+	const uint32_t PCAP_MAGIC_NANOSECONDS  = 0xA1B23C4D;
+
+	const uint32_t PCAPNG_SECTION_HEADER   = 0x0A0D0D0A;
+	const uint32_t PCAPNG_INTERFACE        = 0x00000001;
+	const uint32_t PCAPNG_PACKET           = 0x00000002;
+	const uint32_t PCAPNG_SIMPLE_PACKET    = 0x00000003;
+	const uint32_t PCAPNG_ENHANCED_PACKET  = 0x00000006;
+	const uint32_t PCAPNG_BYTE_ORDER_MAGIC = 0x1A2B3C4D;
+
+	const uint16_t PCAPNG_IF_TSRESOL       = 9;
+
+	// pcapng timestamps count microseconds unless an interface says
+	// otherwise
+	const uint64_t DEFAULT_TICKS_PER_SECOND = 1000000;
+
+	uint32_t byteSwap(uint32_t value) {
+
+		return (value >> 24)
+			| ((value >> 8) & 0xFF00)
+			| ((value << 8) & 0xFF0000)
+			| (value << 24);
+
+	}
+
+	// Reads an integer written in either byte order
+	uint64_t load(const uint8_t *data, size_t size, bool bigEndian) {
+
+		uint64_t value = 0;
+
+		for(size_t byte = 0; byte < size; ++byte) {
+
+			size_t index = bigEndian ? byte : size - 1 - byte;
+
+			value = (value << 8) | data[index];
+
+		}
+
+		return value;
+
+	}
+
+	Timestamp makeTimestamp(uint64_t ticks, uint64_t ticksPerSecond) {
+
+		uint64_t seconds = ticks / ticksPerSecond;
+		uint64_t fraction = ticks % ticksPerSecond;
+
+		std::chrono::nanoseconds time = std::chrono::seconds(seconds)
+			+ std::chrono::nanoseconds(
+				static_cast<uint64_t>(double(fraction) * 1e9 / ticksPerSecond)
+			);
+
+		return Timestamp(
+			std::chrono::duration_cast<Timestamp::duration>(time)
+		);
+
+	}
+
+	// Builds a miniDAQ frame around some data words
+	void makeFrame(
+		const uint8_t *data,
+		size_t size,
+		uint16_t packetNumber,
+		Frame &frame
+	) {
+
+		vector<uint8_t> &bytes = frame.bytes;
+
+		bytes.resize(PRELOAD_BYTES + size + POSTLOAD_BYTES);
+
+		std::memset(bytes.data(), 0xFF, 6);
+		std::memcpy(bytes.data() + 6, MINIDAQ_SOURCE, 6);
+
+		size_t length = size + POSTLOAD_BYTES;
+		bytes[12] = static_cast<uint8_t>(length >> 8);
+		bytes[13] = static_cast<uint8_t>(length);
+
+		std::memcpy(bytes.data() + PRELOAD_BYTES, data, size);
+
+		uint8_t *postload = bytes.data() + PRELOAD_BYTES + size;
+		postload[0] = 0;
+		postload[1] = 0;
+		postload[2] = static_cast<uint8_t>(packetNumber >> 8);
+		postload[3] = static_cast<uint8_t>(packetNumber);
+
+		frame.originalLength = bytes.size();
+
+	}
+
+	// Reads a file sequentially through a large buffer
+	class BufferedFile final {
+
+	public:
+
+		static const size_t BUFFER_SIZE = 1 << 20;
+
+		explicit BufferedFile(const string &path)
+			: path(path), buffer(BUFFER_SIZE), start(0), end(0) {
+
+			fd = ::open(path.data(), O_RDONLY);
+
+			if(fd < 0) {
+
+				throw std::runtime_error(
+					"Could not open " + path + ": " + std::strerror(errno)
+				);
+
+			}
+
+		}
+
+		~BufferedFile() {
+
+			::close(fd);
+
+		}
+
+		BufferedFile(const BufferedFile &other) = delete;
+		BufferedFile &operator=(const BufferedFile &other) = delete;
+
+		// Reads up to size bytes. Returns fewer only at the end of the file.
+		size_t read(uint8_t *out, size_t size) {
+
+			size_t copied = 0;
+
+			while(copied < size) {
+
+				if(start == end && !fill()) break;
+
+				size_t count = std::min(size - copied, end - start);
+
+				std::memcpy(out + copied, buffer.data() + start, count);
+
+				start += count;
+				copied += count;
+
+			}
+
+			return copied;
+
+		}
+
+		// Reads exactly size bytes, or throws if the file ends first
+		void readExactly(uint8_t *out, size_t size) {
+
+			if(read(out, size) != size) {
+
+				throw std::runtime_error(path + " is truncated.");
+
+			}
+
+		}
+
+		const string &name() const {
+
+			return path;
+
+		}
+
+	private:
+
+		string path;
+		int fd;
+
+		vector<uint8_t> buffer;
+		size_t start;
+		size_t end;
+
+		bool fill() {
+
+			while(true) {
+
+				ssize_t count = ::read(fd, buffer.data(), buffer.size());
+
+				if(count < 0 && errno == EINTR) continue;
+
+				if(count < 0) {
+
+					throw std::runtime_error(
+						"Could not read " + path + ": " + std::strerror(errno)
+					);
+
+				}
+
+				start = 0;
+				end = count;
+
+				return count > 0;
+
+			}
+
+		}
+
+	};
+
+	///////////////////////////////////////////////////////////////////////////
+	// .dat files
+	///////////////////////////////////////////////////////////////////////////
+
+	class RunFileSource final : public FrameSource {
+
+	public:
+
+		RunFileSource(const string &path, size_t frameWords)
+			: file(path),
+			  words(frameWords * Packet::WORD_SIZE),
+			  packetNumber(0) {}
+
+		bool next(Frame &frame) override {
+
+			size_t size = file.read(words.data(), words.size());
+
+			// Drop a partial word at the end of the file
+			size -= size % Packet::WORD_SIZE;
+
+			if(size == 0) return false;
+
+			makeFrame(words.data(), size, packetNumber++, frame);
+			frame.time = Timestamp();
+
+			return true;
+
+		}
+
+		bool timed() const override {
+
+			return false;
+
+		}
+
+	private:
+
+		BufferedFile file;
+
+		vector<uint8_t> words;
+
+		uint16_t packetNumber;
+
+	};
+
+	///////////////////////////////////////////////////////////////////////////
+	// Chunked files
+	///////////////////////////////////////////////////////////////////////////
+
+	class ChunkedFrameSource final : public FrameSource {
+
+	public:
+
+		ChunkedFrameSource(const string &path, size_t frameWords)
+			: reader(path),
+			  frameBytes(frameWords * Packet::WORD_SIZE),
+			  nextChunk(0),
+			  offset(0),
+			  frameInChunk(0),
+			  framesInChunk(0),
+			  packetNumber(0) {}
+
+		bool next(Frame &frame) override {
+
+			while(offset == data.size()) {
+
+				if(nextChunk == reader.chunkCount()) return false;
+
+				startChunk(nextChunk++);
+
+			}
+
+			size_t size = std::min(frameBytes, data.size() - offset);
+
+			makeFrame(data.data() + offset, size, packetNumber++, frame);
+
+			// Chunks only record when their first and last packets arrived,
+			// so spread the frames in between evenly
+			int64_t steps = std::max<int64_t>(framesInChunk - 1, 1);
+			frame.time = firstArrival
+				+ (lastArrival - firstArrival) * int64_t(frameInChunk) / steps;
+
+			offset += size;
+			++frameInChunk;
+
+			return true;
+
+		}
+
+		bool timed() const override {
+
+			return true;
+
+		}
+
+	private:
+
+		ChunkedFileReader reader;
+
+		size_t frameBytes;
+		size_t nextChunk;
+
+		// The data of the chunk being read
+		vector<uint8_t> data;
+		size_t offset;
+
+		size_t frameInChunk;
+		size_t framesInChunk;
+
+		Timestamp firstArrival;
+		Timestamp lastArrival;
+
+		uint16_t packetNumber;
+
+		void startChunk(size_t index) {
+
+			const ChunkInfo &info = reader.chunk(index);
+
+			reader.readChunk(index, data);
+			data.resize(data.size() - data.size() % Packet::WORD_SIZE);
+
+			offset = 0;
+			frameInChunk = 0;
+			framesInChunk = (data.size() + frameBytes - 1) / frameBytes;
+
+			firstArrival = info.firstArrival;
+			lastArrival = info.lastArrival;
+
+			// Start from the number the first packet was captured with.
+			// Frames don't line up with the original packets, so numbers
+			// simply count up from there.
+			if(index == 0 && info.packetCount > 0) {
+
+				packetNumber = info.firstSequence;
+
+			}
+
+		}
+
+	};
+
+	///////////////////////////////////////////////////////////////////////////
+	// pcap and pcapng files
+	///////////////////////////////////////////////////////////////////////////
+
+	class PcapFrameSource final : public FrameSource {
+
+	public:
+
+		explicit PcapFrameSource(const string &path)
+			: file(path), pcapng(false), bigEndian(false), nanoseconds(false) {
+
+			uint8_t header[24];
+			file.readExactly(header, 4);
+
+			uint32_t magic = loadU32(header);
+
+			if(magic == PCAPNG_SECTION_HEADER) {
+
+				pcapng = true;
+
+				// The section header is read like any other block
+				pending.assign(header, header + 4);
+
+				return;
+
+			}
+
+			bigEndian = magic != PCAP_MAGIC_MICROSECONDS
+				&& magic != PCAP_MAGIC_NANOSECONDS;
+
+			if(bigEndian) magic = byteSwap(magic);
+
+			nanoseconds = magic == PCAP_MAGIC_NANOSECONDS;
+
+			file.readExactly(header + 4, sizeof(header) - 4);
+
+		}
+
+		bool next(Frame &frame) override {
+
+			return pcapng ? nextBlock(frame) : nextRecord(frame);
+
+		}
+
+		bool timed() const override {
+
+			return true;
+
+		}
+
+	private:
+
+		BufferedFile file;
+
+		bool pcapng;
+		bool bigEndian;
+		bool nanoseconds;
+
+		// Bytes of the next block that were read ahead
+		vector<uint8_t> pending;
+
+		// The timestamp resolution of each interface in the section
+		vector<uint64_t> ticksPerSecond;
+
+		vector<uint8_t> block;
+
+		Timestamp lastTime;
+
+		uint64_t field(const uint8_t *data, size_t size) const {
+
+			return load(data, size, bigEndian);
+
+		}
+
+		void corrupt() const {
+
+			throw std::runtime_error(file.name() + " is corrupt.");
+
+		}
+
+		// Reads a record from a classic pcap file
+		bool nextRecord(Frame &frame) {
+
+			uint8_t header[16];
+
+			size_t count = file.read(header, sizeof(header));
+
+			if(count == 0) return false;
+			if(count != sizeof(header)) corrupt();
+
+			uint64_t seconds = field(header, 4);
+			uint64_t fraction = field(header + 4, 4);
+			uint32_t captured = field(header + 8, 4);
+
+			if(captured > MAX_RECORD_BYTES) corrupt();
+
+			frame.bytes.resize(captured);
+			file.readExactly(frame.bytes.data(), captured);
+
+			frame.originalLength = field(header + 12, 4);
+			frame.time = makeTimestamp(
+				seconds * (nanoseconds ? 1000000000 : 1000000) + fraction,
+				nanoseconds ? 1000000000 : 1000000
+			);
+
+			return true;
+
+		}
+
+		// Reads the next whole block from a pcapng file into block.
+		// Returns false at the end of the file.
+		bool readBlock() {
+
+			// The type and length of the block, and the section header's
+			// byte-order magic, which comes before we know the byte order
+			uint8_t header[12];
+
+			std::copy(pending.begin(), pending.end(), header);
+
+			size_t count = pending.size()
+				+ file.read(header + pending.size(), 8 - pending.size());
+
+			pending.clear();
+
+			if(count == 0) return false;
+			if(count != 8) corrupt();
+
+			size_t headerSize = 8;
+
+			if(loadU32(header) == PCAPNG_SECTION_HEADER) {
+
+				file.readExactly(header + 8, 4);
+				headerSize = 12;
+
+				bigEndian = loadU32(header + 8) != PCAPNG_BYTE_ORDER_MAGIC;
+
+				if(bigEndian && byteSwap(loadU32(header + 8))
+					!= PCAPNG_BYTE_ORDER_MAGIC) {
+
+					corrupt();
+
+				}
+
+			}
+
+			uint32_t length = field(header + 4, 4);
+
+			if(length < 12 || length % 4 != 0 || length > MAX_RECORD_BYTES) {
+
+				corrupt();
+
+			}
+
+			block.resize(length);
+			std::copy(header, header + headerSize, block.begin());
+
+			file.readExactly(
+				block.data() + headerSize,
+				length - headerSize
+			);
+
+			return true;
+
+		}
+
+		// Reads blocks from a pcapng file until one holds a frame
+		bool nextBlock(Frame &frame) {
+
+			while(readBlock()) {
+
+				uint32_t type = field(block.data(), 4);
+
+				// The body, without the block type and lengths
+				const uint8_t *body = block.data() + 8;
+				size_t bodySize = block.size() - 12;
+
+				if(type == PCAPNG_SECTION_HEADER) {
+
+					ticksPerSecond.clear();
+
+				} else if(type == PCAPNG_INTERFACE) {
+
+					readInterface(body, bodySize);
+
+				} else if(type == PCAPNG_ENHANCED_PACKET) {
+
+					if(bodySize < 20) corrupt();
+
+					readPacket(
+						frame,
+						field(body, 4),
+						(field(body + 4, 4) << 32) | field(body + 8, 4),
+						field(body + 12, 4),
+						field(body + 16, 4),
+						body + 20,
+						bodySize - 20
+					);
+
+					return true;
+
+				} else if(type == PCAPNG_PACKET) {
+
+					if(bodySize < 20) corrupt();
+
+					readPacket(
+						frame,
+						field(body, 2),
+						(field(body + 4, 4) << 32) | field(body + 8, 4),
+						field(body + 12, 4),
+						field(body + 16, 4),
+						body + 20,
+						bodySize - 20
+					);
+
+					return true;
+
+				} else if(type == PCAPNG_SIMPLE_PACKET) {
+
+					if(bodySize < 4) corrupt();
+
+					uint32_t original = field(body, 4);
+
+					frame.bytes.assign(
+						body + 4,
+						body + 4 + std::min<size_t>(original, bodySize - 4)
+					);
+					frame.originalLength = original;
+
+					// Simple packets have no timestamp
+					frame.time = lastTime;
+
+					return true;
+
+				}
+
+			}
+
+			return false;
+
+		}
+
+		void readInterface(const uint8_t *body, size_t size) {
+
+			uint64_t ticks = DEFAULT_TICKS_PER_SECOND;
+
+			// Options follow the link type, reserved field and snap length
+			size_t offset = 8;
+			while(offset + 4 <= size) {
+
+				uint16_t code = field(body + offset, 2);
+				uint16_t length = field(body + offset + 2, 2);
+
+				if(code == 0 || offset + 4 + length > size) break;
+
+				if(code == PCAPNG_IF_TSRESOL && length >= 1) {
+
+					uint8_t resolution = body[offset + 4];
+					unsigned exponent = resolution & 0x7F;
+
+					// The high bit chooses a power of 2 instead of 10
+					if(resolution & 0x80) {
+
+						if(exponent > 63) corrupt();
+
+						ticks = uint64_t(1) << exponent;
+
+					} else {
+
+						if(exponent > 19) corrupt();
+
+						ticks = 1;
+						for(unsigned i = 0; i < exponent; ++i) ticks *= 10;
+
+					}
+
+				}
+
+				offset += 4 + ((length + 3) & ~3);
+
+			}
+
+			ticksPerSecond.push_back(ticks);
+
+		}
+
+		void readPacket(
+			Frame &frame,
+			uint32_t interfaceId,
+			uint64_t ticks,
+			uint32_t captured,
+			uint32_t original,
+			const uint8_t *data,
+			size_t available
+		) {
+
+			if(interfaceId >= ticksPerSecond.size() || captured > available) {
+
+				corrupt();
+
+			}
+
+			frame.bytes.assign(data, data + captured);
+			frame.originalLength = original;
+			frame.time = makeTimestamp(ticks, ticksPerSecond[interfaceId]);
+
+			lastTime = frame.time;
+
+		}
+
+	};
+
+	bool isPcapFile(const string &path) {
+
+		int fd = ::open(path.data(), O_RDONLY);
+
+		if(fd < 0) return false;
+
+		uint8_t magic[4];
+		bool complete = ::read(fd, magic, sizeof(magic)) == sizeof(magic);
+
+		::close(fd);
+
+		if(!complete) return false;
+
+		uint32_t value = loadU32(magic);
+
+		for(uint32_t known : {PCAP_MAGIC_MICROSECONDS, PCAP_MAGIC_NANOSECONDS}) {
+
+			if(value == known || byteSwap(value) == known) return true;
+
+		}
+
+		return value == PCAPNG_SECTION_HEADER;
+
+	}
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// FrameSource
+///////////////////////////////////////////////////////////////////////////////
+
+unique_ptr<FrameSource> FrameSource::open(
+	const string &path,
+	const FrameSourceOptions &options
+) {
+
+	size_t maxWords = (MAX_FRAME_BYTES - PRELOAD_BYTES - POSTLOAD_BYTES)
+		/ Packet::WORD_SIZE;
+
+	if(options.frameWords == 0 || options.frameWords > maxWords) {
+
+		throw std::invalid_argument(
+			"Frames must hold between 1 and " + std::to_string(maxWords)
+				+ " words."
+		);
+
+	}
+
+	if(isPcapFile(path)) {
+
+		return unique_ptr<FrameSource>(new PcapFrameSource(path));
+
+	}
+
+	if(ChunkedFileReader::isChunkedFile(path)) {
+
+		return unique_ptr<FrameSource>(
+			new ChunkedFrameSource(path, options.frameWords)
+		);
+
+	}
+
+	return unique_ptr<FrameSource>(
+		new RunFileSource(path, options.frameWords)
+	);
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// FramePacer
+///////////////////////////////////////////////////////////////////////////////
+
+FramePacer::FramePacer(double speed, double bytesPerSecond)
+	: speed(speed), bytesPerSecond(bytesPerSecond), started(false), bytes(0) {
+
+	if(speed < 0 || bytesPerSecond < 0) {
+
+		throw std::invalid_argument("Replay rates can't be negative.");
+
+	}
+
+}
+
+void FramePacer::wait(const Frame &frame) {
+
+	if(!started) {
+
+		started = true;
+
+		start = std::chrono::steady_clock::now();
+		firstFrame = frame.time;
+		bytes = frame.bytes.size();
+
+		return;
+
+	}
+
+	std::chrono::duration<double> due;
+
+	if(bytesPerSecond > 0) {
+
+		// Each frame is due once the frames before it have had their time
+		due = std::chrono::duration<double>(bytes / bytesPerSecond);
+
+		bytes += frame.bytes.size();
+
+	} else if(speed > 0) {
+
+		due = std::chrono::duration<double>(frame.time - firstFrame) / speed;
+
+	} else {
+
+		return;
+
+	}
+
+	std::this_thread::sleep_until(
+		start + std::chrono::duration_cast<
+			std::chrono::steady_clock::duration
+		>(due)
+	);
+
+}
+
+void FramePacer::reset() {
+
+	started = false;
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// FrameBlobBuilder
+///////////////////////////////////////////////////////////////////////////////
+
+struct FrameBlobBuilder::Batch {
+
+	PacketProcessor processor;
+
+	vector<Packet> packets;
+	CaptureStats stats;
+
+	size_t frames = 0;
+
+};
+
+FrameBlobBuilder::FrameBlobBuilder() : batch(new Batch) {}
+
+FrameBlobBuilder::~FrameBlobBuilder() = default;
+
+void FrameBlobBuilder::add(const Frame &frame) {
+
+	++batch->frames;
+
+	try {
+
+		batch->packets.emplace_back(
+			frame.bytes.data(),
+			frame.bytes.size(),
+			frame.time
+		);
+
+	} catch(const std::invalid_argument&) {
+
+		++batch->stats.framesRejected;
+
+	}
+
+}
+
+size_t FrameBlobBuilder::size() const {
+
+	return batch->frames;
+
+}
+
+void FrameBlobBuilder::build(DataBlob &blob) {
+
+	batch->processor.blobify(batch->packets, blob, batch->stats);
+
+	batch->packets.clear();
+	batch->stats = CaptureStats();
+	batch->frames = 0;
+
+}
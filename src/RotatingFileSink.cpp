@@ -0,0 +1,332 @@
+#include <RotatingFileSink.h>
+
+#include "Packet.h"
+
+#include <stdexcept>
+#include <algorithm>
+
+#include <unistd.h>
+
+using std::vector;
+using std::string;
+using std::unique_ptr;
+using std::shared_ptr;
+
+using namespace DAQCap;
+
+namespace {
+
+	// Opens a file sink. Runs in the background.
+	unique_ptr<FileSink> openSink(string path, FileSinkOptions options) {
+
+		return FileSink::open(path, options);
+
+	}
+
+	// Closes a file sink. Runs in the background.
+	void closeSink(shared_ptr<FileSink> sink) {
+
+		sink->close();
+
+	}
+
+}
+
+RotatingFileSink::RotatingFileSink(
+	PathFunction pathFor,
+	const RotationOptions &rotation,
+	const FileSinkOptions &options
+) : pathFor(pathFor),
+    rotation(rotation),
+    options(options),
+    index(0),
+    fileBytes(0),
+    bytes(0) {
+
+	if(rotation.maxBytes != 0 && rotation.maxBytes < Packet::WORD_SIZE) {
+
+		throw std::invalid_argument(
+			"Rotated files must be able to hold at least one word."
+		);
+
+	}
+
+	path = pathFor(index);
+	current = FileSink::open(path, options);
+	fileStart = std::chrono::steady_clock::now();
+
+	prepareNext();
+
+}
+
+RotatingFileSink::~RotatingFileSink() {
+
+	try {
+
+		close();
+
+	} catch(...) {}
+
+}
+
+void RotatingFileSink::write(ByteView data) {
+
+	checkOpen();
+
+	const uint8_t *next = data.data();
+	size_t remaining = data.size();
+
+	while(remaining > 0) {
+
+		if(expired()) rotate();
+
+		size_t count = remaining;
+
+		if(rotation.maxBytes != 0) {
+
+			uint64_t left = room();
+
+			if(left == 0) {
+
+				rotate();
+				continue;
+
+			}
+
+			count = std::min<uint64_t>(count, left);
+
+		}
+
+		current->write(ByteView(next, count));
+
+		fileBytes += count;
+		bytes     += count;
+		next      += count;
+		remaining -= count;
+
+	}
+
+}
+
+void RotatingFileSink::write(const vector<DataBlob> &blobs) {
+
+	checkOpen();
+
+	if(expired()) rotate();
+
+	uint64_t size = 0;
+	for(const DataBlob &blob : blobs) size += blob.size();
+
+	// Hand the whole batch over at once if it fits, so the file's sink can
+	// write it in one go
+	if(rotation.maxBytes == 0 || size <= room()) {
+
+		current->write(blobs);
+
+		fileBytes += size;
+		bytes     += size;
+
+		return;
+
+	}
+
+	for(const DataBlob &blob : blobs) write(blob.view());
+
+}
+
+void RotatingFileSink::flush() {
+
+	checkOpen();
+
+	current->flush();
+
+	collectClosed(false);
+
+}
+
+void RotatingFileSink::close() {
+
+	if(!current) return;
+
+	unique_ptr<FileSink> last = std::move(current);
+
+	// Make sure everything gets cleaned up even if something fails, then
+	// report the first failure
+	std::exception_ptr failure;
+
+	try {
+
+		last->close();
+
+	} catch(...) {
+
+		failure = std::current_exception();
+
+	}
+
+	// The prepared file was never written, so get rid of it
+	if(next.valid()) {
+
+		try {
+
+			unique_ptr<FileSink> unused = next.get();
+			unused->close();
+
+			unlink(nextPath.data());
+
+		} catch(...) {}
+
+	}
+
+	try {
+
+		collectClosed(true);
+
+	} catch(...) {
+
+		if(!failure) failure = std::current_exception();
+
+	}
+
+	if(failure) std::rethrow_exception(failure);
+
+}
+
+uint64_t RotatingFileSink::bytesWritten() const {
+
+	return bytes;
+
+}
+
+size_t RotatingFileSink::fileIndex() const {
+
+	return index;
+
+}
+
+string RotatingFileSink::currentPath() const {
+
+	return path;
+
+}
+
+void RotatingFileSink::prepareNext() {
+
+	nextPath = pathFor(index + 1);
+
+	next = std::async(std::launch::async, openSink, nextPath, options);
+
+}
+
+void RotatingFileSink::rotate() {
+
+	// A failed rotation leaves nothing prepared if even the retry couldn't
+	// be started
+	if(!next.valid()) prepareNext();
+
+	// NOTE: This only blocks if the next file isn't ready yet. If opening
+	//       it failed, this throws and we keep the current file, but
+	//       start opening the next one again so a later rotation can
+	//       succeed.
+	unique_ptr<FileSink> opened;
+
+	try {
+
+		opened = next.get();
+
+	} catch(...) {
+
+		try {
+
+			prepareNext();
+
+		} catch(...) {}
+
+		throw;
+
+	}
+
+	shared_ptr<FileSink> finished(std::move(current));
+
+	current = std::move(opened);
+	path    = nextPath;
+
+	++index;
+
+	fileBytes = 0;
+	fileStart = std::chrono::steady_clock::now();
+
+	closing.push_back(
+		std::async(std::launch::async, closeSink, finished)
+	);
+
+	prepareNext();
+
+	collectClosed(false);
+
+}
+
+bool RotatingFileSink::expired() const {
+
+	return rotation.maxDuration.count() > 0
+		&& fileBytes > 0
+		&& std::chrono::steady_clock::now() - fileStart
+			>= rotation.maxDuration;
+
+}
+
+uint64_t RotatingFileSink::room() const {
+
+	if(fileBytes >= rotation.maxBytes) return 0;
+
+	uint64_t left = rotation.maxBytes - fileBytes;
+
+	// End files on a word boundary. Files always start on one, since data
+	// is written a whole number of words at a time.
+	return left - (left % Packet::WORD_SIZE);
+
+}
+
+void RotatingFileSink::collectClosed(bool wait) {
+
+	std::exception_ptr failure;
+
+	for(auto iter = closing.begin(); iter != closing.end();) {
+
+		bool ready = iter->wait_for(std::chrono::seconds(0))
+			== std::future_status::ready;
+
+		if(!ready && !wait) {
+
+			++iter;
+			continue;
+
+		}
+
+		try {
+
+			iter->get();
+
+		} catch(...) {
+
+			if(!failure) failure = std::current_exception();
+
+		}
+
+		iter = closing.erase(iter);
+
+	}
+
+	if(failure) std::rethrow_exception(failure);
+
+}
+
+void RotatingFileSink::checkOpen() const {
+
+	if(!current) {
+
+		throw std::runtime_error("Cannot write to a closed FileSink.");
+
+	}
+
+}
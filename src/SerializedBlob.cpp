@@ -0,0 +1,470 @@
+#include <SerializedBlob.h>
+
+#include "Packet.h"
+#include "ByteOrder.h"
+
+#include <stdexcept>
+#include <string>
+
+using std::vector;
+using std::string;
+
+using namespace DAQCap;
+
+/*
+ * Serialized blob format (all integers little-endian):
+ *   u32 SERIAL_MAGIC
+ *   u16 format version
+ *   u16 size of the fixed header in bytes, including this field
+ *   u64 size of the whole serialized blob in bytes
+ *   i32 packet count
+ *   i32 first packet number
+ *   i32 last packet number
+ *   u32 number of packet gaps
+ *   u32 number of packet index entries
+ *   u32 number of warnings
+ *   i64 first arrival time, in nanoseconds since the epoch
+ *   i64 last arrival time, in nanoseconds since the epoch
+ *   u64 raw bytes
+ *   u64 idle words removed
+ *   u64 frames rejected
+ *   u64 kernel drops
+ *   i64 processing time in nanoseconds
+ *   u64 data size in bytes
+ *   packet gaps: i32 previous sequence, i32 next sequence, i32 missing,
+ *                u32 reserved, u64 word offset
+ *   packet index: i32 sequence, u32 word count, u64 word offset
+ *   warnings: u32 length, then the characters of the warning
+ *   data
+ *
+ * Readers skip any fixed header fields past the ones they know about, so
+ * new fields may be added to the end of the fixed header without changing
+ * the version. The version only changes when old readers can no longer
+ * read the format.
+ */
+
+const uint16_t SerializedBlob::VERSION = 1;
+
+namespace {
+
+	const uint32_t SERIAL_MAGIC = 0x53425144; // "DQBS"
+
+	const size_t FIXED_HEADER_SIZE = 104;
+	const size_t GAP_SIZE          = 24;
+	const size_t INDEX_ENTRY_SIZE  = 16;
+
+	int64_t toNanoseconds(Timestamp time) {
+
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			time.time_since_epoch()
+		).count();
+
+	}
+
+	Timestamp fromNanoseconds(int64_t count) {
+
+		return Timestamp(
+			std::chrono::duration_cast<Timestamp::duration>(
+				std::chrono::nanoseconds(count)
+			)
+		);
+
+	}
+
+	void putI32(vector<uint8_t> &out, int value) {
+
+		putU32(out, static_cast<uint32_t>(value));
+
+	}
+
+	int loadI32(const uint8_t *data) {
+
+		return static_cast<int32_t>(loadU32(data));
+
+	}
+
+	[[noreturn]] void malformed(const string &reason) {
+
+		throw std::invalid_argument("Malformed serialized blob: " + reason);
+
+	}
+
+	// Checks that the section of count elements of the given size starting
+	// at offset fits in limit bytes, and returns the offset of its end
+	size_t sectionEnd(
+		size_t offset,
+		uint64_t count,
+		size_t elementSize,
+		uint64_t limit
+	) {
+
+		if(offset > limit || count > (limit - offset) / elementSize) {
+
+			malformed("section extends past the end of the blob.");
+
+		}
+
+		return offset + count * elementSize;
+
+	}
+
+}
+
+void DAQCap::serializeBlobHeader(const DataBlob &blob, vector<uint8_t> &out) {
+
+	const BlobMetadata &metadata = blob.metadata();
+
+	const vector<PacketGap> &gaps = blob.gaps();
+	const vector<PacketIndexEntry> &entries = blob.packetIndex();
+	const vector<string> &warnings = blob.warnings();
+
+	uint64_t size = FIXED_HEADER_SIZE
+		+ gaps.size() * GAP_SIZE
+		+ entries.size() * INDEX_ENTRY_SIZE
+		+ blob.size();
+
+	for(const string &warning : warnings) {
+
+		size += 4 + warning.size();
+
+	}
+
+	out.reserve(out.size() + (size - blob.size()));
+
+	putU32(out, SERIAL_MAGIC);
+	putU16(out, SerializedBlob::VERSION);
+	putU16(out, FIXED_HEADER_SIZE);
+	putU64(out, size);
+	putI32(out, blob.packetCount());
+	putI32(out, metadata.firstSequence);
+	putI32(out, metadata.lastSequence);
+	putU32(out, gaps.size());
+	putU32(out, entries.size());
+	putU32(out, warnings.size());
+	putU64(out, toNanoseconds(metadata.firstArrival));
+	putU64(out, toNanoseconds(metadata.lastArrival));
+	putU64(out, metadata.rawBytes);
+	putU64(out, metadata.idleWordsRemoved);
+	putU64(out, metadata.framesRejected);
+	putU64(out, metadata.kernelDrops);
+	putU64(out, metadata.processingTime.count());
+	putU64(out, blob.size());
+
+	for(const PacketGap &gap : gaps) {
+
+		putI32(out, gap.previousSequence);
+		putI32(out, gap.nextSequence);
+		putI32(out, gap.missing);
+		putU32(out, 0);
+		putU64(out, gap.wordOffset);
+
+	}
+
+	for(const PacketIndexEntry &entry : entries) {
+
+		putI32(out, entry.sequence);
+		putU32(out, entry.wordCount);
+		putU64(out, entry.wordOffset);
+
+	}
+
+	for(const string &warning : warnings) {
+
+		putU32(out, warning.size());
+		out.insert(out.end(), warning.cbegin(), warning.cend());
+
+	}
+
+}
+
+vector<uint8_t> DAQCap::serializeBlob(const DataBlob &blob) {
+
+	vector<uint8_t> out;
+
+	serializeBlobHeader(blob, out);
+
+	out.insert(out.end(), blob.view().cbegin(), blob.view().cend());
+
+	return out;
+
+}
+
+SerializedBlob::SerializedBlob(ByteView bytes) {
+
+	if(bytes.size() < FIXED_HEADER_SIZE) {
+
+		malformed("too short to hold a header.");
+
+	}
+
+	const uint8_t *header = bytes.data();
+
+	if(loadU32(header) != SERIAL_MAGIC) {
+
+		malformed("bad magic number.");
+
+	}
+
+	formatVersion = loadU16(header + 4);
+
+	if(formatVersion != VERSION) {
+
+		throw std::invalid_argument(
+			"Serialized blob has unsupported format version "
+				+ std::to_string(formatVersion)
+				+ ". Expected version "
+				+ std::to_string(VERSION)
+				+ "."
+		);
+
+	}
+
+	size_t headerSize = loadU16(header + 6);
+	uint64_t recordSize = loadU64(header + 8);
+
+	if(headerSize < FIXED_HEADER_SIZE || recordSize > bytes.size()) {
+
+		malformed("header does not fit in the available bytes.");
+
+	}
+
+	packets        = loadI32(header + 16);
+	gaps           = loadU32(header + 28);
+	indexEntries   = loadU32(header + 32);
+	warningStrings = loadU32(header + 36);
+
+	blobMetadata.firstSequence    = loadI32(header + 20);
+	blobMetadata.lastSequence     = loadI32(header + 24);
+	blobMetadata.firstArrival     = fromNanoseconds(loadU64(header + 40));
+	blobMetadata.lastArrival      = fromNanoseconds(loadU64(header + 48));
+	blobMetadata.rawBytes         = loadU64(header + 56);
+	blobMetadata.idleWordsRemoved = loadU64(header + 64);
+	blobMetadata.framesRejected   = loadU64(header + 72);
+	blobMetadata.kernelDrops      = loadU64(header + 80);
+	blobMetadata.processingTime   = std::chrono::nanoseconds(
+		loadU64(header + 88)
+	);
+
+	uint64_t dataSize = loadU64(header + 96);
+
+	if(dataSize % Packet::WORD_SIZE != 0) {
+
+		malformed("data is not a whole number of words.");
+
+	}
+
+	// Find the sections, checking each one fits in the record
+	gapStart     = headerSize;
+	indexStart   = sectionEnd(gapStart, gaps, GAP_SIZE, recordSize);
+	warningStart = sectionEnd(
+		indexStart,
+		indexEntries,
+		INDEX_ENTRY_SIZE,
+		recordSize
+	);
+
+	size_t offset = warningStart;
+	for(size_t i = 0; i < warningStrings; ++i) {
+
+		offset = sectionEnd(offset, 1, 4, recordSize);
+
+		uint32_t length = loadU32(header + offset - 4);
+
+		offset = sectionEnd(offset, length, 1, recordSize);
+
+	}
+
+	dataStart = offset;
+
+	if(recordSize - dataStart != dataSize) {
+
+		malformed("section sizes do not add up to the blob size.");
+
+	}
+
+	// Check that gaps and index entries point into the data, so toBlob()
+	// and packetView() never read past it
+	uint64_t words = dataSize / Packet::WORD_SIZE;
+
+	for(size_t i = 0; i < gaps; ++i) {
+
+		uint64_t wordOffset = loadU64(header + gapStart + i * GAP_SIZE + 16);
+
+		if(wordOffset > words) {
+
+			malformed("gap lies outside the data.");
+
+		}
+
+	}
+
+	for(size_t i = 0; i < indexEntries; ++i) {
+
+		const uint8_t *entry = header + indexStart + i * INDEX_ENTRY_SIZE;
+
+		uint32_t wordCount  = loadU32(entry + 4);
+		uint64_t wordOffset = loadU64(entry + 8);
+
+		// NOTE: Written so wordOffset + wordCount can't overflow
+		if(wordOffset > words || wordCount > words - wordOffset) {
+
+			malformed("packet index entry lies outside the data.");
+
+		}
+
+	}
+
+	this->bytes = ByteView(bytes.data(), recordSize);
+
+}
+
+size_t SerializedBlob::size() const {
+
+	return bytes.size();
+
+}
+
+uint16_t SerializedBlob::version() const {
+
+	return formatVersion;
+
+}
+
+int SerializedBlob::packetCount() const {
+
+	return packets;
+
+}
+
+const BlobMetadata &SerializedBlob::metadata() const {
+
+	return blobMetadata;
+
+}
+
+size_t SerializedBlob::gapCount() const {
+
+	return gaps;
+
+}
+
+PacketGap SerializedBlob::gap(size_t index) const {
+
+	if(index >= gaps) {
+
+		throw std::out_of_range(
+			"Gap " + std::to_string(index) + " is out of range."
+		);
+
+	}
+
+	const uint8_t *data = bytes.data() + gapStart + index * GAP_SIZE;
+
+	PacketGap result;
+	result.previousSequence = loadI32(data);
+	result.nextSequence     = loadI32(data + 4);
+	result.missing          = loadI32(data + 8);
+	result.wordOffset       = loadU64(data + 16);
+
+	return result;
+
+}
+
+size_t SerializedBlob::packetIndexSize() const {
+
+	return indexEntries;
+
+}
+
+PacketIndexEntry SerializedBlob::packetIndexEntry(size_t index) const {
+
+	if(index >= indexEntries) {
+
+		throw std::out_of_range(
+			"Packet index entry "
+				+ std::to_string(index)
+				+ " is out of range."
+		);
+
+	}
+
+	const uint8_t *data
+		= bytes.data() + indexStart + index * INDEX_ENTRY_SIZE;
+
+	PacketIndexEntry result;
+	result.sequence   = loadI32(data);
+	result.wordCount  = loadU32(data + 4);
+	result.wordOffset = loadU64(data + 8);
+
+	return result;
+
+}
+
+size_t SerializedBlob::warningCount() const {
+
+	return warningStrings;
+
+}
+
+vector<string> SerializedBlob::warnings() const {
+
+	vector<string> result;
+	result.reserve(warningStrings);
+
+	const uint8_t *data = bytes.data() + warningStart;
+
+	for(size_t i = 0; i < warningStrings; ++i) {
+
+		uint32_t length = loadU32(data);
+
+		result.emplace_back(
+			reinterpret_cast<const char*>(data + 4),
+			length
+		);
+
+		data += 4 + length;
+
+	}
+
+	return result;
+
+}
+
+ByteView SerializedBlob::data() const {
+
+	return ByteView(bytes.data() + dataStart, bytes.size() - dataStart);
+
+}
+
+DataBlob SerializedBlob::toBlob() const {
+
+	DataBlob blob;
+	blob.contents = std::make_shared<DataBlob::Contents>();
+
+	DataBlob::Contents &contents = *blob.contents;
+
+	contents.packets  = packets;
+	contents.metadata = blobMetadata;
+
+	ByteView payload = data();
+	contents.dataBuffer.assign(payload.cbegin(), payload.cend());
+
+	contents.warningsBuffer = warnings();
+
+	contents.gapList.reserve(gaps);
+	for(size_t i = 0; i < gaps; ++i) {
+
+		contents.gapList.push_back(gap(i));
+
+	}
+
+	contents.packetList.reserve(indexEntries);
+	for(size_t i = 0; i < indexEntries; ++i) {
+
+		contents.packetList.push_back(packetIndexEntry(i));
+
+	}
+
+	return blob;
+
+}
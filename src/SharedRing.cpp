@@ -0,0 +1,484 @@
+#include <SharedRing.h>
+#include <SerializedBlob.h>
+
+#include "ByteOrder.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <new>
+#include <cstring>
+#include <cerrno>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using std::vector;
+using std::string;
+
+using namespace DAQCap;
+
+/*
+ * The shared memory object holds a RingHeader followed by the ring itself.
+ * Positions count every byte ever written to the ring, and wrap around it
+ * modulo its capacity. Each record in the ring is
+ *   u64 size of the serialized blob in bytes
+ *   u64 record number, counting from 0
+ *   serialized blob, padded to 8 bytes
+ *
+ * The publisher advances reserved before it overwrites anything, and
+ * advances written once the record is complete. A reader copies a record
+ * out, then checks reserved to see whether the publisher could have
+ * started overwriting it in the meantime, like a seqlock.
+ */
+
+const size_t SharedRingPublisher::DEFAULT_CAPACITY = 64 << 20;
+
+namespace {
+
+	const uint32_t RING_MAGIC   = 0x52535144; // "DQSR"
+	const uint16_t RING_VERSION = 1;
+
+	const size_t RECORD_HEADER_SIZE = 16;
+
+	// NOTE: Atomics in shared memory must not rely on a lock in either
+	//       process's address space.
+	static_assert(
+		ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2,
+		"Shared memory rings need lock-free atomics."
+	);
+
+	struct RingHeader {
+
+		uint32_t magic;
+		uint16_t version;
+		uint16_t headerSize;
+		uint64_t capacity;
+
+		std::atomic<uint32_t> closed;
+
+		// OPTIMIZATION -- The publisher's counters get their own cache line,
+		//                 away from the fields readers only check at startup.
+		alignas(64) std::atomic<uint64_t> reserved;
+		std::atomic<uint64_t> written;
+
+	};
+
+	const size_t DATA_OFFSET = (sizeof(RingHeader) + 63) & ~size_t(63);
+
+	uint64_t padded(uint64_t size) {
+
+		return (size + 7) & ~uint64_t(7);
+
+	}
+
+	string shmName(const string &name) {
+
+		if(!name.empty() && name[0] == '/') return name;
+
+		return "/" + name;
+
+	}
+
+	RingHeader *headerOf(void *mapping) {
+
+		return static_cast<RingHeader*>(mapping);
+
+	}
+
+	uint8_t *ringOf(void *mapping) {
+
+		return static_cast<uint8_t*>(mapping) + DATA_OFFSET;
+
+	}
+
+}
+
+SharedRingPublisher::SharedRingPublisher(const string &name, size_t capacity)
+	: objectName(shmName(name)),
+	  mapping(nullptr),
+	  mappingSize(0),
+	  capacity(padded(capacity)),
+	  position(0),
+	  records(0) {
+
+	if(this->capacity <= RECORD_HEADER_SIZE) {
+
+		throw std::invalid_argument("Shared memory ring is too small.");
+
+	}
+
+	// NOTE: Readers of an old ring keep it until they detach. Creating a
+	//       fresh object instead of truncating the old one means their
+	//       mappings stay valid.
+	shm_unlink(objectName.data());
+
+	int fd = shm_open(objectName.data(), O_RDWR | O_CREAT | O_EXCL, 0644);
+
+	if(fd < 0) {
+
+		throw std::runtime_error(
+			"Could not create shared memory " + objectName + ": "
+				+ std::strerror(errno)
+		);
+
+	}
+
+	mappingSize = DATA_OFFSET + this->capacity;
+
+	if(ftruncate(fd, mappingSize) != 0) {
+
+		int error = errno;
+
+		::close(fd);
+		shm_unlink(objectName.data());
+
+		throw std::runtime_error(
+			"Could not size shared memory " + objectName + ": "
+				+ std::strerror(error)
+		);
+
+	}
+
+	mapping = mmap(
+		nullptr,
+		mappingSize,
+		PROT_READ | PROT_WRITE,
+		MAP_SHARED,
+		fd,
+		0
+	);
+
+	int error = errno;
+
+	// The mapping stays valid after the object is closed
+	::close(fd);
+
+	if(mapping == MAP_FAILED) {
+
+		mapping = nullptr;
+		shm_unlink(objectName.data());
+
+		throw std::runtime_error(
+			"Could not map shared memory " + objectName + ": "
+				+ std::strerror(error)
+		);
+
+	}
+
+	RingHeader *ring = new(mapping) RingHeader;
+
+	ring->version = RING_VERSION;
+	ring->headerSize = DATA_OFFSET;
+	ring->capacity = this->capacity;
+	ring->closed.store(0, std::memory_order_relaxed);
+	ring->reserved.store(0, std::memory_order_relaxed);
+	ring->written.store(0, std::memory_order_relaxed);
+
+	// Readers check the magic number last, so they never see a half
+	// initialized header
+	std::atomic_thread_fence(std::memory_order_release);
+	ring->magic = RING_MAGIC;
+
+}
+
+SharedRingPublisher::~SharedRingPublisher() {
+
+	headerOf(mapping)->closed.store(1, std::memory_order_release);
+
+	munmap(mapping, mappingSize);
+
+	shm_unlink(objectName.data());
+
+}
+
+void SharedRingPublisher::publish(const DataBlob &blob) {
+
+	header.clear();
+	serializeBlobHeader(blob, header);
+
+	uint64_t size = header.size() + blob.size();
+	uint64_t recordSize = padded(RECORD_HEADER_SIZE + size);
+
+	if(recordSize > capacity) {
+
+		throw std::invalid_argument(
+			"Blob is too large for shared memory ring " + objectName + "."
+		);
+
+	}
+
+	RingHeader *ring = headerOf(mapping);
+
+	// Tell readers which bytes are about to be overwritten before touching
+	// them
+	ring->reserved.store(position + recordSize, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	uint8_t recordHeader[RECORD_HEADER_SIZE];
+	storeLittleEndian(recordHeader, size, 8);
+	storeLittleEndian(recordHeader + 8, records, 8);
+
+	copyIn(position, recordHeader, RECORD_HEADER_SIZE);
+	copyIn(position + RECORD_HEADER_SIZE, header.data(), header.size());
+	copyIn(
+		position + RECORD_HEADER_SIZE + header.size(),
+		blob.data().data(),
+		blob.size()
+	);
+
+	position += recordSize;
+	++records;
+
+	ring->written.store(position, std::memory_order_release);
+
+}
+
+uint64_t SharedRingPublisher::published() const {
+
+	return records;
+
+}
+
+const string &SharedRingPublisher::name() const {
+
+	return objectName;
+
+}
+
+void SharedRingPublisher::copyIn(
+	uint64_t at,
+	const uint8_t *data,
+	size_t size
+) {
+
+	uint8_t *ring = ringOf(mapping);
+
+	size_t offset = at % capacity;
+	size_t first = std::min<uint64_t>(size, capacity - offset);
+
+	std::memcpy(ring + offset, data, first);
+	std::memcpy(ring, data + first, size - first);
+
+}
+
+SharedRingSubscriber::SharedRingSubscriber(const string &name)
+	: mapping(nullptr),
+	  mappingSize(0),
+	  capacity(0),
+	  position(0),
+	  started(false),
+	  nextRecord(0),
+	  skipped(0) {
+
+	string object = shmName(name);
+
+	int fd = shm_open(object.data(), O_RDONLY, 0);
+
+	if(fd < 0) {
+
+		throw std::runtime_error(
+			"Could not open shared memory " + object + ": "
+				+ std::strerror(errno)
+		);
+
+	}
+
+	struct stat info;
+	if(fstat(fd, &info) != 0) {
+
+		int error = errno;
+
+		::close(fd);
+
+		throw std::runtime_error(
+			"Could not read shared memory " + object + ": "
+				+ std::strerror(error)
+		);
+
+	}
+
+	mappingSize = info.st_size;
+
+	if(mappingSize > DATA_OFFSET) {
+
+		mapping = mmap(nullptr, mappingSize, PROT_READ, MAP_SHARED, fd, 0);
+
+	}
+
+	int error = errno;
+
+	::close(fd);
+
+	if(mapping == MAP_FAILED) {
+
+		mapping = nullptr;
+
+		throw std::runtime_error(
+			"Could not map shared memory " + object + ": "
+				+ std::strerror(error)
+		);
+
+	}
+
+	const RingHeader *ring = mapping ? headerOf(mapping) : nullptr;
+
+	bool valid = ring && ring->magic == RING_MAGIC;
+	std::atomic_thread_fence(std::memory_order_acquire);
+
+	valid = valid
+		&& ring->version == RING_VERSION
+		&& ring->headerSize == DATA_OFFSET
+		&& ring->capacity == mappingSize - DATA_OFFSET;
+
+	if(!valid) {
+
+		if(mapping) munmap(mapping, mappingSize);
+
+		throw std::runtime_error(
+			object + " is not a compatible DAQCap shared memory ring."
+		);
+
+	}
+
+	capacity = ring->capacity;
+	position = ring->written.load(std::memory_order_acquire);
+
+}
+
+SharedRingSubscriber::~SharedRingSubscriber() {
+
+	munmap(mapping, mappingSize);
+
+}
+
+bool SharedRingSubscriber::next(
+	DataBlob &blob,
+	std::chrono::milliseconds timeout
+) {
+
+	auto deadline = std::chrono::steady_clock::now() + timeout;
+
+	while(true) {
+
+		// Check whether the ring was closed before looking for data, so
+		// the last blobs are still read
+		bool wasClosed = closed();
+
+		if(tryRead(blob)) return true;
+
+		if(wasClosed || std::chrono::steady_clock::now() >= deadline) {
+
+			return false;
+
+		}
+
+		// NOTE: Readers poll, so that the publisher never has to wake
+		//       anyone up. Monitoring doesn't need lower latency than this.
+		std::this_thread::sleep_for(std::chrono::microseconds(500));
+
+	}
+
+}
+
+uint64_t SharedRingSubscriber::missed() const {
+
+	return skipped;
+
+}
+
+bool SharedRingSubscriber::closed() const {
+
+	return headerOf(mapping)->closed.load(std::memory_order_acquire) != 0;
+
+}
+
+void SharedRingSubscriber::copyOut(
+	uint64_t at,
+	uint8_t *data,
+	size_t size
+) const {
+
+	const uint8_t *ring = ringOf(mapping);
+
+	size_t offset = at % capacity;
+	size_t first = std::min<uint64_t>(size, capacity - offset);
+
+	std::memcpy(data, ring + offset, first);
+	std::memcpy(data + first, ring, size - first);
+
+}
+
+bool SharedRingSubscriber::overwritten() const {
+
+	std::atomic_thread_fence(std::memory_order_acquire);
+
+	uint64_t reserved = headerOf(mapping)->reserved.load(
+		std::memory_order_relaxed
+	);
+
+	return reserved > position + capacity;
+
+}
+
+bool SharedRingSubscriber::tryRead(DataBlob &blob) {
+
+	const RingHeader *ring = headerOf(mapping);
+
+	while(true) {
+
+		uint64_t written = ring->written.load(std::memory_order_acquire);
+
+		if(position == written) return false;
+
+		uint8_t recordHeader[RECORD_HEADER_SIZE];
+
+		bool lapped = written - position > capacity;
+
+		if(!lapped) {
+
+			copyOut(position, recordHeader, RECORD_HEADER_SIZE);
+			lapped = overwritten();
+
+		}
+
+		uint64_t size = loadU64(recordHeader);
+		uint64_t record = loadU64(recordHeader + 8);
+
+		if(!lapped) {
+
+			// A torn header can't be trusted, but overwritten() would
+			// have caught it
+			buffer.resize(size);
+			copyOut(position + RECORD_HEADER_SIZE, buffer.data(), size);
+
+			lapped = overwritten();
+
+		}
+
+		// Skip to the newest data. The blobs in between are counted as
+		// missed once the next record number is known.
+		if(lapped) {
+
+			position = written;
+			continue;
+
+		}
+
+		position += padded(RECORD_HEADER_SIZE + size);
+
+		if(started) skipped += record - nextRecord;
+
+		started = true;
+		nextRecord = record + 1;
+
+		blob = SerializedBlob(ByteView(buffer.data(), buffer.size())).toBlob();
+
+		return true;
+
+	}
+
+}
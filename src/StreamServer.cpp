@@ -0,0 +1,630 @@
+#include <StreamServer.h>
+#include <SerializedBlob.h>
+
+#include "ByteOrder.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+using std::vector;
+using std::string;
+using std::unique_ptr;
+
+using namespace DAQCap;
+
+namespace {
+
+	// Every serialized blob starts with its magic number, version, header
+	// size and total size
+	const size_t PREFIX_SIZE = 16;
+	const size_t TOTAL_SIZE_OFFSET = 8;
+
+	// Anything larger is certainly a corrupt stream
+	const uint64_t MAX_BLOB_SIZE = uint64_t(1) << 32;
+
+	// OPTIMIZATION -- Large socket buffers let a whole blob go out in one
+	//                 call, so the server thread wakes up less often. The
+	//                 kernel caps this at its configured maximum.
+	const int SEND_BUFFER_SIZE = 4 << 20;
+
+	sockaddr_un socketAddress(const string &path) {
+
+		sockaddr_un address;
+		std::memset(&address, 0, sizeof(address));
+
+		address.sun_family = AF_UNIX;
+
+		if(path.empty() || path.size() >= sizeof(address.sun_path)) {
+
+			throw std::invalid_argument(
+				"Invalid socket path: \"" + path + "\"."
+			);
+
+		}
+
+		std::memcpy(address.sun_path, path.data(), path.size());
+
+		return address;
+
+	}
+
+	void setNonblocking(int fd) {
+
+		int flags = fcntl(fd, F_GETFL);
+		fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+
+	}
+
+	// Creates a socket that doesn't raise SIGPIPE where that has to be
+	// set on the socket instead of on each call
+	int makeSocket() {
+
+		int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+		if(fd < 0) return fd;
+
+		fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+	#ifdef SO_NOSIGPIPE
+
+		int on = 1;
+		setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+
+	#endif
+
+		return fd;
+
+	}
+
+	#ifdef MSG_NOSIGNAL
+		const int SEND_FLAGS = MSG_NOSIGNAL;
+	#else
+		const int SEND_FLAGS = 0;
+	#endif
+
+	std::runtime_error socketError(const string &what, const string &path) {
+
+		return std::runtime_error(
+			what + " " + path + ": " + std::strerror(errno)
+		);
+
+	}
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// StreamServer
+///////////////////////////////////////////////////////////////////////////////
+
+StreamServer::StreamServer(
+	const string &path,
+	const StreamServerOptions &options
+) : socketPath(path),
+	queueLength(options.queueLength),
+	listener(-1),
+	wakeRead(-1),
+	wakeWrite(-1),
+	dropCount(0),
+	closing(false) {
+
+	if(queueLength == 0) {
+
+		throw std::invalid_argument(
+			"StreamServer queue length must be nonzero."
+		);
+
+	}
+
+	sockaddr_un address = socketAddress(path);
+
+	// Replace a socket left behind by a server that didn't close, but
+	// nothing else
+	struct stat info;
+	if(lstat(path.data(), &info) == 0 && S_ISSOCK(info.st_mode)) {
+
+		unlink(path.data());
+
+	}
+
+	listener = makeSocket();
+
+	if(listener < 0) throw socketError("Could not create socket", path);
+
+	if(
+		bind(listener, (const sockaddr*)&address, sizeof(address)) != 0
+		|| listen(listener, SOMAXCONN) != 0
+	) {
+
+		std::runtime_error error = socketError("Could not listen on", path);
+
+		::close(listener);
+
+		throw error;
+
+	}
+
+	setNonblocking(listener);
+
+	int wakeFds[2];
+	if(pipe(wakeFds) != 0) {
+
+		std::runtime_error error = socketError("Could not start", path);
+
+		::close(listener);
+		unlink(path.data());
+
+		throw error;
+
+	}
+
+	wakeRead = wakeFds[0];
+	wakeWrite = wakeFds[1];
+
+	setNonblocking(wakeRead);
+	setNonblocking(wakeWrite);
+
+	thread = std::thread(&StreamServer::run, this);
+
+}
+
+StreamServer::~StreamServer() {
+
+	try {
+
+		close();
+
+	} catch(...) {}
+
+}
+
+void StreamServer::publish(const DataBlob &blob) {
+
+	if(blob.empty()) return;
+
+	{
+
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if(closing) {
+
+			throw std::runtime_error("Cannot publish to a closed StreamServer.");
+
+		}
+
+		for(const unique_ptr<Subscriber> &subscriber : subscribers) {
+
+			std::deque<DataBlob> &queue = subscriber->queue;
+
+			// The blob being sent can't be dropped without breaking up
+			// the stream, so only blobs behind it count
+			size_t sending = subscriber->header.empty() ? 0 : 1;
+
+			if(queue.size() - sending >= queueLength) {
+
+				queue.erase(queue.begin() + sending);
+
+				++dropCount;
+
+			}
+
+			queue.push_back(blob);
+
+		}
+
+	}
+
+	wake();
+
+}
+
+size_t StreamServer::subscriberCount() const {
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	return subscribers.size();
+
+}
+
+uint64_t StreamServer::dropped() const {
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	return dropCount;
+
+}
+
+const string &StreamServer::path() const {
+
+	return socketPath;
+
+}
+
+void StreamServer::close() {
+
+	{
+
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if(listener < 0) return;
+
+		closing = true;
+
+	}
+
+	wake();
+
+	if(thread.joinable()) thread.join();
+
+	for(const unique_ptr<Subscriber> &subscriber : subscribers) {
+
+		::close(subscriber->fd);
+
+	}
+
+	subscribers.clear();
+
+	::close(listener);
+	::close(wakeRead);
+	::close(wakeWrite);
+
+	listener = -1;
+
+	unlink(socketPath.data());
+
+}
+
+void StreamServer::run() {
+
+	vector<pollfd> fds;
+	vector<Subscriber*> polled;
+
+	while(true) {
+
+		fds.clear();
+		polled.clear();
+
+		fds.push_back(pollfd{wakeRead, POLLIN, 0});
+		fds.push_back(pollfd{listener, POLLIN, 0});
+
+		{
+
+			std::lock_guard<std::mutex> lock(mutex);
+
+			if(closing) return;
+
+			for(const unique_ptr<Subscriber> &subscriber : subscribers) {
+
+				short events = POLLIN;
+				if(!subscriber->queue.empty()) events |= POLLOUT;
+
+				fds.push_back(pollfd{subscriber->fd, events, 0});
+				polled.push_back(subscriber.get());
+
+			}
+
+		}
+
+		if(poll(fds.data(), fds.size(), -1) < 0) continue;
+
+		if(fds[0].revents & POLLIN) {
+
+			char scratch[64];
+			while(read(wakeRead, scratch, sizeof(scratch)) > 0) {}
+
+		}
+
+		if(fds[1].revents & POLLIN) {
+
+			int fd;
+			while((fd = accept(listener, nullptr, nullptr)) >= 0) {
+
+				fcntl(fd, F_SETFD, FD_CLOEXEC);
+				setNonblocking(fd);
+
+				setsockopt(
+					fd,
+					SOL_SOCKET,
+					SO_SNDBUF,
+					&SEND_BUFFER_SIZE,
+					sizeof(SEND_BUFFER_SIZE)
+				);
+
+				unique_ptr<Subscriber> subscriber(new Subscriber);
+				subscriber->fd = fd;
+				subscriber->sent = 0;
+
+				std::lock_guard<std::mutex> lock(mutex);
+				subscribers.push_back(std::move(subscriber));
+
+			}
+
+		}
+
+		for(size_t i = 0; i < polled.size(); ++i) {
+
+			Subscriber &subscriber = *polled[i];
+			short events = fds[i + 2].revents;
+
+			bool connected = !(events & (POLLERR | POLLNVAL));
+
+			// Anything subscribers send is discarded. Reading tells whether
+			// they hung up.
+			if(connected && (events & (POLLIN | POLLHUP))) {
+
+				char scratch[256];
+				ssize_t count = recv(subscriber.fd, scratch, sizeof(scratch), 0);
+
+				connected = count > 0
+					|| (count < 0 && (errno == EAGAIN || errno == EINTR));
+
+			}
+
+			if(connected && (events & POLLOUT)) {
+
+				connected = send(subscriber);
+
+			}
+
+			if(!connected) {
+
+				std::lock_guard<std::mutex> lock(mutex);
+
+				::close(subscriber.fd);
+
+				subscribers.erase(
+					std::find_if(
+						subscribers.begin(),
+						subscribers.end(),
+						[&](const unique_ptr<Subscriber> &candidate) {
+							return candidate.get() == &subscriber;
+						}
+					)
+				);
+
+			}
+
+		}
+
+	}
+
+}
+
+bool StreamServer::send(Subscriber &subscriber) {
+
+	while(true) {
+
+		DataBlob blob;
+		size_t sent;
+
+		{
+
+			std::lock_guard<std::mutex> lock(mutex);
+
+			if(subscriber.queue.empty()) return true;
+
+			// Sharing the blob keeps its buffer alive while it's sent
+			// outside the lock
+			blob = subscriber.queue.front();
+
+			if(subscriber.header.empty()) {
+
+				serializeBlobHeader(blob, subscriber.header);
+
+			}
+
+			sent = subscriber.sent;
+
+		}
+
+		const vector<uint8_t> &header = subscriber.header;
+
+		iovec parts[2];
+		int partCount = 0;
+
+		if(sent < header.size()) {
+
+			parts[partCount].iov_base = (void*)(header.data() + sent);
+			parts[partCount].iov_len = header.size() - sent;
+			++partCount;
+
+		}
+
+		size_t dataSent = sent > header.size() ? sent - header.size() : 0;
+
+		parts[partCount].iov_base = (void*)(blob.data().data() + dataSent);
+		parts[partCount].iov_len = blob.size() - dataSent;
+		++partCount;
+
+		msghdr message;
+		std::memset(&message, 0, sizeof(message));
+		message.msg_iov = parts;
+		message.msg_iovlen = partCount;
+
+		ssize_t count = sendmsg(subscriber.fd, &message, SEND_FLAGS);
+
+		if(count < 0) {
+
+			if(errno == EINTR) continue;
+
+			return errno == EAGAIN || errno == EWOULDBLOCK;
+
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+
+		subscriber.sent += count;
+
+		if(subscriber.sent == header.size() + blob.size()) {
+
+			subscriber.queue.pop_front();
+			subscriber.header.clear();
+			subscriber.sent = 0;
+
+		}
+
+	}
+
+}
+
+void StreamServer::wake() {
+
+	// NOTE: If the pipe is full, the server thread is already due to wake
+	char byte = 0;
+	ssize_t ignored = write(wakeWrite, &byte, 1);
+	(void)ignored;
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// StreamClient
+///////////////////////////////////////////////////////////////////////////////
+
+StreamClient::StreamClient(const string &path)
+	: fd(-1), buffer(PREFIX_SIZE), received(0) {
+
+	sockaddr_un address = socketAddress(path);
+
+	fd = makeSocket();
+
+	if(fd < 0) throw socketError("Could not create socket for", path);
+
+	if(connect(fd, (const sockaddr*)&address, sizeof(address)) != 0) {
+
+		std::runtime_error error = socketError("Could not connect to", path);
+
+		::close(fd);
+
+		throw error;
+
+	}
+
+}
+
+StreamClient::~StreamClient() {
+
+	if(fd >= 0) ::close(fd);
+
+}
+
+bool StreamClient::next(DataBlob &blob, std::chrono::milliseconds timeout) {
+
+	auto deadline = std::chrono::steady_clock::now() + timeout;
+
+	while(connected()) {
+
+		if(received == buffer.size()) {
+
+			if(buffer.size() == PREFIX_SIZE) {
+
+				uint64_t size = loadU64(&buffer[TOTAL_SIZE_OFFSET]);
+
+				if(size < PREFIX_SIZE || size > MAX_BLOB_SIZE) {
+
+					throw std::runtime_error(
+						"Corrupt blob stream: invalid blob size."
+					);
+
+				}
+
+				buffer.resize(size);
+
+			}
+
+			if(received == buffer.size()) {
+
+				try {
+
+					blob = SerializedBlob(
+						ByteView(buffer.data(), buffer.size())
+					).toBlob();
+
+				} catch(const std::invalid_argument &e) {
+
+					throw std::runtime_error(
+						string("Corrupt blob stream: ") + e.what()
+					);
+
+				}
+
+				buffer.resize(PREFIX_SIZE);
+				received = 0;
+
+				return true;
+
+			}
+
+		}
+
+		auto remaining = std::chrono::duration_cast<
+			std::chrono::milliseconds
+		>(deadline - std::chrono::steady_clock::now());
+
+		pollfd readable = {fd, POLLIN, 0};
+
+		int ready = poll(
+			&readable,
+			1,
+			std::max<int64_t>(remaining.count(), 0)
+		);
+
+		if(ready < 0) {
+
+			if(errno == EINTR) continue;
+
+			throw std::runtime_error(
+				string("Could not read blob stream: ") + std::strerror(errno)
+			);
+
+		}
+
+		if(ready == 0) return false;
+
+		ssize_t count = recv(
+			fd,
+			buffer.data() + received,
+			buffer.size() - received,
+			0
+		);
+
+		if(count < 0 && (errno == EINTR || errno == EAGAIN)) continue;
+
+		if(count < 0 && errno != ECONNRESET) {
+
+			throw std::runtime_error(
+				string("Could not read blob stream: ") + std::strerror(errno)
+			);
+
+		}
+
+		// The server hung up
+		if(count <= 0) {
+
+			::close(fd);
+			fd = -1;
+
+			break;
+
+		}
+
+		received += count;
+
+	}
+
+	return false;
+
+}
+
+bool StreamClient::connected() const {
+
+	return fd >= 0;
+
+}
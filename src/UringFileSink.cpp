@@ -0,0 +1,795 @@
+#include "FileSinks.h"
+
+#include <stdexcept>
+#include <string>
+
+using std::vector;
+using std::string;
+using std::unique_ptr;
+
+using namespace DAQCap;
+
+// NOTE: We talk to io_uring with raw system calls rather than liburing, so
+//       that the library has no extra dependencies. All we need is the
+//       kernel's io_uring header, which CMake checks for.
+#ifdef DAQCAP_HAVE_IO_URING
+
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace {
+
+	int uringSetup(unsigned entries, struct io_uring_params *params) {
+
+		return static_cast<int>(
+			syscall(__NR_io_uring_setup, entries, params)
+		);
+
+	}
+
+	int uringEnter(
+		int ringFd,
+		unsigned toSubmit,
+		unsigned minComplete,
+		unsigned flags
+	) {
+
+		return static_cast<int>(
+			syscall(
+				__NR_io_uring_enter,
+				ringFd,
+				toSubmit,
+				minComplete,
+				flags,
+				nullptr,
+				0
+			)
+		);
+
+	}
+
+	int uringRegister(
+		int ringFd,
+		unsigned opcode,
+		const void *arg,
+		unsigned count
+	) {
+
+		return static_cast<int>(
+			syscall(__NR_io_uring_register, ringFd, opcode, arg, count)
+		);
+
+	}
+
+	[[noreturn]] void systemError(const string &what, int error) {
+
+		throw std::runtime_error(what + ": " + std::strerror(error));
+
+	}
+
+	// Writes through an io_uring, copying data into a fixed set of buffers
+	// and keeping one write in flight for each buffer that is full
+	class UringFileSink final : public FileSink {
+
+	public:
+
+		UringFileSink(int fd, bool ownsFd, const FileSinkOptions &options);
+		virtual ~UringFileSink();
+
+		virtual void write(ByteView data) override;
+
+		virtual void flush() override;
+		virtual void close() override;
+
+		virtual uint64_t bytesWritten() const override;
+
+	private:
+
+		struct Buffer {
+
+			uint8_t *data = nullptr;
+
+			// Bytes of data in the buffer
+			size_t fill = 0;
+
+			// Bytes of data the kernel has written so far
+			size_t done = 0;
+
+			// Where in the file the buffer's data goes
+			uint64_t offset = 0;
+
+			// Describes the unwritten data when the buffers aren't
+			// registered. Must stay put until the write completes.
+			struct iovec pending;
+
+		};
+
+		int fd;
+		bool ownsFd;
+
+		int ringFd;
+
+		// Submission queue ring
+		void *sqRing;
+		size_t sqRingSize;
+		unsigned *sqHead;
+		unsigned *sqTail;
+		unsigned *sqMask;
+		unsigned *sqArray;
+
+		struct io_uring_sqe *sqes;
+		size_t sqesSize;
+
+		// Completion queue ring. Shares sqRing's mapping on newer kernels.
+		void *cqRing;
+		size_t cqRingSize;
+		unsigned *cqHead;
+		unsigned *cqTail;
+		unsigned *cqMask;
+
+		struct io_uring_cqe *cqes;
+
+		// Whether the buffers are registered with the kernel
+		bool fixedBuffers;
+
+		size_t bufferSize;
+		vector<Buffer> buffers;
+
+		// Buffers not being written by the kernel
+		vector<size_t> freeBuffers;
+
+		// The buffer currently being filled, or -1 if there is none
+		long current;
+
+		size_t inFlight;
+
+		uint64_t fileOffset;
+		uint64_t bytes;
+
+		Preallocator preallocator;
+		Writeback writeback;
+
+		// The first write error, if any. Once a write fails the sink can't
+		// be used any more.
+		string failure;
+
+		// Queues the unwritten part of a buffer to be written
+		void submit(size_t buffer);
+
+		// Processes completed writes. If wait is true, blocks until at least
+		// one write completes.
+		void reap(bool wait);
+
+		// Gets the end of the data the kernel has finished writing, with no
+		// unfinished writes before it
+		uint64_t completedOffset() const;
+
+		// Gets a buffer with room in it, waiting for one if needed
+		Buffer &fillable();
+
+		// Submits the buffer being filled, if there is one
+		void submitCurrent();
+
+		void checkFailure() const;
+
+		// Waits for all writes to finish and releases the ring and buffers
+		void teardown();
+
+	};
+
+	UringFileSink::UringFileSink(
+		int fd,
+		bool ownsFd,
+		const FileSinkOptions &options
+	) : fd(fd),
+	    ownsFd(ownsFd),
+	    ringFd(-1),
+	    sqRing(MAP_FAILED),
+	    sqRingSize(0),
+	    sqesSize(0),
+	    cqRing(MAP_FAILED),
+	    cqRingSize(0),
+	    fixedBuffers(false),
+	    bufferSize(options.bufferSize),
+	    current(-1),
+	    inFlight(0),
+	    bytes(0),
+	    preallocator(fd, options.preallocateBytes),
+	    writeback(fd, options.writebackBytes) {
+
+		sqes = static_cast<struct io_uring_sqe*>(MAP_FAILED);
+
+		if(options.bufferSize == 0 || options.bufferCount == 0) {
+
+			throw std::invalid_argument(
+				"io_uring buffer size and count must be nonzero."
+			);
+
+		}
+
+		off_t start = lseek(fd, 0, SEEK_CUR);
+		if(start < 0) {
+
+			systemError("io_uring output must be a seekable file", errno);
+
+		}
+
+		fileOffset = start;
+
+		try {
+
+			///////////////////////////////////////////////////////////////////
+			// Set up the ring
+			///////////////////////////////////////////////////////////////////
+
+			struct io_uring_params params;
+			std::memset(&params, 0, sizeof(params));
+
+			ringFd = uringSetup(options.bufferCount, &params);
+			if(ringFd < 0) systemError("Could not set up io_uring", errno);
+
+			sqRingSize = params.sq_off.array
+				+ params.sq_entries * sizeof(unsigned);
+			cqRingSize = params.cq_off.cqes
+				+ params.cq_entries * sizeof(struct io_uring_cqe);
+
+			bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+			if(singleMap) {
+
+				sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+
+			}
+
+			sqRing = mmap(
+				nullptr,
+				sqRingSize,
+				PROT_READ | PROT_WRITE,
+				MAP_SHARED | MAP_POPULATE,
+				ringFd,
+				IORING_OFF_SQ_RING
+			);
+			if(sqRing == MAP_FAILED) {
+
+				systemError("Could not map io_uring", errno);
+
+			}
+
+			if(singleMap) {
+
+				cqRing = sqRing;
+
+			} else {
+
+				cqRing = mmap(
+					nullptr,
+					cqRingSize,
+					PROT_READ | PROT_WRITE,
+					MAP_SHARED | MAP_POPULATE,
+					ringFd,
+					IORING_OFF_CQ_RING
+				);
+				if(cqRing == MAP_FAILED) {
+
+					systemError("Could not map io_uring", errno);
+
+				}
+
+			}
+
+			sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+			sqes = static_cast<struct io_uring_sqe*>(mmap(
+				nullptr,
+				sqesSize,
+				PROT_READ | PROT_WRITE,
+				MAP_SHARED | MAP_POPULATE,
+				ringFd,
+				IORING_OFF_SQES
+			));
+			if(sqes == MAP_FAILED) {
+
+				systemError("Could not map io_uring", errno);
+
+			}
+
+			uint8_t *sq = static_cast<uint8_t*>(sqRing);
+			uint8_t *cq = static_cast<uint8_t*>(cqRing);
+
+			sqHead  = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+			sqTail  = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+			sqMask  = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+			sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+
+			cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+			cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+			cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+			cqes   = reinterpret_cast<struct io_uring_cqe*>(
+				cq + params.cq_off.cqes
+			);
+
+			///////////////////////////////////////////////////////////////////
+			// Set up the buffers
+			///////////////////////////////////////////////////////////////////
+
+			buffers.resize(options.bufferCount);
+			freeBuffers.reserve(options.bufferCount);
+
+			vector<struct iovec> iov(options.bufferCount);
+
+			for(size_t i = 0; i < buffers.size(); ++i) {
+
+				void *memory = nullptr;
+				int error = posix_memalign(
+					&memory,
+					sysconf(_SC_PAGESIZE),
+					bufferSize
+				);
+				if(error != 0) {
+
+					systemError("Could not allocate io_uring buffers", error);
+
+				}
+
+				buffers[i].data = static_cast<uint8_t*>(memory);
+				freeBuffers.push_back(buffers.size() - 1 - i);
+
+				iov[i].iov_base = memory;
+				iov[i].iov_len  = bufferSize;
+
+			}
+
+			// Registered buffers save the kernel from mapping each buffer on
+			// every write. Registration counts against the locked memory
+			// limit on older kernels, so fall back to vectored writes if it
+			// fails.
+			fixedBuffers = uringRegister(
+				ringFd,
+				IORING_REGISTER_BUFFERS,
+				iov.data(),
+				iov.size()
+			) == 0;
+
+		} catch(...) {
+
+			teardown();
+			throw;
+
+		}
+
+	}
+
+	UringFileSink::~UringFileSink() {
+
+		try {
+
+			close();
+
+		} catch(...) {}
+
+		teardown();
+
+	}
+
+	void UringFileSink::write(ByteView data) {
+
+		checkFailure();
+
+		if(ringFd < 0) {
+
+			throw std::runtime_error("Cannot write to a closed FileSink.");
+
+		}
+
+		const uint8_t *next = data.data();
+		size_t remaining = data.size();
+
+		while(remaining > 0) {
+
+			Buffer &buffer = fillable();
+
+			size_t count = std::min(remaining, bufferSize - buffer.fill);
+
+			std::memcpy(buffer.data + buffer.fill, next, count);
+
+			buffer.fill += count;
+			next        += count;
+			remaining   -= count;
+
+			if(buffer.fill == bufferSize) submitCurrent();
+
+		}
+
+		bytes += data.size();
+
+		// Pick up finished writes while we're here, so buffers are free
+		// when we next need them
+		reap(false);
+
+	}
+
+	void UringFileSink::flush() {
+
+		checkFailure();
+
+		if(ringFd < 0) return;
+
+		submitCurrent();
+
+		while(inFlight > 0) reap(true);
+
+	}
+
+	void UringFileSink::close() {
+
+		if(ringFd < 0) return;
+
+		try {
+
+			flush();
+
+		} catch(...) {
+
+			teardown();
+			throw;
+
+		}
+
+		teardown();
+
+		preallocator.release(fileOffset);
+
+		// Leave the file offset past the data we wrote, as a blocking write
+		// would have
+		if(!ownsFd) {
+
+			lseek(fd, fileOffset, SEEK_SET);
+			return;
+
+		}
+
+		if(::close(fd) != 0) {
+
+			systemError("Could not close output file", errno);
+
+		}
+
+	}
+
+	uint64_t UringFileSink::bytesWritten() const {
+
+		return bytes;
+
+	}
+
+	void UringFileSink::submit(size_t index) {
+
+		Buffer &buffer = buffers[index];
+
+		unsigned tail = *sqTail;
+		unsigned slot = tail & *sqMask;
+
+		struct io_uring_sqe &sqe = sqes[slot];
+		std::memset(&sqe, 0, sizeof(sqe));
+
+		sqe.fd        = fd;
+		sqe.off       = buffer.offset + buffer.done;
+		sqe.user_data = index;
+
+		if(fixedBuffers) {
+
+			sqe.opcode    = IORING_OP_WRITE_FIXED;
+			sqe.addr      = reinterpret_cast<uint64_t>(
+				buffer.data + buffer.done
+			);
+			sqe.len       = buffer.fill - buffer.done;
+			sqe.buf_index = index;
+
+		} else {
+
+			buffer.pending.iov_base = buffer.data + buffer.done;
+			buffer.pending.iov_len  = buffer.fill - buffer.done;
+
+			sqe.opcode = IORING_OP_WRITEV;
+			sqe.addr   = reinterpret_cast<uint64_t>(&buffer.pending);
+			sqe.len    = 1;
+
+		}
+
+		sqArray[slot] = slot;
+
+		// The kernel must see the entry before it sees the new tail
+		__atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+
+		while(uringEnter(ringFd, 1, 0, 0) < 0) {
+
+			if(errno == EINTR) continue;
+
+			int error = errno;
+
+			// NOTE: The write is only in flight if the kernel took the entry
+			//       off the ring anyway. Otherwise take it back, so nothing
+			//       waits for a completion that will never come.
+			if(__atomic_load_n(sqHead, __ATOMIC_ACQUIRE) == tail) {
+
+				__atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+
+			} else {
+
+				++inFlight;
+
+			}
+
+			// The buffer's data will never be written, so the file can't
+			// be trusted past this point
+			if(failure.empty()) {
+
+				failure = string("Could not submit write: ")
+					+ std::strerror(error);
+
+			}
+
+			systemError("Could not submit write", error);
+
+		}
+
+		++inFlight;
+
+	}
+
+	void UringFileSink::reap(bool wait) {
+
+		bool reaped = false;
+
+		unsigned head = *cqHead;
+
+		while(true) {
+
+			unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+
+			if(head == tail) {
+
+				if(reaped || !wait || inFlight == 0) break;
+
+				if(
+					uringEnter(ringFd, 0, 1, IORING_ENTER_GETEVENTS) < 0 &&
+					errno != EINTR
+				) {
+
+					systemError("Could not wait for writes", errno);
+
+				}
+
+				continue;
+
+			}
+
+			const struct io_uring_cqe &cqe = cqes[head & *cqMask];
+
+			size_t index = cqe.user_data;
+			int result   = cqe.res;
+
+			++head;
+			__atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+
+			--inFlight;
+			reaped = true;
+
+			Buffer &buffer = buffers[index];
+
+			if(result < 0 && failure.empty()) {
+
+				failure = string("Could not write data: ")
+					+ std::strerror(-result);
+
+			} else if(result == 0 && failure.empty()) {
+
+				failure = "Could not write data: no progress was made.";
+
+			} else if(result > 0) {
+
+				buffer.done += result;
+
+			}
+
+			// Finish short writes unless the sink has already failed
+			if(buffer.done < buffer.fill && failure.empty()) {
+
+				submit(index);
+
+			} else {
+
+				buffer.fill = 0;
+				buffer.done = 0;
+
+				freeBuffers.push_back(index);
+
+			}
+
+		}
+
+		if(reaped) writeback.advance(completedOffset());
+
+		checkFailure();
+
+	}
+
+	uint64_t UringFileSink::completedOffset() const {
+
+		uint64_t end = fileOffset;
+
+		// Every buffer holding data, other than the one being filled, is
+		// still being written
+		for(size_t i = 0; i < buffers.size(); ++i) {
+
+			if(buffers[i].fill > 0 && (long)i != current) {
+
+				end = std::min(end, buffers[i].offset);
+
+			}
+
+		}
+
+		return end;
+
+	}
+
+	UringFileSink::Buffer &UringFileSink::fillable() {
+
+		if(current >= 0) return buffers[current];
+
+		while(freeBuffers.empty()) reap(true);
+
+		current = freeBuffers.back();
+		freeBuffers.pop_back();
+
+		Buffer &buffer = buffers[current];
+		buffer.offset = fileOffset;
+
+		preallocator.reserve(fileOffset + bufferSize);
+
+		return buffer;
+
+	}
+
+	void UringFileSink::submitCurrent() {
+
+		if(current < 0) return;
+
+		Buffer &buffer = buffers[current];
+
+		if(buffer.fill == 0) return;
+
+		fileOffset += buffer.fill;
+
+		size_t index = current;
+		current = -1;
+
+		submit(index);
+
+	}
+
+	void UringFileSink::checkFailure() const {
+
+		if(!failure.empty()) throw std::runtime_error(failure);
+
+	}
+
+	void UringFileSink::teardown() {
+
+		// The kernel may still be reading from the buffers, so wait for
+		// every write before freeing them
+		if(ringFd >= 0 && cqRing != MAP_FAILED) {
+
+			if(failure.empty()) failure = "The FileSink was closed.";
+
+			// reap() always throws here, since the sink has failed. Only
+			// give up once waiting stops making progress, which means the
+			// ring itself is broken.
+			while(inFlight > 0) {
+
+				size_t before = inFlight;
+
+				try {
+
+					reap(true);
+
+				} catch(...) {}
+
+				if(inFlight == before) break;
+
+			}
+
+		}
+
+		if(sqes != MAP_FAILED) munmap(sqes, sqesSize);
+		if(cqRing != MAP_FAILED && cqRing != sqRing) munmap(cqRing, cqRingSize);
+		if(sqRing != MAP_FAILED) munmap(sqRing, sqRingSize);
+
+		sqes   = static_cast<struct io_uring_sqe*>(MAP_FAILED);
+		sqRing = MAP_FAILED;
+		cqRing = MAP_FAILED;
+
+		// Closing the ring cancels any writes we gave up waiting for
+		if(ringFd >= 0) ::close(ringFd);
+		ringFd = -1;
+
+		// NOTE: An abandoned write can only read from its buffer, and its
+		//       data is lost either way, so the buffers are safe to free
+		//       even then. Registered buffers stay pinned by the kernel
+		//       until it is done with them.
+		for(Buffer &buffer : buffers) free(buffer.data);
+
+		inFlight = 0;
+
+		buffers.clear();
+		freeBuffers.clear();
+
+	}
+
+}
+
+unique_ptr<FileSink> DAQCap::openUringFileSink(
+	int fd,
+	bool ownsFd,
+	const FileSinkOptions &options
+) {
+
+	return unique_ptr<FileSink>(new UringFileSink(fd, ownsFd, options));
+
+}
+
+bool DAQCap::uringSupported() {
+
+	// Setting up a tiny ring is the only reliable check. The kernel may be
+	// too old, or io_uring may be disabled by the administrator or by a
+	// seccomp filter.
+	static const bool SUPPORTED = []() {
+
+		struct io_uring_params params;
+		std::memset(&params, 0, sizeof(params));
+
+		int ringFd = uringSetup(1, &params);
+		if(ringFd < 0) return false;
+
+		::close(ringFd);
+
+		return true;
+
+	}();
+
+	return SUPPORTED;
+
+}
+
+#else
+
+unique_ptr<FileSink> DAQCap::openUringFileSink(
+	int fd,
+	bool ownsFd,
+	const FileSinkOptions &options
+) {
+
+	(void)fd;
+	(void)ownsFd;
+	(void)options;
+
+	throw std::runtime_error(
+		"DAQCap was built without io_uring support."
+	);
+
+}
+
+bool DAQCap::uringSupported() {
+
+	return false;
+
+}
+
+#endif
@@ -0,0 +1,85 @@
+#include <WordLayout.h>
+
+// pext is compiled for just the function that uses it, and only used if the
+// CPU has it, so builds still run on any x86-64 CPU.
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+	#define DAQCAP_HAVE_BMI2_PEXT
+	#include <immintrin.h>
+#endif
+
+using namespace DAQCap;
+
+namespace {
+
+	typedef void (*Implementation)(
+		const Word *words,
+		size_t count,
+		Word mask,
+		Word *out
+	);
+
+#ifdef DAQCAP_HAVE_BMI2_PEXT
+
+	__attribute__((target("bmi2")))
+	void pextGather(const Word *words, size_t count, Word mask, Word *out) {
+
+		for(size_t i = 0; i < count; ++i) {
+
+			out[i] = _pext_u64(words[i], mask);
+
+		}
+
+	}
+
+#endif
+
+	Implementation chooseImplementation() {
+
+#ifdef DAQCAP_HAVE_BMI2_PEXT
+
+		// NOTE: AMD CPUs before Zen 3 implement pext in microcode, which is
+		//       far slower than gathering the fields with shifts.
+		if(
+			__builtin_cpu_supports("bmi2") &&
+			!__builtin_cpu_is("amdfam15h") &&
+			!__builtin_cpu_is("amdfam17h")
+		) {
+
+			return pextGather;
+
+		}
+
+#endif
+
+		return nullptr;
+
+	}
+
+	// A function-local static, so words gathered during another file's
+	// static initialization still find the implementation
+	Implementation implementation() {
+
+		static const Implementation CHOSEN = chooseImplementation();
+
+		return CHOSEN;
+
+	}
+
+}
+
+bool DAQCap::wordGatherAccelerated() {
+
+	return implementation() != nullptr;
+
+}
+
+void DAQCap::detail::pextWords(
+	const Word *words,
+	size_t count,
+	Word mask,
+	Word *out
+) {
+
+	implementation()(words, count, mask, out);
+
+}
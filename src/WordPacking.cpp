@@ -0,0 +1,198 @@
+#include "WordPacking.h"
+
+#include "Packet.h"
+
+#include <cstring>
+
+// The vectorized kernel uses SSSE3 byte shuffles. We compile it with a
+// function-level target attribute and pick it at runtime, so the library
+// itself doesn't need to be built with -mssse3.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+	#define SSSE3_KERNEL
+
+	#include <tmmintrin.h>
+
+#endif
+
+// Scalar packing can load a whole word at once and swap its bytes if we
+// know the byte order of the host.
+#if defined(__GNUC__) && defined(__BYTE_ORDER__)
+
+	#define FAST_SCALAR_PACKING
+
+#endif
+
+using namespace DAQCap;
+
+namespace {
+
+	// The word size the fast kernels are written for. Packet::WORD_SIZE is
+	// the source of truth, and any other size falls back to the generic
+	// byte loop.
+	const size_t FAST_WORD_SIZE = 5;
+
+	// Packs one word a byte at a time. Works for any word size.
+	Word packWordGeneric(const uint8_t *data) {
+
+		Word word = 0;
+		for(size_t byte = 0; byte < Packet::WORD_SIZE; ++byte) {
+
+			// NOTE: Without the cast to uint64_t, the shift will be done as if
+			//       on a 32-bit integer, causing the first byte to wrap around
+			//       and distort the data.
+			word |= static_cast<Word>(data[byte])
+					<< (8 * (Packet::WORD_SIZE - byte - 1));
+
+		}
+
+		return word;
+
+	}
+
+	#ifdef FAST_SCALAR_PACKING
+
+	// Packs one 5-byte word with a single 8-byte load.
+	// REQUIRES: 8 bytes starting at data are readable.
+	inline Word packWordWide(const uint8_t *data) {
+
+		uint64_t raw;
+		std::memcpy(&raw, data, sizeof(raw));
+
+		#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+
+			raw = __builtin_bswap64(raw);
+
+		#endif
+
+		// The word is now in the top five bytes, followed by three bytes
+		// of the next word
+		return raw >> (8 * (sizeof(raw) - FAST_WORD_SIZE));
+
+	}
+
+	#endif
+
+	// Packs words one at a time, using wide loads wherever the input is
+	// long enough to allow them.
+	void packWordsScalar(const uint8_t *data, size_t words, Word *out) {
+
+		size_t word = 0;
+
+		#ifdef FAST_SCALAR_PACKING
+
+			// Wide loads read 3 bytes past the end of each word, so the
+			// last word can't use them.
+			if(Packet::WORD_SIZE == FAST_WORD_SIZE) {
+
+				for(; word + 1 < words; ++word) {
+
+					out[word] = packWordWide(data + word * FAST_WORD_SIZE);
+
+				}
+
+			}
+
+		#endif
+
+		for(; word < words; ++word) {
+
+			out[word] = packWordGeneric(data + word * Packet::WORD_SIZE);
+
+		}
+
+	}
+
+	#ifdef SSSE3_KERNEL
+
+	// Packs words four at a time with SSSE3 shuffles, and returns the number
+	// of words packed. The caller packs whatever is left.
+	__attribute__((target("ssse3")))
+	size_t packWordsSSSE3(const uint8_t *data, size_t words, Word *out) {
+
+		// Reverses the bytes of the two 5-byte words at the start of a
+		// 16-byte load into two little-endian 64-bit lanes, zero-filling
+		// the top three bytes of each lane.
+		const __m128i shuffle = _mm_setr_epi8(
+			4, 3, 2, 1, 0, -1, -1, -1,
+			9, 8, 7, 6, 5, -1, -1, -1
+		);
+
+		// Each iteration loads 16 bytes at offsets 0 and 10 of a 20-byte
+		// group, so it reads 6 bytes past the group. Stop while those
+		// bytes are still part of the input.
+		const size_t GROUP_WORDS = 4;
+		const size_t GROUP_BYTES = GROUP_WORDS * FAST_WORD_SIZE;
+		const size_t OVERREAD    = 6;
+
+		size_t word = 0;
+		for(
+			; 
+			(word + GROUP_WORDS) * FAST_WORD_SIZE + OVERREAD 
+				<= words * FAST_WORD_SIZE;
+			word += GROUP_WORDS
+		) {
+
+			const uint8_t *group = data + word * FAST_WORD_SIZE;
+
+			__m128i low  = _mm_loadu_si128(
+				reinterpret_cast<const __m128i*>(group)
+			);
+			__m128i high = _mm_loadu_si128(
+				reinterpret_cast<const __m128i*>(group + GROUP_BYTES / 2)
+			);
+
+			_mm_storeu_si128(
+				reinterpret_cast<__m128i*>(out + word), 
+				_mm_shuffle_epi8(low, shuffle)
+			);
+			_mm_storeu_si128(
+				reinterpret_cast<__m128i*>(out + word + 2), 
+				_mm_shuffle_epi8(high, shuffle)
+			);
+
+		}
+
+		return word;
+
+	}
+
+	bool ssse3Supported() {
+
+		static const bool supported = __builtin_cpu_supports("ssse3");
+
+		return supported;
+
+	}
+
+	#endif
+
+}
+
+Word DAQCap::packWord(const uint8_t *data) {
+
+	return packWordGeneric(data);
+
+}
+
+void DAQCap::packWords(const uint8_t *data, size_t words, Word *out) {
+
+	#ifdef SSSE3_KERNEL
+
+		// NOTE: The SSSE3 kernel stores little-endian lanes, so it's only
+		//       correct on little-endian hosts, which every x86 host is.
+		if(Packet::WORD_SIZE == FAST_WORD_SIZE && ssse3Supported()) {
+
+			size_t packed = packWordsSSSE3(data, words, out);
+
+			data  += packed * FAST_WORD_SIZE;
+			out   += packed;
+			words -= packed;
+
+		}
+
+	#endif
+
+	packWordsScalar(data, words, out);
+
+}
@@ -0,0 +1,45 @@
+/**
+ * @file WordPacking.h
+ *
+ * @brief Converts raw big-endian miniDAQ bytes into words.
+ *
+ * @author Robert Myers
+ * Contact: romyers@umich.edu
+ */
+
+#pragma once
+
+#include <DAQBlob.h>
+
+#include <cstddef>
+#include <stdint.h>
+
+namespace DAQCap {
+
+	/**
+	 * @brief Packs a run of whole words into an output array.
+	 * 
+	 * Uses a vectorized implementation when the CPU supports one.
+	 * Otherwise, words are packed one at a time, with a single byte-swapped
+	 * 8-byte load per word where the platform allows it and a byte loop
+	 * elsewhere.
+	 * 
+	 * REQUIRES:
+	 *  - data points to at least words * Packet::WORD_SIZE readable bytes.
+	 *  - out points to at least words writable Words.
+	 *  - Words in data are in big-endian byte order.
+	 * 
+	 * @param[in] data The first byte of the first word to pack.
+	 * @param[in] words The number of words to pack.
+	 * @param[out] out Receives the packed words.
+	 */
+	void packWords(const uint8_t *data, size_t words, Word *out);
+
+	/**
+	 * @brief Packs a single word.
+	 * 
+	 * REQUIRES: data points to at least Packet::WORD_SIZE readable bytes.
+	 */
+	Word packWord(const uint8_t *data);
+
+}
@@ -0,0 +1,70 @@
+#include <WordView.h>
+
+#include "WordPacking.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace DAQCap;
+
+// NOTE: WORD_SIZE is given in the header so it is a constant expression.
+//       It must match Packet::WORD_SIZE.
+constexpr size_t WordView::WORD_SIZE;
+
+WordView::WordView(ByteView bytes) 
+	: first(bytes.data()), words(bytes.size() / WORD_SIZE) {}
+
+WordView::WordView(const uint8_t *data, size_t size)
+	: first(data), words(size / WORD_SIZE) {}
+
+WordView::WordView(const DataBlob &blob) : WordView(blob.view()) {}
+
+Word WordView::at(size_t index) const {
+
+	if(index >= words) {
+
+		throw std::out_of_range(
+			"WordView::at: index out of range."
+		);
+
+	}
+
+	return (*this)[index];
+
+}
+
+size_t WordView::decode(size_t firstWord, size_t count, Word *out) const {
+
+	if(firstWord > words) {
+
+		throw std::out_of_range(
+			"WordView::decode: firstWord out of range."
+		);
+
+	}
+
+	count = std::min(count, words - firstWord);
+
+	packWords(first + firstWord * WORD_SIZE, count, out);
+
+	return count;
+
+}
+
+WordView WordView::subview(size_t firstWord, size_t count) const {
+
+	if(firstWord > words) {
+
+		throw std::out_of_range(
+			"WordView::subview: firstWord out of range."
+		);
+
+	}
+
+	WordView result;
+	result.first = first + firstWord * WORD_SIZE;
+	result.words = std::min(count, words - firstWord);
+
+	return result;
+
+}
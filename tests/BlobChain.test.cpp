@@ -0,0 +1,204 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <BlobChain.h>
+#include <PacketProcessor.h>
+
+#include "TestHelpers.h"
+
+#include <numeric>
+#include <sstream>
+
+using std::vector;
+using std::string;
+
+using namespace DAQCap;
+
+// Gets size consecutive byte values starting at first
+vector<uint8_t> sequence(size_t first, size_t size) {
+
+	vector<uint8_t> result(size);
+	std::iota(result.begin(), result.end(), first);
+
+	return result;
+
+}
+
+TEST_CASE("BlobChain::append()", "[BlobChain]") {
+
+	PacketProcessor processor;
+
+	SECTION("Default chain is empty") {
+
+		BlobChain chain;
+
+		REQUIRE(chain.empty());
+		REQUIRE(chain.size() == 0);
+		REQUIRE(chain.wordCount() == 0);
+		REQUIRE(chain.flatten().empty());
+
+	}
+
+	SECTION("append() joins blobs in order without copying") {
+
+		DataBlob first  = makeBlob(processor, 2, 0);
+		DataBlob second = makeBlob(processor, 3, 2 * WORD_SIZE);
+
+		BlobChain chain(first);
+		chain.append(second);
+
+		REQUIRE(chain.segments().size() == 2);
+		REQUIRE(chain.wordCount() == 5);
+		REQUIRE(chain.segments()[1].view().data() == second.view().data());
+		REQUIRE(first.useCount() == 2);
+
+		REQUIRE(chain.flatten() == sequence(0, 5 * WORD_SIZE));
+
+	}
+
+	SECTION("append() ignores empty blobs") {
+
+		BlobChain chain;
+		chain.append(DataBlob());
+
+		REQUIRE(chain.empty());
+		REQUIRE(chain.segments().empty());
+
+	}
+
+	SECTION("append() joins chains, including a chain to itself") {
+
+		BlobChain chain(makeBlob(processor, 2, 0));
+		BlobChain other(makeBlob(processor, 1, 2 * WORD_SIZE));
+
+		chain.append(other);
+
+		REQUIRE(chain.flatten() == sequence(0, 3 * WORD_SIZE));
+
+		chain.append(chain);
+
+		REQUIRE(chain.wordCount() == 6);
+		REQUIRE(chain.word(3) == chain.word(0));
+
+	}
+
+}
+
+TEST_CASE("BlobChain::split()", "[BlobChain]") {
+
+	PacketProcessor processor;
+
+	BlobChain chain(makeBlob(processor, 2, 0));
+	chain.append(makeBlob(processor, 3, 2 * WORD_SIZE));
+
+	SECTION("split() in the middle of a segment shares the segment") {
+
+		BlobChain tail = chain.split(3);
+
+		REQUIRE(chain.wordCount() == 3);
+		REQUIRE(tail.wordCount() == 2);
+
+		REQUIRE(chain.flatten() == sequence(0, 3 * WORD_SIZE));
+		REQUIRE(tail.flatten() == sequence(3 * WORD_SIZE, 2 * WORD_SIZE));
+
+		REQUIRE(
+			chain.segments()[1].blob.view().data() 
+				== tail.segments()[0].blob.view().data()
+		);
+
+	}
+
+	SECTION("split() at a segment boundary moves whole segments") {
+
+		BlobChain tail = chain.split(2);
+
+		REQUIRE(chain.segments().size() == 1);
+		REQUIRE(tail.segments().size() == 1);
+		REQUIRE(tail.flatten() == sequence(2 * WORD_SIZE, 3 * WORD_SIZE));
+
+	}
+
+	SECTION("split() at either end leaves one chain empty") {
+
+		BlobChain all = chain.split(0);
+
+		REQUIRE(chain.empty());
+		REQUIRE(all.wordCount() == 5);
+
+		BlobChain none = all.split(5);
+
+		REQUIRE(none.empty());
+		REQUIRE(all.wordCount() == 5);
+
+	}
+
+	SECTION("split() throws if the word is out of range") {
+
+		REQUIRE_THROWS_AS(chain.split(6), std::out_of_range);
+
+	}
+
+	SECTION("Split chains can be appended back together") {
+
+		BlobChain tail = chain.split(1);
+		chain.append(tail);
+
+		REQUIRE(chain.flatten() == sequence(0, 5 * WORD_SIZE));
+
+	}
+
+}
+
+TEST_CASE("BlobChain::slice()", "[BlobChain]") {
+
+	PacketProcessor processor;
+
+	BlobChain chain(makeBlob(processor, 2, 0));
+	chain.append(makeBlob(processor, 3, 2 * WORD_SIZE));
+
+	SECTION("slice() spans segments") {
+
+		BlobChain slice = chain.slice(1, 3);
+
+		REQUIRE(slice.wordCount() == 3);
+		REQUIRE(slice.flatten() == sequence(WORD_SIZE, 3 * WORD_SIZE));
+		REQUIRE(chain.wordCount() == 5);
+
+	}
+
+	SECTION("slice() stops at the end of the chain") {
+
+		REQUIRE(chain.slice(4, 10).wordCount() == 1);
+		REQUIRE(chain.slice(5, 10).empty());
+		REQUIRE_THROWS_AS(chain.slice(6, 1), std::out_of_range);
+
+	}
+
+}
+
+TEST_CASE("BlobChain output", "[BlobChain]") {
+
+	PacketProcessor processor;
+
+	BlobChain chain(makeBlob(processor, 2, 0));
+	chain.append(makeBlob(processor, 3, 2 * WORD_SIZE));
+
+	SECTION("word() decodes words across segments") {
+
+		REQUIRE(chain.word(0) == 0x0001020304);
+		REQUIRE(chain.word(2) == 0x0a0b0c0d0e);
+		REQUIRE_THROWS_AS(chain.word(5), std::out_of_range);
+
+	}
+
+	SECTION("operator<< writes every segment in order") {
+
+		std::ostringstream stream;
+		stream << chain;
+
+		vector<uint8_t> expected = sequence(0, 5 * WORD_SIZE);
+
+		REQUIRE(stream.str() == string(expected.begin(), expected.end()));
+
+	}
+
+}
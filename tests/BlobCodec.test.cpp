@@ -0,0 +1,306 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <BlobCodec.h>
+
+#include <numeric>
+#include <algorithm>
+#include <random>
+
+using std::vector;
+
+using namespace DAQCap;
+
+const size_t WORD_SIZE = 5;
+
+// Appends a word to data in big-endian byte order
+void appendWord(vector<uint8_t> &data, Word word) {
+
+	for(size_t byte = 0; byte < WORD_SIZE; ++byte) {
+
+		data.push_back(
+			static_cast<uint8_t>(word >> (8 * (WORD_SIZE - byte - 1)))
+		);
+
+	}
+
+}
+
+// Builds data resembling a miniDAQ stream: runs of repeated header words
+// and words with a slowly increasing timestamp field
+vector<uint8_t> makeStream(size_t words) {
+
+	std::mt19937 generator(54321);
+	std::uniform_int_distribution<int> step(0, 20);
+
+	vector<uint8_t> data;
+	Word timestamp = 0;
+	for(size_t i = 0; i < words; ++i) {
+
+		if(i % 50 < 10) {
+
+			appendWord(data, 0xA000000000);
+
+		} else {
+
+			timestamp += step(generator);
+			appendWord(data, 0x3100000000 | (timestamp & 0xFFFFF));
+
+		}
+
+	}
+
+	return data;
+
+}
+
+ByteView viewOf(const vector<uint8_t> &data) {
+
+	return ByteView(data.data(), data.size());
+
+}
+
+// Builds an encoded block from its header fields after the magic number and
+// block size, followed by body
+vector<uint8_t> makeBlock(
+	std::initializer_list<uint32_t> fields, 
+	const vector<uint8_t> &body
+) {
+
+	vector<uint32_t> header = { 0x31425144u, 0u };
+	header.insert(header.end(), fields.begin(), fields.end());
+	header[1] = 4 * header.size() + body.size();
+
+	vector<uint8_t> block;
+	for(uint32_t field : header) {
+
+		for(int byte = 0; byte < 4; ++byte) {
+
+			block.push_back(static_cast<uint8_t>(field >> (8 * byte)));
+
+		}
+
+	}
+
+	block.insert(block.end(), body.begin(), body.end());
+
+	return block;
+
+}
+
+TEST_CASE("DAQCap::compressData()", "[BlobCodec]") {
+
+	SECTION("compressData() round trips empty data") {
+
+		vector<uint8_t> empty;
+
+		vector<uint8_t> encoded = compressData(viewOf(empty));
+
+		REQUIRE(encoded.empty());
+		REQUIRE(decompressData(viewOf(encoded)).empty());
+
+	}
+
+	SECTION("compressData() round trips a single word") {
+
+		vector<uint8_t> data;
+		appendWord(data, 0x0102030405);
+
+		REQUIRE(decompressData(viewOf(compressData(viewOf(data)))) == data);
+
+	}
+
+	SECTION("compressData() round trips random data") {
+
+		std::mt19937 generator(12345);
+		std::uniform_int_distribution<int> byte(0, 255);
+
+		vector<uint8_t> data(WORD_SIZE * 1000);
+		for(uint8_t &value : data) value = byte(generator);
+
+		REQUIRE(decompressData(viewOf(compressData(viewOf(data)))) == data);
+
+	}
+
+	SECTION("compressData() shrinks repetitive miniDAQ data") {
+
+		vector<uint8_t> data = makeStream(100000);
+
+		vector<uint8_t> encoded = compressData(viewOf(data));
+
+		REQUIRE(encoded.size() < data.size() / 2);
+		REQUIRE(decompressData(viewOf(encoded)) == data);
+
+	}
+
+	SECTION("compressData() collapses long runs of one word") {
+
+		vector<uint8_t> data;
+		for(int i = 0; i < 10000; ++i) appendWord(data, 0x1234567890);
+
+		vector<uint8_t> encoded = compressData(viewOf(data));
+
+		REQUIRE(encoded.size() < 100);
+		REQUIRE(decompressData(viewOf(encoded)) == data);
+
+	}
+
+}
+
+TEST_CASE("DAQCap::decompressData() error handling", "[BlobCodec]") {
+
+	vector<uint8_t> data = makeStream(1000);
+	vector<uint8_t> encoded = compressData(viewOf(data));
+
+	SECTION("decompressData() throws for truncated data") {
+
+		encoded.pop_back();
+
+		REQUIRE_THROWS_AS(
+			decompressData(viewOf(encoded)), 
+			std::invalid_argument
+		);
+
+	}
+
+	SECTION("decompressData() throws for a bad block header") {
+
+		encoded[0] ^= 0xFF;
+
+		REQUIRE_THROWS_AS(
+			decompressData(viewOf(encoded)), 
+			std::invalid_argument
+		);
+
+	}
+
+	SECTION("decompressData() throws for impossible run counts") {
+
+		// A bare header claiming billions of words and runs
+		vector<uint8_t> block = makeBlock(
+			{ 0xFFFFFFFFu, 0xFFFFFFFFu, 0u, 0u, 0u, 0u, 0u, 0u }, 
+			{}
+		);
+
+		REQUIRE_THROWS_AS(
+			decompressData(viewOf(block)), 
+			std::invalid_argument
+		);
+
+	}
+
+	SECTION("decompressData() throws for run lengths that wrap around") {
+
+		// Two words in two runs, where the first run's length of 2^64
+		// wraps to 0 and the second run holds both words
+		vector<uint8_t> body = {
+			10, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x01, 0x01
+		};
+		for(size_t plane = 0; plane < WORD_SIZE; ++plane) {
+
+			body.insert(body.end(), { 1, 0, 0 });
+
+		}
+
+		vector<uint8_t> block = makeBlock(
+			{ 2u, 2u, 12u, 3u, 3u, 3u, 3u, 3u }, 
+			body
+		);
+
+		REQUIRE_THROWS_AS(
+			decompressData(viewOf(block)), 
+			std::invalid_argument
+		);
+
+	}
+
+	SECTION("decompressData() throws for data past the expected size") {
+
+		REQUIRE(decompressData(viewOf(encoded), data.size()) == data);
+
+		REQUIRE_THROWS_AS(
+			decompressData(viewOf(encoded), data.size() - WORD_SIZE),
+			std::invalid_argument
+		);
+
+	}
+
+}
+
+TEST_CASE("DAQCap::BlobEncoder", "[BlobCodec]") {
+
+	vector<uint8_t> data = makeStream(10000);
+
+	SECTION("BlobEncoder rejects empty blocks") {
+
+		REQUIRE_THROWS_AS(BlobEncoder(0), std::invalid_argument);
+
+	}
+
+	SECTION("BlobEncoder emits complete blocks as data arrives") {
+
+		BlobEncoder encoder(1000);
+		vector<uint8_t> encoded;
+
+		encoder.encode(ByteView(data.data(), WORD_SIZE * 999), encoded);
+
+		REQUIRE(encoded.empty());
+
+		encoder.encode(
+			ByteView(data.data() + WORD_SIZE * 999, WORD_SIZE), 
+			encoded
+		);
+
+		REQUIRE_FALSE(encoded.empty());
+
+	}
+
+	SECTION("BlobEncoder handles words split across calls") {
+
+		BlobEncoder encoder(333);
+		vector<uint8_t> encoded;
+
+		// Feed the data in pieces that don't line up with word boundaries
+		size_t position = 0;
+		size_t piece = 1;
+		while(position < data.size()) {
+
+			size_t size = std::min(piece, data.size() - position);
+
+			encoder.encode(ByteView(data.data() + position, size), encoded);
+
+			position += size;
+			piece = piece * 3 % 97 + 1;
+
+		}
+
+		encoder.finish(encoded);
+
+		REQUIRE(decompressData(viewOf(encoded)) == data);
+
+	}
+
+	SECTION("BlobDecoder decodes blocks split across calls") {
+
+		BlobEncoder encoder(100);
+		vector<uint8_t> encoded;
+
+		encoder.encode(viewOf(data), encoded);
+		encoder.finish(encoded);
+
+		BlobDecoder decoder;
+		vector<uint8_t> decoded;
+
+		for(size_t position = 0; position < encoded.size(); position += 7) {
+
+			size_t size = std::min<size_t>(7, encoded.size() - position);
+
+			decoder.decode(ByteView(encoded.data() + position, size), decoded);
+
+		}
+
+		REQUIRE_FALSE(decoder.hasPartialBlock());
+		REQUIRE(decoded == data);
+
+	}
+
+}
@@ -0,0 +1,153 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <BlobIO.h>
+#include <PacketProcessor.h>
+
+#include "TestHelpers.h"
+
+#include <sstream>
+#include <cstdio>
+
+#include <unistd.h>
+
+using std::vector;
+using std::string;
+
+using namespace DAQCap;
+
+// Reads back everything written to a temporary file
+vector<uint8_t> readAll(FILE *file) {
+
+	int fd = fileno(file);
+
+	vector<uint8_t> contents(lseek(fd, 0, SEEK_END));
+
+	REQUIRE(pread(fd, contents.data(), contents.size(), 0) 
+		== (ssize_t)contents.size());
+
+	return contents;
+
+}
+
+TEST_CASE("DAQCap::writeBlob()", "[BlobIO]") {
+
+	PacketProcessor processor;
+
+	FILE *file = tmpfile();
+	REQUIRE(file);
+
+	SECTION("writeBlob() writes nothing for an empty blob") {
+
+		DataBlob blob;
+
+		REQUIRE(writeBlob(fileno(file), blob) == 0);
+		REQUIRE(readAll(file).empty());
+
+	}
+
+	SECTION("writeBlob() writes the same bytes as operator<<") {
+
+		DataBlob blob = makeBlob(processor, 3, 0);
+
+		std::ostringstream stream;
+		stream << blob;
+
+		REQUIRE(writeBlob(fileno(file), blob) == blob.size());
+
+		vector<uint8_t> contents = readAll(file);
+
+		REQUIRE(string(contents.begin(), contents.end()) == stream.str());
+
+	}
+
+	SECTION("writeBlob() throws for an invalid file descriptor") {
+
+		DataBlob blob = makeBlob(processor, 1, 0);
+
+		REQUIRE_THROWS_AS(writeBlob(-1, blob), std::runtime_error);
+
+	}
+
+	fclose(file);
+
+}
+
+TEST_CASE("DAQCap::writeBlobs()", "[BlobIO]") {
+
+	PacketProcessor processor;
+
+	FILE *file = tmpfile();
+	REQUIRE(file);
+
+	SECTION("writeBlobs() writes nothing for no blobs") {
+
+		REQUIRE(writeBlobs(fileno(file), vector<DataBlob>()) == 0);
+		REQUIRE(readAll(file).empty());
+
+	}
+
+	SECTION("writeBlobs() writes blobs in order and skips empty blobs") {
+
+		vector<DataBlob> blobs;
+		blobs.push_back(makeBlob(processor, 2, 0));
+		blobs.push_back(DataBlob());
+		blobs.push_back(makeBlob(processor, 3, 2 * WORD_SIZE));
+
+		REQUIRE(writeBlobs(fileno(file), blobs) == 5 * WORD_SIZE);
+
+		vector<uint8_t> contents = readAll(file);
+
+		REQUIRE(contents.size() == 5 * WORD_SIZE);
+
+		for(int i = 0; i < contents.size(); ++i) {
+
+			REQUIRE(contents[i] == i);
+
+		}
+
+	}
+
+	SECTION("writeBlobs() handles more blobs than fit in one writev() call") {
+
+		vector<DataBlob> blobs;
+		for(int i = 0; i < 3000; ++i) {
+
+			blobs.push_back(makeBlob(processor, 1, i % 200));
+
+		}
+
+		REQUIRE(writeBlobs(fileno(file), blobs) == 3000 * WORD_SIZE);
+
+		vector<uint8_t> contents = readAll(file);
+
+		REQUIRE(contents.size() == 3000 * WORD_SIZE);
+		REQUIRE(contents[2999 * WORD_SIZE] == 2999 % 200);
+
+	}
+
+	fclose(file);
+
+}
+
+
+TEST_CASE("DAQCap::writeChain()", "[BlobIO]") {
+
+	PacketProcessor processor;
+
+	FILE *file = tmpfile();
+	REQUIRE(file);
+
+	BlobChain chain(makeBlob(processor, 2, 0));
+	chain.append(makeBlob(processor, 3, 2 * WORD_SIZE));
+
+	BlobChain tail = chain.split(1);
+
+	REQUIRE(writeChain(fileno(file), tail) == 4 * WORD_SIZE);
+
+	vector<uint8_t> contents = readAll(file);
+
+	REQUIRE(contents == tail.flatten());
+
+	fclose(file);
+
+}
\ No newline at end of file
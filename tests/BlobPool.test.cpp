@@ -0,0 +1,242 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <BlobPool.h>
+
+using namespace DAQCap;
+
+TEST_CASE("BlobPool::acquire()", "[BlobPool]") {
+
+	BlobPool pool;
+
+	SECTION("acquire() produces an empty blob with enough capacity") {
+
+		DataBlob blob;
+		pool.acquire(blob, 100);
+
+		REQUIRE(blob.empty());
+		REQUIRE(blob.packetCount() == 0);
+		REQUIRE(blob.warnings().empty());
+		REQUIRE(blob.data().capacity() >= 100);
+
+	}
+
+	SECTION("acquire() does not count the pool as a blob owner") {
+
+		DataBlob blob;
+		pool.acquire(blob, 100);
+
+		REQUIRE(pool.size() == 1);
+		REQUIRE(blob.useCount() == 1);
+
+	}
+
+	SECTION("acquire() reuses the buffer of a released blob") {
+
+		DataBlob blob;
+		pool.acquire(blob, 100);
+
+		const uint8_t *buffer = blob.data().data();
+
+		blob = DataBlob();
+
+		REQUIRE(pool.available() == 1);
+
+		DataBlob other;
+		pool.acquire(other, 100);
+
+		REQUIRE(other.data().data() == buffer);
+		REQUIRE(pool.size() == 1);
+
+	}
+
+	SECTION("acquire() reuses the buffer of the blob it is given") {
+
+		DataBlob blob;
+		pool.acquire(blob, 100);
+
+		const uint8_t *buffer = blob.data().data();
+
+		pool.acquire(blob, 100);
+
+		REQUIRE(blob.data().data() == buffer);
+		REQUIRE(pool.size() == 1);
+
+	}
+
+	SECTION("acquire() does not reuse buffers that are still shared") {
+
+		DataBlob blob;
+		pool.acquire(blob, 100);
+
+		DataBlob copy = blob;
+
+		pool.acquire(blob, 100);
+
+		REQUIRE(blob.data().data() != copy.data().data());
+		REQUIRE(copy.useCount() == 1);
+		REQUIRE(pool.size() == 2);
+		REQUIRE(pool.available() == 0);
+
+	}
+
+	SECTION("acquire() prefers the smallest buffer that is large enough") {
+
+		DataBlob large;
+		DataBlob small;
+		pool.acquire(large, 1000);
+		pool.acquire(small, 100);
+
+		const uint8_t *smallBuffer = small.data().data();
+		const uint8_t *largeBuffer = large.data().data();
+
+		large = DataBlob();
+		small = DataBlob();
+
+		DataBlob blob;
+		pool.acquire(blob, 50);
+
+		REQUIRE(blob.data().data() == smallBuffer);
+
+		DataBlob other;
+		pool.acquire(other, 200);
+
+		REQUIRE(other.data().data() == largeBuffer);
+
+	}
+
+	SECTION("acquire() hands out free buffers in turn") {
+
+		BlobPool largePool(3);
+
+		DataBlob blobs[3];
+		const uint8_t *buffers[3];
+		for(int i = 0; i < 3; ++i) {
+
+			largePool.acquire(blobs[i], 100);
+			buffers[i] = blobs[i].data().data();
+
+		}
+
+		for(DataBlob &blob : blobs) blob = DataBlob();
+
+		// Each search starts after the buffer handed out last
+		for(int round = 0; round < 2; ++round) {
+
+			for(int i = 0; i < 3; ++i) {
+
+				DataBlob blob;
+				largePool.acquire(blob, 100);
+
+				REQUIRE(blob.data().data() == buffers[i]);
+
+			}
+
+		}
+
+	}
+
+	SECTION("acquire() grows a free buffer rather than allocating another") {
+
+		DataBlob blob;
+		pool.acquire(blob, 100);
+
+		blob = DataBlob();
+
+		pool.acquire(blob, 1000);
+
+		REQUIRE(blob.data().capacity() >= 1000);
+		REQUIRE(pool.size() == 1);
+
+	}
+
+	SECTION("acquire() does not grow the pool past its maximum size") {
+
+		BlobPool smallPool(1);
+
+		DataBlob first;
+		DataBlob second;
+		smallPool.acquire(first, 100);
+		smallPool.acquire(second, 100);
+
+		REQUIRE(smallPool.size() == 1);
+		REQUIRE(second.data().capacity() >= 100);
+
+	}
+
+}
+
+TEST_CASE("BlobPool::setMaxBuffers()", "[BlobPool]") {
+
+	BlobPool pool(1);
+
+	DataBlob first;
+	DataBlob second;
+	pool.acquire(first, 100);
+
+	SECTION("setMaxBuffers() lets the pool grow") {
+
+		pool.setMaxBuffers(2);
+
+		pool.acquire(second, 100);
+
+		REQUIRE(pool.maxSize() == 2);
+		REQUIRE(pool.size() == 2);
+
+		first = DataBlob();
+		second = DataBlob();
+
+		REQUIRE(pool.available() == 2);
+
+	}
+
+	SECTION("setMaxBuffers() drops free buffers before used ones") {
+
+		pool.setMaxBuffers(2);
+
+		pool.acquire(second, 100);
+
+		const uint8_t *buffer = second.data().data();
+
+		first = DataBlob();
+
+		pool.setMaxBuffers(1);
+
+		REQUIRE(pool.size() == 1);
+		REQUIRE(pool.available() == 0);
+
+		// The remaining buffer is the one still in use
+		second = DataBlob();
+
+		DataBlob blob;
+		pool.acquire(blob, 100);
+
+		REQUIRE(blob.data().data() == buffer);
+
+	}
+
+	SECTION("setMaxBuffers() releases buffers still in use") {
+
+		pool.setMaxBuffers(0);
+
+		REQUIRE(pool.size() == 0);
+		REQUIRE(first.useCount() == 1);
+		REQUIRE(first.data().capacity() >= 100);
+
+	}
+
+}
+
+TEST_CASE("BlobPool::clear()", "[BlobPool]") {
+
+	BlobPool pool;
+
+	DataBlob blob;
+	pool.acquire(blob, 100);
+
+	pool.clear();
+
+	REQUIRE(pool.size() == 0);
+	REQUIRE(blob.useCount() == 1);
+	REQUIRE(blob.data().capacity() >= 100);
+
+}
@@ -0,0 +1,154 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <BlobWriter.h>
+#include <PacketProcessor.h>
+
+#include "TestHelpers.h"
+
+#include <stdexcept>
+#include <cstdio>
+
+#include <unistd.h>
+
+using std::vector;
+
+using namespace DAQCap;
+
+// Reads back everything written to a temporary file
+vector<uint8_t> readAll(FILE *file) {
+
+	int fd = fileno(file);
+
+	vector<uint8_t> contents(lseek(fd, 0, SEEK_END));
+
+	REQUIRE(pread(fd, contents.data(), contents.size(), 0) 
+		== (ssize_t)contents.size());
+
+	return contents;
+
+}
+
+TEST_CASE("BlobWriter", "[BlobWriter]") {
+
+	PacketProcessor processor;
+
+	FILE *file = tmpfile();
+	REQUIRE(file);
+
+	SECTION("BlobWriter rejects a zero queue capacity") {
+
+		REQUIRE_THROWS_AS(BlobWriter(fileno(file), 0), std::invalid_argument);
+
+	}
+
+	SECTION("BlobWriter writes blobs in order") {
+
+		vector<uint8_t> expected;
+
+		{
+
+			BlobWriter writer(fileno(file), 4);
+
+			for(int i = 0; i < 100; ++i) {
+
+				DataBlob blob = makeBlob(processor, i % 7, i);
+
+				expected.insert(
+					expected.end(), 
+					blob.data().begin(), 
+					blob.data().end()
+				);
+
+				writer.write(blob);
+
+			}
+
+			writer.close();
+
+			REQUIRE(writer.bytesWritten() == expected.size());
+			REQUIRE(writer.queueDepth() == 0);
+			REQUIRE(writer.maxQueueDepth() >= 1);
+			REQUIRE(writer.maxQueueDepth() <= 8);
+
+		}
+
+		REQUIRE(readAll(file) == expected);
+
+	}
+
+	SECTION("flush() waits for queued blobs to be written") {
+
+		BlobWriter writer(fileno(file));
+
+		DataBlob blob = makeBlob(processor, 10, 0);
+
+		writer.write(blob);
+		writer.write(blob);
+		writer.flush();
+
+		REQUIRE(writer.queueDepth() == 0);
+		REQUIRE(writer.bytesWritten() == 2 * blob.size());
+		REQUIRE(readAll(file).size() == 2 * blob.size());
+
+	}
+
+	SECTION("Written blobs are released") {
+
+		BlobWriter writer(fileno(file));
+
+		DataBlob blob = makeBlob(processor, 10, 0);
+
+		writer.write(blob);
+		writer.flush();
+
+		REQUIRE(blob.useCount() == 1);
+
+	}
+
+	SECTION("The destructor writes queued blobs") {
+
+		DataBlob blob = makeBlob(processor, 10, 0);
+
+		{
+
+			BlobWriter writer(fileno(file));
+
+			writer.write(blob);
+
+		}
+
+		REQUIRE(readAll(file) == blob.data());
+
+	}
+
+	SECTION("Writing to a closed writer throws") {
+
+		BlobWriter writer(fileno(file));
+
+		writer.close();
+
+		REQUIRE_THROWS_AS(
+			writer.write(makeBlob(processor, 1, 0)), 
+			std::runtime_error
+		);
+
+	}
+
+	SECTION("Write errors are reported to the caller") {
+
+		BlobWriter writer(-1);
+
+		writer.write(makeBlob(processor, 1, 0));
+
+		REQUIRE_THROWS_AS(writer.flush(), std::runtime_error);
+		REQUIRE_THROWS_AS(
+			writer.write(makeBlob(processor, 1, 0)), 
+			std::runtime_error
+		);
+		REQUIRE_THROWS_AS(writer.close(), std::runtime_error);
+
+	}
+
+	fclose(file);
+
+}
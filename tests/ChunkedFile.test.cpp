@@ -0,0 +1,547 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <ChunkedFile.h>
+#include <BlobWriter.h>
+#include <PacketProcessor.h>
+
+#include "ByteOrder.h"
+#include "Crc32c.h"
+#include "TestHelpers.h"
+
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <random>
+#include <cstdlib>
+
+#include <unistd.h>
+#include <fcntl.h>
+
+using std::vector;
+using std::string;
+
+using namespace DAQCap;
+
+namespace {
+
+	std::unique_ptr<ChunkedFileSink> openChunked(
+		const string &path,
+		uint64_t chunkSize,
+		ChunkCodec codec = ChunkCodec::None,
+		unsigned threads = 0
+	) {
+
+		ChunkedFileOptions options;
+		options.chunkSize = chunkSize;
+		options.codec = codec;
+		options.compressionThreads = threads;
+
+		return std::unique_ptr<ChunkedFileSink>(
+			new ChunkedFileSink(FileSink::open(path), options)
+		);
+
+	}
+
+	vector<uint8_t> readAll(const ChunkedFileReader &reader) {
+
+		vector<uint8_t> data;
+
+		for(size_t i = 0; i < reader.chunkCount(); ++i) {
+
+			vector<uint8_t> chunk = reader.readChunk(i);
+
+			data.insert(data.end(), chunk.begin(), chunk.end());
+
+		}
+
+		return data;
+
+	}
+
+}
+
+TEST_CASE("Chunked files", "[ChunkedFile]") {
+
+	string path = makeTempFile();
+
+	SECTION("Data survives a round trip") {
+
+		std::unique_ptr<ChunkedFileSink> sink = openChunked(path, 100);
+
+		vector<uint8_t> expected = writeRun(*sink, 10, 10);
+
+		sink->close();
+
+		REQUIRE(sink->chunks().size() == 5);
+		REQUIRE(sink->bytesWritten() == expected.size());
+
+		ChunkedFileReader reader(path);
+
+		REQUIRE(!reader.recovered());
+		REQUIRE(reader.chunkCount() == 5);
+		REQUIRE(readAll(reader) == expected);
+
+	}
+
+	SECTION("Chunks describe their packets") {
+
+		std::unique_ptr<ChunkedFileSink> sink = openChunked(path, 100);
+
+		writeRun(*sink, 6, 10);
+		sink->close();
+
+		ChunkedFileReader reader(path);
+
+		REQUIRE(reader.chunkCount() == 3);
+
+		for(size_t i = 0; i < reader.chunkCount(); ++i) {
+
+			const ChunkInfo &chunk = reader.chunk(i);
+
+			REQUIRE(chunk.dataSize == 100);
+			REQUIRE(chunk.wordCount == 20);
+			REQUIRE(chunk.blobCount == 2);
+			REQUIRE(chunk.firstPacket == 2 * i);
+			REQUIRE(chunk.packetCount == 2);
+			REQUIRE(chunk.firstSequence == (int)(2 * i));
+			REQUIRE(chunk.lastSequence == (int)(2 * i + 1));
+			REQUIRE(chunk.firstArrival == secondsAfterEpoch(2 * i));
+			REQUIRE(chunk.lastArrival == secondsAfterEpoch(2 * i + 1));
+
+		}
+
+		REQUIRE_THROWS_AS(reader.chunk(3), std::out_of_range);
+		REQUIRE_THROWS_AS(reader.readChunk(3), std::out_of_range);
+
+	}
+
+	SECTION("Lost packets are counted in packet positions") {
+
+		PacketProcessor processor;
+
+		std::unique_ptr<ChunkedFileSink> sink = openChunked(path, 1);
+
+		sink->write(vector<DataBlob>{makeBlob(processor, 0, 2, 0)});
+		sink->write(vector<DataBlob>{makeBlob(processor, 5, 2, 0)});
+		sink->write(vector<DataBlob>{makeBlob(processor, 6, 2, 0)});
+		sink->close();
+
+		ChunkedFileReader reader(path);
+
+		REQUIRE(reader.chunkCount() == 3);
+		REQUIRE(reader.chunk(1).packetCount == 5);
+		REQUIRE(reader.chunk(2).firstPacket == 6);
+
+		REQUIRE(reader.findPacket(0) == 0);
+		REQUIRE(reader.findPacket(3) == 1);
+		REQUIRE(reader.findPacket(6) == 2);
+		REQUIRE(reader.findPacket(7) == 3);
+
+	}
+
+	SECTION("Chunks can be found by packet and time") {
+
+		std::unique_ptr<ChunkedFileSink> sink = openChunked(path, 100);
+
+		writeRun(*sink, 100, 10);
+		sink->close();
+
+		ChunkedFileReader reader(path);
+
+		REQUIRE(reader.chunkCount() == 50);
+
+		for(uint64_t packet = 0; packet < 100; ++packet) {
+
+			REQUIRE(reader.findPacket(packet) == packet / 2);
+			REQUIRE(
+				reader.findTime(secondsAfterEpoch(packet)) == packet / 2
+			);
+
+		}
+
+		REQUIRE(reader.findPacket(100) == reader.chunkCount());
+		REQUIRE(reader.findTime(secondsAfterEpoch(100)) == reader.chunkCount());
+		REQUIRE(reader.findTime(Timestamp()) == 0);
+
+	}
+
+	SECTION("flush() finishes the current chunk") {
+
+		std::unique_ptr<ChunkedFileSink> sink = openChunked(path, 1 << 20);
+
+		vector<uint8_t> expected = writeRun(*sink, 3, 10);
+
+		REQUIRE(sink->chunks().empty());
+
+		sink->flush();
+
+		REQUIRE(sink->chunks().size() == 1);
+
+		vector<uint8_t> more = writeRun(*sink, 2, 10);
+		expected.insert(expected.end(), more.begin(), more.end());
+
+		sink->close();
+
+		ChunkedFileReader reader(path);
+
+		REQUIRE(reader.chunkCount() == 2);
+		REQUIRE(readAll(reader) == expected);
+
+	}
+
+	SECTION("Raw data is chunked too") {
+
+		std::unique_ptr<ChunkedFileSink> sink = openChunked(path, 50);
+
+		vector<uint8_t> data(120);
+		std::iota(data.begin(), data.end(), 0);
+
+		sink->write(ByteView(data.data(), 30));
+		sink->write(ByteView(data.data() + 30, 90));
+		sink->close();
+
+		ChunkedFileReader reader(path);
+
+		REQUIRE(reader.chunkCount() == 1);
+		REQUIRE(reader.chunk(0).firstSequence == -1);
+		REQUIRE(reader.chunk(0).wordCount == 24);
+		REQUIRE(readAll(reader) == data);
+
+	}
+
+	SECTION("Files without an index are recovered") {
+
+		std::unique_ptr<ChunkedFileSink> sink = openChunked(path, 100);
+
+		vector<uint8_t> expected = writeRun(*sink, 10, 10);
+		sink->close();
+
+		// Cut the file partway through the last chunk, as if the recorder
+		// had stopped while writing it
+		uint64_t cut = sink->chunks().back().offset + 30;
+		REQUIRE(truncate(path.data(), cut) == 0);
+
+		ChunkedFileReader reader(path);
+
+		REQUIRE(reader.recovered());
+		REQUIRE(reader.chunkCount() == 4);
+
+		expected.resize(400);
+		REQUIRE(readAll(reader) == expected);
+
+	}
+
+	SECTION("Corrupt chunks are detected") {
+
+		std::unique_ptr<ChunkedFileSink> sink = openChunked(path, 100);
+
+		writeRun(*sink, 4, 10);
+		sink->close();
+
+		int fd = ::open(path.data(), O_RDWR);
+		REQUIRE(fd >= 0);
+
+		uint8_t byte = 0xFF;
+		REQUIRE(pwrite(fd, &byte, 1, sink->chunks()[1].offset + 7) == 1);
+
+		::close(fd);
+
+		ChunkedFileReader reader(path);
+
+		REQUIRE_NOTHROW(reader.readChunk(0));
+		REQUIRE_THROWS_AS(reader.readChunk(1), std::runtime_error);
+
+	}
+
+	SECTION("Files that aren't chunked are rejected") {
+
+		int fd = ::open(path.data(), O_WRONLY);
+		REQUIRE(fd >= 0);
+
+		vector<uint8_t> junk(100, 0xAB);
+		REQUIRE(::write(fd, junk.data(), junk.size()) == 100);
+
+		::close(fd);
+
+		REQUIRE_THROWS_AS(ChunkedFileReader(path), std::runtime_error);
+		REQUIRE_THROWS_AS(
+			ChunkedFileReader(path + ".missing"),
+			std::runtime_error
+		);
+
+	}
+
+	SECTION("Works with a BlobWriter") {
+
+		PacketProcessor processor;
+
+		vector<uint8_t> expected;
+
+		{
+
+			std::unique_ptr<ChunkedFileSink> sink = openChunked(path, 256);
+			BlobWriter writer(*sink, 4);
+
+			for(int i = 0; i < 50; ++i) {
+
+				DataBlob blob = makeBlob(processor, i, 9, i);
+
+				expected.insert(
+					expected.end(),
+					blob.view().begin(),
+					blob.view().end()
+				);
+
+				writer.write(blob);
+
+			}
+
+			writer.close();
+			sink->close();
+
+		}
+
+		ChunkedFileReader reader(path);
+
+		REQUIRE(readAll(reader) == expected);
+		REQUIRE(reader.chunk(reader.chunkCount() - 1).lastSequence == 49);
+
+	}
+
+	SECTION("Version 1 files can still be read") {
+
+		vector<uint8_t> data(50);
+		std::iota(data.begin(), data.end(), 0);
+
+		vector<uint8_t> file;
+		putU32(file, 0x46435144);
+		putU16(file, 1);
+		putU16(file, 16);
+		putU64(file, 100);
+
+		// A version 1 chunk header has no codec or stored size
+		size_t header = file.size();
+		putU32(file, 0x4B435144);
+		putU32(file, crc32c(data.data(), data.size()));
+		putU64(file, data.size());
+		putU64(file, 10);
+		putU64(file, 0);
+		putU64(file, 0);
+		putU32(file, uint32_t(-1));
+		putU32(file, uint32_t(-1));
+		putU64(file, 0);
+		putU64(file, 0);
+		putU32(file, 0);
+		putU32(file, crc32c(&file[header], file.size() - header));
+
+		file.insert(file.end(), data.begin(), data.end());
+
+		int fd = ::open(path.data(), O_WRONLY);
+		REQUIRE(fd >= 0);
+		REQUIRE(::write(fd, file.data(), file.size()) == (ssize_t)file.size());
+		::close(fd);
+
+		ChunkedFileReader reader(path);
+
+		REQUIRE(reader.chunkCount() == 1);
+		REQUIRE(reader.chunk(0).codec == ChunkCodec::None);
+		REQUIRE(reader.chunk(0).storedSize == data.size());
+		REQUIRE(readAll(reader) == data);
+
+	}
+
+	SECTION("Invalid options are rejected") {
+
+		REQUIRE_THROWS_AS(
+			ChunkedFileSink(std::unique_ptr<FileSink>()),
+			std::invalid_argument
+		);
+		REQUIRE_THROWS_AS(openChunked(path, 0), std::invalid_argument);
+
+		if(!ChunkedFileSink::supportsCodec(ChunkCodec::Zstd)) {
+
+			REQUIRE_THROWS_AS(
+				openChunked(path, 100, ChunkCodec::Zstd),
+				std::runtime_error
+			);
+
+		}
+
+	}
+
+	unlink(path.data());
+
+}
+
+TEST_CASE("Compressed chunked files", "[ChunkedFile]") {
+
+	string path = makeTempFile();
+
+	SECTION("Compressed chunks survive a round trip in order") {
+
+		std::unique_ptr<ChunkedFileSink> sink = openChunked(
+			path, 
+			1000, 
+			ChunkCodec::Blob, 
+			3
+		);
+
+		vector<uint8_t> expected = writeRun(*sink, 200, 100);
+
+		sink->close();
+
+		ChunkedFileReader reader(path);
+
+		REQUIRE(reader.chunkCount() == 100);
+		REQUIRE(readAll(reader) == expected);
+
+		for(size_t i = 0; i < reader.chunkCount(); ++i) {
+
+			const ChunkInfo &chunk = reader.chunk(i);
+
+			REQUIRE(chunk.codec == ChunkCodec::Blob);
+			REQUIRE(chunk.storedSize < chunk.dataSize);
+			REQUIRE(chunk.firstSequence == (int)(2 * i));
+
+		}
+
+	}
+
+	SECTION("Chunks that don't compress are stored as they are") {
+
+		std::unique_ptr<ChunkedFileSink> sink = openChunked(
+			path, 
+			1000, 
+			ChunkCodec::Blob
+		);
+
+		std::mt19937 random(7);
+
+		vector<uint8_t> data(5000);
+		for(uint8_t &byte : data) byte = random();
+
+		for(size_t i = 0; i < data.size(); i += 1000) {
+
+			sink->write(ByteView(data.data() + i, 1000));
+
+		}
+
+		sink->close();
+
+		ChunkedFileReader reader(path);
+
+		REQUIRE(reader.chunkCount() == 5);
+		REQUIRE(reader.chunk(0).codec == ChunkCodec::None);
+		REQUIRE(reader.chunk(0).storedSize == reader.chunk(0).dataSize);
+		REQUIRE(readAll(reader) == data);
+
+	}
+
+	SECTION("flush() waits for every chunk to be written") {
+
+		std::unique_ptr<ChunkedFileSink> sink = openChunked(
+			path, 
+			100, 
+			ChunkCodec::Blob, 
+			2
+		);
+
+		writeRun(*sink, 40, 20);
+
+		sink->flush();
+
+		REQUIRE(sink->chunks().size() == 40);
+
+		for(size_t i = 1; i < sink->chunks().size(); ++i) {
+
+			const ChunkInfo &previous = sink->chunks()[i - 1];
+
+			REQUIRE(sink->chunks()[i].offset > previous.offset 
+				+ previous.storedSize);
+
+		}
+
+	}
+
+	SECTION("Files without an index are recovered") {
+
+		std::unique_ptr<ChunkedFileSink> sink = openChunked(
+			path, 
+			1000, 
+			ChunkCodec::Blob
+		);
+
+		vector<uint8_t> expected = writeRun(*sink, 10, 100);
+		sink->close();
+
+		uint64_t cut = sink->chunks().back().offset + 1;
+		REQUIRE(truncate(path.data(), cut) == 0);
+
+		ChunkedFileReader reader(path);
+
+		REQUIRE(reader.recovered());
+		REQUIRE(reader.chunkCount() == 4);
+
+		expected.resize(4000);
+		REQUIRE(readAll(reader) == expected);
+
+	}
+
+	SECTION("Corrupt compressed chunks are detected") {
+
+		std::unique_ptr<ChunkedFileSink> sink = openChunked(
+			path, 
+			1000, 
+			ChunkCodec::Blob
+		);
+
+		writeRun(*sink, 4, 100);
+		sink->close();
+
+		int fd = ::open(path.data(), O_RDWR);
+		REQUIRE(fd >= 0);
+
+		const ChunkInfo &chunk = sink->chunks()[1];
+
+		vector<uint8_t> stored(chunk.storedSize);
+		REQUIRE(pread(fd, stored.data(), stored.size(), chunk.offset) 
+			== (ssize_t)stored.size());
+
+		for(uint8_t &byte : stored) byte ^= 0x55;
+
+		REQUIRE(pwrite(fd, stored.data(), stored.size(), chunk.offset) 
+			== (ssize_t)stored.size());
+
+		::close(fd);
+
+		ChunkedFileReader reader(path);
+
+		REQUIRE_NOTHROW(reader.readChunk(0));
+		REQUIRE_THROWS_AS(reader.readChunk(1), std::runtime_error);
+
+	}
+
+	SECTION("zstd chunks survive a round trip") {
+
+		if(!ChunkedFileSink::supportsCodec(ChunkCodec::Zstd)) return;
+
+		std::unique_ptr<ChunkedFileSink> sink = openChunked(
+			path, 
+			1000, 
+			ChunkCodec::Zstd, 
+			2
+		);
+
+		vector<uint8_t> expected = writeRun(*sink, 20, 100);
+		sink->close();
+
+		ChunkedFileReader reader(path);
+
+		REQUIRE(reader.chunk(0).codec == ChunkCodec::Zstd);
+		REQUIRE(readAll(reader) == expected);
+
+	}
+
+	unlink(path.data());
+
+}
\ No newline at end of file
@@ -0,0 +1,125 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <Crc32c.h>
+
+#include <numeric>
+#include <string>
+#include <vector>
+
+using std::vector;
+using std::string;
+
+using namespace DAQCap;
+
+namespace {
+
+	// Computes a CRC32C one bit at a time
+	uint32_t referenceCrc(const uint8_t *data, size_t size) {
+
+		uint32_t crc = 0xFFFFFFFF;
+
+		for(size_t i = 0; i < size; ++i) {
+
+			crc ^= data[i];
+
+			for(int bit = 0; bit < 8; ++bit) {
+
+				crc = (crc >> 1) ^ (0x82F63B78 & (0 - (crc & 1)));
+
+			}
+
+		}
+
+		return ~crc;
+
+	}
+
+}
+
+TEST_CASE("crc32c()", "[Crc32c]") {
+
+	SECTION("crc32c() matches known checksums") {
+
+		string check = "123456789";
+
+		REQUIRE(
+			crc32c(reinterpret_cast<const uint8_t*>(check.data()), 9)
+				== 0xE3069283
+		);
+
+		vector<uint8_t> zeros(32, 0);
+		REQUIRE(crc32c(zeros.data(), zeros.size()) == 0x8A9136AA);
+
+		vector<uint8_t> ones(32, 0xFF);
+		REQUIRE(crc32c(ones.data(), ones.size()) == 0x62A8AB43);
+
+	}
+
+	SECTION("crc32c() matches a bitwise CRC at any length and alignment") {
+
+		INFO("Hardware CRC: " << (crc32cAccelerated() ? "yes" : "no"));
+
+		vector<uint8_t> data(300);
+		std::iota(data.begin(), data.end(), 7);
+
+		for(size_t offset = 0; offset < 8; ++offset) {
+
+			for(size_t size = 0; size + offset <= data.size(); size += 3) {
+
+				REQUIRE(
+					crc32c(data.data() + offset, size)
+						== referenceCrc(data.data() + offset, size)
+				);
+
+			}
+
+		}
+
+	}
+
+	SECTION("crc32c() of nothing is 0") {
+
+		REQUIRE(crc32c(nullptr, 0) == 0);
+
+	}
+
+	SECTION("crc32c() can be computed piece by piece") {
+
+		vector<uint8_t> data(1000);
+		std::iota(data.begin(), data.end(), 0);
+
+		uint32_t whole = crc32c(data.data(), data.size());
+
+		for(size_t split : {1, 7, 8, 9, 500, 999}) {
+
+			uint32_t first = crc32c(data.data(), split);
+
+			REQUIRE(
+				crc32c(data.data() + split, data.size() - split, first)
+					== whole
+			);
+
+		}
+
+	}
+
+	SECTION("crc32c() detects single-bit errors") {
+
+		vector<uint8_t> data(100);
+		std::iota(data.begin(), data.end(), 0);
+
+		uint32_t original = crc32c(data.data(), data.size());
+
+		for(size_t byte = 0; byte < data.size(); byte += 13) {
+
+			data[byte] ^= 0x10;
+
+			REQUIRE(crc32c(data.data(), data.size()) != original);
+
+			data[byte] ^= 0x10;
+
+		}
+
+	}
+
+}
\ No newline at end of file
@@ -1,16 +1,33 @@
 #include <catch2/catch_test_macros.hpp>
 
 #include <DAQBlob.h>
+#include <WordPacking.h>
 
 #include <thread>
 #include <numeric>
 #include <sstream>
+#include <random>
 
 using std::vector;
 
 const size_t WORD_SIZE = 5;
 
 using namespace DAQCap;
+
+// Packs a word one byte at a time, for comparison with the fast paths
+Word referenceWord(const uint8_t *data) {
+
+	Word word = 0;
+	for(size_t byte = 0; byte < WORD_SIZE; ++byte) {
+
+		word = (word << 8) | data[byte];
+
+	}
+
+	return word;
+
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
@@ -93,4 +110,139 @@ TEST_CASE("DAQCap::packData()") {
 
 	}
 
+	SECTION("packData() is correct for every input length up to 64 words") {
+
+		std::mt19937 generator(12345);
+		std::uniform_int_distribution<int> byteDistribution(0, 255);
+
+		vector<uint8_t> data(WORD_SIZE * 64 + WORD_SIZE - 1);
+		for(uint8_t &byte : data) byte = byteDistribution(generator);
+
+		for(size_t size = 0; size <= data.size(); ++size) {
+
+			vector<Word> packedData = packData(
+				vector<uint8_t>(data.begin(), data.begin() + size)
+			);
+
+			REQUIRE(packedData.size() == size / WORD_SIZE);
+
+			for(size_t i = 0; i < packedData.size(); ++i) {
+
+				REQUIRE(packedData[i] == referenceWord(&data[i * WORD_SIZE]));
+
+			}
+
+		}
+
+	}
+
+	SECTION("packData() accepts a ByteView") {
+
+		vector<uint8_t> data(WORD_SIZE * 3);
+
+		std::iota(data.begin(), data.end(), 0);
+
+		vector<Word> packedData = packData(ByteView(data.data(), data.size()));
+
+		REQUIRE(packedData == packData(data));
+
+	}
+
+}
+
+TEST_CASE("DAQCap::packWords()") {
+
+	SECTION("packWords() does not write past the requested words") {
+
+		vector<uint8_t> data(WORD_SIZE * 9, 0xAB);
+		vector<Word> out(10, 0);
+
+		packWords(data.data(), 9, out.data());
+
+		REQUIRE(out[8] == 0xABABABABAB);
+		REQUIRE(out[9] == 0);
+
+	}
+
+	SECTION("packWords() handles unaligned input") {
+
+		vector<uint8_t> data(WORD_SIZE * 20 + 1);
+
+		std::iota(data.begin(), data.end(), 0);
+
+		vector<Word> out(20);
+
+		packWords(data.data() + 1, 20, out.data());
+
+		for(size_t i = 0; i < out.size(); ++i) {
+
+			REQUIRE(out[i] == referenceWord(&data[1 + i * WORD_SIZE]));
+
+		}
+
+	}
+
+	SECTION("packWord() packs a single word") {
+
+		uint8_t data[WORD_SIZE] = {0x12, 0x34, 0x56, 0x78, 0x9A};
+
+		REQUIRE(packWord(data) == 0x123456789A);
+
+	}
+
+}
+
+TEST_CASE("DAQCap::ByteView") {
+
+	SECTION("Default ByteView is empty") {
+
+		ByteView view;
+
+		REQUIRE(view.empty());
+		REQUIRE(view.size() == 0);
+		REQUIRE(view.begin() == view.end());
+
+	}
+
+	SECTION("ByteView refers to the viewed bytes without copying") {
+
+		vector<uint8_t> data(WORD_SIZE * 2);
+
+		std::iota(data.begin(), data.end(), 0);
+
+		ByteView view(data.data(), data.size());
+
+		REQUIRE(view.data() == data.data());
+		REQUIRE(view.size() == data.size());
+		REQUIRE(vector<uint8_t>(view.begin(), view.end()) == data);
+
+	}
+
+}
+
+TEST_CASE("DataBlob accessors") {
+
+	DataBlob blob;
+
+	SECTION("Default DataBlob is empty") {
+
+		REQUIRE(blob.empty());
+		REQUIRE(blob.size() == 0);
+		REQUIRE(blob.data().empty());
+		REQUIRE(blob.warnings().empty());
+		REQUIRE(blob.view().empty());
+		REQUIRE(blob.useCount() == 0);
+
+	}
+
+	SECTION("Default DataBlob writes nothing to a stream") {
+
+		std::ostringstream stream;
+
+		stream << blob;
+
+		REQUIRE(stream.str().empty());
+
+	}
+
 }
\ No newline at end of file
@@ -0,0 +1,450 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <FileSink.h>
+#include <BlobWriter.h>
+#include <PacketProcessor.h>
+
+#include "TestHelpers.h"
+
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <cstdlib>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+using std::vector;
+using std::string;
+
+using namespace DAQCap;
+
+namespace {
+
+	// Writes an assortment of data through a sink and checks the result
+	void checkSink(const FileSinkOptions &options) {
+
+		string path = makeTempFile();
+
+		vector<uint8_t> expected;
+
+		{
+
+			std::unique_ptr<FileSink> sink = FileSink::open(path, options);
+
+			for(size_t size : { 1, 4095, 4096, 4097, 20000, 3, 0, 9000 }) {
+
+				vector<uint8_t> data(size);
+				std::iota(data.begin(), data.end(), expected.size());
+
+				sink->write(ByteView(data.data(), data.size()));
+
+				expected.insert(expected.end(), data.begin(), data.end());
+
+			}
+
+			PacketProcessor processor;
+
+			vector<DataBlob> blobs;
+			blobs.push_back(makeBlob(processor, 10, 0));
+			blobs.push_back(makeBlob(processor, 3, 100));
+
+			sink->write(blobs);
+
+			for(const DataBlob &blob : blobs) {
+
+				expected.insert(
+					expected.end(), 
+					blob.data().begin(), 
+					blob.data().end()
+				);
+
+			}
+
+			REQUIRE(sink->bytesWritten() == expected.size());
+
+			sink->flush();
+
+			REQUIRE(readFile(path) == expected);
+
+			sink->write(ByteView(expected.data(), 10));
+			expected.insert(
+				expected.end(), 
+				expected.begin(), 
+				expected.begin() + 10
+			);
+
+			sink->close();
+
+			REQUIRE_THROWS_AS(
+				sink->write(ByteView(expected.data(), 1)), 
+				std::runtime_error
+			);
+
+		}
+
+		REQUIRE(readFile(path) == expected);
+
+		unlink(path.data());
+
+	}
+
+}
+
+TEST_CASE("FileSink", "[FileSink]") {
+
+	SECTION("FileSink writes data in order") {
+
+		checkSink(FileSinkOptions());
+
+	}
+
+	SECTION("FileSink::open() fails for a bad path") {
+
+		REQUIRE_THROWS_AS(
+			FileSink::open("/nonexistent/directory/file.dat"),
+			std::runtime_error
+		);
+
+	}
+
+	SECTION("FileSink works with BlobWriter") {
+
+		string path = makeTempFile();
+
+		PacketProcessor processor;
+		DataBlob blob = makeBlob(processor, 100, 0);
+
+		std::unique_ptr<FileSink> sink = FileSink::open(path);
+
+		BlobWriter writer(*sink);
+
+		writer.write(blob);
+		writer.write(blob);
+		writer.flush();
+
+		vector<uint8_t> contents = readFile(path);
+
+		REQUIRE(contents.size() == 2 * blob.size());
+
+		writer.close();
+		sink->close();
+
+		unlink(path.data());
+
+	}
+
+}
+
+TEST_CASE("FileSink preallocation", "[FileSink]") {
+
+	string path = makeTempFile();
+
+	FileSinkOptions options;
+	options.preallocateBytes = 1 << 24;
+
+	SECTION("Preallocation does not change the file's contents") {
+
+		checkSink(options);
+
+	}
+
+	SECTION("Unused preallocated space is released on close") {
+
+		std::unique_ptr<FileSink> sink = FileSink::open(path, options);
+
+		vector<uint8_t> data(1000, 7);
+		sink->write(ByteView(data.data(), data.size()));
+		sink->flush();
+
+		struct stat info;
+		REQUIRE(stat(path.data(), &info) == 0);
+		REQUIRE(info.st_size == 1000);
+
+		sink->close();
+
+		REQUIRE(stat(path.data(), &info) == 0);
+		REQUIRE(info.st_size == 1000);
+		REQUIRE(info.st_blocks * 512 < options.preallocateBytes);
+
+	}
+
+	unlink(path.data());
+
+}
+
+TEST_CASE("FileSink writeback", "[FileSink]") {
+
+	FileSinkOptions options;
+	options.writebackBytes = 4096;
+
+	SECTION("Writeback does not change the file's contents") {
+
+		checkSink(options);
+
+	}
+
+	SECTION("Writeback does not change the file's contents with io_uring") {
+
+		if(!FileSink::supportsIOUring()) return;
+
+		options.useIOUring  = true;
+		options.bufferSize  = 4096;
+		options.bufferCount = 4;
+
+		checkSink(options);
+
+	}
+
+	SECTION("Writeback keeps up with larger writes") {
+
+		options.writebackBytes = 1 << 16;
+
+		string path = makeTempFile();
+
+		std::unique_ptr<FileSink> sink = FileSink::open(path, options);
+
+		vector<uint8_t> expected;
+		for(int i = 0; i < 64; ++i) {
+
+			vector<uint8_t> data(50000);
+			std::iota(data.begin(), data.end(), i);
+
+			sink->write(ByteView(data.data(), data.size()));
+
+			expected.insert(expected.end(), data.begin(), data.end());
+
+		}
+
+		sink->close();
+
+		REQUIRE(readFile(path) == expected);
+
+		unlink(path.data());
+
+	}
+
+}
+
+TEST_CASE("FileSink with direct I/O", "[FileSink]") {
+
+	FileSinkOptions options;
+	options.directIO = true;
+	options.bufferSize = 8192;
+
+	// Some file systems, such as tmpfs, don't support O_DIRECT
+	string path = makeTempFile();
+	bool supported = true;
+
+	try {
+
+		FileSink::open(path, options);
+
+	} catch(const std::runtime_error &e) {
+
+		supported = false;
+
+	}
+
+	unlink(path.data());
+
+	if(!supported) {
+
+		WARN("Direct I/O is not supported here. Skipping direct I/O tests.");
+		return;
+
+	}
+
+	SECTION("Direct sinks write data in order") {
+
+		checkSink(options);
+
+	}
+
+	SECTION("Direct sinks round odd buffer sizes up to whole blocks") {
+
+		options.bufferSize = 5000;
+
+		checkSink(options);
+
+	}
+
+	SECTION("Direct sinks support preallocation") {
+
+		options.preallocateBytes = 1 << 20;
+
+		checkSink(options);
+
+	}
+
+	SECTION("Direct sinks keep their preallocation across flushes") {
+
+		options.preallocateBytes = 1 << 20;
+
+		string path = makeTempFile();
+
+		std::unique_ptr<FileSink> sink = FileSink::open(path, options);
+
+		vector<uint8_t> data(1000, 7);
+		sink->write(ByteView(data.data(), data.size()));
+
+		// Flushing a partial block cuts the padding off the file
+		sink->flush();
+
+		struct stat info;
+		REQUIRE(stat(path.data(), &info) == 0);
+		REQUIRE(info.st_size == 1000);
+		REQUIRE(info.st_blocks * 512 >= options.preallocateBytes);
+
+		sink->close();
+
+		REQUIRE(readFile(path) == data);
+
+		unlink(path.data());
+
+	}
+
+	SECTION("Direct I/O can't be combined with io_uring") {
+
+		options.useIOUring = true;
+
+		string path = makeTempFile();
+
+		REQUIRE_THROWS_AS(FileSink::open(path, options), std::runtime_error);
+
+		unlink(path.data());
+
+	}
+
+}
+
+TEST_CASE("FileSink with io_uring", "[FileSink]") {
+
+	if(!FileSink::supportsIOUring()) {
+
+		WARN("io_uring is not supported here. Skipping io_uring tests.");
+		return;
+
+	}
+
+	FileSinkOptions options;
+	options.useIOUring = true;
+
+	SECTION("io_uring sinks write data in order") {
+
+		checkSink(options);
+
+	}
+
+	SECTION("io_uring sinks reuse their buffers") {
+
+		options.bufferSize  = 4096;
+		options.bufferCount = 2;
+
+		checkSink(options);
+
+	}
+
+	SECTION("io_uring sinks support preallocation") {
+
+		options.preallocateBytes = 1 << 20;
+
+		checkSink(options);
+
+	}
+
+	SECTION("io_uring sinks report failed writes") {
+
+		options.bufferSize  = 4096;
+		options.bufferCount = 4;
+
+		// Every write to /dev/full fails, so some fail while others are
+		// still in flight
+		std::unique_ptr<FileSink> sink = FileSink::open("/dev/full", options);
+
+		vector<uint8_t> data(1 << 20, 7);
+
+		REQUIRE_THROWS_AS(
+			[&]() {
+
+				sink->write(ByteView(data.data(), data.size()));
+				sink->close();
+
+			}(),
+			std::runtime_error
+		);
+
+		// Closing cleans up even though the sink has failed, and the sink
+		// can't be used afterwards
+		try {
+
+			sink->close();
+
+		} catch(const std::runtime_error &e) {}
+
+		REQUIRE_THROWS_AS(
+			sink->write(ByteView(data.data(), 1)),
+			std::runtime_error
+		);
+
+	}
+
+	SECTION("io_uring sinks reject empty buffers") {
+
+		options.bufferSize = 0;
+
+		string path = makeTempFile();
+
+		REQUIRE_THROWS_AS(
+			FileSink::open(path, options),
+			std::invalid_argument
+		);
+
+		unlink(path.data());
+
+	}
+
+	SECTION("io_uring sinks work with BlobWriter") {
+
+		string path = makeTempFile();
+
+		options.bufferSize  = 4096;
+		options.bufferCount = 4;
+
+		PacketProcessor processor;
+
+		vector<uint8_t> expected;
+
+		{
+
+			std::unique_ptr<FileSink> sink = FileSink::open(path, options);
+			BlobWriter writer(*sink, 4);
+
+			for(int i = 0; i < 200; ++i) {
+
+				DataBlob blob = makeBlob(processor, i % 50, i);
+
+				expected.insert(
+					expected.end(), 
+					blob.data().begin(), 
+					blob.data().end()
+				);
+
+				writer.write(blob);
+
+			}
+
+			writer.flush();
+
+			REQUIRE(readFile(path) == expected);
+
+		}
+
+		REQUIRE(readFile(path) == expected);
+
+		unlink(path.data());
+
+	}
+
+}
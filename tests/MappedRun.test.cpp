@@ -0,0 +1,293 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <MappedRun.h>
+#include <ChunkedFile.h>
+#include <PacketProcessor.h>
+
+#include "TestHelpers.h"
+
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <mutex>
+#include <cstdlib>
+
+#include <unistd.h>
+#include <fcntl.h>
+
+using std::vector;
+using std::string;
+
+using namespace DAQCap;
+
+namespace {
+
+	void writeFile(const string &path, const vector<uint8_t> &data) {
+
+		int fd = ::open(path.data(), O_WRONLY | O_TRUNC);
+		REQUIRE(fd >= 0);
+
+		REQUIRE(::write(fd, data.data(), data.size()) == (ssize_t)data.size());
+
+		::close(fd);
+
+	}
+
+	// Writes a chunked file of blobs and returns their data
+	vector<uint8_t> writeChunked(const string &path, int blobs) {
+
+		ChunkedFileOptions options;
+		options.chunkSize = 100;
+
+		ChunkedFileSink sink(FileSink::open(path), options);
+
+		vector<uint8_t> expected = writeRun(sink, blobs, 7);
+
+		sink.close();
+
+		return expected;
+
+	}
+
+	// Decodes every chunk on several threads and puts the words back
+	// together
+	vector<Word> collect(const MappedRun &run, unsigned threads) {
+
+		vector<Word> words(run.size());
+		vector<int> visits(run.chunkCount(), 0);
+
+		std::mutex mutex;
+
+		run.forEachChunk(
+			[&](size_t chunk, const vector<Word> &decoded) {
+
+				std::lock_guard<std::mutex> lock(mutex);
+
+				++visits[chunk];
+
+				std::copy(
+					decoded.begin(),
+					decoded.end(),
+					words.begin() + run.chunkOffset(chunk)
+				);
+
+			},
+			threads
+		);
+
+		for(int count : visits) REQUIRE(count == 1);
+
+		return words;
+
+	}
+
+}
+
+TEST_CASE("MappedRun with .dat files", "[MappedRun]") {
+
+	string path = makeTempFile();
+
+	// 1000 words, plus a trailing partial word
+	vector<uint8_t> data(1000 * WORD_SIZE + 3);
+	std::iota(data.begin(), data.end(), 0);
+
+	writeFile(path, data);
+
+	vector<Word> expected = packData(data);
+
+	SECTION("Words can be read at random") {
+
+		MappedRun run(path);
+
+		REQUIRE(!run.chunked());
+		REQUIRE(run.size() == 1000);
+		REQUIRE(!run.empty());
+
+		for(uint64_t i = 0; i < run.size(); i += 37) {
+
+			REQUIRE(run[i] == expected[i]);
+			REQUIRE(run.at(i) == expected[i]);
+
+		}
+
+		REQUIRE_THROWS_AS(run.at(1000), std::out_of_range);
+
+	}
+
+	SECTION("Files are divided into chunks") {
+
+		MappedRun run(path, 300);
+
+		REQUIRE(run.chunkCount() == 4);
+		REQUIRE(run.chunk(0).size() == 300);
+		REQUIRE(run.chunk(3).size() == 100);
+		REQUIRE(run.chunkOffset(3) == 900);
+		REQUIRE(run.chunk(1)[0] == expected[300]);
+		REQUIRE(run.verifyChunk(2));
+
+		REQUIRE_THROWS_AS(run.chunk(4), std::out_of_range);
+
+	}
+
+	SECTION("decode() crosses chunk boundaries") {
+
+		MappedRun run(path, 64);
+
+		vector<Word> words(300);
+
+		REQUIRE(run.decode(50, 300, words.data()) == 300);
+		REQUIRE(
+			words == vector<Word>(expected.begin() + 50, expected.begin() + 350)
+		);
+
+		REQUIRE(run.decode(900, 300, words.data()) == 100);
+		REQUIRE(run.decode(1000, 10, words.data()) == 0);
+		REQUIRE_THROWS_AS(run.decode(1001, 1, words.data()), std::out_of_range);
+
+	}
+
+	SECTION("forEachChunk() visits every chunk once") {
+
+		MappedRun run(path, 64);
+
+		REQUIRE(collect(run, 1) == expected);
+		REQUIRE(collect(run, 4) == expected);
+		REQUIRE(collect(run, 0) == expected);
+
+	}
+
+	SECTION("forEachChunk() rethrows exceptions") {
+
+		MappedRun run(path, 64);
+
+		REQUIRE_THROWS_AS(
+			run.forEachChunk(
+				[](size_t chunk, const vector<Word>&) {
+
+					if(chunk == 5) throw std::logic_error("Failed");
+
+				},
+				4
+			),
+			std::logic_error
+		);
+
+	}
+
+	SECTION("Empty files have no words") {
+
+		writeFile(path, vector<uint8_t>());
+
+		MappedRun run(path);
+
+		REQUIRE(run.empty());
+		REQUIRE(run.chunkCount() == 0);
+
+		REQUIRE(collect(run, 4).empty());
+
+	}
+
+	SECTION("Bad arguments are rejected") {
+
+		REQUIRE_THROWS_AS(MappedRun(path, 0), std::invalid_argument);
+		REQUIRE_THROWS_AS(MappedRun(path + ".missing"), std::runtime_error);
+
+	}
+
+	unlink(path.data());
+
+}
+
+TEST_CASE("MappedRun with chunked files", "[MappedRun]") {
+
+	string path = makeTempFile();
+
+	vector<uint8_t> data = writeChunked(path, 20);
+	vector<Word> expected = packData(data);
+
+	SECTION("Chunked files keep their chunks") {
+
+		MappedRun run(path);
+
+		REQUIRE(run.chunked());
+		REQUIRE(run.size() == expected.size());
+		REQUIRE(run.chunkCount() == 7);
+
+		for(uint64_t i = 0; i < run.size(); ++i) {
+
+			REQUIRE(run[i] == expected[i]);
+
+		}
+
+		vector<Word> words(expected.size());
+		REQUIRE(run.decode(0, words.size(), words.data()) == words.size());
+		REQUIRE(words == expected);
+
+		REQUIRE(collect(run, 3) == expected);
+
+	}
+
+	SECTION("Corrupt chunks are detected") {
+
+		int fd = ::open(path.data(), O_RDWR);
+		REQUIRE(fd >= 0);
+
+		ChunkedFileReader reader(path);
+
+		uint8_t byte = 0xFF;
+		REQUIRE(pwrite(fd, &byte, 1, reader.chunk(2).offset + 1) == 1);
+
+		::close(fd);
+
+		MappedRun run(path);
+
+		REQUIRE(run.verifyChunk(1));
+		REQUIRE(!run.verifyChunk(2));
+
+		REQUIRE_THROWS_AS(
+			run.forEachChunk([](size_t, const vector<Word>&) {}, 2),
+			std::runtime_error
+		);
+
+	}
+
+	SECTION("Chunks ending in a partial word still verify") {
+
+		ChunkedFileSink sink(FileSink::open(path), ChunkedFileOptions());
+
+		// Two whole words and two stray bytes
+		vector<uint8_t> bytes(2 * WORD_SIZE + 2);
+		std::iota(bytes.begin(), bytes.end(), 1);
+
+		sink.write(ByteView(bytes.data(), bytes.size()));
+		sink.close();
+
+		MappedRun run(path);
+
+		REQUIRE(run.size() == 2);
+		REQUIRE(run.verifyChunk(0));
+
+		REQUIRE_NOTHROW(
+			run.forEachChunk([](size_t, const vector<Word>&) {}, 1)
+		);
+
+	}
+
+	SECTION("Compressed chunked files are rejected") {
+
+		ChunkedFileOptions options;
+		options.codec = ChunkCodec::Blob;
+
+		ChunkedFileSink sink(FileSink::open(path), options);
+
+		vector<uint8_t> zeros(1000, 0);
+		sink.write(ByteView(zeros.data(), zeros.size()));
+		sink.close();
+
+		REQUIRE_THROWS_AS(MappedRun(path), std::runtime_error);
+
+	}
+
+	unlink(path.data());
+
+}
\ No newline at end of file
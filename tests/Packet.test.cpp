@@ -62,6 +62,45 @@ TEST_CASE("Packet::size()", "[Packet]") {
 
 }
 
+TEST_CASE("Packet::getTimestamp()", "[Packet]") {
+
+	vector<uint8_t> data(PRELOAD + POSTLOAD, 0);
+
+	SECTION("Packet timestamp defaults to the epoch") {
+
+		Packet packet(data.data(), data.size());
+
+		REQUIRE(
+			packet.getTimestamp() == std::chrono::system_clock::time_point()
+		);
+
+	}
+
+	SECTION("Packet stores its timestamp") {
+
+		std::chrono::system_clock::time_point timestamp 
+			= std::chrono::system_clock::now();
+
+		Packet packet(data.data(), data.size(), timestamp);
+
+		REQUIRE(packet.getTimestamp() == timestamp);
+
+	}
+
+}
+
+TEST_CASE("Packet::getRawSize()", "[Packet]") {
+
+	size_t packetSize = 10;
+	vector<uint8_t> data(PRELOAD + POSTLOAD + packetSize, 0);
+
+	Packet packet(data.data(), data.size());
+
+	REQUIRE(packet.getRawSize() == data.size());
+	REQUIRE(packet.size() == packetSize);
+
+}
+
 TEST_CASE("Packet::getPacketNumber()", "[Packet]") {
 
 	size_t packetSize = 10;
@@ -3,6 +3,7 @@
 #include <PacketProcessor.h>
 
 #include <numeric>
+#include <stdexcept>
 
 using std::vector;
 
@@ -65,6 +66,11 @@ TEST_CASE("PacketProcessor::blobify()", "[PacketProcessor]") {
 		REQUIRE(blob.packetCount() == 2);
 		REQUIRE(blob.data().size() == size * blob.packetCount());
 
+		// Views refer to the blob's own buffer rather than a copy
+		REQUIRE(blob.size() == blob.data().size());
+		REQUIRE(blob.view().data() == blob.data().data());
+		REQUIRE(blob.view().size() == blob.data().size());
+
 		for(int i = 0; i < blob.data().size(); ++i) {
 
 			REQUIRE(blob.data()[i] == i);
@@ -73,6 +79,32 @@ TEST_CASE("PacketProcessor::blobify()", "[PacketProcessor]") {
 
 	}
 
+	SECTION("blobify() produces blobs that share data when copied") {
+
+		vector<uint8_t> data(PRELOAD + POSTLOAD + WORD_SIZE * 2, 0);
+
+		packets.emplace_back(data.data(), data.size());
+
+		DataBlob blob = processor.blobify(packets);
+		packets.clear();
+
+		REQUIRE(blob.useCount() == 1);
+
+		DataBlob copy = blob;
+
+		REQUIRE(blob.useCount() == 2);
+		REQUIRE(copy.view().data() == blob.view().data());
+		REQUIRE(copy.packetCount() == blob.packetCount());
+
+		// Reassigning one copy leaves the other intact
+		copy = DataBlob();
+
+		REQUIRE(blob.useCount() == 1);
+		REQUIRE(copy.useCount() == 0);
+		REQUIRE(blob.size() == WORD_SIZE * 2);
+
+	}
+
 	SECTION("blobify() succeeds with partial words") {
 
 		int FIRST_VAL  = 1;
@@ -445,7 +477,7 @@ TEST_CASE("PacketProcessor::blobify()", "[PacketProcessor]") {
 
 			for(uint8_t i = 0; i < blob.data().size(); ++i) {
 
-				blob.data()[i] = 0;
+				REQUIRE(blob.data()[i] == 0);
 
 			}
 
@@ -453,4 +485,274 @@ TEST_CASE("PacketProcessor::blobify()", "[PacketProcessor]") {
 
 	}
 
-}
\ No newline at end of file
+}
+
+TEST_CASE("PacketProcessor::blobify() into an existing blob", "[PacketProcessor]") {
+
+	PacketProcessor processor;
+	vector<Packet> packets;
+
+	vector<uint8_t> data(PRELOAD + POSTLOAD + WORD_SIZE * 3, 0);
+	std::iota(data.begin() + PRELOAD, data.end() - POSTLOAD, 0);
+
+	packets.emplace_back(data.data(), data.size());
+
+	SECTION("blobify() produces the same data as a fresh blob") {
+
+		DataBlob blob;
+		processor.blobify(packets, blob);
+
+		PacketProcessor other;
+		DataBlob fresh = other.blobify(packets);
+
+		REQUIRE(blob.packetCount() == fresh.packetCount());
+		REQUIRE(blob.data() == fresh.data());
+
+	}
+
+	SECTION("blobify() reuses the buffer of the blob it is given") {
+
+		DataBlob blob;
+		processor.blobify(packets, blob);
+
+		const uint8_t *buffer = blob.data().data();
+
+		processor.blobify(packets, blob);
+
+		REQUIRE(blob.data().data() == buffer);
+		REQUIRE(blob.size() == WORD_SIZE * 3);
+
+	}
+
+	SECTION("blobify() leaves copies of the blob it is given intact") {
+
+		DataBlob blob;
+		processor.blobify(packets, blob);
+
+		DataBlob copy = blob;
+
+		packets.clear();
+		processor.blobify(packets, blob);
+
+		REQUIRE(blob.empty());
+		REQUIRE(copy.size() == WORD_SIZE * 3);
+
+	}
+
+	SECTION("blobify() recycles buffers of released blobs") {
+
+		DataBlob blob = processor.blobify(packets);
+
+		const uint8_t *buffer = blob.data().data();
+
+		blob = DataBlob();
+
+		blob = processor.blobify(packets);
+
+		REQUIRE(blob.data().data() == buffer);
+
+	}
+
+}
+
+
+TEST_CASE("PacketProcessor::blobify() metadata", "[PacketProcessor]") {
+
+	PacketProcessor processor;
+	vector<Packet> packets;
+
+	SECTION("blobify() records empty metadata for no packets") {
+
+		DataBlob blob = processor.blobify(packets);
+
+		REQUIRE(blob.metadata().firstSequence == -1);
+		REQUIRE(blob.metadata().lastSequence == -1);
+		REQUIRE(blob.metadata().rawBytes == 0);
+		REQUIRE(blob.metadata().idleWordsRemoved == 0);
+
+	}
+
+	SECTION("blobify() records packet statistics") {
+
+		std::chrono::system_clock::time_point start 
+			= std::chrono::system_clock::now();
+
+		vector<uint8_t> data (PRELOAD + POSTLOAD + WORD_SIZE * 2, 0);
+		vector<uint8_t> data2(PRELOAD + POSTLOAD + WORD_SIZE * 3, 0xFF);
+
+		data [data .size() - 1] = 7;
+		data2[data2.size() - 2] = 0;
+		data2[data2.size() - 1] = 8;
+
+		packets.emplace_back(data .data(), data .size(), start);
+		packets.emplace_back(
+			data2.data(), 
+			data2.size(), 
+			start + std::chrono::seconds(1)
+		);
+
+		CaptureStats stats;
+		stats.framesRejected = 2;
+		stats.kernelDrops = 3;
+
+		DataBlob blob;
+		processor.blobify(packets, blob, stats);
+
+		const BlobMetadata &metadata = blob.metadata();
+
+		REQUIRE(metadata.firstArrival == start);
+		REQUIRE(metadata.lastArrival == start + std::chrono::seconds(1));
+		REQUIRE(metadata.firstSequence == 7);
+		REQUIRE(metadata.lastSequence == 8);
+		REQUIRE(metadata.rawBytes == data.size() + data2.size());
+		REQUIRE(metadata.idleWordsRemoved == 3);
+		REQUIRE(metadata.framesRejected == 2);
+		REQUIRE(metadata.kernelDrops == 3);
+		REQUIRE(metadata.processingTime.count() >= 0);
+
+	}
+
+	SECTION("blobify() resets metadata when reusing a blob") {
+
+		vector<uint8_t> data(PRELOAD + POSTLOAD + WORD_SIZE, 0xFF);
+
+		packets.emplace_back(data.data(), data.size());
+
+		DataBlob blob;
+		processor.blobify(packets, blob);
+
+		REQUIRE(blob.metadata().idleWordsRemoved == 1);
+
+		packets.clear();
+		processor.blobify(packets, blob);
+
+		REQUIRE(blob.metadata().idleWordsRemoved == 0);
+		REQUIRE(blob.metadata().rawBytes == 0);
+
+	}
+
+}
+TEST_CASE("PacketProcessor::blobify() packet index", "[PacketProcessor]") {
+
+	PacketProcessor processor;
+	vector<Packet> packets;
+
+	// Packet 1 holds a data word, an idle word and the start of a word that
+	// finishes in packet 2. Packet 2 also holds one more word. Packets 3
+	// and 4 are lost before packet 5, which holds one word.
+	vector<uint8_t> data (PRELOAD + POSTLOAD + WORD_SIZE * 2 + 2, 0);
+	vector<uint8_t> data2(PRELOAD + POSTLOAD + WORD_SIZE + 3, 0);
+	vector<uint8_t> data3(PRELOAD + POSTLOAD + WORD_SIZE, 0);
+
+	std::iota(data .begin() + PRELOAD, data .end() - POSTLOAD, 0);
+	std::iota(data2.begin() + PRELOAD, data2.end() - POSTLOAD, 20);
+	std::iota(data3.begin() + PRELOAD, data3.end() - POSTLOAD, 40);
+
+	std::fill(
+		data.begin() + PRELOAD + WORD_SIZE, 
+		data.begin() + PRELOAD + WORD_SIZE * 2, 
+		0xFF
+	);
+
+	data [data .size() - 1] = 1;
+	data2[data2.size() - 1] = 2;
+	data3[data3.size() - 1] = 5;
+
+	packets.emplace_back(data .data(), data .size());
+	packets.emplace_back(data2.data(), data2.size());
+	packets.emplace_back(data3.data(), data3.size());
+
+	SECTION("blobify() does not index packets by default") {
+
+		REQUIRE_FALSE(processor.packetIndexing());
+
+		DataBlob blob = processor.blobify(packets);
+
+		REQUIRE(blob.packetIndex().empty());
+		REQUIRE_THROWS_AS(blob.packetView(0), std::out_of_range);
+
+	}
+
+	SECTION("blobify() records gaps whether or not indexing is enabled") {
+
+		DataBlob blob = processor.blobify(packets);
+
+		REQUIRE(blob.gaps().size() == 1);
+		REQUIRE(blob.gaps()[0].previousSequence == 2);
+		REQUIRE(blob.gaps()[0].nextSequence == 5);
+		REQUIRE(blob.gaps()[0].missing == 2);
+		REQUIRE(blob.gaps()[0].wordOffset == 3);
+
+	}
+
+	SECTION("blobify() attributes words to the packet they finish in") {
+
+		processor.setPacketIndexing(true);
+
+		DataBlob blob = processor.blobify(packets);
+
+		const vector<PacketIndexEntry> &entries = blob.packetIndex();
+
+		REQUIRE(blob.size() == WORD_SIZE * 4);
+		REQUIRE(entries.size() == 3);
+
+		REQUIRE(entries[0].sequence == 1);
+		REQUIRE(entries[0].wordOffset == 0);
+		REQUIRE(entries[0].wordCount == 1);
+
+		REQUIRE(entries[1].sequence == 2);
+		REQUIRE(entries[1].wordOffset == 1);
+		REQUIRE(entries[1].wordCount == 2);
+
+		REQUIRE(entries[2].sequence == 5);
+		REQUIRE(entries[2].wordOffset == 3);
+		REQUIRE(entries[2].wordCount == 1);
+
+	}
+
+	SECTION("packetView() refers to a packet's data in the blob") {
+
+		processor.setPacketIndexing(true);
+
+		DataBlob blob = processor.blobify(packets);
+
+		ByteView view = blob.packetView(1);
+
+		REQUIRE(view.data() == blob.view().data() + WORD_SIZE);
+		REQUIRE(view.size() == WORD_SIZE * 2);
+
+		// The split word starts with the end of packet 1
+		REQUIRE(view[0] == 10);
+		REQUIRE(view[2] == 20);
+		REQUIRE(view[WORD_SIZE * 2 - 1] == 27);
+
+		REQUIRE_THROWS_AS(blob.packetView(3), std::out_of_range);
+
+	}
+
+	SECTION("Words finished in a later blob belong to its first packet") {
+
+		processor.setPacketIndexing(true);
+
+		packets.pop_back();
+		packets.pop_back();
+
+		DataBlob blob = processor.blobify(packets);
+
+		REQUIRE(blob.packetIndex().size() == 1);
+		REQUIRE(blob.packetIndex()[0].wordCount == 1);
+
+		packets.clear();
+		packets.emplace_back(data2.data(), data2.size());
+
+		processor.blobify(packets, blob);
+
+		REQUIRE(blob.packetIndex().size() == 1);
+		REQUIRE(blob.packetIndex()[0].sequence == 2);
+		REQUIRE(blob.packetIndex()[0].wordOffset == 0);
+		REQUIRE(blob.packetIndex()[0].wordCount == 2);
+		REQUIRE(blob.gaps().empty());
+
+	}
+
+}
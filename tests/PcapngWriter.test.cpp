@@ -0,0 +1,259 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <PcapngWriter.h>
+
+#include "ByteOrder.h"
+#include "TestHelpers.h"
+
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <cstdlib>
+
+#include <unistd.h>
+#include <fcntl.h>
+
+using std::vector;
+using std::string;
+
+using namespace DAQCap;
+
+namespace {
+
+	// A block read back from a pcapng file
+	struct Block {
+
+		uint32_t type;
+		vector<uint8_t> body;
+
+	};
+
+	// Splits a file into blocks, checking that their lengths agree
+	vector<Block> readBlocks(const string &path) {
+
+		vector<uint8_t> file = readFile(path);
+
+		vector<Block> blocks;
+
+		size_t offset = 0;
+		while(offset < file.size()) {
+
+			REQUIRE(file.size() - offset >= 12);
+
+			uint32_t length = loadU32(&file[offset + 4]);
+
+			REQUIRE(length % 4 == 0);
+			REQUIRE(offset + length <= file.size());
+			REQUIRE(loadU32(&file[offset + length - 4]) == length);
+
+			Block block;
+			block.type = loadU32(&file[offset]);
+			block.body.assign(
+				file.begin() + offset + 8,
+				file.begin() + offset + length - 4
+			);
+
+			blocks.push_back(block);
+
+			offset += length;
+
+		}
+
+		return blocks;
+
+	}
+
+	// Finds an option in a list of options and returns its value
+	vector<uint8_t> findOption(
+		const vector<uint8_t> &body,
+		size_t offset,
+		uint16_t code
+	) {
+
+		while(offset + 4 <= body.size()) {
+
+			uint16_t optionCode = loadU16(&body[offset]);
+			uint16_t length = loadU16(&body[offset + 2]);
+
+			if(optionCode == 0) break;
+
+			if(optionCode == code) {
+
+				return vector<uint8_t>(
+					body.begin() + offset + 4,
+					body.begin() + offset + 4 + length
+				);
+
+			}
+
+			offset += 4 + ((length + 3) & ~3);
+
+		}
+
+		return vector<uint8_t>();
+
+	}
+
+	string asString(const vector<uint8_t> &bytes) {
+
+		return string(bytes.begin(), bytes.end());
+
+	}
+
+}
+
+TEST_CASE("PcapngWriter", "[PcapngWriter]") {
+
+	string path = makeTempFile();
+
+	PcapngInterface link;
+	link.snapLength = 9000;
+	link.name = "eth1";
+	link.description = "miniDAQ link";
+
+	SECTION("Files start with a section header and interface") {
+
+		PcapngWriter writer(FileSink::open(path), link);
+		writer.close();
+
+		vector<Block> blocks = readBlocks(path);
+
+		REQUIRE(blocks.size() == 2);
+
+		REQUIRE(blocks[0].type == 0x0A0D0D0A);
+		REQUIRE(loadU32(&blocks[0].body[0]) == 0x1A2B3C4D);
+		REQUIRE(loadU16(&blocks[0].body[4]) == 1);
+		REQUIRE(loadU16(&blocks[0].body[6]) == 0);
+
+		REQUIRE(blocks[1].type == 1);
+		REQUIRE(loadU16(&blocks[1].body[0]) == 1);
+		REQUIRE(loadU32(&blocks[1].body[4]) == 9000);
+		REQUIRE(asString(findOption(blocks[1].body, 8, 2)) == "eth1");
+		REQUIRE(asString(findOption(blocks[1].body, 8, 3)) == "miniDAQ link");
+		REQUIRE(findOption(blocks[1].body, 8, 9) == vector<uint8_t>{9});
+
+	}
+
+	SECTION("Frames are recorded with nanosecond timestamps") {
+
+		Timestamp time(
+			std::chrono::duration_cast<Timestamp::duration>(
+				std::chrono::nanoseconds(1700000000123456789LL)
+			)
+		);
+
+		uint64_t nanoseconds = std::chrono::duration_cast<
+			std::chrono::nanoseconds
+		>(time.time_since_epoch()).count();
+
+		vector<vector<uint8_t>> frames;
+
+		{
+
+			PcapngWriter writer(FileSink::open(path), link);
+
+			for(size_t size : {60, 61, 62, 63, 64, 1500}) {
+
+				vector<uint8_t> frame(size);
+				std::iota(frame.begin(), frame.end(), size);
+
+				writer.writeFrame(
+					ByteView(frame.data(), frame.size()),
+					size + 4,
+					time
+				);
+
+				frames.push_back(frame);
+
+			}
+
+			REQUIRE(writer.framesWritten() == 6);
+
+			writer.close();
+
+		}
+
+		vector<Block> blocks = readBlocks(path);
+
+		REQUIRE(blocks.size() == 2 + frames.size());
+
+		for(size_t i = 0; i < frames.size(); ++i) {
+
+			const Block &block = blocks[2 + i];
+
+			REQUIRE(block.type == 6);
+			REQUIRE(loadU32(&block.body[0]) == 0);
+
+			uint64_t stamp = (uint64_t(loadU32(&block.body[4])) << 32)
+				| loadU32(&block.body[8]);
+
+			REQUIRE(stamp == nanoseconds);
+			REQUIRE(loadU32(&block.body[12]) == frames[i].size());
+			REQUIRE(loadU32(&block.body[16]) == frames[i].size() + 4);
+
+			REQUIRE(
+				vector<uint8_t>(
+					block.body.begin() + 20,
+					block.body.begin() + 20 + frames[i].size()
+				) == frames[i]
+			);
+
+		}
+
+	}
+
+	SECTION("Frames are written in buffered blocks") {
+
+		// A buffer that holds a few frames at a time, and is smaller than
+		// the last frame
+		PcapngWriter writer(FileSink::open(path), link, 512);
+
+		vector<uint8_t> frame(100, 0xAB);
+
+		for(int i = 0; i < 20; ++i) {
+
+			writer.writeFrame(
+				ByteView(frame.data(), frame.size()),
+				frame.size(),
+				Timestamp()
+			);
+
+		}
+
+		vector<uint8_t> big(2000, 0xCD);
+		writer.writeFrame(ByteView(big.data(), big.size()), 2000, Timestamp());
+
+		// Most frames have been written, but some are still buffered
+		size_t written = readBlocks(path).size();
+		REQUIRE(written > 2);
+		REQUIRE(written <= 2 + 21);
+
+		writer.flush();
+
+		REQUIRE(readBlocks(path).size() == 2 + 21);
+
+		writer.close();
+
+		REQUIRE_THROWS_AS(
+			writer.writeFrame(
+				ByteView(frame.data(), frame.size()),
+				frame.size(),
+				Timestamp()
+			),
+			std::runtime_error
+		);
+
+	}
+
+	SECTION("Writers need a sink") {
+
+		REQUIRE_THROWS_AS(
+			PcapngWriter(std::unique_ptr<FileSink>(), link),
+			std::invalid_argument
+		);
+
+	}
+
+	unlink(path.data());
+
+}
\ No newline at end of file
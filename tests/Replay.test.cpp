@@ -0,0 +1,420 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <Replay.h>
+#include <ChunkedFile.h>
+#include <PcapngWriter.h>
+#include <PacketProcessor.h>
+
+#include "TestHelpers.h"
+
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <cstdlib>
+#include <cstdio>
+
+#include <unistd.h>
+#include <fcntl.h>
+
+using std::vector;
+using std::string;
+
+using namespace DAQCap;
+
+namespace {
+
+	void writeFile(const string &path, const vector<uint8_t> &data) {
+
+		FILE *file = std::fopen(path.data(), "wb");
+		REQUIRE(file != nullptr);
+
+		REQUIRE(std::fwrite(data.data(), 1, data.size(), file) == data.size());
+
+		std::fclose(file);
+
+	}
+
+	// Words of consecutive byte values, which never form an idle word
+	vector<uint8_t> makeWords(int words, uint8_t first) {
+
+		vector<uint8_t> data(words * WORD_SIZE);
+
+		std::iota(data.begin(), data.end(), first);
+
+		return data;
+
+	}
+
+	// Builds a miniDAQ frame holding words
+	vector<uint8_t> makeFrame(const vector<uint8_t> &words, int sequence) {
+
+		vector<uint8_t> raw(PRELOAD, 0);
+
+		raw.insert(raw.end(), words.begin(), words.end());
+
+		raw.push_back(0);
+		raw.push_back(0);
+		raw.push_back((sequence >> 8) & 0xFF);
+		raw.push_back(sequence & 0xFF);
+
+		return raw;
+
+	}
+
+	vector<Frame> readAll(FrameSource &source) {
+
+		vector<Frame> frames;
+
+		Frame frame;
+		while(source.next(frame)) frames.push_back(frame);
+
+		return frames;
+
+	}
+
+	int packetNumber(const Frame &frame) {
+
+		size_t size = frame.bytes.size();
+
+		return (frame.bytes[size - 2] << 8) | frame.bytes[size - 1];
+
+	}
+
+	// Gets the data words of a frame made from a run file
+	vector<uint8_t> frameWords(const Frame &frame) {
+
+		return vector<uint8_t>(
+			frame.bytes.begin() + PRELOAD,
+			frame.bytes.end() - POSTLOAD
+		);
+
+	}
+
+	void putBigEndian(vector<uint8_t> &out, uint32_t value) {
+
+		out.push_back(value >> 24);
+		out.push_back((value >> 16) & 0xFF);
+		out.push_back((value >> 8) & 0xFF);
+		out.push_back(value & 0xFF);
+
+	}
+
+}
+
+TEST_CASE("Replaying .dat files", "[Replay]") {
+
+	string path = makeTempFile();
+
+	// 10 words, then a partial word that can't be replayed
+	vector<uint8_t> data = makeWords(10, 0);
+	vector<uint8_t> file = data;
+	file.push_back(0);
+	file.push_back(0);
+
+	writeFile(path, file);
+
+	FrameSourceOptions options;
+	options.frameWords = 4;
+
+	std::unique_ptr<FrameSource> source = FrameSource::open(path, options);
+
+	REQUIRE(!source->timed());
+
+	SECTION("Data is split into miniDAQ frames") {
+
+		vector<Frame> frames = readAll(*source);
+
+		REQUIRE(frames.size() == 3);
+
+		vector<uint8_t> replayed;
+		for(size_t i = 0; i < frames.size(); ++i) {
+
+			const Frame &frame = frames[i];
+
+			REQUIRE(packetNumber(frame) == (int)i);
+			REQUIRE(frame.originalLength == frame.bytes.size());
+
+			// The capture filter matches the source address
+			const uint8_t SOURCE[] = {0xFF, 0xFF, 0xFF, 0xC7, 0x05, 0x01};
+			REQUIRE(vector<uint8_t>(frame.bytes.begin() + 6, frame.bytes.begin() + 12)
+				== vector<uint8_t>(SOURCE, SOURCE + 6));
+
+			vector<uint8_t> words = frameWords(frame);
+			replayed.insert(replayed.end(), words.begin(), words.end());
+
+		}
+
+		REQUIRE(frameWords(frames[0]).size() == 4 * WORD_SIZE);
+		REQUIRE(frameWords(frames[2]).size() == 2 * WORD_SIZE);
+		REQUIRE(replayed == data);
+
+	}
+
+	SECTION("Replayed frames are processed back into the original data") {
+
+		FrameBlobBuilder builder;
+
+		Frame frame;
+		while(source->next(frame)) builder.add(frame);
+
+		// Too short to be a miniDAQ packet
+		Frame runt;
+		runt.bytes.assign(10, 0);
+		builder.add(runt);
+
+		REQUIRE(builder.size() == 4);
+
+		DataBlob blob;
+		builder.build(blob);
+
+		REQUIRE(builder.size() == 0);
+		REQUIRE(blob.data() == data);
+		REQUIRE(blob.packetCount() == 3);
+		REQUIRE(blob.gaps().empty());
+		REQUIRE(blob.metadata().framesRejected == 1);
+
+	}
+
+	std::remove(path.data());
+
+}
+
+TEST_CASE("Replaying chunked files", "[Replay]") {
+
+	string path = makeTempFile();
+
+	PacketProcessor processor;
+
+	ChunkedFileOptions chunkOptions;
+	chunkOptions.chunkSize = 100;
+
+	ChunkedFileSink sink(FileSink::open(path), chunkOptions);
+
+	vector<uint8_t> data;
+	for(int i = 0; i < 4; ++i) {
+
+		vector<uint8_t> words = makeWords(10, i);
+
+		data.insert(data.end(), words.begin(), words.end());
+
+		sink.write(vector<DataBlob>{makeBlob(processor, i + 7, 10, i)});
+
+	}
+
+	sink.close();
+
+	FrameSourceOptions options;
+	options.frameWords = 5;
+
+	std::unique_ptr<FrameSource> source = FrameSource::open(path, options);
+
+	REQUIRE(source->timed());
+
+	vector<Frame> frames = readAll(*source);
+
+	REQUIRE(frames.size() == 8);
+
+	vector<uint8_t> replayed;
+	for(size_t i = 0; i < frames.size(); ++i) {
+
+		// Packet numbers pick up where the capture's did
+		REQUIRE(packetNumber(frames[i]) == (int)(i + 7));
+
+		vector<uint8_t> words = frameWords(frames[i]);
+		replayed.insert(replayed.end(), words.begin(), words.end());
+
+	}
+
+	REQUIRE(replayed == data);
+
+	// Frames span the times their chunks were captured over
+	REQUIRE(frames[0].time == secondsAfterEpoch(7));
+	REQUIRE(frames[3].time == secondsAfterEpoch(8));
+	REQUIRE(frames[4].time == secondsAfterEpoch(9));
+	REQUIRE(frames[7].time == secondsAfterEpoch(10));
+	REQUIRE(frames[1].time > frames[0].time);
+	REQUIRE(frames[2].time < frames[3].time);
+
+	std::remove(path.data());
+
+}
+
+TEST_CASE("Replaying pcap files", "[Replay]") {
+
+	string path = makeTempFile();
+
+	SECTION("pcapng files are read as they were recorded") {
+
+		vector<vector<uint8_t>> expected;
+		vector<Timestamp> times;
+
+		{
+
+			PcapngWriter writer(FileSink::open(path), PcapngInterface());
+
+			for(int i = 0; i < 5; ++i) {
+
+				expected.push_back(makeFrame(makeWords(i + 1, i), i));
+				times.push_back(
+					secondsAfterEpoch(1000 + i) + std::chrono::microseconds(i)
+				);
+
+				writer.writeFrame(
+					ByteView(expected.back().data(), expected.back().size()),
+					expected.back().size() + i,
+					times.back()
+				);
+
+			}
+
+			writer.close();
+
+		}
+
+		std::unique_ptr<FrameSource> source = FrameSource::open(path);
+
+		REQUIRE(source->timed());
+
+		vector<Frame> frames = readAll(*source);
+
+		REQUIRE(frames.size() == expected.size());
+
+		for(size_t i = 0; i < frames.size(); ++i) {
+
+			REQUIRE(frames[i].bytes == expected[i]);
+			REQUIRE(frames[i].originalLength == expected[i].size() + i);
+			REQUIRE(frames[i].time == times[i]);
+
+		}
+
+	}
+
+	SECTION("Classic pcap files are read in either byte order") {
+
+		vector<uint8_t> frame = makeFrame(makeWords(3, 0), 42);
+
+		// A big-endian file with nanosecond timestamps
+		vector<uint8_t> file;
+		putBigEndian(file, 0xA1B23C4D);
+		file.push_back(0);
+		file.push_back(2);
+		file.push_back(0);
+		file.push_back(4);
+		putBigEndian(file, 0);
+		putBigEndian(file, 0);
+		putBigEndian(file, 65535);
+		putBigEndian(file, 1);
+
+		putBigEndian(file, 1234);
+		putBigEndian(file, 500);
+		putBigEndian(file, frame.size());
+		putBigEndian(file, frame.size());
+		file.insert(file.end(), frame.begin(), frame.end());
+
+		writeFile(path, file);
+
+		std::unique_ptr<FrameSource> source = FrameSource::open(path);
+
+		vector<Frame> frames = readAll(*source);
+
+		REQUIRE(frames.size() == 1);
+		REQUIRE(frames[0].bytes == frame);
+		REQUIRE(frames[0].time == secondsAfterEpoch(1234)
+			+ std::chrono::duration_cast<Timestamp::duration>(
+				std::chrono::nanoseconds(500)
+			));
+
+		// Truncate the frame
+		file.resize(file.size() - 3);
+		writeFile(path, file);
+
+		source = FrameSource::open(path);
+
+		Frame truncated;
+		REQUIRE_THROWS_AS(source->next(truncated), std::runtime_error);
+
+	}
+
+	std::remove(path.data());
+
+}
+
+TEST_CASE("Pacing replayed frames", "[Replay]") {
+
+	using namespace std::chrono;
+
+	Frame frame;
+	frame.bytes.assign(1000, 0);
+
+	SECTION("Timed frames keep their spacing") {
+
+		FramePacer pacer(2);
+
+		steady_clock::time_point start = steady_clock::now();
+
+		frame.time = secondsAfterEpoch(0);
+		pacer.wait(frame);
+
+		frame.time += milliseconds(100);
+		pacer.wait(frame);
+
+		// 100 ms apart at twice the speed
+		REQUIRE(steady_clock::now() - start >= milliseconds(50));
+
+	}
+
+	SECTION("Frames can be replayed at a fixed data rate") {
+
+		FramePacer pacer(1, 1e6);
+
+		steady_clock::time_point start = steady_clock::now();
+
+		for(int i = 0; i < 51; ++i) pacer.wait(frame);
+
+		// 50 frames of 1000 bytes must have been sent
+		REQUIRE(steady_clock::now() - start >= milliseconds(50));
+
+	}
+
+	SECTION("Frames can be replayed as fast as possible") {
+
+		FramePacer pacer(0);
+
+		steady_clock::time_point start = steady_clock::now();
+
+		frame.time = secondsAfterEpoch(0);
+		pacer.wait(frame);
+
+		frame.time += seconds(100);
+		pacer.wait(frame);
+
+		REQUIRE(steady_clock::now() - start < seconds(1));
+
+	}
+
+	SECTION("Negative rates are rejected") {
+
+		REQUIRE_THROWS_AS(FramePacer(-1), std::invalid_argument);
+		REQUIRE_THROWS_AS(FramePacer(1, -1), std::invalid_argument);
+
+	}
+
+}
+
+TEST_CASE("Opening recorded runs", "[Replay]") {
+
+	string path = makeTempFile();
+
+	FrameSourceOptions options;
+
+	options.frameWords = 0;
+	REQUIRE_THROWS_AS(FrameSource::open(path, options), std::invalid_argument);
+
+	options.frameWords = 20000;
+	REQUIRE_THROWS_AS(FrameSource::open(path, options), std::invalid_argument);
+
+	std::remove(path.data());
+
+	REQUIRE_THROWS_AS(FrameSource::open(path), std::runtime_error);
+
+}
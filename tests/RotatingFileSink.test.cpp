@@ -0,0 +1,407 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <RotatingFileSink.h>
+#include <BlobWriter.h>
+#include <PacketProcessor.h>
+
+#include "TestHelpers.h"
+
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <cstdlib>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+using std::vector;
+using std::string;
+
+using namespace DAQCap;
+
+namespace {
+
+	// Makes an empty temporary directory and returns its path
+	string makeTempDir() {
+
+		char path[] = "/tmp/DAQCapRotatingXXXXXX";
+
+		REQUIRE(mkdtemp(path) != nullptr);
+
+		return path;
+
+	}
+
+	string filePath(const string &dir, size_t index) {
+
+		return dir + "/run_" + std::to_string(index) + ".dat";
+
+	}
+
+	// Counts the files in a directory
+	size_t countFiles(const string &dir) {
+
+		DIR *handle = opendir(dir.data());
+		REQUIRE(handle != nullptr);
+
+		size_t count = 0;
+
+		while(dirent *entry = readdir(handle)) {
+
+			if(string(entry->d_name) != "." && string(entry->d_name) != "..") {
+
+				++count;
+
+			}
+
+		}
+
+		closedir(handle);
+
+		return count;
+
+	}
+
+	// Reads back the first count files and removes the directory
+	vector<vector<uint8_t>> readFiles(const string &dir, size_t count) {
+
+		vector<vector<uint8_t>> files;
+
+		for(size_t i = 0; i < count; ++i) {
+
+			files.push_back(readFile(filePath(dir, i)));
+
+		}
+
+		return files;
+
+	}
+
+	void removeDir(const string &dir) {
+
+		DIR *handle = opendir(dir.data());
+		REQUIRE(handle != nullptr);
+
+		while(dirent *entry = readdir(handle)) {
+
+			string name = entry->d_name;
+			if(name != "." && name != "..") unlink((dir + "/" + name).data());
+
+		}
+
+		closedir(handle);
+
+		rmdir(dir.data());
+
+	}
+
+}
+
+TEST_CASE("RotatingFileSink", "[RotatingFileSink]") {
+
+	string dir = makeTempDir();
+
+	RotatingFileSink::PathFunction pathFor = [&dir](size_t index) {
+
+		return filePath(dir, index);
+
+	};
+
+	RotationOptions rotation;
+
+	vector<uint8_t> data(100);
+	std::iota(data.begin(), data.end(), 0);
+
+	SECTION("Everything goes to one file without limits") {
+
+		RotatingFileSink sink(pathFor, rotation);
+
+		sink.write(ByteView(data.data(), data.size()));
+		sink.write(ByteView(data.data(), data.size()));
+
+		REQUIRE(sink.fileIndex() == 0);
+		REQUIRE(sink.currentPath() == filePath(dir, 0));
+		REQUIRE(sink.bytesWritten() == 200);
+
+		sink.close();
+
+		// The file prepared in advance is removed, since it's empty
+		REQUIRE(countFiles(dir) == 1);
+		REQUIRE(readFile(filePath(dir, 0)).size() == 200);
+
+	}
+
+	SECTION("Files end at word boundaries") {
+
+		rotation.maxBytes = 12;
+
+		RotatingFileSink sink(pathFor, rotation);
+
+		sink.write(ByteView(data.data(), data.size()));
+
+		REQUIRE(sink.fileIndex() == 9);
+		REQUIRE(sink.bytesWritten() == data.size());
+
+		sink.close();
+
+		REQUIRE(countFiles(dir) == 10);
+
+		vector<uint8_t> joined;
+
+		for(const vector<uint8_t> &file : readFiles(dir, 10)) {
+
+			REQUIRE(file.size() == 10);
+
+			joined.insert(joined.end(), file.begin(), file.end());
+
+		}
+
+		REQUIRE(joined == data);
+
+	}
+
+	SECTION("Writes continue across files") {
+
+		rotation.maxBytes = 50;
+
+		RotatingFileSink sink(pathFor, rotation);
+
+		sink.write(ByteView(data.data(), 35));
+		sink.write(ByteView(data.data() + 35, 35));
+		sink.write(ByteView(data.data() + 70, 30));
+
+		sink.close();
+
+		vector<vector<uint8_t>> files = readFiles(dir, 2);
+
+		REQUIRE(countFiles(dir) == 2);
+		REQUIRE(files[0] == vector<uint8_t>(data.begin(), data.begin() + 50));
+		REQUIRE(files[1] == vector<uint8_t>(data.begin() + 50, data.end()));
+
+	}
+
+	SECTION("Batches of blobs are split across files") {
+
+		rotation.maxBytes = 100;
+
+		PacketProcessor processor;
+
+		vector<DataBlob> blobs;
+		vector<uint8_t> expected;
+
+		for(int i = 0; i < 6; ++i) {
+
+			blobs.push_back(makeBlob(processor, 7, i * 35));
+
+			ByteView view = blobs.back().view();
+			expected.insert(expected.end(), view.begin(), view.end());
+
+		}
+
+		RotatingFileSink sink(pathFor, rotation);
+
+		sink.write(vector<DataBlob>(blobs.begin(), blobs.begin() + 2));
+		sink.write(vector<DataBlob>(blobs.begin() + 2, blobs.end()));
+
+		REQUIRE(sink.bytesWritten() == expected.size());
+
+		sink.close();
+
+		REQUIRE(countFiles(dir) == 3);
+
+		vector<uint8_t> joined;
+
+		for(const vector<uint8_t> &file : readFiles(dir, 3)) {
+
+			REQUIRE(file.size() % WORD_SIZE == 0);
+			REQUIRE(file.size() <= 100);
+
+			joined.insert(joined.end(), file.begin(), file.end());
+
+		}
+
+		REQUIRE(joined == expected);
+
+	}
+
+	SECTION("Files are rotated after the time limit") {
+
+		rotation.maxDuration = std::chrono::seconds(1);
+
+		RotatingFileSink sink(pathFor, rotation);
+
+		sink.write(ByteView(data.data(), 50));
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+
+		sink.write(ByteView(data.data() + 50, 50));
+
+		REQUIRE(sink.fileIndex() == 1);
+
+		sink.close();
+
+		vector<vector<uint8_t>> files = readFiles(dir, 2);
+
+		REQUIRE(files[0] == vector<uint8_t>(data.begin(), data.begin() + 50));
+		REQUIRE(files[1] == vector<uint8_t>(data.begin() + 50, data.end()));
+
+	}
+
+	SECTION("Files are preallocated") {
+
+		FileSinkOptions options;
+		options.preallocateBytes = 1 << 20;
+
+		rotation.maxBytes = 50;
+
+		RotatingFileSink sink(pathFor, rotation, options);
+
+		sink.write(ByteView(data.data(), data.size()));
+		sink.close();
+
+		vector<vector<uint8_t>> files = readFiles(dir, 2);
+
+		REQUIRE(countFiles(dir) == 2);
+		REQUIRE(files[0] == vector<uint8_t>(data.begin(), data.begin() + 50));
+		REQUIRE(files[1] == vector<uint8_t>(data.begin() + 50, data.end()));
+
+		struct stat info;
+		REQUIRE(stat(filePath(dir, 0).data(), &info) == 0);
+		REQUIRE(info.st_blocks * 512 < options.preallocateBytes);
+
+	}
+
+	SECTION("Works with a BlobWriter") {
+
+		rotation.maxBytes = 1000;
+
+		PacketProcessor processor;
+
+		vector<uint8_t> expected;
+
+		{
+
+			RotatingFileSink sink(pathFor, rotation);
+			BlobWriter writer(sink, 4);
+
+			for(int i = 0; i < 50; ++i) {
+
+				DataBlob blob = makeBlob(processor, 9, i);
+
+				ByteView view = blob.view();
+				expected.insert(expected.end(), view.begin(), view.end());
+
+				writer.write(blob);
+
+			}
+
+			writer.close();
+			sink.close();
+
+		}
+
+		size_t count = countFiles(dir);
+
+		REQUIRE(count == (expected.size() + 999) / 1000);
+
+		vector<uint8_t> joined;
+
+		for(const vector<uint8_t> &file : readFiles(dir, count)) {
+
+			joined.insert(joined.end(), file.begin(), file.end());
+
+		}
+
+		REQUIRE(joined == expected);
+
+	}
+
+	SECTION("Files must hold at least one word") {
+
+		rotation.maxBytes = WORD_SIZE - 1;
+
+		REQUIRE_THROWS_AS(
+			RotatingFileSink(pathFor, rotation),
+			std::invalid_argument
+		);
+
+	}
+
+	SECTION("Failing to open a file throws") {
+
+		RotatingFileSink::PathFunction missing = [&dir](size_t index) {
+
+			return dir + "/missing/run_" + std::to_string(index) + ".dat";
+
+		};
+
+		REQUIRE_THROWS_AS(
+			RotatingFileSink(missing, rotation),
+			std::runtime_error
+		);
+
+	}
+
+	SECTION("A failed rotation can be retried") {
+
+		rotation.maxBytes = 50;
+
+		// The first attempt to open the second file fails
+		int attempts = 0;
+
+		RotatingFileSink::PathFunction flaky = [&](size_t index) {
+
+			if(index == 1 && attempts++ == 0) {
+
+				return dir + "/missing/run_1.dat";
+
+			}
+
+			return filePath(dir, index);
+
+		};
+
+		RotatingFileSink sink(flaky, rotation);
+
+		REQUIRE_THROWS_AS(
+			sink.write(ByteView(data.data(), data.size())),
+			std::runtime_error
+		);
+
+		// The current file is kept
+		REQUIRE(sink.fileIndex() == 0);
+		REQUIRE(sink.bytesWritten() == 50);
+
+		sink.write(ByteView(data.data() + 50, 50));
+
+		REQUIRE(sink.fileIndex() == 1);
+
+		sink.close();
+
+		vector<vector<uint8_t>> files = readFiles(dir, 2);
+
+		REQUIRE(countFiles(dir) == 2);
+		REQUIRE(files[0] == vector<uint8_t>(data.begin(), data.begin() + 50));
+		REQUIRE(files[1] == vector<uint8_t>(data.begin() + 50, data.end()));
+
+	}
+
+	SECTION("Writing after closing throws") {
+
+		RotatingFileSink sink(pathFor, rotation);
+
+		sink.close();
+
+		REQUIRE_THROWS_AS(
+			sink.write(ByteView(data.data(), data.size())),
+			std::runtime_error
+		);
+
+	}
+
+	removeDir(dir);
+
+}
\ No newline at end of file
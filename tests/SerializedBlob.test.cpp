@@ -0,0 +1,341 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <SerializedBlob.h>
+#include <BlobIO.h>
+#include <PacketProcessor.h>
+
+#include "ByteOrder.h"
+
+#include <numeric>
+#include <stdexcept>
+#include <cstdio>
+
+#include <unistd.h>
+
+using std::vector;
+using std::string;
+
+using namespace DAQCap;
+
+const int PRELOAD = 14;
+const int POSTLOAD = 4;
+const int WORD_SIZE = 5;
+
+namespace {
+
+	// Builds a packet holding words of consecutive byte values
+	vector<uint8_t> makePacket(int words, uint8_t first, uint8_t sequence) {
+
+		vector<uint8_t> raw(PRELOAD + POSTLOAD + words * WORD_SIZE, 0);
+
+		std::iota(raw.begin() + PRELOAD, raw.end() - POSTLOAD, first);
+
+		raw.back() = sequence;
+
+		return raw;
+
+	}
+
+	void requireSameBlob(const DataBlob &a, const DataBlob &b) {
+
+		REQUIRE(a.packetCount() == b.packetCount());
+		REQUIRE(a.data() == b.data());
+		REQUIRE(a.warnings() == b.warnings());
+
+		REQUIRE(a.metadata().firstArrival == b.metadata().firstArrival);
+		REQUIRE(a.metadata().lastArrival == b.metadata().lastArrival);
+		REQUIRE(a.metadata().firstSequence == b.metadata().firstSequence);
+		REQUIRE(a.metadata().lastSequence == b.metadata().lastSequence);
+		REQUIRE(a.metadata().rawBytes == b.metadata().rawBytes);
+		REQUIRE(
+			a.metadata().idleWordsRemoved == b.metadata().idleWordsRemoved
+		);
+		REQUIRE(a.metadata().framesRejected == b.metadata().framesRejected);
+		REQUIRE(a.metadata().kernelDrops == b.metadata().kernelDrops);
+		REQUIRE(a.metadata().processingTime == b.metadata().processingTime);
+
+		REQUIRE(a.gaps().size() == b.gaps().size());
+		for(size_t i = 0; i < a.gaps().size(); ++i) {
+
+			REQUIRE(a.gaps()[i].previousSequence 
+				== b.gaps()[i].previousSequence);
+			REQUIRE(a.gaps()[i].nextSequence == b.gaps()[i].nextSequence);
+			REQUIRE(a.gaps()[i].missing == b.gaps()[i].missing);
+			REQUIRE(a.gaps()[i].wordOffset == b.gaps()[i].wordOffset);
+
+		}
+
+		REQUIRE(a.packetIndex().size() == b.packetIndex().size());
+		for(size_t i = 0; i < a.packetIndex().size(); ++i) {
+
+			REQUIRE(a.packetIndex()[i].sequence 
+				== b.packetIndex()[i].sequence);
+			REQUIRE(a.packetIndex()[i].wordCount 
+				== b.packetIndex()[i].wordCount);
+			REQUIRE(a.packetIndex()[i].wordOffset 
+				== b.packetIndex()[i].wordOffset);
+
+		}
+
+	}
+
+}
+
+TEST_CASE("SerializedBlob round trip", "[SerializedBlob]") {
+
+	PacketProcessor processor;
+	processor.setPacketIndexing(true);
+
+	vector<uint8_t> data  = makePacket(3, 0, 1);
+	vector<uint8_t> data2 = makePacket(2, 50, 4);
+
+	vector<Packet> packets;
+	packets.emplace_back(
+		data.data(), 
+		data.size(), 
+		std::chrono::system_clock::now()
+	);
+	packets.emplace_back(
+		data2.data(), 
+		data2.size(), 
+		std::chrono::system_clock::now()
+	);
+
+	CaptureStats stats;
+	stats.framesRejected = 3;
+	stats.kernelDrops = 9;
+
+	DataBlob blob;
+	processor.blobify(packets, blob, stats);
+
+	REQUIRE(blob.gaps().size() == 1);
+	REQUIRE(blob.warnings().size() == 1);
+
+	SECTION("A serialized blob parses back to the same blob") {
+
+		vector<uint8_t> bytes = serializeBlob(blob);
+
+		SerializedBlob serialized(ByteView(bytes.data(), bytes.size()));
+
+		REQUIRE(serialized.size() == bytes.size());
+		REQUIRE(serialized.version() == SerializedBlob::VERSION);
+		REQUIRE(serialized.packetCount() == 2);
+		REQUIRE(serialized.gapCount() == 1);
+		REQUIRE(serialized.packetIndexSize() == 2);
+		REQUIRE(serialized.warningCount() == 1);
+		REQUIRE(serialized.warnings() == blob.warnings());
+		REQUIRE(serialized.gap(0).missing == 2);
+		REQUIRE(serialized.packetIndexEntry(1).sequence == 4);
+
+		requireSameBlob(serialized.toBlob(), blob);
+
+	}
+
+	SECTION("Data is viewed in place without copying") {
+
+		vector<uint8_t> bytes = serializeBlob(blob);
+
+		SerializedBlob serialized(ByteView(bytes.data(), bytes.size()));
+
+		ByteView payload = serialized.data();
+
+		REQUIRE(payload.data() == bytes.data() + bytes.size() - blob.size());
+		REQUIRE(
+			vector<uint8_t>(payload.begin(), payload.end()) == blob.data()
+		);
+
+	}
+
+	SECTION("Empty blobs round trip") {
+
+		vector<uint8_t> bytes = serializeBlob(DataBlob());
+
+		SerializedBlob serialized(ByteView(bytes.data(), bytes.size()));
+
+		REQUIRE(serialized.packetCount() == 0);
+		REQUIRE(serialized.data().empty());
+
+		requireSameBlob(serialized.toBlob(), DataBlob());
+
+	}
+
+	SECTION("Serialized blobs can be stored back to back") {
+
+		vector<uint8_t> bytes = serializeBlob(blob);
+		vector<uint8_t> second = serializeBlob(DataBlob());
+
+		bytes.insert(bytes.end(), second.begin(), second.end());
+
+		SerializedBlob first(ByteView(bytes.data(), bytes.size()));
+		SerializedBlob next(
+			ByteView(
+				bytes.data() + first.size(), 
+				bytes.size() - first.size()
+			)
+		);
+
+		REQUIRE(first.size() + next.size() == bytes.size());
+		REQUIRE(first.packetCount() == 2);
+		REQUIRE(next.packetCount() == 0);
+
+	}
+
+	SECTION("writeSerializedBlob() writes the same bytes as serializeBlob()") {
+
+		FILE *file = tmpfile();
+		REQUIRE(file);
+
+		int fd = fileno(file);
+
+		vector<uint8_t> expected = serializeBlob(blob);
+
+		REQUIRE(writeSerializedBlob(fd, blob) == expected.size());
+
+		vector<uint8_t> written(expected.size());
+		REQUIRE(
+			pread(fd, written.data(), written.size(), 0) 
+				== (ssize_t)written.size()
+		);
+
+		REQUIRE(written == expected);
+
+		fclose(file);
+
+	}
+
+	SECTION("Out of range entries throw") {
+
+		vector<uint8_t> bytes = serializeBlob(blob);
+
+		SerializedBlob serialized(ByteView(bytes.data(), bytes.size()));
+
+		REQUIRE_THROWS_AS(serialized.gap(1), std::out_of_range);
+		REQUIRE_THROWS_AS(
+			serialized.packetIndexEntry(2), 
+			std::out_of_range
+		);
+
+	}
+
+}
+
+TEST_CASE("SerializedBlob rejects malformed input", "[SerializedBlob]") {
+
+	PacketProcessor processor;
+
+	vector<uint8_t> data = makePacket(3, 0, 1);
+
+	vector<Packet> packets;
+	packets.emplace_back(data.data(), data.size());
+
+	vector<uint8_t> bytes = serializeBlob(processor.blobify(packets));
+
+	SECTION("Truncated input is rejected") {
+
+		for(size_t size : { size_t(0), size_t(10), bytes.size() - 1 }) {
+
+			REQUIRE_THROWS_AS(
+				SerializedBlob(ByteView(bytes.data(), size)),
+				std::invalid_argument
+			);
+
+		}
+
+	}
+
+	SECTION("Bad magic numbers are rejected") {
+
+		bytes[0] ^= 0xFF;
+
+		REQUIRE_THROWS_AS(
+			SerializedBlob(ByteView(bytes.data(), bytes.size())),
+			std::invalid_argument
+		);
+
+	}
+
+	SECTION("Unknown versions are rejected") {
+
+		bytes[4] = SerializedBlob::VERSION + 1;
+
+		REQUIRE_THROWS_AS(
+			SerializedBlob(ByteView(bytes.data(), bytes.size())),
+			std::invalid_argument
+		);
+
+	}
+
+	SECTION("Section counts that overrun the blob are rejected") {
+
+		// Claim a huge number of warnings
+		bytes[39] = 0x7F;
+
+		REQUIRE_THROWS_AS(
+			SerializedBlob(ByteView(bytes.data(), bytes.size())),
+			std::invalid_argument
+		);
+
+	}
+
+}
+
+TEST_CASE(
+	"SerializedBlob rejects gaps and index entries outside the data", 
+	"[SerializedBlob]"
+) {
+
+	PacketProcessor processor;
+	processor.setPacketIndexing(true);
+
+	vector<uint8_t> data  = makePacket(3, 0, 1);
+	vector<uint8_t> data2 = makePacket(2, 50, 4);
+
+	vector<Packet> packets;
+	packets.emplace_back(data.data(), data.size());
+	packets.emplace_back(data2.data(), data2.size());
+
+	vector<uint8_t> bytes = serializeBlob(processor.blobify(packets));
+
+	// One gap, then the index entries, follow the header
+	size_t gapStart   = loadU16(bytes.data() + 6);
+	size_t indexStart = gapStart + 24;
+
+	REQUIRE(SerializedBlob(ByteView(bytes.data(), bytes.size())).gapCount()
+		== 1);
+
+	SECTION("Gaps past the end of the data are rejected") {
+
+		storeLittleEndian(&bytes[gapStart + 16], 6, 8);
+
+		REQUIRE_THROWS_AS(
+			SerializedBlob(ByteView(bytes.data(), bytes.size())),
+			std::invalid_argument
+		);
+
+	}
+
+	SECTION("Index entries that overrun the data are rejected") {
+
+		// The second packet's 2 words start at word 3 of 5
+		storeLittleEndian(&bytes[indexStart + 16 + 4], 3, 4);
+
+		REQUIRE_THROWS_AS(
+			SerializedBlob(ByteView(bytes.data(), bytes.size())),
+			std::invalid_argument
+		);
+
+	}
+
+	SECTION("Index entries whose end overflows are rejected") {
+
+		storeLittleEndian(&bytes[indexStart + 4], UINT32_MAX, 4);
+		storeLittleEndian(&bytes[indexStart + 8], UINT64_MAX, 8);
+
+		REQUIRE_THROWS_AS(
+			SerializedBlob(ByteView(bytes.data(), bytes.size())),
+			std::invalid_argument
+		);
+
+	}
+
+}
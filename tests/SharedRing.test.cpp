@@ -0,0 +1,244 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <SharedRing.h>
+#include <PacketProcessor.h>
+
+#include "TestHelpers.h"
+
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <memory>
+
+#include <unistd.h>
+
+using std::vector;
+using std::string;
+
+using namespace DAQCap;
+
+namespace {
+
+	// Checks that a blob is one made by makeBlob()
+	bool consistent(const DataBlob &blob) {
+
+		if(blob.empty()) return false;
+
+		for(size_t i = 1; i < blob.size(); ++i) {
+
+			if(uint8_t(blob.data()[i - 1] + 1) != blob.data()[i]) return false;
+
+		}
+
+		return true;
+
+	}
+
+	string ringName() {
+
+		return perProcessName("/DAQCapRingTest");
+
+	}
+
+}
+
+TEST_CASE("SharedRing", "[SharedRing]") {
+
+	PacketProcessor processor;
+
+	string name = ringName();
+
+	SECTION("Subscribers read blobs in order") {
+
+		SharedRingPublisher publisher(name, 4096);
+		SharedRingSubscriber subscriber(name);
+
+		DataBlob blob;
+		REQUIRE(!subscriber.next(blob));
+
+		vector<DataBlob> blobs;
+		for(int i = 0; i < 5; ++i) {
+
+			blobs.push_back(makeBlob(processor, 10 + i, i * 10));
+			publisher.publish(blobs.back());
+
+		}
+
+		REQUIRE(publisher.published() == 5);
+
+		for(const DataBlob &expected : blobs) {
+
+			REQUIRE(subscriber.next(blob));
+			REQUIRE(blob.data() == expected.data());
+			REQUIRE(blob.packetCount() == expected.packetCount());
+
+		}
+
+		REQUIRE(!subscriber.next(blob));
+		REQUIRE(subscriber.missed() == 0);
+
+	}
+
+	SECTION("Subscribers start at the newest blob") {
+
+		SharedRingPublisher publisher(name, 4096);
+
+		publisher.publish(makeBlob(processor, 10, 0));
+
+		SharedRingSubscriber subscriber(name);
+
+		DataBlob blob;
+		REQUIRE(!subscriber.next(blob));
+
+		DataBlob expected = makeBlob(processor, 10, 50);
+		publisher.publish(expected);
+
+		REQUIRE(subscriber.next(blob));
+		REQUIRE(blob.data() == expected.data());
+
+	}
+
+	SECTION("Records wrap around the end of the ring") {
+
+		SharedRingPublisher publisher(name, 1024);
+		SharedRingSubscriber subscriber(name);
+
+		DataBlob blob;
+
+		for(int i = 0; i < 50; ++i) {
+
+			DataBlob expected = makeBlob(processor, 20 + i % 7, i);
+			publisher.publish(expected);
+
+			REQUIRE(subscriber.next(blob));
+			REQUIRE(blob.data() == expected.data());
+
+		}
+
+		REQUIRE(subscriber.missed() == 0);
+
+	}
+
+	SECTION("Subscribers that fall behind skip ahead") {
+
+		SharedRingPublisher publisher(name, 1024);
+		SharedRingSubscriber subscriber(name);
+
+		DataBlob blob;
+
+		publisher.publish(makeBlob(processor, 20, 0));
+		REQUIRE(subscriber.next(blob));
+
+		// Far more than the ring holds
+		for(int i = 1; i <= 100; ++i) {
+
+			publisher.publish(makeBlob(processor, 20, i));
+
+		}
+
+		REQUIRE(!subscriber.next(blob));
+
+		DataBlob expected = makeBlob(processor, 20, 200);
+		publisher.publish(expected);
+
+		REQUIRE(subscriber.next(blob));
+		REQUIRE(blob.data() == expected.data());
+		REQUIRE(subscriber.missed() == 100);
+
+	}
+
+	SECTION("Subscribers see the ring close") {
+
+		std::unique_ptr<SharedRingPublisher> publisher(
+			new SharedRingPublisher(name, 4096)
+		);
+
+		SharedRingSubscriber subscriber(name);
+
+		DataBlob expected = makeBlob(processor, 10, 0);
+		publisher->publish(expected);
+
+		REQUIRE(!subscriber.closed());
+
+		publisher.reset();
+
+		REQUIRE(subscriber.closed());
+
+		// Blobs published before closing can still be read
+		DataBlob blob;
+		REQUIRE(subscriber.next(blob, std::chrono::milliseconds(1000)));
+		REQUIRE(blob.data() == expected.data());
+
+		REQUIRE(!subscriber.next(blob, std::chrono::milliseconds(1000)));
+
+		REQUIRE_THROWS_AS(SharedRingSubscriber(name), std::runtime_error);
+
+	}
+
+	SECTION("Subscribers read while the publisher writes") {
+
+		const int BLOBS = 2000;
+
+		SharedRingPublisher publisher(name, 4096);
+		SharedRingSubscriber subscriber(name);
+
+		std::thread writer([&]() {
+
+			PacketProcessor writerProcessor;
+
+			for(int i = 0; i < BLOBS; ++i) {
+
+				publisher.publish(makeBlob(writerProcessor, 1 + i % 50, i));
+
+				// Give the subscriber a chance to keep up some of the time
+				if(i % 10 == 0) {
+
+					std::this_thread::sleep_for(std::chrono::microseconds(500));
+
+				}
+
+			}
+
+		});
+
+		uint64_t read = 0;
+		bool valid = true;
+
+		DataBlob blob;
+		while(subscriber.next(blob, std::chrono::milliseconds(200))) {
+
+			valid = valid && consistent(blob);
+			++read;
+
+		}
+
+		writer.join();
+
+		REQUIRE(valid);
+		REQUIRE(read > 0);
+		REQUIRE(read + subscriber.missed() <= BLOBS);
+
+	}
+
+	SECTION("Bad arguments are rejected") {
+
+		REQUIRE_THROWS_AS(
+			SharedRingPublisher(name, 16),
+			std::invalid_argument
+		);
+
+		REQUIRE_THROWS_AS(
+			SharedRingSubscriber(name + "Missing"),
+			std::runtime_error
+		);
+
+		SharedRingPublisher publisher(name, 256);
+
+		REQUIRE_THROWS_AS(
+			publisher.publish(makeBlob(processor, 100, 0)),
+			std::invalid_argument
+		);
+
+	}
+
+}
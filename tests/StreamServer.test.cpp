@@ -0,0 +1,190 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <StreamServer.h>
+#include <PacketProcessor.h>
+
+#include "TestHelpers.h"
+
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <memory>
+
+#include <unistd.h>
+
+using std::vector;
+using std::string;
+
+using namespace DAQCap;
+
+namespace {
+
+	string socketPath() {
+
+		return perProcessName("/tmp/DAQCapStreamTest") + ".sock";
+
+	}
+
+	// Waits for the server to accept a number of subscribers
+	bool waitForSubscribers(const StreamServer &server, size_t count) {
+
+		for(int i = 0; i < 1000; ++i) {
+
+			if(server.subscriberCount() == count) return true;
+
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+		}
+
+		return false;
+
+	}
+
+	const std::chrono::milliseconds TIMEOUT(2000);
+
+}
+
+TEST_CASE("StreamServer", "[StreamServer]") {
+
+	PacketProcessor processor;
+
+	string path = socketPath();
+
+	SECTION("Every subscriber receives every blob in order") {
+
+		StreamServer server(path);
+
+		StreamClient first(path);
+		StreamClient second(path);
+
+		REQUIRE(waitForSubscribers(server, 2));
+
+		vector<DataBlob> blobs;
+		for(int i = 0; i < 20; ++i) {
+
+			blobs.push_back(makeBlob(processor, 1 + i * 100, i));
+			server.publish(blobs.back());
+
+		}
+
+		for(StreamClient *client : {&first, &second}) {
+
+			for(const DataBlob &expected : blobs) {
+
+				DataBlob blob;
+				REQUIRE(client->next(blob, TIMEOUT));
+				REQUIRE(blob.data() == expected.data());
+				REQUIRE(blob.packetCount() == expected.packetCount());
+
+			}
+
+		}
+
+		REQUIRE(server.dropped() == 0);
+
+	}
+
+	SECTION("Clients time out when nothing is sent") {
+
+		StreamServer server(path);
+		StreamClient client(path);
+
+		DataBlob blob;
+		REQUIRE(!client.next(blob, std::chrono::milliseconds(10)));
+		REQUIRE(client.connected());
+
+	}
+
+	SECTION("Slow subscribers lose their oldest blobs") {
+
+		StreamServerOptions options;
+		options.queueLength = 4;
+
+		StreamServer server(path, options);
+		StreamClient client(path);
+
+		REQUIRE(waitForSubscribers(server, 1));
+
+		// Much more than the socket can buffer, while the client isn't
+		// reading
+		const int BLOBS = 200;
+		for(int i = 0; i < BLOBS; ++i) {
+
+			server.publish(makeBlob(processor, 20000, i));
+
+		}
+
+		REQUIRE(server.dropped() > 0);
+
+		DataBlob last = makeBlob(processor, 10, 0);
+		server.publish(last);
+
+		// The stream stays intact, and ends with the newest blob
+		int received = 0;
+		DataBlob blob;
+		while(client.next(blob, std::chrono::milliseconds(500))) {
+
+			++received;
+
+		}
+
+		REQUIRE(blob.data() == last.data());
+		REQUIRE(received + server.dropped() == BLOBS + 1);
+
+	}
+
+	SECTION("Disconnected subscribers are removed") {
+
+		StreamServer server(path);
+
+		std::unique_ptr<StreamClient> client(new StreamClient(path));
+		REQUIRE(waitForSubscribers(server, 1));
+
+		client.reset();
+
+		server.publish(makeBlob(processor, 10, 0));
+		REQUIRE(waitForSubscribers(server, 0));
+
+		// Publishing with no subscribers is fine
+		server.publish(makeBlob(processor, 10, 0));
+
+	}
+
+	SECTION("Clients see the server close") {
+
+		StreamServer server(path);
+		StreamClient client(path);
+
+		server.close();
+
+		DataBlob blob;
+		REQUIRE(!client.next(blob, TIMEOUT));
+		REQUIRE(!client.connected());
+
+		REQUIRE(access(path.data(), F_OK) != 0);
+
+		REQUIRE_THROWS_AS(
+			server.publish(makeBlob(processor, 10, 0)),
+			std::runtime_error
+		);
+
+	}
+
+	SECTION("Bad arguments are rejected") {
+
+		StreamServerOptions options;
+		options.queueLength = 0;
+
+		REQUIRE_THROWS_AS(StreamServer(path, options), std::invalid_argument);
+		REQUIRE_THROWS_AS(
+			StreamServer(string(200, 'x')),
+			std::invalid_argument
+		);
+
+		REQUIRE_THROWS_AS(StreamClient(path), std::runtime_error);
+
+	}
+
+	unlink(path.data());
+
+}
@@ -0,0 +1,150 @@
+/**
+ * @file TestHelpers.h
+ *
+ * @brief Fixtures shared by the unit tests: miniDAQ framing constants, blob
+ * builders, chunked runs and temporary files.
+ *
+ * @author Robert Myers
+ * Contact: romyers@umich.edu
+ */
+
+#pragma once
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <PacketProcessor.h>
+#include <ChunkedFile.h>
+
+#include <numeric>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+
+#include <unistd.h>
+#include <fcntl.h>
+
+// The miniDAQ packet layout the tests build packets with
+const int PRELOAD = 14;
+const int POSTLOAD = 4;
+const int WORD_SIZE = 5;
+
+inline DAQCap::Timestamp secondsAfterEpoch(int seconds) {
+
+	return DAQCap::Timestamp(std::chrono::seconds(seconds));
+
+}
+
+// Builds a blob holding one packet of words of consecutive byte values
+// starting at first
+inline DAQCap::DataBlob makeBlob(
+	DAQCap::PacketProcessor &processor,
+	int words,
+	uint8_t first
+) {
+
+	std::vector<uint8_t> raw(PRELOAD + POSTLOAD + words * WORD_SIZE, 0);
+
+	std::iota(raw.begin() + PRELOAD, raw.end() - POSTLOAD, first);
+
+	std::vector<DAQCap::Packet> packets;
+	packets.emplace_back(raw.data(), raw.size());
+
+	return processor.blobify(packets);
+
+}
+
+// Like makeBlob(processor, words, first), but the packet is numbered
+// sequence and captured sequence seconds after the epoch
+inline DAQCap::DataBlob makeBlob(
+	DAQCap::PacketProcessor &processor,
+	int sequence,
+	int words,
+	uint8_t first
+) {
+
+	std::vector<uint8_t> raw(PRELOAD + POSTLOAD + words * WORD_SIZE, 0);
+
+	std::iota(raw.begin() + PRELOAD, raw.end() - POSTLOAD, first);
+
+	raw[raw.size() - 2] = (sequence >> 8) & 0xFF;
+	raw[raw.size() - 1] = sequence & 0xFF;
+
+	std::vector<DAQCap::Packet> packets;
+	packets.emplace_back(
+		raw.data(),
+		raw.size(),
+		secondsAfterEpoch(sequence)
+	);
+
+	return processor.blobify(packets);
+
+}
+
+// Writes blobs of words each, with consecutive packet numbers from 0, and
+// returns their data
+inline std::vector<uint8_t> writeRun(
+	DAQCap::ChunkedFileSink &sink,
+	int blobs,
+	int words
+) {
+
+	DAQCap::PacketProcessor processor;
+
+	std::vector<uint8_t> expected;
+
+	for(int i = 0; i < blobs; ++i) {
+
+		DAQCap::DataBlob blob = makeBlob(processor, i, words, i);
+
+		expected.insert(
+			expected.end(),
+			blob.view().begin(),
+			blob.view().end()
+		);
+
+		sink.write(std::vector<DAQCap::DataBlob>{blob});
+
+	}
+
+	return expected;
+
+}
+
+// Appends the process ID to a name, so tests that create named system
+// objects don't collide when several test runs happen at once
+inline std::string perProcessName(const std::string &name) {
+
+	return name + std::to_string(getpid());
+
+}
+
+// Makes an empty temporary file and returns its path
+inline std::string makeTempFile() {
+
+	char path[] = "/tmp/DAQCapTestXXXXXX";
+
+	int fd = mkstemp(path);
+	REQUIRE(fd >= 0);
+
+	::close(fd);
+
+	return path;
+
+}
+
+inline std::vector<uint8_t> readFile(const std::string &path) {
+
+	int fd = ::open(path.data(), O_RDONLY);
+	REQUIRE(fd >= 0);
+
+	std::vector<uint8_t> contents(lseek(fd, 0, SEEK_END));
+
+	REQUIRE(pread(fd, contents.data(), contents.size(), 0)
+		== (ssize_t)contents.size());
+
+	::close(fd);
+
+	return contents;
+
+}
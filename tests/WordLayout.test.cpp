@@ -0,0 +1,201 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <WordLayout.h>
+
+#include <vector>
+#include <random>
+
+using std::vector;
+
+using namespace DAQCap;
+
+namespace {
+
+	struct Low    : BitField<0, 8>   {};
+	struct Middle : BitField<12, 5>  {};
+	struct High   : BitField<35, 5>  {};
+	struct Full   : BitField<0, 64>  {};
+
+	typedef WordLayout<High, Low, Middle> TestLayout;
+
+}
+
+TEST_CASE("BitField masks and extraction", "[WordLayout]") {
+
+	SECTION("Masks cover exactly the field's bits") {
+
+		REQUIRE(Low::mask()    == 0xFFull);
+		REQUIRE(Middle::mask() == 0x1F000ull);
+		REQUIRE(High::mask()   == 0xF800000000ull);
+		REQUIRE(Full::mask()   == ~Word(0));
+
+	}
+
+	SECTION("Fields are extracted from the right bits") {
+
+		Word word = 0xA5C3E4F6B7ull;
+
+		REQUIRE(Low::extract(word)    == 0xB7);
+		REQUIRE(Middle::extract(word) == ((word >> 12) & 0x1F));
+		REQUIRE(High::extract(word)   == ((word >> 35) & 0x1F));
+		REQUIRE(Full::extract(word)   == word);
+
+	}
+
+	SECTION("insert replaces only the field's bits") {
+
+		Word word = 0xFFFFFFFFFFull;
+		Word result = Middle::insert(word, 0x3);
+
+		REQUIRE(Middle::extract(result) == 0x3);
+		REQUIRE((result & ~Middle::mask()) == (word & ~Middle::mask()));
+
+	}
+
+	SECTION("insert ignores bits that don't fit in the field") {
+
+		REQUIRE(Middle::insert(0, 0xFF) == Middle::mask());
+
+	}
+
+	SECTION("Extraction is usable in constant expressions") {
+
+		static_assert(High::extract(Word(0x1F) << 35) == 0x1F, "");
+		static_assert(TestLayout::get<Low>(0x1234) == 0x34, "");
+
+	}
+
+}
+
+TEST_CASE("WordLayout decoding", "[WordLayout]") {
+
+	vector<Word> words;
+	for(Word i = 0; i < 1000; ++i) {
+
+		words.push_back(i * 0x9E3779B97Full & 0xFFFFFFFFFFull);
+
+	}
+
+	SECTION("Layout mask combines the field masks") {
+
+		REQUIRE(TestLayout::fieldCount() == 3);
+		REQUIRE(
+			TestLayout::mask() == 
+			(Low::mask() | Middle::mask() | High::mask())
+		);
+
+	}
+
+	SECTION("decode returns fields in layout order") {
+
+		auto fields = TestLayout::decode(words[7]);
+
+		REQUIRE(fields[0] == High::extract(words[7]));
+		REQUIRE(fields[1] == Low::extract(words[7]));
+		REQUIRE(fields[2] == Middle::extract(words[7]));
+
+	}
+
+	SECTION("Batch decode extracts a field from every word") {
+
+		vector<Word> out(words.size());
+		TestLayout::decode<Middle>(words.data(), words.size(), out.data());
+
+		for(size_t i = 0; i < words.size(); ++i) {
+
+			REQUIRE(out[i] == Middle::extract(words[i]));
+
+		}
+
+	}
+
+	SECTION("Batch decode reads directly from a WordView") {
+
+		vector<uint8_t> bytes;
+		for(Word word : words) {
+
+			for(int shift = 32; shift >= 0; shift -= 8) {
+
+				bytes.push_back(static_cast<uint8_t>(word >> shift));
+
+			}
+
+		}
+
+		WordView view(bytes.data(), bytes.size());
+		vector<Word> out(view.size());
+		TestLayout::decode<High>(view, out.data());
+
+		for(size_t i = 0; i < words.size(); ++i) {
+
+			REQUIRE(out[i] == High::extract(words[i]));
+
+		}
+
+	}
+
+}
+
+TEST_CASE("WordLayout gathering", "[WordLayout]") {
+
+	SECTION("Fields are packed in word order") {
+
+		REQUIRE(TestLayout::gatheredOffset<Low>()    == 0);
+		REQUIRE(TestLayout::gatheredOffset<Middle>() == 8);
+		REQUIRE(TestLayout::gatheredOffset<High>()   == 13);
+
+		Word word = Low::insert(0, 0xAB);
+		word = Middle::insert(word, 0x15);
+		word = High::insert(word, 0x0C);
+
+		REQUIRE(
+			TestLayout::gather(word) == 
+			(0xABull | 0x15ull << 8 | 0x0Cull << 13)
+		);
+
+	}
+
+	SECTION("Bits outside the layout are ignored") {
+
+		REQUIRE(TestLayout::gather(~TestLayout::mask()) == 0);
+		REQUIRE(TestLayout::gather(~Word(0)) == (Word(1) << 18) - 1);
+
+	}
+
+	SECTION("Batch gather matches single-word gather") {
+
+		vector<Word> words = { 0, 1, 0xFFFFFFFFFFull, 0x123456789Aull };
+		vector<Word> out(words.size());
+		TestLayout::gather(words.data(), words.size(), out.data());
+
+		for(size_t i = 0; i < words.size(); ++i) {
+
+			REQUIRE(out[i] == TestLayout::gather(words[i]));
+
+		}
+
+	}
+
+	SECTION("Batch gather matches single-word gather for many words") {
+
+		// Long enough for any batched path, with every bit pattern mixed in
+		std::mt19937_64 generator(12345);
+
+		vector<Word> words(1000);
+		for(Word &word : words) word = generator() & 0xFFFFFFFFFFull;
+
+		vector<Word> out(words.size());
+		TestLayout::gather(words.data(), words.size(), out.data());
+
+		for(size_t i = 0; i < words.size(); ++i) {
+
+			REQUIRE(out[i] == TestLayout::gather(words[i]));
+
+		}
+
+		// Gathering nothing writes nothing
+		TestLayout::gather(words.data(), 0, nullptr);
+
+	}
+
+}
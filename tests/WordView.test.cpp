@@ -0,0 +1,180 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <WordView.h>
+
+#include <numeric>
+#include <algorithm>
+
+using std::vector;
+
+using namespace DAQCap;
+
+const size_t WORD_SIZE = 5;
+
+TEST_CASE("WordView construction", "[WordView]") {
+
+	vector<uint8_t> data(WORD_SIZE * 3 + 2);
+	std::iota(data.begin(), data.end(), 0);
+
+	SECTION("Default WordView is empty") {
+
+		WordView view;
+
+		REQUIRE(view.empty());
+		REQUIRE(view.size() == 0);
+		REQUIRE(view.begin() == view.end());
+
+	}
+
+	SECTION("WordView excludes trailing partial words") {
+
+		WordView view(data.data(), data.size());
+
+		REQUIRE(view.size() == 3);
+		REQUIRE(view.bytes().size() == WORD_SIZE * 3);
+
+	}
+
+	SECTION("WordView refers to the viewed bytes without copying") {
+
+		WordView view(ByteView(data.data(), data.size()));
+
+		REQUIRE(view.bytes().data() == data.data());
+
+	}
+
+	SECTION("WordView of an empty blob is empty") {
+
+		DataBlob blob;
+
+		REQUIRE(WordView(blob).empty());
+
+	}
+
+}
+
+TEST_CASE("WordView element access", "[WordView]") {
+
+	vector<uint8_t> data(WORD_SIZE * 3);
+	std::iota(data.begin(), data.end(), 0);
+
+	WordView view(data.data(), data.size());
+
+	SECTION("operator[] decodes words") {
+
+		REQUIRE(view[0] == 0x0001020304);
+		REQUIRE(view[1] == 0x0506070809);
+		REQUIRE(view[2] == 0x0a0b0c0d0e);
+
+	}
+
+	SECTION("at() throws if the index is out of range") {
+
+		REQUIRE(view.at(2) == 0x0a0b0c0d0e);
+		REQUIRE_THROWS_AS(view.at(3), std::out_of_range);
+
+	}
+
+	SECTION("Words agree with packData()") {
+
+		vector<Word> packed = packData(data);
+
+		REQUIRE(vector<Word>(view.begin(), view.end()) == packed);
+
+	}
+
+}
+
+TEST_CASE("WordView::const_iterator", "[WordView]") {
+
+	vector<uint8_t> data(WORD_SIZE * 4);
+	std::iota(data.begin(), data.end(), 0);
+
+	WordView view(data.data(), data.size());
+
+	SECTION("Iterators support random access") {
+
+		WordView::const_iterator it = view.begin();
+
+		REQUIRE(view.end() - view.begin() == 4);
+		REQUIRE(*(it + 2) == view[2]);
+		REQUIRE(it[3] == view[3]);
+
+		it += 3;
+		REQUIRE(*it == view[3]);
+
+		--it;
+		REQUIRE(*it == view[2]);
+
+		REQUIRE(view.begin() < it);
+		REQUIRE(it - 2 == view.begin());
+
+	}
+
+	SECTION("Iterators work with standard algorithms") {
+
+		WordView::const_iterator found = std::find(
+			view.begin(), 
+			view.end(), 
+			Word(0x0a0b0c0d0e)
+		);
+
+		REQUIRE(found - view.begin() == 2);
+
+		REQUIRE(std::is_sorted(view.begin(), view.end()));
+
+	}
+
+}
+
+TEST_CASE("WordView::decode()", "[WordView]") {
+
+	vector<uint8_t> data(WORD_SIZE * 20);
+	std::iota(data.begin(), data.end(), 0);
+
+	WordView view(data.data(), data.size());
+
+	SECTION("decode() decodes a range of words") {
+
+		vector<Word> out(10);
+
+		REQUIRE(view.decode(5, 10, out.data()) == 10);
+
+		for(size_t i = 0; i < out.size(); ++i) {
+
+			REQUIRE(out[i] == view[i + 5]);
+
+		}
+
+	}
+
+	SECTION("decode() stops at the end of the view") {
+
+		vector<Word> out(10, 0);
+
+		REQUIRE(view.decode(15, 10, out.data()) == 5);
+		REQUIRE(out[4] == view[19]);
+		REQUIRE(out[5] == 0);
+
+	}
+
+	SECTION("decode() throws if the first word is out of range") {
+
+		Word out;
+
+		REQUIRE(view.decode(20, 1, &out) == 0);
+		REQUIRE_THROWS_AS(view.decode(21, 1, &out), std::out_of_range);
+
+	}
+
+	SECTION("subview() views a range of words") {
+
+		WordView sub = view.subview(18, 10);
+
+		REQUIRE(sub.size() == 2);
+		REQUIRE(sub[0] == view[18]);
+		REQUIRE_THROWS_AS(view.subview(21, 1), std::out_of_range);
+
+	}
+
+}